@@ -0,0 +1,309 @@
+/* ==============================================================================
+   Analysis Cache Implementation
+   ============================================================================== */
+
+#include "AnalysisCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace AnalysisCache
+{
+namespace
+{
+struct ManifestHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numChunks;
+    uint32_t reserved;
+    uint64_t fileSize;
+    int64_t modifiedNs;
+};
+
+static_assert (sizeof (ManifestHeader) == 32, "ManifestHeader layout");
+
+void setError (std::string* errorMessage, const std::string& text)
+{
+    if (errorMessage != nullptr)
+        *errorMessage = text;
+}
+
+inline uint64_t rotateLeft (uint64_t value, int bits) noexcept
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t finalMix (uint64_t k) noexcept
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+bool readWhole (const std::string& path, std::vector<unsigned char>& bytes)
+{
+    auto* file = std::fopen (path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    std::fseek (file, 0, SEEK_END);
+    const auto size = std::ftell (file);
+    std::fseek (file, 0, SEEK_SET);
+
+    bytes.resize (static_cast<size_t> (size > 0 ? size : 0));
+    const auto numRead = std::fread (bytes.data(), 1, bytes.size(), file);
+    std::fclose (file);
+    return size > 0 && numRead == bytes.size();
+}
+}
+
+std::string Digest::toHex() const
+{
+    char text[33];
+    std::snprintf (text, sizeof (text), "%016llx%016llx",
+                   static_cast<unsigned long long> (high), static_cast<unsigned long long> (low));
+    return text;
+}
+
+Digest hashBytes (const void* data, size_t numBytes, const Digest& seed) noexcept
+{
+    constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+    constexpr uint64_t c2 = 0x4cf5ad432745937full;
+
+    const auto* bytes = static_cast<const unsigned char*> (data);
+    auto h1 = seed.low;
+    auto h2 = seed.high;
+
+    const auto mixBlock = [&h1, &h2] (uint64_t k1, uint64_t k2)
+    {
+        k1 *= c1; k1 = rotateLeft (k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotateLeft (h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotateLeft (k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotateLeft (h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    };
+
+    const auto numBlocks = numBytes / 16;
+    for (size_t block = 0; block < numBlocks; ++block)
+    {
+        uint64_t k[2];
+        std::memcpy (k, bytes + block * 16, sizeof (k));
+        mixBlock (k[0], k[1]);
+    }
+
+    // The tail is zero-padded into one last block; the length folded in below keeps it unambiguous.
+    if (const auto tail = numBytes % 16; tail != 0)
+    {
+        uint64_t k[2] = {};
+        std::memcpy (k, bytes + numBlocks * 16, tail);
+        mixBlock (k[0], k[1]);
+    }
+
+    h1 ^= static_cast<uint64_t> (numBytes);
+    h2 ^= static_cast<uint64_t> (numBytes);
+    h1 += h2;
+    h2 += h1;
+    h1 = finalMix (h1);
+    h2 = finalMix (h2);
+    h1 += h2;
+    h2 += h1;
+
+    Digest digest;
+    digest.high = h2;
+    digest.low = h1;
+    return digest;
+}
+
+Digest Config::digest() const noexcept
+{
+    const uint32_t fields[] = {
+        formatVersion,
+        static_cast<uint32_t> (sizeof (thd_result)),
+        THDCORE_API_VERSION,
+        sampleRate,
+        numChannels,
+        sampleFormat,
+        bytesPerFrame,
+        static_cast<uint32_t> (fftOrder),
+        static_cast<uint32_t> (hopSize),
+        static_cast<uint32_t> (framesPerChunk)
+    };
+
+    return hashBytes (fields, sizeof (fields));
+}
+
+//==============================================================================
+Store::Store (std::string directoryToUse)
+    : directory (std::move (directoryToUse))
+{
+    while (directory.size() > 1 && directory.back() == '/')
+        directory.pop_back();
+}
+
+bool Store::open (std::string* errorMessage)
+{
+    if (directory.empty())
+    {
+        setError (errorMessage, "no cache directory");
+        return false;
+    }
+
+    // mkdir -p
+    for (size_t slash = 1; slash <= directory.size(); ++slash)
+    {
+        if (slash < directory.size() && directory[slash] != '/')
+            continue;
+
+        const auto prefix = directory.substr (0, slash);
+        if (::mkdir (prefix.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            setError (errorMessage, prefix + ": " + std::strerror (errno));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string Store::pathFor (const Digest& key, const char* extension) const
+{
+    return directory + "/" + key.toHex() + extension;
+}
+
+bool Store::writeAtomically (const std::string& path, const void* header, size_t headerSize,
+                             const void* body, size_t bodySize, std::string* errorMessage) const
+{
+    // Unique per process, so analyzers sharing the directory never write the same temporary.
+    const auto temporaryPath = path + ".tmp" + std::to_string (static_cast<long> (::getpid()));
+    auto* file = std::fopen (temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        setError (errorMessage, temporaryPath + ": " + std::strerror (errno));
+        return false;
+    }
+
+    const auto written = std::fwrite (header, headerSize, 1, file) == 1
+                      && (bodySize == 0 || std::fwrite (body, bodySize, 1, file) == 1);
+
+    if (std::fclose (file) != 0 || ! written || std::rename (temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        setError (errorMessage, path + ": write failed");
+        std::remove (temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Store::loadChunk (const Digest& key, uint32_t numChannels, std::vector<thd_result>& results) const
+{
+    std::vector<unsigned char> bytes;
+    if (! readWhole (pathFor (key, ".thdchunk"), bytes) || bytes.size() < sizeof (ChunkHeader))
+        return false;
+
+    ChunkHeader header;
+    std::memcpy (&header, bytes.data(), sizeof (header));
+
+    const auto numResults = header.numFrames * header.numChannels;
+    if (header.magic != chunkMagic || header.version != formatVersion || header.resultSize != sizeof (thd_result)
+        || header.numChannels != numChannels || bytes.size() != sizeof (header) + numResults * sizeof (thd_result))
+        return false;
+
+    results.resize (static_cast<size_t> (numResults));
+    std::memcpy (results.data(), bytes.data() + sizeof (header), results.size() * sizeof (thd_result));
+    return true;
+}
+
+bool Store::storeChunk (const Digest& key, uint32_t numChannels, const thd_result* results, size_t numFrames,
+                        std::string* errorMessage) const
+{
+    ChunkHeader header;
+    std::memset (&header, 0, sizeof (header));
+    header.magic = chunkMagic;
+    header.version = formatVersion;
+    header.resultSize = sizeof (thd_result);
+    header.numChannels = numChannels;
+    header.numFrames = numFrames;
+
+    return writeAtomically (pathFor (key, ".thdchunk"), &header, sizeof (header),
+                            results, numFrames * numChannels * sizeof (thd_result), errorMessage);
+}
+
+bool Store::loadManifest (const Digest& fileKey, Manifest& manifest) const
+{
+    std::vector<unsigned char> bytes;
+    if (! readWhole (pathFor (fileKey, ".thdmanifest"), bytes) || bytes.size() < sizeof (ManifestHeader))
+        return false;
+
+    ManifestHeader header;
+    std::memcpy (&header, bytes.data(), sizeof (header));
+
+    if (header.magic != manifestMagic || header.version != formatVersion
+        || bytes.size() != sizeof (header) + static_cast<size_t> (header.numChunks) * 2 * sizeof (uint64_t))
+        return false;
+
+    manifest.fileSize = header.fileSize;
+    manifest.modifiedNs = header.modifiedNs;
+    manifest.chunkKeys.resize (header.numChunks);
+
+    for (size_t chunk = 0; chunk < manifest.chunkKeys.size(); ++chunk)
+    {
+        uint64_t words[2];
+        std::memcpy (words, bytes.data() + sizeof (header) + chunk * sizeof (words), sizeof (words));
+        manifest.chunkKeys[chunk].high = words[0];
+        manifest.chunkKeys[chunk].low = words[1];
+    }
+
+    return true;
+}
+
+bool Store::storeManifest (const Digest& fileKey, const Manifest& manifest, std::string* errorMessage) const
+{
+    ManifestHeader header;
+    std::memset (&header, 0, sizeof (header));
+    header.magic = manifestMagic;
+    header.version = formatVersion;
+    header.numChunks = static_cast<uint32_t> (manifest.chunkKeys.size());
+    header.fileSize = manifest.fileSize;
+    header.modifiedNs = manifest.modifiedNs;
+
+    std::vector<uint64_t> words;
+    words.reserve (manifest.chunkKeys.size() * 2);
+    for (const auto& key : manifest.chunkKeys)
+    {
+        words.push_back (key.high);
+        words.push_back (key.low);
+    }
+
+    return writeAtomically (pathFor (fileKey, ".thdmanifest"), &header, sizeof (header),
+                            words.data(), words.size() * sizeof (uint64_t), errorMessage);
+}
+
+Digest Store::manifestKeyFor (const std::string& canonicalPath, const Config& config) noexcept
+{
+    return hashBytes (canonicalPath.data(), canonicalPath.size(), config.digest());
+}
+
+std::string Store::defaultDirectory()
+{
+    if (const auto* configured = std::getenv ("THD_ANALYZE_CACHE"); configured != nullptr && *configured != '\0')
+        return configured;
+
+    if (const auto* cacheHome = std::getenv ("XDG_CACHE_HOME"); cacheHome != nullptr && *cacheHome != '\0')
+        return std::string (cacheHome) + "/thd-analyzer";
+
+    if (const auto* home = std::getenv ("HOME"); home != nullptr && *home != '\0')
+        return std::string (home) + "/.cache/thd-analyzer";
+
+    return {};
+}
+}
@@ -0,0 +1,118 @@
+/* ==============================================================================
+   Analysis Cache
+   On-disk cache of per-chunk analysis results for the offline analyzer, so
+   re-running QC on a file after a small edit only re-analyses what changed.
+
+   A file is cut into fixed chunks of whole analysis frames. A chunk's key is
+   a 128-bit hash of exactly the bytes its frames read (the chunk plus the
+   overlap into the next one), seeded with a digest of everything else that
+   decides the results: sample format, rate, channels, FFT size, hop and
+   chunk length. Equal keys therefore mean equal results, wherever the chunk
+   sits in whichever file. Results are stored frame-relative, one file per
+   chunk: <key>.thdchunk, a 32-byte ChunkHeader followed by the thd_result
+   array exactly as the engine wrote it.
+
+   A manifest per (file path, config) records the file's size, modification
+   time and chunk keys. When both still match, every chunk is loaded by key
+   without reading or hashing any audio, so an unchanged file returns at the
+   speed of reading its results.
+
+   Writes go to a temporary file and are renamed into place, so concurrent
+   analyzers sharing a cache directory never see a partial entry.
+   ============================================================================== */
+
+#pragma once
+
+#include "thdcore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AnalysisCache
+{
+constexpr uint32_t chunkMagic = 0x4B444854;      // "THDK" in file order
+constexpr uint32_t manifestMagic = 0x4D444854;   // "THDM" in file order
+constexpr uint32_t formatVersion = 1;
+
+struct Digest
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator== (const Digest& other) const noexcept { return high == other.high && low == other.low; }
+    bool operator!= (const Digest& other) const noexcept { return ! (*this == other); }
+
+    /** 32 lowercase hex digits, used as the cache file name. */
+    std::string toHex() const;
+};
+
+/** 128-bit Murmur3-style hash of numBytes, chained from seed. Not cryptographic. */
+Digest hashBytes (const void* data, size_t numBytes, const Digest& seed = {}) noexcept;
+
+/** Everything besides the audio bytes that decides a chunk's results. */
+struct Config
+{
+    uint32_t sampleRate = 0;
+    uint32_t numChannels = 0;
+    uint32_t sampleFormat = 0;   // tool-defined code of the stored sample encoding
+    uint32_t bytesPerFrame = 0;  // one sample of every channel, as stored
+    int32_t fftOrder = THD_DEFAULT_FFT_ORDER;
+    int32_t hopSize = 0;
+    int32_t framesPerChunk = 0;
+
+    Digest digest() const noexcept;
+};
+
+struct ChunkHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t resultSize;         // sizeof (thd_result) when written
+    uint32_t numChannels;
+    uint64_t numFrames;
+    uint64_t reserved;
+};
+
+static_assert (sizeof (ChunkHeader) == 32, "ChunkHeader layout");
+
+struct Manifest
+{
+    uint64_t fileSize = 0;
+    int64_t modifiedNs = 0;
+    std::vector<Digest> chunkKeys;
+};
+
+class Store
+{
+public:
+    explicit Store (std::string directory);
+
+    const std::string& getDirectory() const noexcept { return directory; }
+
+    /** Creates the directory (and parents) if needed. */
+    bool open (std::string* errorMessage = nullptr);
+
+    /** Frame-major results of the chunk with this key; false if absent or unreadable. */
+    bool loadChunk (const Digest& key, uint32_t numChannels, std::vector<thd_result>& results) const;
+    bool storeChunk (const Digest& key, uint32_t numChannels, const thd_result* results, size_t numFrames,
+                     std::string* errorMessage = nullptr) const;
+
+    /** Manifests are keyed by fileKey (see manifestKeyFor). */
+    bool loadManifest (const Digest& fileKey, Manifest& manifest) const;
+    bool storeManifest (const Digest& fileKey, const Manifest& manifest, std::string* errorMessage = nullptr) const;
+
+    static Digest manifestKeyFor (const std::string& canonicalPath, const Config& config) noexcept;
+
+    /** XDG cache location: $THD_ANALYZE_CACHE, else $XDG_CACHE_HOME/thd-analyzer, else ~/.cache/thd-analyzer. */
+    static std::string defaultDirectory();
+
+private:
+    std::string pathFor (const Digest& key, const char* extension) const;
+    bool writeAtomically (const std::string& path, const void* header, size_t headerSize,
+                          const void* body, size_t bodySize, std::string* errorMessage) const;
+
+    std::string directory;
+};
+}
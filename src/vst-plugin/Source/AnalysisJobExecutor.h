@@ -0,0 +1,33 @@
+/* ==============================================================================
+   Analysis Job Executor
+   Runs a batch of independent analysis jobs and returns once all are done.
+
+   processBlock hands each hop's jobs (one per analysis lane) to an executor.
+   The default executor runs them in order on the calling thread; plugin
+   formats whose hosts lend worker threads (CLAP thread-pool) provide an
+   executor that fans the jobs out and blocks until they complete.
+   ============================================================================== */
+
+#pragma once
+
+class AnalysisJobExecutor
+{
+public:
+    /** Must be safe to call concurrently for different job indices. */
+    using JobFunction = void (*) (void* context, int jobIndex) noexcept;
+
+    virtual ~AnalysisJobExecutor() = default;
+
+    /** Runs job (context, 0 .. numJobs - 1); every job has finished when this returns. */
+    virtual void run (int numJobs, JobFunction job, void* context) noexcept = 0;
+};
+
+class SerialAnalysisJobExecutor final : public AnalysisJobExecutor
+{
+public:
+    void run (int numJobs, JobFunction job, void* context) noexcept override
+    {
+        for (int jobIndex = 0; jobIndex < numJobs; ++jobIndex)
+            job (context, jobIndex);
+    }
+};
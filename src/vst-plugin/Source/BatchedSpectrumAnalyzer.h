@@ -0,0 +1,317 @@
+/* ==============================================================================
+   Batched Spectrum Analyzer
+   Analyses up to numLanes equal-sized frames at once, one channel per SIMD lane.
+
+   Frames are gathered into a bin-major structure-of-arrays block
+   (value[index * numLanes + lane]) so every butterfly, magnitude and sum is a
+   fixed-width loop over lanes that the compiler turns into vector code. The
+   real FFT is computed as a half-size complex FFT of even/odd sample pairs
+   followed by the usual split step. Windowing and scaling match FFTAnalyzer
+   (normalised Hann, unscaled forward transform), so results agree with the
+   scalar path to rounding.
+
+   Only the per-lane harmonic peak picks are scalar; the noise sum uses a
+   per-lane exclusion mask so it stays lane-parallel too.
+
+   An optional residual power spectrum (a calibration profile, see
+   CalibrationProfile.h) is subtracted from every lane before any of this.
+
+   keepComplexSpectrum also keeps X[k] itself (not just |X[k]|^2) for callers
+   that need phase, such as the reference-mode cross-spectra.
+   ============================================================================== */
+
+#pragma once
+
+#include "HarmonicAnalysis.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+template <int fftOrder, int numLanes, bool keepComplexSpectrum = false>
+class BatchedSpectrumAnalyzer
+{
+public:
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int maxLanes = numLanes;
+
+    BatchedSpectrumAnalyzer()
+        : window (static_cast<size_t> (fftSize)),
+          frame (static_cast<size_t> (fftSize) * numLanes),
+          real (static_cast<size_t> (halfSize) * numLanes),
+          imag (static_cast<size_t> (halfSize) * numLanes),
+          magSquared (static_cast<size_t> (halfSize) * numLanes),
+          spectrumReal (keepComplexSpectrum ? static_cast<size_t> (halfSize) * numLanes : 0),
+          spectrumImag (keepComplexSpectrum ? static_cast<size_t> (halfSize) * numLanes : 0),
+          noiseMask (static_cast<size_t> (halfSize) * numLanes),
+          bitReversed (static_cast<size_t> (halfSize)),
+          twiddleCos (static_cast<size_t> (halfSize)),
+          twiddleSin (static_cast<size_t> (halfSize)),
+          splitCos (static_cast<size_t> (halfSize)),
+          splitSin (static_cast<size_t> (halfSize))
+    {
+        constexpr double pi = 3.14159265358979323846;
+
+        // Symmetric Hann normalised so the window sums to fftSize, as juce::dsp::WindowingFunction does.
+        double windowSum = 0.0;
+        for (int i = 0; i < fftSize; ++i)
+        {
+            const auto w = 0.5 - 0.5 * std::cos (2.0 * pi * i / (fftSize - 1));
+            window[static_cast<size_t> (i)] = static_cast<float> (w);
+            windowSum += w;
+        }
+
+        const auto windowScale = static_cast<float> (fftSize / windowSum);
+        for (auto& w : window)
+            w *= windowScale;
+
+        for (int i = 0; i < halfSize; ++i)
+        {
+            int reversed = 0;
+            for (int bit = 0; bit < fftOrder - 1; ++bit)
+                reversed |= ((i >> bit) & 1) << (fftOrder - 2 - bit);
+
+            bitReversed[static_cast<size_t> (i)] = reversed;
+            twiddleCos[static_cast<size_t> (i)] = static_cast<float> (std::cos (2.0 * pi * i / halfSize));
+            twiddleSin[static_cast<size_t> (i)] = static_cast<float> (std::sin (2.0 * pi * i / halfSize));
+            splitCos[static_cast<size_t> (i)] = static_cast<float> (std::cos (2.0 * pi * i / fftSize));
+            splitSin[static_cast<size_t> (i)] = static_cast<float> (std::sin (2.0 * pi * i / fftSize));
+        }
+    }
+
+    /** Analyses laneInputs[0 .. numActiveLanes - 1] (each fftSize samples, oldest first).
+        Sample i of a lane is read from laneInputs[lane][i * inputStride], so interleaved
+        buffers can be analysed in place.
+    */
+    void analyze (const float* const* laneInputs, int numActiveLanes, float sampleRate, HarmonicAnalysis::Result* results,
+                  size_t inputStride = 1)
+    {
+        numActiveLanes = std::min (numActiveLanes, numLanes);
+        if (numActiveLanes <= 0 || sampleRate <= 0.0f)
+            return;
+
+        std::array<float, numLanes> sumSquares {};
+        gather (laneInputs, numActiveLanes, inputStride, sumSquares);
+        transform();
+
+        if (residualPower != nullptr)
+            HarmonicAnalysis::subtractResidualPower<numLanes> (magSquared.data(), residualPower, halfSize);
+
+        const auto band = HarmonicAnalysis::fundamentalSearchBand (fftSize, sampleRate);
+
+        std::array<float, numLanes> maxMag {};
+        std::array<int, numLanes> peakBin {};
+        std::array<float, numLanes> totalPower {};
+
+        for (int bin = band.minBin; bin < halfSize; ++bin)
+        {
+            const auto* row = magSquared.data() + static_cast<size_t> (bin) * numLanes;
+
+            for (int lane = 0; lane < numLanes; ++lane)
+                totalPower[lane] += row[lane];
+
+            if (bin > band.maxBin)
+                continue;
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                const auto isPeak = row[lane] > maxMag[lane];
+                maxMag[lane] = isPeak ? row[lane] : maxMag[lane];
+                peakBin[lane] = isPeak ? bin : peakBin[lane];
+            }
+        }
+
+        std::fill (noiseMask.begin(), noiseMask.end(), 1.0f);
+        std::array<HarmonicAnalysis::HarmonicBins, numLanes> harmonicBins {};
+        std::array<float, numLanes> harmonicPower {};
+        std::array<bool, numLanes> measured {};
+
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+        {
+            auto& result = results[lane];
+            result = {};
+
+            const auto level = std::sqrt (sumSquares[lane] / static_cast<float> (fftSize));
+            measured[lane] = HarmonicAnalysis::classifyFundamental (result, peakBin[lane], maxMag[lane], totalPower[lane], level, fftSize, sampleRate);
+
+            if (! measured[lane])
+                continue;
+
+            harmonicBins[lane] = HarmonicAnalysis::harmonicBinsFor (result.fundamentalFrequency, fftSize, sampleRate);
+            harmonicPower[lane] = HarmonicAnalysis::measureHarmonics (result, magSquared.data() + lane, numLanes, fftSize, maxMag[lane], harmonicBins[lane]);
+
+            HarmonicAnalysis::forEachHarmonicRegion (harmonicBins[lane], band.minBin, fftSize, [this, lane] (int first, int last)
+            {
+                for (int bin = first; bin <= last; ++bin)
+                    noiseMask[static_cast<size_t> (bin) * numLanes + static_cast<size_t> (lane)] = 0.0f;
+            });
+        }
+
+        std::array<float, numLanes> noise {};
+        for (int bin = band.minBin; bin < halfSize; ++bin)
+        {
+            const auto* row = magSquared.data() + static_cast<size_t> (bin) * numLanes;
+            const auto* mask = noiseMask.data() + static_cast<size_t> (bin) * numLanes;
+
+            for (int lane = 0; lane < numLanes; ++lane)
+                noise[lane] += row[lane] * mask[lane];
+        }
+
+        for (int lane = 0; lane < numActiveLanes; ++lane)
+            if (measured[lane])
+                HarmonicAnalysis::finishNoise (results[lane], harmonicPower[lane], noise[lane], maxMag[lane]);
+    }
+
+    /** fftSize / 2 bin powers subtracted from every lane's spectrum before analysis, or
+        nullptr for none. The array is read in place, not copied, and must outlive its use.
+    */
+    void setResidualPower (const float* residualPowerPerBin) noexcept { residualPower = residualPowerPerBin; }
+
+    /** Power spectrum of the last batch, bin-major (bin * numLanes + lane), fftSize / 2 bins. */
+    const float* getPowerSpectrum() const noexcept { return magSquared.data(); }
+
+    /** Complex spectrum of the last batch, same layout as the power spectrum. */
+    const float* getSpectrumReal() const noexcept
+    {
+        static_assert (keepComplexSpectrum, "Instantiate with keepComplexSpectrum to read the complex spectrum");
+        return spectrumReal.data();
+    }
+
+    const float* getSpectrumImag() const noexcept
+    {
+        static_assert (keepComplexSpectrum, "Instantiate with keepComplexSpectrum to read the complex spectrum");
+        return spectrumImag.data();
+    }
+
+private:
+    static constexpr int halfSize = fftSize / 2;
+
+    // Complex entries per cache block: re + im for all lanes in roughly 32 KB.
+    static constexpr int cacheBlockEntries = std::max (2, 4096 / numLanes);
+
+    void radix2Pass (int span, int first, int last) noexcept
+    {
+        const auto twiddleStride = halfSize / (2 * span);
+
+        for (int start = first; start < last; start += 2 * span)
+        {
+            for (int k = 0; k < span; ++k)
+            {
+                const auto c = twiddleCos[static_cast<size_t> (k * twiddleStride)];
+                const auto s = twiddleSin[static_cast<size_t> (k * twiddleStride)];
+                auto* aRe = real.data() + static_cast<size_t> (start + k) * numLanes;
+                auto* aIm = imag.data() + static_cast<size_t> (start + k) * numLanes;
+                auto* bRe = aRe + static_cast<size_t> (span) * numLanes;
+                auto* bIm = aIm + static_cast<size_t> (span) * numLanes;
+
+                // b * e^{-i theta}
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    const auto tRe = bRe[lane] * c + bIm[lane] * s;
+                    const auto tIm = bIm[lane] * c - bRe[lane] * s;
+                    bRe[lane] = aRe[lane] - tRe;
+                    bIm[lane] = aIm[lane] - tIm;
+                    aRe[lane] += tRe;
+                    aIm[lane] += tIm;
+                }
+            }
+        }
+    }
+
+    void gather (const float* const* laneInputs, int numActiveLanes, size_t inputStride, std::array<float, numLanes>& sumSquares)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const auto* input = lane < numActiveLanes ? laneInputs[lane] : nullptr;
+            float energy = 0.0f;
+
+            for (int i = 0; i < fftSize; ++i)
+            {
+                const auto sample = input != nullptr ? input[static_cast<size_t> (i) * inputStride] : 0.0f;
+                energy += sample * sample;
+                frame[static_cast<size_t> (i) * numLanes + static_cast<size_t> (lane)] = sample * window[static_cast<size_t> (i)];
+            }
+
+            sumSquares[lane] = energy;
+        }
+    }
+
+    void transform()
+    {
+        // z[m] = x[2m] + i x[2m+1], loaded in bit-reversed order for the in-place radix-2 passes.
+        for (int m = 0; m < halfSize; ++m)
+        {
+            const auto source = static_cast<size_t> (bitReversed[static_cast<size_t> (m)]);
+            const auto* even = frame.data() + (2 * source) * numLanes;
+            const auto* odd = even + numLanes;
+            auto* re = real.data() + static_cast<size_t> (m) * numLanes;
+            auto* im = imag.data() + static_cast<size_t> (m) * numLanes;
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                re[lane] = even[lane];
+                im[lane] = odd[lane];
+            }
+        }
+
+        // Early passes only touch groups of 2 * span entries, so they run block by
+        // block while the block is cache-resident; later passes sweep the whole array.
+        constexpr int blockSize = std::min (halfSize, cacheBlockEntries);
+
+        for (int blockStart = 0; blockStart < halfSize; blockStart += blockSize)
+            for (int span = 1; span < blockSize; span *= 2)
+                radix2Pass (span, blockStart, blockStart + blockSize);
+
+        for (int span = blockSize; span < halfSize; span *= 2)
+            radix2Pass (span, 0, halfSize);
+
+        // Split: X[k] = E[k] + e^{-2 pi i k / N} O[k], with E/O recovered from Z[k] and conj(Z[M-k]).
+        for (int k = 0; k < halfSize; ++k)
+        {
+            const auto mirror = static_cast<size_t> ((halfSize - k) % halfSize);
+            const auto* zRe = real.data() + static_cast<size_t> (k) * numLanes;
+            const auto* zIm = imag.data() + static_cast<size_t> (k) * numLanes;
+            const auto* mRe = real.data() + mirror * numLanes;
+            const auto* mIm = imag.data() + mirror * numLanes;
+            auto* power = magSquared.data() + static_cast<size_t> (k) * numLanes;
+            auto* outRe = keepComplexSpectrum ? spectrumReal.data() + static_cast<size_t> (k) * numLanes : nullptr;
+            auto* outIm = keepComplexSpectrum ? spectrumImag.data() + static_cast<size_t> (k) * numLanes : nullptr;
+            const auto c = splitCos[static_cast<size_t> (k)];
+            const auto s = splitSin[static_cast<size_t> (k)];
+
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                const auto eRe = 0.5f * (zRe[lane] + mRe[lane]);
+                const auto eIm = 0.5f * (zIm[lane] - mIm[lane]);
+                const auto oRe = 0.5f * (zIm[lane] + mIm[lane]);
+                const auto oIm = -0.5f * (zRe[lane] - mRe[lane]);
+                const auto xRe = eRe + c * oRe + s * oIm;
+                const auto xIm = eIm + c * oIm - s * oRe;
+                power[lane] = xRe * xRe + xIm * xIm;
+
+                if constexpr (keepComplexSpectrum)
+                {
+                    outRe[lane] = xRe;
+                    outIm[lane] = xIm;
+                }
+            }
+        }
+    }
+
+    std::vector<float> window;
+    std::vector<float> frame;
+    std::vector<float> real;
+    std::vector<float> imag;
+    std::vector<float> magSquared;
+    std::vector<float> spectrumReal;
+    std::vector<float> spectrumImag;
+    std::vector<float> noiseMask;
+    std::vector<int> bitReversed;
+    std::vector<float> twiddleCos;
+    std::vector<float> twiddleSin;
+    std::vector<float> splitCos;
+    std::vector<float> splitSin;
+    const float* residualPower = nullptr;
+};
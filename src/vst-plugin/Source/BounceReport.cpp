@@ -0,0 +1,158 @@
+/* ==============================================================================
+   Bounce Report Implementation
+   ============================================================================== */
+
+#include "BounceReport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+const char* const laneNames[BounceReport::maxLanes] { "mono", "left", "right" };
+
+struct Distribution
+{
+    float minimum = 0.0f;
+    float mean = 0.0f;
+    float median = 0.0f;
+    float percentile95 = 0.0f;
+    float maximum = 0.0f;
+};
+
+// Sorts values in place; nearest-rank percentiles.
+Distribution describe (std::vector<float>& values)
+{
+    Distribution d;
+    if (values.empty())
+        return d;
+
+    std::sort (values.begin(), values.end());
+
+    double sum = 0.0;
+    for (const auto v : values)
+        sum += v;
+
+    const auto rank = [&values] (double fraction)
+    {
+        const auto index = static_cast<size_t> (fraction * static_cast<double> (values.size() - 1) + 0.5);
+        return values[std::min (index, values.size() - 1)];
+    };
+
+    d.minimum = values.front();
+    d.mean = static_cast<float> (sum / static_cast<double> (values.size()));
+    d.median = rank (0.5);
+    d.percentile95 = rank (0.95);
+    d.maximum = values.back();
+    return d;
+}
+}
+
+void BounceReport::begin (int channel, double rate, int size, int hop, int lanes)
+{
+    clear();
+    started = true;
+    channelId = channel;
+    sampleRate = rate;
+    fftSize = size;
+    hopSize = hop;
+    numLanes = std::clamp (lanes, 1, maxLanes);
+}
+
+void BounceReport::clear()
+{
+    started = false;
+    hops.clear();
+}
+
+bool BounceReport::write (const std::string& path, std::string* errorMessage) const
+{
+    auto* file = std::fopen (path.c_str(), "w");
+    if (file == nullptr)
+    {
+        if (errorMessage != nullptr)
+            *errorMessage = path + ": " + std::strerror (errno);
+
+        return false;
+    }
+
+    const auto firstSeconds = hops.empty() ? 0.0 : hops.front().timelineSeconds;
+    const auto lastSeconds = hops.empty() ? 0.0 : hops.back().timelineSeconds;
+
+    std::fprintf (file, "# THD Analyzer bounce report\n");
+    std::fprintf (file, "# channel=%d sample_rate=%.0f fft=%d hop=%d hops=%zu start_s=%.6f end_s=%.6f\n",
+                  channelId, sampleRate, fftSize, hopSize, hops.size(), firstSeconds, lastSeconds);
+    std::fprintf (file, "# lane,valid_hops,thd_min,thd_mean,thd_p50,thd_p95,thd_max,"
+                        "thdn_min,thdn_mean,thdn_p50,thdn_p95,thdn_max,level_max,f0_median_hz\n");
+
+    std::vector<float> thd, thdN, fundamental;
+    thd.reserve (hops.size());
+    thdN.reserve (hops.size());
+    fundamental.reserve (hops.size());
+
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        thd.clear();
+        thdN.clear();
+        fundamental.clear();
+        float levelMax = 0.0f;
+
+        for (const auto& hop : hops)
+        {
+            const auto& result = hop.lanes[static_cast<size_t> (lane)];
+            levelMax = std::max (levelMax, result.level);
+
+            if (! result.fundamentalValid)
+                continue;
+
+            thd.push_back (result.thd);
+            thdN.push_back (result.thdN);
+            fundamental.push_back (result.fundamentalFrequency);
+        }
+
+        const auto validHops = thd.size();
+        const auto thdStats = describe (thd);
+        const auto thdNStats = describe (thdN);
+        const auto fundamentalStats = describe (fundamental);
+
+        std::fprintf (file, "# %s,%zu,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                      laneNames[lane], validHops,
+                      static_cast<double> (thdStats.minimum), static_cast<double> (thdStats.mean),
+                      static_cast<double> (thdStats.median), static_cast<double> (thdStats.percentile95),
+                      static_cast<double> (thdStats.maximum),
+                      static_cast<double> (thdNStats.minimum), static_cast<double> (thdNStats.mean),
+                      static_cast<double> (thdNStats.median), static_cast<double> (thdNStats.percentile95),
+                      static_cast<double> (thdNStats.maximum),
+                      static_cast<double> (levelMax), static_cast<double> (fundamentalStats.median));
+    }
+
+    std::fputs ("time_s,lane,valid,f0_hz,thd_pct,thdn_pct,level_rms,noise_floor,h2,h3,h4,h5,h6,h7,h8\n", file);
+
+    for (const auto& hop : hops)
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const auto& result = hop.lanes[static_cast<size_t> (lane)];
+            std::fprintf (file, "%.6f,%s,%d,%.6g,%.6g,%.6g,%.6g,%.6g",
+                          hop.timelineSeconds, laneNames[lane], result.fundamentalValid ? 1 : 0,
+                          static_cast<double> (result.fundamentalFrequency),
+                          static_cast<double> (result.thd), static_cast<double> (result.thdN),
+                          static_cast<double> (result.level), static_cast<double> (result.noiseFloor));
+
+            for (const auto harmonic : result.harmonics)
+                std::fprintf (file, ",%.6g", static_cast<double> (harmonic));
+
+            std::fputc ('\n', file);
+        }
+    }
+
+    const auto ok = std::ferror (file) == 0;
+    std::fclose (file);
+
+    if (! ok && errorMessage != nullptr)
+        *errorMessage = path + ": write failed";
+
+    return ok;
+}
@@ -0,0 +1,55 @@
+/* ==============================================================================
+   Bounce Report
+   Per-hop measurements collected during an offline render, written as one CSV
+   file when the render ends.
+
+   Each hop is keyed to the timeline position of its frame centre and holds one
+   unsmoothed result per analysis lane (mono sum, left, right). The file starts
+   with '#' summary lines (per-lane valid-hop count and min / mean / median /
+   95th percentile / max of THD and THD+N), followed by the per-hop table:
+     time_s,lane,valid,f0_hz,thd_pct,thdn_pct,level_rms,noise_floor,h2,...,h8
+   ============================================================================== */
+
+#pragma once
+
+#include "HarmonicAnalysis.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class BounceReport
+{
+public:
+    static constexpr int maxLanes = 3;
+
+    struct Hop
+    {
+        double timelineSeconds = 0.0;
+        std::array<HarmonicAnalysis::Result, maxLanes> lanes {};
+    };
+
+    /** Clears collected hops and records the settings printed in the summary. */
+    void begin (int channelId, double sampleRate, int fftSize, int hopSize, int numLanes);
+    bool isStarted() const noexcept { return started; }
+
+    /** Offline rendering has no deadline, so hops are simply appended. */
+    void add (const Hop& hop) { hops.push_back (hop); }
+
+    size_t getNumHops() const noexcept { return hops.size(); }
+
+    bool write (const std::string& path, std::string* errorMessage = nullptr) const;
+
+    /** Forgets all hops; the next begin() starts a new report. */
+    void clear();
+
+private:
+    bool started = false;
+    int channelId = 0;
+    double sampleRate = 0.0;
+    int fftSize = 0;
+    int hopSize = 0;
+    int numLanes = 1;
+    std::vector<Hop> hops;
+};
@@ -0,0 +1,267 @@
+/* ==============================================================================
+   Calibration Profile Implementation
+   ============================================================================== */
+
+#include "CalibrationProfile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined (__unix__) || defined (__APPLE__)
+ #define THD_CALIBRATION_HAS_MMAP 1
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#else
+ #define THD_CALIBRATION_HAS_MMAP 0
+#endif
+
+namespace CalibrationProfile
+{
+namespace
+{
+const char* windowName (Window window) noexcept
+{
+    return window == Window::hann ? "hann" : "unknown";
+}
+
+void setError (std::string* errorMessage, const std::string& text)
+{
+    if (errorMessage != nullptr)
+        *errorMessage = text;
+}
+
+struct ProfileCache
+{
+    std::mutex lock;
+    std::map<std::string, std::weak_ptr<const Profile>> profiles;
+};
+
+ProfileCache& getProfileCache()
+{
+    static ProfileCache cache;
+    return cache;
+}
+}
+
+std::string fileNameFor (const Key& key)
+{
+    return "residual-" + std::to_string (key.sampleRate) + "-" + std::to_string (key.fftSize) + "-" + windowName (key.window) + ".thdcal";
+}
+
+//==============================================================================
+Profile::~Profile()
+{
+   #if THD_CALIBRATION_HAS_MMAP
+    if (mapping != nullptr)
+        ::munmap (const_cast<void*> (mapping), mappingSize);
+   #endif
+}
+
+std::shared_ptr<const Profile> Profile::open (const std::string& path, const Key& key, std::string* errorMessage)
+{
+    std::shared_ptr<Profile> profile (new Profile());
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+   #if THD_CALIBRATION_HAS_MMAP
+    const auto fd = ::open (path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return nullptr;
+    }
+
+    struct stat info {};
+    if (::fstat (fd, &info) != 0 || info.st_size < static_cast<off_t> (sizeof (FileHeader)))
+    {
+        ::close (fd);
+        setError (errorMessage, path + ": not a calibration profile");
+        return nullptr;
+    }
+
+    size = static_cast<size_t> (info.st_size);
+    auto* mapped = ::mmap (nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return nullptr;
+    }
+
+    profile->mapping = mapped;
+    profile->mappingSize = size;
+    data = static_cast<const unsigned char*> (mapped);
+   #else
+    auto* file = std::fopen (path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return nullptr;
+    }
+
+    std::fseek (file, 0, SEEK_END);
+    size = static_cast<size_t> (std::max (0L, std::ftell (file)));
+    std::fseek (file, 0, SEEK_SET);
+
+    profile->heapCopy.resize ((size + sizeof (uint64_t) - 1) / sizeof (uint64_t));
+    const auto numRead = std::fread (profile->heapCopy.data(), 1, size, file);
+    std::fclose (file);
+
+    if (numRead != size)
+    {
+        setError (errorMessage, path + ": read failed");
+        return nullptr;
+    }
+
+    data = reinterpret_cast<const unsigned char*> (profile->heapCopy.data());
+   #endif
+
+    const auto* header = reinterpret_cast<const FileHeader*> (data);
+    if (size < sizeof (FileHeader) || header->magic != magic || header->version != formatVersion)
+    {
+        setError (errorMessage, path + ": not a calibration profile");
+        return nullptr;
+    }
+
+    if (header->window != static_cast<uint32_t> (key.window) || header->fftSize != key.fftSize
+        || header->sampleRate != key.sampleRate || header->numBins != key.fftSize / 2
+        || size != sizeof (FileHeader) + static_cast<size_t> (header->numBins) * sizeof (float))
+    {
+        setError (errorMessage, path + ": profile does not match " + fileNameFor (key));
+        return nullptr;
+    }
+
+    profile->header = header;
+    profile->bins = reinterpret_cast<const float*> (data + sizeof (FileHeader));
+    return profile;
+}
+
+std::shared_ptr<const Profile> acquire (const std::string& path, const Key& key)
+{
+    auto& cache = getProfileCache();
+    const std::lock_guard<std::mutex> lock (cache.lock);
+
+    auto& entry = cache.profiles[path];
+    if (auto shared = entry.lock())
+        return shared;
+
+    auto profile = Profile::open (path, key);
+    entry = profile;
+    return profile;
+}
+
+std::shared_ptr<const Profile> reload (const std::string& path, const Key& key)
+{
+    auto& cache = getProfileCache();
+    const std::lock_guard<std::mutex> lock (cache.lock);
+
+    auto profile = Profile::open (path, key);
+    cache.profiles[path] = profile;
+    return profile;
+}
+
+//==============================================================================
+void Capture::begin (const Key& keyToCapture, int hopsToAverage)
+{
+    key = keyToCapture;
+    targetHops = std::max (1, hopsToAverage);
+    numHops = 0;
+    powerSums.assign (key.fftSize / 2, 0.0);
+    binCounts.assign (key.fftSize / 2, 0);
+}
+
+void Capture::add (const float* powerSpectrum, const HarmonicAnalysis::Result& analysis) noexcept
+{
+    if (isComplete() || powerSums.empty())
+        return;
+
+    const auto numBins = static_cast<int> (powerSums.size());
+    int toneFirst = numBins;
+    int toneLast = -1;
+
+    if (analysis.fundamentalValid && key.sampleRate > 0)
+    {
+        const auto toneBin = static_cast<int> (std::lround (analysis.fundamentalFrequency * static_cast<float> (key.fftSize)
+                                                            / static_cast<float> (key.sampleRate)));
+        toneFirst = toneBin - (HarmonicAnalysis::harmonicExclusionRadius - 1);
+        toneLast = toneBin + (HarmonicAnalysis::harmonicExclusionRadius - 1);
+    }
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        if (bin >= toneFirst && bin <= toneLast)
+            continue;
+
+        powerSums[static_cast<size_t> (bin)] += static_cast<double> (powerSpectrum[bin]);
+        ++binCounts[static_cast<size_t> (bin)];
+    }
+
+    ++numHops;
+}
+
+bool Capture::write (const std::string& path, std::string* errorMessage) const
+{
+    if (numHops == 0 || powerSums.empty())
+    {
+        setError (errorMessage, "nothing captured");
+        return false;
+    }
+
+    FileHeader header;
+    std::memset (&header, 0, sizeof (header));
+    header.magic = magic;
+    header.version = formatVersion;
+    header.window = static_cast<uint32_t> (key.window);
+    header.fftSize = key.fftSize;
+    header.sampleRate = key.sampleRate;
+    header.numBins = static_cast<uint32_t> (powerSums.size());
+    header.numAverages = static_cast<uint32_t> (numHops);
+    header.createdUnixMs = static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::milliseconds> (
+                                                      std::chrono::system_clock::now().time_since_epoch()).count());
+
+    std::vector<float> averages (powerSums.size(), 0.0f);
+    for (size_t bin = 0; bin < averages.size(); ++bin)
+        if (binCounts[bin] > 0)
+            averages[bin] = static_cast<float> (powerSums[bin] / static_cast<double> (binCounts[bin]));
+
+    // Readers may have the old file mapped; renaming over it leaves their pages intact.
+    const auto temporaryPath = path + ".tmp";
+    auto* file = std::fopen (temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        setError (errorMessage, temporaryPath + ": " + std::strerror (errno));
+        return false;
+    }
+
+    const auto written = std::fwrite (&header, sizeof (header), 1, file) == 1
+                      && std::fwrite (averages.data(), sizeof (float), averages.size(), file) == averages.size();
+
+    if (std::fclose (file) != 0 || ! written)
+    {
+        setError (errorMessage, temporaryPath + ": write failed");
+        std::remove (temporaryPath.c_str());
+        return false;
+    }
+
+   #if ! THD_CALIBRATION_HAS_MMAP
+    std::remove (path.c_str());
+   #endif
+
+    if (std::rename (temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        std::remove (temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+}
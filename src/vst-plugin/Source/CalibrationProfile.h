@@ -0,0 +1,132 @@
+/* ==============================================================================
+   Calibration Profile
+   The audio interface's own residual spectrum, measured once in loopback and
+   subtracted (in power, per bin) from every analysed spectrum, so converter
+   distortion and noise stop setting the floor of every measurement.
+
+   A profile is keyed by (sample rate, FFT size, window) and stored as one flat
+   file: a 64-byte FileHeader followed by fftSize / 2 float32 bin powers in the
+   analysers' own |X[k]|^2 units. The bins are used exactly as stored, so a
+   profile is memory-mapped read-only and handed to the analysers in place.
+   acquire() shares one mapping per file across the whole process, so every
+   instance at the same key reads the same pages and correction adds no
+   per-instance memory.
+
+   Capture averages raw (uncorrected) power spectra over a number of hops.
+   When the loopback carries a test tone, the bins around its fundamental
+   (+/- harmonicExclusionRadius) are left out: the tone is the stimulus, not
+   residual, and must never be subtracted from a measured fundamental. Its
+   harmonics stay in - they are the converters' distortion at that frequency.
+   ============================================================================== */
+
+#pragma once
+
+#include "HarmonicAnalysis.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CalibrationProfile
+{
+constexpr uint32_t magic = 0x4C414354; // "TCAL" in file order
+constexpr uint32_t formatVersion = 1;
+
+enum class Window : uint32_t
+{
+    hann = 1
+};
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t window;
+    uint32_t fftSize;
+    uint32_t sampleRate;        // Hz, rounded
+    uint32_t numBins;           // fftSize / 2 float32 powers follow the header
+    uint32_t numAverages;       // hops averaged into the profile
+    uint32_t reserved0;
+    uint64_t createdUnixMs;
+    uint8_t reserved[24];
+};
+
+// 64 bytes keeps the bins cache-line aligned inside a page-aligned mapping.
+static_assert (sizeof (FileHeader) == 64, "FileHeader layout");
+
+struct Key
+{
+    uint32_t sampleRate = 0;
+    uint32_t fftSize = 0;
+    Window window = Window::hann;
+};
+
+inline Key makeKey (double sampleRate, int fftSize, Window window = Window::hann) noexcept
+{
+    Key key;
+    key.sampleRate = static_cast<uint32_t> (std::lround (sampleRate));
+    key.fftSize = static_cast<uint32_t> (fftSize);
+    key.window = window;
+    return key;
+}
+
+/** File name for a key, e.g. "residual-48000-8192-hann.thdcal". */
+std::string fileNameFor (const Key& key);
+
+/** A validated, read-only profile, memory-mapped where the platform allows. */
+class Profile
+{
+public:
+    ~Profile();
+
+    const FileHeader& getHeader() const noexcept { return *header; }
+    const float* getResidualPower() const noexcept { return bins; }
+    int getNumBins() const noexcept { return static_cast<int> (header->numBins); }
+
+    /** Maps path and checks it was captured for key; nullptr (with errorMessage) if missing or malformed. */
+    static std::shared_ptr<const Profile> open (const std::string& path, const Key& key, std::string* errorMessage = nullptr);
+
+private:
+    Profile() = default;
+
+    const void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<uint64_t> heapCopy;     // platforms without mmap
+    const FileHeader* header = nullptr;
+    const float* bins = nullptr;
+};
+
+/** The process-wide profile for path, mapped on first use and shared while anyone holds it. */
+std::shared_ptr<const Profile> acquire (const std::string& path, const Key& key);
+
+/** Re-maps path after it was rewritten. Holders of the previous profile keep it until they re-acquire. */
+std::shared_ptr<const Profile> reload (const std::string& path, const Key& key);
+
+/** Averages loopback power spectra into a new profile. Not thread-safe: one owner feeds it. */
+class Capture
+{
+public:
+    /** Allocates for key and starts over; call off the audio thread. */
+    void begin (const Key& key, int hopsToAverage);
+
+    /** Adds one raw power spectrum (fftSize / 2 bins) and the analysis it produced. */
+    void add (const float* powerSpectrum, const HarmonicAnalysis::Result& analysis) noexcept;
+
+    bool isComplete() const noexcept { return numHops >= targetHops; }
+    float getProgress() const noexcept { return targetHops > 0 ? static_cast<float> (numHops) / static_cast<float> (targetHops) : 0.0f; }
+    const Key& getKey() const noexcept { return key; }
+
+    /** Writes the averaged profile, replacing path atomically (write to a temporary, then rename). */
+    bool write (const std::string& path, std::string* errorMessage = nullptr) const;
+
+private:
+    Key key;
+    int targetHops = 0;
+    int numHops = 0;
+    std::vector<double> powerSums;
+    std::vector<uint32_t> binCounts;
+};
+}
@@ -0,0 +1,211 @@
+/* ==============================================================================
+   Channel Group Tree
+   Incrementally maintained channel -> group -> ... -> master aggregation.
+
+   Each channel contributes (THD, THD^2, THD+N^2, count) to its group and to
+   every ancestor of that group. Updating a channel applies only the delta to
+   its ancestor chain, so the cost of a channel change is O(tree depth) rather
+   than O(channel count). Topology edits (re-parenting one group, or replacing
+   every parent with setGroupParents) trigger one full rebuild, which also
+   discards any accumulated floating-point drift.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+template <int maxChannels, int maxGroups>
+class ChannelGroupTree
+{
+public:
+    static constexpr int noGroup = -1;
+
+    struct Contribution
+    {
+        double sumThd = 0.0;
+        double sumThdSquared = 0.0;
+        double sumThdNSquared = 0.0;
+        int numChannels = 0;
+
+        static Contribution fromChannel (float thd, float thdN) noexcept
+        {
+            return { thd, static_cast<double> (thd) * thd, static_cast<double> (thdN) * thdN, 1 };
+        }
+
+        void add (const Contribution& other, double sign) noexcept
+        {
+            sumThd += sign * other.sumThd;
+            sumThdSquared += sign * other.sumThdSquared;
+            sumThdNSquared += sign * other.sumThdNSquared;
+            numChannels += sign > 0.0 ? other.numChannels : -other.numChannels;
+        }
+    };
+
+    struct GroupAggregate
+    {
+        Contribution totals;
+        int parent = noGroup;
+        int depth = 0;
+
+        float averageThd() const noexcept { return totals.numChannels > 0 ? static_cast<float> (totals.sumThd / totals.numChannels) : 0.0f; }
+        float rssThd() const noexcept { return rms (totals.sumThdSquared); }
+        float rssThdN() const noexcept { return rms (totals.sumThdNSquared); }
+
+    private:
+        float rms (double sumOfSquares) const noexcept
+        {
+            return totals.numChannels > 0 ? static_cast<float> (std::sqrt (std::fmax (0.0, sumOfSquares) / totals.numChannels)) : 0.0f;
+        }
+    };
+
+    ChannelGroupTree() noexcept
+    {
+        channelGroups.fill (noGroup);
+    }
+
+    /** Re-parents a group. Returns false (and changes nothing) if this would create a cycle. */
+    bool setGroupParent (int group, int parent) noexcept
+    {
+        if (! isValidGroup (group) || (parent != noGroup && ! isValidGroup (parent)))
+            return false;
+
+        for (auto ancestor = parent; ancestor != noGroup; ancestor = groups[static_cast<size_t> (ancestor)].parent)
+            if (ancestor == group)
+                return false;
+
+        if (groups[static_cast<size_t> (group)].parent == parent)
+            return true;
+
+        groups[static_cast<size_t> (group)].parent = parent;
+        rebuild();
+        return true;
+    }
+
+    /** Replaces every group's parent at once, checking the final topology for
+        cycles and rebuilding once. Returns false (and changes nothing) if any
+        parent is out of range or the set contains a cycle. */
+    bool setGroupParents (const std::array<int, maxGroups>& parents) noexcept
+    {
+        for (int g = 0; g < maxGroups; ++g)
+        {
+            const auto parent = parents[static_cast<size_t> (g)];
+            if (parent != noGroup && ! isValidGroup (parent))
+                return false;
+
+            // An acyclic chain reaches the root in fewer than maxGroups steps.
+            int steps = 0;
+            for (auto ancestor = parent; ancestor != noGroup; ancestor = parents[static_cast<size_t> (ancestor)])
+                if (ancestor == g || ++steps > maxGroups)
+                    return false;
+        }
+
+        bool changed = false;
+        for (int g = 0; g < maxGroups; ++g)
+        {
+            auto& node = groups[static_cast<size_t> (g)];
+            changed = changed || node.parent != parents[static_cast<size_t> (g)];
+            node.parent = parents[static_cast<size_t> (g)];
+        }
+
+        if (changed)
+            rebuild();
+
+        return true;
+    }
+
+    int getGroupParent (int group) const noexcept
+    {
+        return isValidGroup (group) ? groups[static_cast<size_t> (group)].parent : noGroup;
+    }
+
+    /** Moves a channel between groups, touching only the old and new ancestor chains. */
+    void setChannelGroup (int channel, int group) noexcept
+    {
+        if (! isValidChannel (channel))
+            return;
+
+        const auto newGroup = isValidGroup (group) ? group : noGroup;
+        auto& current = channelGroups[static_cast<size_t> (channel)];
+        if (current == newGroup)
+            return;
+
+        const auto& contribution = contributions[static_cast<size_t> (channel)];
+        applyToAncestors (current, contribution, -1.0);
+        current = newGroup;
+        applyToAncestors (current, contribution, 1.0);
+        ++version;
+    }
+
+    int getChannelGroup (int channel) const noexcept
+    {
+        return isValidChannel (channel) ? channelGroups[static_cast<size_t> (channel)] : noGroup;
+    }
+
+    /** Replaces a channel's contribution and propagates the delta to its ancestors. */
+    void updateChannel (int channel, const Contribution& contribution) noexcept
+    {
+        if (! isValidChannel (channel))
+            return;
+
+        auto& stored = contributions[static_cast<size_t> (channel)];
+        auto delta = contribution;
+        delta.add (stored, -1.0);
+        stored = contribution;
+        applyToAncestors (channelGroups[static_cast<size_t> (channel)], delta, 1.0);
+        ++version;
+    }
+
+    void clearChannel (int channel) noexcept
+    {
+        updateChannel (channel, {});
+    }
+
+    /** Recomputes every group total and depth from the per-channel contributions. */
+    void rebuild() noexcept
+    {
+        for (auto& group : groups)
+            group.totals = {};
+
+        for (int g = 0; g < maxGroups; ++g)
+        {
+            int depth = 0;
+            for (auto ancestor = groups[static_cast<size_t> (g)].parent; ancestor != noGroup; ancestor = groups[static_cast<size_t> (ancestor)].parent)
+                ++depth;
+
+            groups[static_cast<size_t> (g)].depth = depth;
+        }
+
+        for (int channel = 0; channel < maxChannels; ++channel)
+            applyToAncestors (channelGroups[static_cast<size_t> (channel)], contributions[static_cast<size_t> (channel)], 1.0);
+
+        ++version;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& contribution : contributions)
+            contribution = {};
+
+        rebuild();
+    }
+
+    const GroupAggregate& getGroup (int group) const noexcept { return groups[static_cast<size_t> (group)]; }
+    uint64_t getVersion() const noexcept { return version; }
+
+    static bool isValidGroup (int group) noexcept { return group >= 0 && group < maxGroups; }
+    static bool isValidChannel (int channel) noexcept { return channel >= 0 && channel < maxChannels; }
+
+private:
+    void applyToAncestors (int group, const Contribution& contribution, double sign) noexcept
+    {
+        for (auto g = group; g != noGroup; g = groups[static_cast<size_t> (g)].parent)
+            groups[static_cast<size_t> (g)].totals.add (contribution, sign);
+    }
+
+    std::array<GroupAggregate, maxGroups> groups {};
+    std::array<int, maxChannels> channelGroups {};
+    std::array<Contribution, maxChannels> contributions {};
+    uint64_t version = 0;
+};
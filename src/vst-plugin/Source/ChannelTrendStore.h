@@ -0,0 +1,363 @@
+/* ==============================================================================
+   Channel Trend Store
+   Compact per-channel THD / THD+N / level history for the Master Brain, about
+   an hour per channel in a few MB for every channel at once.
+
+   Time is cut into fixed sample periods on one clock shared by all channels,
+   so sample n of every channel covers the same interval. A sample is the mean
+   of the values a channel published during its period, stored as IEEE half
+   float (2 bytes, ~0.05 % resolution, which is far below what a THD reading
+   means). Periods without data hold NaN, so gaps stay gaps.
+
+   Samples are grouped into blocks of samplesPerBlock. Each block also keeps a
+   min / max / mean summary of the raw values it received, so spikes shorter
+   than a period still show. Sparklines read only these summaries: with the
+   default 0.5 s period a block spans 32 s and the numBlocks ring covers 68
+   minutes, one summary per sparkline pixel or so.
+
+   The Master Brain audio thread is the only writer. Each channel has a
+   sequence lock (odd while being written); readers copy and retry, so the
+   writer never waits. Storage is allocated once in the constructor.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+template <int maxChannels>
+class ChannelTrendStore
+{
+public:
+    enum Series
+    {
+        thd = 0,
+        thdN,
+        level,
+        numSeries
+    };
+
+    static constexpr int samplesPerBlock = 64;
+    static constexpr int numBlocks = 128;
+    static constexpr int samplesPerSeries = samplesPerBlock * numBlocks;
+    static constexpr double defaultSamplePeriodSeconds = 0.5;
+
+    struct Summary
+    {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        float mean = 0.0f;
+        uint32_t count = 0;         // raw values in the block; 0 = no data
+    };
+
+    using Summaries = std::array<Summary, numBlocks>;
+
+    explicit ChannelTrendStore (double samplePeriodSecondsToUse = defaultSamplePeriodSeconds)
+        : samplePeriodSeconds (samplePeriodSecondsToUse > 0.0 ? samplePeriodSecondsToUse : defaultSamplePeriodSeconds),
+          tracks (new Track[static_cast<size_t> (maxChannels)])
+    {
+        reset();
+    }
+
+    double getSamplePeriodSeconds() const noexcept { return samplePeriodSeconds; }
+    double getBlockSeconds() const noexcept { return samplePeriodSeconds * samplesPerBlock; }
+
+    static constexpr size_t getStorageBytes() noexcept { return sizeof (Track) * static_cast<size_t> (maxChannels); }
+
+    /** Writer thread: forgets every channel's history. */
+    void reset() noexcept
+    {
+        for (int channel = 0; channel < maxChannels; ++channel)
+            clearChannel (channel);
+
+        newestBlock.store (-1, std::memory_order_release);
+    }
+
+    /** Writer thread: forgets one channel's history (e.g. when it goes away). */
+    void clearChannel (int channel) noexcept
+    {
+        if (channel < 0 || channel >= maxChannels)
+            return;
+
+        auto& track = tracks[static_cast<size_t> (channel)];
+        beginWrite (track);
+        clearTrack (track);
+        endWrite (track);
+    }
+
+    /** Writer thread: adds one published reading taken at nowSeconds on the shared clock. */
+    void add (int channel, double nowSeconds, float thdValue, float thdNValue, float levelValue) noexcept
+    {
+        if (channel < 0 || channel >= maxChannels || ! std::isfinite (nowSeconds) || nowSeconds < 0.0)
+            return;
+
+        const float values[numSeries] = { thdValue, thdNValue, levelValue };
+        const auto sample = static_cast<int64_t> (nowSeconds / samplePeriodSeconds);
+        auto& track = tracks[static_cast<size_t> (channel)];
+
+        beginWrite (track);
+
+        if (sample != track.currentSample)
+            advanceTo (track, sample);
+
+        auto& block = track.blocks[static_cast<size_t> ((sample / samplesPerBlock) % numBlocks)];
+        ++track.pendingCount;
+        ++block.count;
+
+        for (int series = 0; series < numSeries; ++series)
+        {
+            const auto value = std::isfinite (values[series]) ? values[series] : 0.0f;
+            track.pendingSums[series] += value;
+            block.sums[series] += value;
+
+            auto& summary = block.summaries[series];
+            summary.minimum = block.count == 1 ? value : std::fmin (summary.minimum, value);
+            summary.maximum = block.count == 1 ? value : std::fmax (summary.maximum, value);
+            summary.mean = static_cast<float> (block.sums[series] / block.count);
+            summary.count = block.count;
+        }
+
+        endWrite (track);
+
+        const auto blockIndex = sample / samplesPerBlock;
+        if (blockIndex > newestBlock.load (std::memory_order_relaxed))
+            newestBlock.store (blockIndex, std::memory_order_release);
+    }
+
+    /** Index of the newest block any channel has written on the shared clock, or -1. */
+    int64_t getNewestBlock() const noexcept { return newestBlock.load (std::memory_order_acquire); }
+
+    /** Any thread: summaries of blocks lastBlock - numBlocks + 1 .. lastBlock, oldest first.
+        Blocks the channel has no data for (or no longer holds) come back with count 0.
+        Returns false if the writer kept the channel busy for every attempt. */
+    bool readSummaries (int channel, Series series, int64_t lastBlock, Summaries& destination) const noexcept
+    {
+        destination.fill (Summary {});
+
+        if (channel < 0 || channel >= maxChannels || series < 0 || series >= numSeries || lastBlock < 0)
+            return channel >= 0 && channel < maxChannels;
+
+        const auto& track = tracks[static_cast<size_t> (channel)];
+
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            const auto before = track.writeSequence.load (std::memory_order_acquire);
+            if ((before & 1u) != 0)
+                continue;
+
+            const auto trackNewest = track.currentSample < 0 ? int64_t { -1 } : track.currentSample / samplesPerBlock;
+
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                const auto block = lastBlock - (numBlocks - 1) + i;
+
+                // The ring holds the channel's numBlocks newest blocks.
+                if (block < 0 || block > trackNewest || block <= trackNewest - numBlocks)
+                    destination[static_cast<size_t> (i)] = Summary {};
+                else
+                    destination[static_cast<size_t> (i)] = track.blocks[static_cast<size_t> (block % numBlocks)].summaries[series];
+            }
+
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            if (track.writeSequence.load (std::memory_order_relaxed) == before)
+                return true;
+        }
+
+        destination.fill (Summary {});
+        return false;
+    }
+
+    /** Any thread: decodes samples firstSample .. firstSample + numSamples - 1 (NaN where there is no data). */
+    bool readSamples (int channel, Series series, int64_t firstSample, int numSamples, float* destination) const noexcept
+    {
+        if (channel < 0 || channel >= maxChannels || series < 0 || series >= numSeries || numSamples <= 0)
+            return false;
+
+        const auto& track = tracks[static_cast<size_t> (channel)];
+
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            const auto before = track.writeSequence.load (std::memory_order_acquire);
+            if ((before & 1u) != 0)
+                continue;
+
+            // The current sample is still accumulating, so committed samples end just before it.
+            const auto newestCommitted = track.currentSample - 1;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto sample = firstSample + i;
+                const auto held = sample >= 0 && sample <= newestCommitted && sample > newestCommitted - samplesPerSeries;
+                destination[i] = held ? fromHalf (track.samples[series][static_cast<size_t> (sample % samplesPerSeries)])
+                                      : std::numeric_limits<float>::quiet_NaN();
+            }
+
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            if (track.writeSequence.load (std::memory_order_relaxed) == before)
+                return true;
+        }
+
+        return false;
+    }
+
+    //==============================================================================
+    /** IEEE 754 binary16, round to nearest even; overflow goes to infinity. */
+    static uint16_t toHalf (float value) noexcept
+    {
+        uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+
+        const auto sign = static_cast<uint16_t> ((bits >> 16) & 0x8000u);
+        const auto exponent = static_cast<int> ((bits >> 23) & 0xffu);
+        auto mantissa = bits & 0x7fffffu;
+
+        if (exponent == 0xff)
+            return static_cast<uint16_t> (sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+        const auto halfExponent = exponent - 127 + 15;
+
+        if (halfExponent >= 0x1f)
+            return static_cast<uint16_t> (sign | 0x7c00u);
+
+        if (halfExponent <= 0)
+        {
+            if (halfExponent < -10)
+                return sign;
+
+            // Subnormal: shift the full significand down to units of 2^-24.
+            mantissa |= 0x800000u;
+            const auto shift = static_cast<uint32_t> (14 - halfExponent);
+            auto half = mantissa >> shift;
+            const auto remainder = mantissa & ((1u << shift) - 1u);
+            const auto halfway = 1u << (shift - 1u);
+
+            if (remainder > halfway || (remainder == halfway && (half & 1u) != 0))
+                ++half;
+
+            return static_cast<uint16_t> (sign | half);
+        }
+
+        // A carry out of the mantissa correctly bumps the exponent (up to infinity).
+        auto half = (static_cast<uint32_t> (halfExponent) << 10) | (mantissa >> 13);
+        const auto remainder = mantissa & 0x1fffu;
+
+        if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0))
+            ++half;
+
+        return static_cast<uint16_t> (sign | half);
+    }
+
+    static float fromHalf (uint16_t half) noexcept
+    {
+        const auto sign = static_cast<uint32_t> (half & 0x8000u) << 16;
+        const auto exponent = static_cast<uint32_t> ((half >> 10) & 0x1fu);
+        const auto mantissa = static_cast<uint32_t> (half & 0x3ffu);
+
+        if (exponent == 0)
+        {
+            const auto magnitude = std::ldexp (static_cast<float> (mantissa), -24);
+            return sign != 0 ? -magnitude : magnitude;
+        }
+
+        const auto bits = sign | (exponent == 0x1f ? 0x7f800000u : (exponent + 112u) << 23) | (mantissa << 13);
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+
+    static constexpr uint16_t noDataHalf = 0x7e00;   // quiet NaN
+
+private:
+    struct Block
+    {
+        std::array<Summary, numSeries> summaries {};
+        double sums[numSeries] {};
+        uint32_t count = 0;
+    };
+
+    struct Track
+    {
+        std::atomic<uint32_t> writeSequence { 0 };
+        int64_t currentSample = -1;             // period now accumulating, -1 before the first value
+        double pendingSums[numSeries] {};
+        uint32_t pendingCount = 0;
+        std::array<Block, numBlocks> blocks {};
+        std::array<std::array<uint16_t, samplesPerSeries>, numSeries> samples {};
+    };
+
+    static void beginWrite (Track& track) noexcept
+    {
+        const auto sequence = track.writeSequence.load (std::memory_order_relaxed);
+        track.writeSequence.store (sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+    }
+
+    static void endWrite (Track& track) noexcept
+    {
+        track.writeSequence.store (track.writeSequence.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    static void clearTrack (Track& track) noexcept
+    {
+        track.currentSample = -1;
+        track.pendingCount = 0;
+
+        for (auto& sum : track.pendingSums)
+            sum = 0.0;
+
+        for (auto& block : track.blocks)
+            block = Block {};
+
+        for (auto& series : track.samples)
+            series.fill (noDataHalf);
+    }
+
+    /** Commits the pending period and moves to sample, marking skipped periods as gaps. */
+    static void advanceTo (Track& track, int64_t sample) noexcept
+    {
+        // The clock went backwards (reset elsewhere) or jumped past everything held: start over.
+        if (sample < track.currentSample || (track.currentSample >= 0 && sample - track.currentSample > samplesPerSeries))
+            clearTrack (track);
+
+        if (track.currentSample >= 0)
+        {
+            const auto slot = static_cast<size_t> (track.currentSample % samplesPerSeries);
+
+            for (int series = 0; series < numSeries; ++series)
+                track.samples[static_cast<size_t> (series)][slot] = track.pendingCount > 0
+                    ? toHalf (static_cast<float> (track.pendingSums[series] / track.pendingCount))
+                    : noDataHalf;
+
+            for (auto next = track.currentSample + 1; next < sample; ++next)
+            {
+                for (auto& series : track.samples)
+                    series[static_cast<size_t> (next % samplesPerSeries)] = noDataHalf;
+
+                if (next % samplesPerBlock == 0)
+                    track.blocks[static_cast<size_t> ((next / samplesPerBlock) % numBlocks)] = Block {};
+            }
+        }
+
+        // Entering a block (other than by continuing within it) recycles its ring entry.
+        const auto block = sample / samplesPerBlock;
+        if (track.currentSample < 0 || track.currentSample / samplesPerBlock != block)
+            track.blocks[static_cast<size_t> (block % numBlocks)] = Block {};
+
+        track.currentSample = sample;
+        track.pendingCount = 0;
+
+        for (auto& sum : track.pendingSums)
+            sum = 0.0;
+    }
+
+    const double samplePeriodSeconds;
+    std::unique_ptr<Track[]> tracks;
+    std::atomic<int64_t> newestBlock { -1 };
+};
@@ -0,0 +1,124 @@
+/* ==============================================================================
+   CLAP Thread-Pool Executor Implementation
+   ============================================================================== */
+
+#include "ClapThreadPoolExecutor.h"
+
+#include <array>
+#include <mutex>
+
+namespace
+{
+struct RegistryEntry
+{
+    std::atomic<const clap_plugin*> plugin { nullptr };
+    std::atomic<ClapThreadPoolExecutor*> executor { nullptr };
+};
+
+constexpr size_t maxRegisteredPlugins = 256;
+std::array<RegistryEntry, maxRegisteredPlugins> registry;
+std::mutex registryWriteLock;
+}
+
+ClapThreadPoolExecutor::~ClapThreadPoolExecutor()
+{
+    detach();
+}
+
+void ClapThreadPoolExecutor::attach (const clap_host* hostToUse, const clap_plugin* pluginToUse) noexcept
+{
+    detach();
+
+    if (hostToUse == nullptr || pluginToUse == nullptr)
+        return;
+
+    host = hostToUse;
+    plugin = pluginToUse;
+
+    if (host->get_extension != nullptr)
+        hostThreadPool = static_cast<const clap_host_thread_pool*> (host->get_extension (host, CLAP_EXT_THREAD_POOL));
+
+    if (hostThreadPool != nullptr && hostThreadPool->request_exec == nullptr)
+        hostThreadPool = nullptr;
+
+    const std::lock_guard<std::mutex> lock (registryWriteLock);
+    for (auto& entry : registry)
+    {
+        if (entry.plugin.load (std::memory_order_relaxed) == nullptr)
+        {
+            entry.executor.store (this, std::memory_order_relaxed);
+            entry.plugin.store (plugin, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Registry full: keep working, just without host workers.
+    hostThreadPool = nullptr;
+}
+
+void ClapThreadPoolExecutor::detach() noexcept
+{
+    if (plugin != nullptr)
+    {
+        const std::lock_guard<std::mutex> lock (registryWriteLock);
+        for (auto& entry : registry)
+        {
+            if (entry.plugin.load (std::memory_order_relaxed) == plugin)
+            {
+                entry.plugin.store (nullptr, std::memory_order_release);
+                entry.executor.store (nullptr, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    host = nullptr;
+    plugin = nullptr;
+    hostThreadPool = nullptr;
+}
+
+void ClapThreadPoolExecutor::run (int numJobs, JobFunction job, void* context) noexcept
+{
+    if (numJobs <= 0)
+        return;
+
+    if (numJobs > 1 && hostThreadPool != nullptr)
+    {
+        pendingJob = job;
+        pendingContext = context;
+
+        // request_exec is synchronous: true means every task index was executed.
+        const auto dispatched = hostThreadPool->request_exec (host, static_cast<uint32_t> (numJobs));
+
+        pendingJob = nullptr;
+        pendingContext = nullptr;
+
+        if (dispatched)
+        {
+            numHostDispatches.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    for (int jobIndex = 0; jobIndex < numJobs; ++jobIndex)
+        job (context, jobIndex);
+}
+
+void ClapThreadPoolExecutor::exec (const clap_plugin* plugin, uint32_t taskIndex) noexcept
+{
+    for (auto& entry : registry)
+    {
+        if (entry.plugin.load (std::memory_order_acquire) != plugin)
+            continue;
+
+        if (auto* executor = entry.executor.load (std::memory_order_relaxed); executor != nullptr && executor->pendingJob != nullptr)
+            executor->pendingJob (executor->pendingContext, static_cast<int> (taskIndex));
+
+        return;
+    }
+}
+
+const clap_plugin_thread_pool* ClapThreadPoolExecutor::getPluginExtension() noexcept
+{
+    static const clap_plugin_thread_pool extension { &ClapThreadPoolExecutor::exec };
+    return &extension;
+}
@@ -0,0 +1,51 @@
+/* ==============================================================================
+   CLAP Thread-Pool Executor
+   AnalysisJobExecutor backed by the host's clap.thread-pool extension.
+
+   run() calls clap_host_thread_pool::request_exec from the audio thread; the
+   host then calls the plugin's clap_plugin_thread_pool::exec once per job on
+   its own workers and returns when all are done. If the host has no pool or
+   refuses the request, the jobs run serially on the calling thread instead.
+
+   The plugin-side exec callback only receives the clap_plugin pointer, so
+   executors are found through a small process-wide registry keyed by it.
+   Only compiled into CLAP builds (THD_WITH_CLAP).
+   ============================================================================== */
+
+#pragma once
+
+#include "AnalysisJobExecutor.h"
+
+#include <atomic>
+#include <clap/clap.h>
+
+class ClapThreadPoolExecutor final : public AnalysisJobExecutor
+{
+public:
+    ClapThreadPoolExecutor() = default;
+    ~ClapThreadPoolExecutor() override;
+
+    /** Binds to a host/plugin pair; call from the main thread before processing starts. */
+    void attach (const clap_host* hostToUse, const clap_plugin* pluginToUse) noexcept;
+    void detach() noexcept;
+
+    bool hasHostThreadPool() const noexcept { return hostThreadPool != nullptr; }
+    uint64_t getNumHostDispatches() const noexcept { return numHostDispatches.load (std::memory_order_relaxed); }
+
+    void run (int numJobs, JobFunction job, void* context) noexcept override;
+
+    /** Returned from the plugin's get_extension for CLAP_EXT_THREAD_POOL. */
+    static const clap_plugin_thread_pool* getPluginExtension() noexcept;
+
+private:
+    static void exec (const clap_plugin* plugin, uint32_t taskIndex) noexcept;
+
+    const clap_host* host = nullptr;
+    const clap_plugin* plugin = nullptr;
+    const clap_host_thread_pool* hostThreadPool = nullptr;
+
+    // Only valid while request_exec is in flight.
+    JobFunction pendingJob = nullptr;
+    void* pendingContext = nullptr;
+    std::atomic<uint64_t> numHostDispatches { 0 };
+};
@@ -0,0 +1,119 @@
+/* ==============================================================================
+   Editor Tick Dispatcher Implementation
+   ============================================================================== */
+
+#include "EditorTickDispatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+EditorTickDispatcher::~EditorTickDispatcher()
+{
+    stopTimer();
+}
+
+void EditorTickDispatcher::add (Client& client, juce::Component& component, double intervalMs)
+{
+    Entry entry;
+    entry.client = &client;
+    entry.component = &component;
+    entry.intervalMs = juce::jmax (1000.0 / frameRateHz, intervalMs);
+    entries.push_back (entry);
+
+    if (! isTimerRunning())
+        startTimerHz (frameRateHz);
+}
+
+void EditorTickDispatcher::remove (Client& client)
+{
+    for (auto& entry : entries)
+    {
+        if (entry.client == &client)
+        {
+            entry.client = nullptr;
+            entry.component = nullptr;
+        }
+    }
+
+    // A client removed from inside another's tick is swept once the frame is done.
+    if (dispatching)
+        return;
+
+    entries.erase (std::remove_if (entries.begin(), entries.end(), [] (const Entry& e) { return e.client == nullptr; }),
+                   entries.end());
+
+    if (entries.empty())
+        stopTimer();
+}
+
+void EditorTickDispatcher::timerCallback()
+{
+    constexpr double frameMs = 1000.0 / frameRateHz;
+    const auto frameStartMs = juce::Time::getMillisecondCounterHiRes();
+
+    due.clear();
+    double ticksPerFrame = 0.0;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& entry = entries[i];
+        if (entry.client == nullptr || ! entry.component->isShowing())
+            continue;
+
+        ticksPerFrame += frameMs / entry.intervalMs;
+
+        const auto sinceTickMs = frameStartMs - entry.lastTickMs;
+        if (sinceTickMs < entry.intervalMs)
+            continue;
+
+        // Nothing new to show: wait for the idle refresh.
+        if (entry.hasTicked && sinceTickMs < idleRefreshMs && entry.client->getTickDataVersion() == entry.lastVersion)
+            continue;
+
+        const auto* peer = entry.component->getPeer();
+        Due candidate;
+        candidate.index = i;
+        candidate.focused = peer != nullptr && peer->isFocused();
+        candidate.overdue = sinceTickMs / entry.intervalMs;
+        due.push_back (candidate);
+    }
+
+    std::sort (due.begin(), due.end(), [] (const Due& a, const Due& b)
+    {
+        if (a.focused != b.focused)
+            return a.focused;
+
+        return a.overdue > b.overdue;
+    });
+
+    // Just enough ticks per frame to hold every showing client at its rate, so they spread out.
+    const auto maxTicks = juce::jmax (1, static_cast<int> (std::ceil (ticksPerFrame)));
+    int numTicked = 0;
+    dispatching = true;
+
+    for (const auto& candidate : due)
+    {
+        if (numTicked >= maxTicks
+            || (numTicked > 0 && juce::Time::getMillisecondCounterHiRes() - frameStartMs >= frameBudgetMs))
+            break;
+
+        auto& entry = entries[candidate.index];
+        if (entry.client == nullptr)
+            continue;
+
+        // Read before ticking, so data arriving during the tick counts as new next frame.
+        entry.lastVersion = entry.client->getTickDataVersion();
+        entry.lastTickMs = frameStartMs;
+        entry.hasTicked = true;
+        entry.client->tick();
+        ++numTicked;
+    }
+
+    dispatching = false;
+
+    entries.erase (std::remove_if (entries.begin(), entries.end(), [] (const Entry& e) { return e.client == nullptr; }),
+                   entries.end());
+
+    if (entries.empty())
+        stopTimer();
+}
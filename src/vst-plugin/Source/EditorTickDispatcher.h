@@ -0,0 +1,76 @@
+/* ==============================================================================
+   Editor Tick Dispatcher
+   One process-wide frame timer that services every open editor, in place of
+   a 20 Hz juce::Timer per editor.
+
+   Each frame, the clients that are due are ranked - focused window first,
+   then by how overdue they are - and ticked in that order until either the
+   frame's time budget or its share of ticks is used up. Whoever misses out is
+   more overdue next frame and moves up, so editors end up staggered across
+   frames rather than all repainting in the same one. Clients that are not
+   showing are never ticked, and clients whose data version has not changed
+   are skipped apart from a slow idle refresh that keeps status text current.
+   The message thread's cost per frame therefore stays bounded however many
+   editors are open; past that point each editor just updates less often.
+   ============================================================================== */
+
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <cstdint>
+#include <vector>
+
+class EditorTickDispatcher final : private juce::Timer
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        /** Changes whenever there is something new to show; unchanged clients are skipped. */
+        virtual uint64_t getTickDataVersion() const = 0;
+
+        /** Pulls the latest data and repaints. */
+        virtual void tick() = 0;
+    };
+
+    static constexpr int frameRateHz = 60;
+    static constexpr double frameBudgetMs = 4.0;
+    static constexpr double defaultIntervalMs = 50.0;
+    static constexpr double idleRefreshMs = 500.0;
+
+    /** The dispatcher shared by everything in the process that currently holds one. */
+    using Pointer = juce::SharedResourcePointer<EditorTickDispatcher>;
+
+    ~EditorTickDispatcher() override;
+
+    /** Message thread. component decides the client's priority (focus, visibility) and must outlive registration. */
+    void add (Client& client, juce::Component& component, double intervalMs = defaultIntervalMs);
+    void remove (Client& client);
+
+private:
+    struct Entry
+    {
+        Client* client = nullptr;           // nullptr once removed during a frame
+        juce::Component* component = nullptr;
+        double intervalMs = defaultIntervalMs;
+        double lastTickMs = 0.0;
+        uint64_t lastVersion = 0;
+        bool hasTicked = false;
+    };
+
+    struct Due
+    {
+        size_t index = 0;
+        bool focused = false;
+        double overdue = 0.0;   // intervals since the last tick
+    };
+
+    void timerCallback() override;
+
+    std::vector<Entry> entries;
+    std::vector<Due> due;       // per-frame scratch, kept to avoid reallocating
+    bool dispatching = false;
+};
@@ -0,0 +1,177 @@
+/* ==============================================================================
+   Harmonic Analysis
+   Post-FFT THD / THD+N math shared by the scalar FFTAnalyzer and the
+   lane-parallel BatchedSpectrumAnalyzer.
+
+   Spectra are power spectra (|X[k]|^2) of a Hann-windowed frame. Accessors
+   take a stride so the same code reads a plain array (stride 1) or one lane
+   of a bin-major structure-of-arrays block (stride = lane count).
+   ============================================================================== */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace HarmonicAnalysis
+{
+struct Result
+{
+    float fundamentalFrequency = 0.0f;
+    float thd = 0.0f;
+    float thdN = 0.0f;
+    float level = 0.0f;
+    float analysisConfidence = 0.0f;
+    bool fundamentalValid = false;
+    std::array<float, 7> harmonics {}; // H2-H8
+    float noiseFloor = 0.0f;
+};
+
+constexpr int numHarmonics = 8;
+constexpr float minFundamentalHz = 20.0f;
+constexpr float maxFundamentalHz = 2000.0f;
+constexpr float minLevel = 0.0001f;
+constexpr float minFundamentalDb = -60.0f;
+constexpr float minFundamentalPowerRatio = 0.1f;
+constexpr int harmonicSearchRadius = 2;
+constexpr int harmonicExclusionRadius = 10;
+
+struct SearchBand
+{
+    int minBin = 1;
+    int maxBin = 1;
+};
+
+inline SearchBand fundamentalSearchBand (int fftSize, float sampleRate) noexcept
+{
+    const auto lastBin = (fftSize / 2) - 1;
+    SearchBand band;
+    band.minBin = std::clamp (static_cast<int> ((minFundamentalHz * static_cast<float> (fftSize)) / sampleRate), 1, lastBin);
+    band.maxBin = std::clamp (static_cast<int> ((maxFundamentalHz * static_cast<float> (fftSize)) / sampleRate), band.minBin, lastBin);
+    return band;
+}
+
+using HarmonicBins = std::array<int, numHarmonics>;
+
+/** Subtracts a residual power spectrum (one value per bin) from every lane of a
+    bin-major block, clamping at zero. numLanes is a compile-time constant so the
+    inner loop is a broadcast-subtract-max the compiler vectorises. */
+template <int numLanes>
+void subtractResidualPower (float* magSquared, const float* residualPower, int numBins) noexcept
+{
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        const auto residual = residualPower[bin];
+        auto* row = magSquared + static_cast<size_t> (bin) * numLanes;
+
+        for (int lane = 0; lane < numLanes; ++lane)
+            row[lane] = std::max (row[lane] - residual, 0.0f);
+    }
+}
+
+/** Bins of H1..H8 for the detected fundamental. */
+inline HarmonicBins harmonicBinsFor (float fundamentalFrequency, int fftSize, float sampleRate) noexcept
+{
+    HarmonicBins bins {};
+    for (int harmonic = 1; harmonic <= numHarmonics; ++harmonic)
+        bins[static_cast<size_t> (harmonic - 1)] = static_cast<int> (static_cast<float> (harmonic) * fundamentalFrequency * static_cast<float> (fftSize) / sampleRate);
+
+    return bins;
+}
+
+/** Fills frequency, level, confidence and validity; returns true if harmonics should be measured. */
+inline bool classifyFundamental (Result& result, int fundamentalBin, float maxMagSquared, float totalSpectralPower,
+                                 float level, int fftSize, float sampleRate) noexcept
+{
+    result.fundamentalFrequency = static_cast<float> (fundamentalBin) * sampleRate / static_cast<float> (fftSize);
+    result.level = level;
+
+    if (result.fundamentalFrequency <= 0.0f || result.level <= minLevel || maxMagSquared <= 0.0f)
+        return false;
+
+    const auto fundamentalRms = std::sqrt (maxMagSquared) / static_cast<float> (fftSize);
+    const auto fundamentalDb = 20.0f * std::log10 (std::max (fundamentalRms, 1.0e-12f));
+
+    const auto fundamentalPowerRatio = totalSpectralPower > 0.0f ? (maxMagSquared / totalSpectralPower) : 0.0f;
+    result.analysisConfidence = std::clamp (fundamentalPowerRatio, 0.0f, 1.0f);
+    result.fundamentalValid = (fundamentalDb >= minFundamentalDb) && (fundamentalPowerRatio >= minFundamentalPowerRatio);
+    return result.fundamentalValid;
+}
+
+/** Peak-picks H2..H8 within +/-harmonicSearchRadius bins; sets harmonics and THD, returns the harmonic power. */
+inline float measureHarmonics (Result& result, const float* magSquared, size_t stride, int fftSize,
+                               float maxMagSquared, const HarmonicBins& bins) noexcept
+{
+    float harmonicSumSquared = 0.0f;
+
+    for (int harmonic = 2; harmonic <= numHarmonics; ++harmonic)
+    {
+        const int harmonicBin = bins[static_cast<size_t> (harmonic - 1)];
+        if (harmonicBin < 1 || harmonicBin >= fftSize / 2)
+            continue;
+
+        float harmonicMagSquared = 0.0f;
+        const int lowerBin = std::max (1, harmonicBin - harmonicSearchRadius);
+        const int upperBin = std::min ((fftSize / 2) - 1, harmonicBin + harmonicSearchRadius);
+
+        for (int bin = lowerBin; bin <= upperBin; ++bin)
+            harmonicMagSquared = std::max (harmonicMagSquared, magSquared[static_cast<size_t> (bin) * stride]);
+
+        result.harmonics[static_cast<size_t> (harmonic - 2)] = std::sqrt (harmonicMagSquared);
+        harmonicSumSquared += harmonicMagSquared;
+    }
+
+    result.thd = (std::sqrt (harmonicSumSquared) / std::sqrt (maxMagSquared)) * 100.0f;
+    return harmonicSumSquared;
+}
+
+/** Calls fn (firstBin, lastBin) for each disjoint bin range excluded from the noise sum. */
+template <typename Fn>
+void forEachHarmonicRegion (const HarmonicBins& bins, int minBin, int fftSize, Fn&& fn)
+{
+    // Bins ascend with harmonic number, so overlapping regions merge in one pass.
+    int coveredUpTo = minBin - 1;
+
+    for (const auto harmonicBin : bins)
+    {
+        const auto first = std::max (coveredUpTo + 1, harmonicBin - (harmonicExclusionRadius - 1));
+        const auto last = std::min ((fftSize / 2) - 1, harmonicBin + (harmonicExclusionRadius - 1));
+
+        if (first <= last)
+        {
+            fn (first, last);
+            coveredUpTo = last;
+        }
+    }
+}
+
+/** Power of all bins from minBin up that lie outside every harmonic region. */
+inline float noisePower (const float* magSquared, size_t stride, int minBin, int fftSize, const HarmonicBins& bins) noexcept
+{
+    float noiseSum = 0.0f;
+    int nextBin = minBin;
+
+    const auto addRange = [&] (int first, int lastExclusive)
+    {
+        for (int i = first; i < lastExclusive; ++i)
+            noiseSum += magSquared[static_cast<size_t> (i) * stride];
+    };
+
+    forEachHarmonicRegion (bins, minBin, fftSize, [&] (int first, int last)
+    {
+        addRange (nextBin, first);
+        nextBin = last + 1;
+    });
+
+    addRange (nextBin, fftSize / 2);
+    return noiseSum;
+}
+
+inline void finishNoise (Result& result, float harmonicSumSquared, float noiseSum, float maxMagSquared) noexcept
+{
+    result.thdN = (std::sqrt (harmonicSumSquared + noiseSum) / std::sqrt (maxMagSquared)) * 100.0f;
+    result.noiseFloor = std::sqrt (noiseSum);
+}
+}
@@ -0,0 +1,381 @@
+/* ==============================================================================
+   Harmonic Fit
+   Least-squares estimate of H1..Hn from a short frame once the fundamental
+   is roughly known, for THD readings at a fraction of the FFT path's latency.
+
+   A short FFT smears every harmonic over its neighbours, which is why the
+   FFT path needs 8192 samples. Here the frame is modelled directly as
+     x[i] = c + sum_h (a_h cos (h w i) + b_h sin (h w i))
+   and the 1 + 2n coefficients are solved jointly from the normal equations
+   (B^T B) p = B^T x, a fixed-size Cholesky solve. With w right, 1024-2048
+   samples give the same THD as a long FFT, provided the frame holds at
+   least minCycles periods.
+
+   The fundamental guess (the last FFT hop's, say) is refined Gauss-Newton
+   style: the frame is also fitted as two halves, and the drift of H1's phase
+   between them is the frequency error. Both half fits come out of the same
+   inner products as the full fit, so this costs nothing extra per frame.
+
+   Everything that depends only on w - the basis rows, and the Cholesky
+   factors of B^T B for the frame and its halves (built in closed form from
+   Dirichlet sums, not from the samples) - is cached. It is reused while the
+   refined fundamental stays close enough that the mismatch hides under the
+   frame's own residual (never looser than basisToleranceCycles across the
+   frame on a clean tone). A steady tone then costs one pass of vectorised
+   inner products per frame.
+   ============================================================================== */
+
+#pragma once
+
+#include "HarmonicAnalysis.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+template <int maxFrameSize, int maxHarmonics = HarmonicAnalysis::numHarmonics>
+class HarmonicFit
+{
+public:
+    static constexpr int maxParameters = 1 + 2 * maxHarmonics;
+    static constexpr double minCycles = 4.0;
+    static constexpr double basisToleranceCycles = 1.0e-6;
+    static constexpr double residualToleranceShare = 0.05;
+    static constexpr int maxRefinementPasses = 4;
+
+    /** Harmonics and noise floor are reported in the units of an equivalentFftSize-point
+        FFTAnalyzer (the |X[k]| of a bin-centred tone), so results are interchangeable.
+    */
+    explicit HarmonicFit (int equivalentFftSize = maxFrameSize)
+        : basis (static_cast<size_t> (maxParameters) * maxFrameSize),
+          magnitudeScale (0.5 * static_cast<double> (equivalentFftSize)),
+          noiseScale (std::sqrt (0.75) * static_cast<double> (equivalentFftSize))
+    {
+    }
+
+    /** Fits the last numSamples of frame (oldest first, numSamples <= maxFrameSize) around
+        fundamentalGuessHz. Returns false, leaving result invalid, if the frame is too short
+        for that fundamental or the fit does not converge.
+    */
+    bool analyze (const float* frame, int numSamples, float sampleRate, float fundamentalGuessHz, HarmonicAnalysis::Result& result)
+    {
+        result = {};
+        numSamples = std::min (numSamples, maxFrameSize) & ~1;
+
+        if (frame == nullptr || sampleRate <= 0.0f || fundamentalGuessHz <= 0.0f
+            || fundamentalGuessHz * static_cast<float> (numSamples) < static_cast<float> (minCycles) * sampleRate)
+            return false;
+
+        constexpr double twoPi = 6.283185307179586476925;
+
+        // Start from the cached fundamental when the guess is within the refinement's reach of it.
+        auto omega = twoPi * static_cast<double> (fundamentalGuessHz) / static_cast<double> (sampleRate);
+        if (hasBasis && cachedNumSamples == numSamples && std::abs (omega - cachedOmega) * numSamples < 0.5 * twoPi)
+            omega = cachedOmega;
+
+        std::array<double, maxParameters> firstHalf {};
+        std::array<double, maxParameters> secondHalf {};
+        std::array<double, maxParameters> coefficients {};
+        double energy = 0.0;
+        double residualEnergy = 0.0;
+        bool converged = false;
+
+        for (int pass = 0; pass < maxRefinementPasses && ! converged; ++pass)
+        {
+            if (! hasBasis || cachedNumSamples != numSamples || std::abs (omega - cachedOmega) * numSamples > toleranceCycles * twoPi)
+                if (! buildBasis (numSamples, omega))
+                    return false;
+
+            innerProducts (frame, firstHalf, secondHalf, energy);
+
+            // The full fit's projections are the sum of the halves'.
+            for (int k = 0; k < numParameters; ++k)
+                coefficients[static_cast<size_t> (k)] = firstHalf[static_cast<size_t> (k)] + secondHalf[static_cast<size_t> (k)];
+
+            const auto projections = coefficients;
+            solve (fullFactor, coefficients);
+
+            double explained = 0.0;
+            for (int k = 0; k < numParameters; ++k)
+                explained += coefficients[static_cast<size_t> (k)] * projections[static_cast<size_t> (k)];
+
+            residualEnergy = std::max (0.0, energy - explained);
+
+            // H1 phase of each half, in the frame's time base; their difference over half a frame is the error in w.
+            solve (halfFactors[0], firstHalf);
+            solve (halfFactors[1], secondHalf);
+
+            const auto phaseDrift = std::atan2 (firstHalf[1] * secondHalf[2] - firstHalf[2] * secondHalf[1],
+                                                firstHalf[1] * secondHalf[1] + firstHalf[2] * secondHalf[2]);
+            const auto omegaError = -phaseDrift / (0.5 * numSamples);
+
+            // An error of d cycles across the frame leaves about 1.3 d of H1 in the residual; once that is
+            // well under what the residual already holds, refitting would not change the reading.
+            const auto fundamentalEnergy = 0.5 * numSamples * (coefficients[1] * coefficients[1] + coefficients[2] * coefficients[2]);
+            const auto residualShare = fundamentalEnergy > 0.0 ? std::sqrt (residualEnergy / fundamentalEnergy) : 0.0;
+            toleranceCycles = std::max (basisToleranceCycles, residualToleranceShare * residualShare);
+
+            converged = std::abs (omegaError) * numSamples <= toleranceCycles * twoPi;
+            omega = cachedOmega + omegaError;
+
+            if (omega <= 0.0 || omega * numSamples < minCycles * twoPi)
+                return false;
+        }
+
+        if (! converged)
+            return false;
+
+        const auto meanSquare = energy / numSamples;
+        const auto amplitude = [&coefficients] (int harmonic)
+        {
+            const auto a = coefficients[static_cast<size_t> (2 * harmonic - 1)];
+            const auto b = coefficients[static_cast<size_t> (2 * harmonic)];
+            return std::sqrt (a * a + b * b);
+        };
+
+        const auto fundamental = amplitude (1);
+        result.fundamentalFrequency = static_cast<float> (cachedOmega * sampleRate / twoPi);
+        result.level = static_cast<float> (std::sqrt (meanSquare));
+
+        if (fundamental <= 0.0 || result.level <= HarmonicAnalysis::minLevel)
+            return false;
+
+        // Same validity rules as the FFT path: level of H1 and its share of the frame's power.
+        const auto fundamentalRms = fundamental / std::sqrt (2.0);
+        const auto fundamentalDb = 20.0 * std::log10 (std::max (fundamentalRms, 1.0e-12));
+        const auto fundamentalPowerRatio = meanSquare > 0.0 ? (0.5 * fundamental * fundamental) / meanSquare : 0.0;
+        result.analysisConfidence = static_cast<float> (std::clamp (fundamentalPowerRatio, 0.0, 1.0));
+        result.fundamentalValid = fundamentalDb >= HarmonicAnalysis::minFundamentalDb
+                               && fundamentalPowerRatio >= HarmonicAnalysis::minFundamentalPowerRatio;
+
+        double harmonicPower = 0.0;
+        for (int harmonic = 2; harmonic <= numHarmonics; ++harmonic)
+        {
+            const auto value = amplitude (harmonic);
+            harmonicPower += value * value;
+            result.harmonics[static_cast<size_t> (harmonic - 2)] = static_cast<float> (value * magnitudeScale);
+        }
+
+        // Sinusoid energy over the frame is A^2 n / 2; the residual is everything the model leaves.
+        const auto fundamentalEnergy = 0.5 * fundamental * fundamental * numSamples;
+        const auto harmonicEnergy = 0.5 * harmonicPower * numSamples;
+        result.thd = static_cast<float> (std::sqrt (harmonicPower) / fundamental * 100.0);
+        result.thdN = static_cast<float> (std::sqrt ((harmonicEnergy + residualEnergy) / fundamentalEnergy) * 100.0);
+        result.noiseFloor = static_cast<float> (std::sqrt (residualEnergy / numSamples) * noiseScale);
+        return result.fundamentalValid;
+    }
+
+    /** How often the w-dependent basis and factors have been rebuilt (cache misses). */
+    int getNumBasisBuilds() const noexcept { return numBasisBuilds; }
+
+private:
+    using Factor = std::array<double, maxParameters * maxParameters>;
+
+    // Sums of cos (theta i) and sin (theta i) for i in [first, first + count).
+    static void dirichletSums (double theta, int first, int count, double& cosSum, double& sinSum) noexcept
+    {
+        const auto halfSin = std::sin (0.5 * theta);
+        if (std::abs (halfSin) < 1.0e-12)
+        {
+            cosSum = std::cos (theta * first) * count;
+            sinSum = std::sin (theta * first) * count;
+            return;
+        }
+
+        const auto gain = std::sin (0.5 * theta * count) / halfSin;
+        const auto centre = theta * (first + 0.5 * (count - 1));
+        cosSum = gain * std::cos (centre);
+        sinSum = gain * std::sin (centre);
+    }
+
+    // B^T B over [first, first + count) in closed form, Cholesky-factored in place (lower triangle).
+    bool factorGram (double omega, int first, int count, Factor& factor) const noexcept
+    {
+        const auto column = [] (int k, int& harmonic, bool& isSine)
+        {
+            harmonic = (k + 1) / 2;
+            isSine = k > 0 && (k % 2) == 0;
+        };
+
+        for (int row = 0; row < numParameters; ++row)
+        {
+            int h = 0;
+            bool hSine = false;
+            column (row, h, hSine);
+
+            for (int col = 0; col <= row; ++col)
+            {
+                int k = 0;
+                bool kSine = false;
+                column (col, k, kSine);
+
+                double cDiff = 0.0, sDiff = 0.0, cSum = 0.0, sSum = 0.0;
+                dirichletSums ((h - k) * omega, first, count, cDiff, sDiff);
+                dirichletSums ((h + k) * omega, first, count, cSum, sSum);
+
+                double value = 0.0;
+                if (h == 0 || k == 0)
+                {
+                    // DC times DC, cos or sin of the other column's harmonic.
+                    const auto other = h == 0 ? kSine : hSine;
+                    value = h == 0 && k == 0 ? count : (other ? sSum : cSum);
+                }
+                else if (! hSine && ! kSine) value = 0.5 * (cDiff + cSum);
+                else if (hSine && kSine)     value = 0.5 * (cDiff - cSum);
+                else if (hSine)              value = 0.5 * (sSum + sDiff);   // sin (h) cos (k)
+                else                         value = 0.5 * (sSum - sDiff);   // cos (h) sin (k)
+
+                factor[static_cast<size_t> (row * maxParameters + col)] = value;
+            }
+        }
+
+        for (int j = 0; j < numParameters; ++j)
+        {
+            auto diagonal = factor[static_cast<size_t> (j * maxParameters + j)];
+            for (int k = 0; k < j; ++k)
+                diagonal -= factor[static_cast<size_t> (j * maxParameters + k)] * factor[static_cast<size_t> (j * maxParameters + k)];
+
+            if (diagonal <= 1.0e-9 * count)
+                return false;
+
+            const auto pivot = std::sqrt (diagonal);
+            factor[static_cast<size_t> (j * maxParameters + j)] = pivot;
+
+            for (int i = j + 1; i < numParameters; ++i)
+            {
+                auto value = factor[static_cast<size_t> (i * maxParameters + j)];
+                for (int k = 0; k < j; ++k)
+                    value -= factor[static_cast<size_t> (i * maxParameters + k)] * factor[static_cast<size_t> (j * maxParameters + k)];
+
+                factor[static_cast<size_t> (i * maxParameters + j)] = value / pivot;
+            }
+        }
+
+        return true;
+    }
+
+    void solve (const Factor& factor, std::array<double, maxParameters>& values) const noexcept
+    {
+        for (int i = 0; i < numParameters; ++i)
+        {
+            auto value = values[static_cast<size_t> (i)];
+            for (int k = 0; k < i; ++k)
+                value -= factor[static_cast<size_t> (i * maxParameters + k)] * values[static_cast<size_t> (k)];
+
+            values[static_cast<size_t> (i)] = value / factor[static_cast<size_t> (i * maxParameters + i)];
+        }
+
+        for (int i = numParameters - 1; i >= 0; --i)
+        {
+            auto value = values[static_cast<size_t> (i)];
+            for (int k = i + 1; k < numParameters; ++k)
+                value -= factor[static_cast<size_t> (k * maxParameters + i)] * values[static_cast<size_t> (k)];
+
+            values[static_cast<size_t> (i)] = value / factor[static_cast<size_t> (i * maxParameters + i)];
+        }
+    }
+
+    bool buildBasis (int numSamples, double omega)
+    {
+        constexpr double twoPi = 6.283185307179586476925;
+        hasBasis = false;
+        cachedOmega = omega;
+        cachedNumSamples = numSamples;
+        ++numBasisBuilds;
+
+        // Harmonics stay clear of Nyquist, where the sine column vanishes.
+        const auto nyquistHarmonics = static_cast<int> (0.45 * twoPi / omega);
+        numHarmonics = std::clamp (nyquistHarmonics, 1, maxHarmonics);
+        numParameters = 1 + 2 * numHarmonics;
+
+        // Rows are cos/sin of h w i for the frame's own sample index; the rotation is
+        // re-seeded every block so the recurrence never drifts.
+        constexpr int reseedInterval = 64;
+        std::fill_n (basis.begin(), numSamples, 1.0);
+
+        double re = 1.0, im = 0.0;
+        const auto stepRe = std::cos (omega);
+        const auto stepIm = std::sin (omega);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (i % reseedInterval == 0)
+            {
+                re = std::cos (omega * i);
+                im = std::sin (omega * i);
+            }
+
+            double hRe = re, hIm = im;
+            for (int h = 1; h <= numHarmonics; ++h)
+            {
+                basis[static_cast<size_t> ((2 * h - 1) * maxFrameSize + i)] = hRe;
+                basis[static_cast<size_t> ((2 * h) * maxFrameSize + i)] = hIm;
+
+                const auto nextRe = hRe * re - hIm * im;
+                hIm = hRe * im + hIm * re;
+                hRe = nextRe;
+            }
+
+            const auto nextRe = re * stepRe - im * stepIm;
+            im = re * stepIm + im * stepRe;
+            re = nextRe;
+        }
+
+        const auto half = numSamples / 2;
+        hasBasis = factorGram (omega, 0, numSamples, fullFactor)
+                && factorGram (omega, 0, half, halfFactors[0])
+                && factorGram (omega, half, half, halfFactors[1]);
+        return hasBasis;
+    }
+
+    // Dot products of every basis row with each half of the frame, plus the frame energy.
+    // Eight independent accumulators per row keep the loops vectorisable without reassociation.
+    void innerProducts (const float* frame, std::array<double, maxParameters>& firstHalf,
+                        std::array<double, maxParameters>& secondHalf, double& energy) const noexcept
+    {
+        constexpr int width = 8;
+        const auto half = cachedNumSamples / 2;
+
+        const auto dot = [half] (const auto* a, const float* b)
+        {
+            std::array<double, width> sums {};
+            int i = 0;
+            for (; i + width <= half; i += width)
+                for (int lane = 0; lane < width; ++lane)
+                    sums[static_cast<size_t> (lane)] += static_cast<double> (a[i + lane]) * static_cast<double> (b[i + lane]);
+
+            double total = 0.0;
+            for (; i < half; ++i)
+                total += static_cast<double> (a[i]) * static_cast<double> (b[i]);
+
+            for (const auto sum : sums)
+                total += sum;
+
+            return total;
+        };
+
+        for (int k = 0; k < numParameters; ++k)
+        {
+            const auto* row = basis.data() + static_cast<size_t> (k) * maxFrameSize;
+            firstHalf[static_cast<size_t> (k)] = dot (row, frame);
+            secondHalf[static_cast<size_t> (k)] = dot (row + half, frame + half);
+        }
+
+        energy = dot (frame, frame) + dot (frame + half, frame + half);
+    }
+
+    std::vector<double> basis;  // row k at basis[k * maxFrameSize]: DC, cos H1, sin H1, cos H2, ...
+    Factor fullFactor {};
+    std::array<Factor, 2> halfFactors {};
+    double magnitudeScale;
+    double noiseScale;
+    double cachedOmega = 0.0;
+    double toleranceCycles = basisToleranceCycles;
+    int cachedNumSamples = 0;
+    int numHarmonics = 0;
+    int numParameters = 0;
+    int numBasisBuilds = 0;
+    bool hasBasis = false;
+};
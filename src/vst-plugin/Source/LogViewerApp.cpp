@@ -0,0 +1,69 @@
+/* ==============================================================================
+   THD Log Viewer
+   Standalone viewer for binary measurement logs written by the daemon
+   (--log PATH.thdr). The index next to the log (<log>.thdx) is built on the
+   first open and reused afterwards.
+
+   Usage:
+     thd-log-viewer [LOG.thdr]
+   ============================================================================== */
+
+#include "LogViewerComponent.h"
+
+class THDLogViewerApplication final : public juce::JUCEApplication
+{
+public:
+    const juce::String getApplicationName() override { return JUCE_APPLICATION_NAME_STRING; }
+    const juce::String getApplicationVersion() override { return JUCE_APPLICATION_VERSION_STRING; }
+    bool moreThanOneInstanceAllowed() override { return true; }
+
+    void initialise (const juce::String& commandLine) override
+    {
+        mainWindow = std::make_unique<MainWindow> (getApplicationName());
+
+        const auto path = commandLine.unquoted().trim();
+        if (path.isNotEmpty())
+            mainWindow->viewer->openLog (juce::File::getCurrentWorkingDirectory().getChildFile (path));
+    }
+
+    void shutdown() override
+    {
+        mainWindow = nullptr;
+    }
+
+    void systemRequestedQuit() override
+    {
+        quit();
+    }
+
+private:
+    class MainWindow final : public juce::DocumentWindow
+    {
+    public:
+        explicit MainWindow (const juce::String& name)
+            : DocumentWindow (name, juce::Colour::fromString ("ff040810"), DocumentWindow::allButtons)
+        {
+            viewer = new LogViewerComponent();
+            setUsingNativeTitleBar (true);
+            setContentOwned (viewer, true);
+            setResizable (true, true);
+            setResizeLimits (640, 360, 10000, 10000);
+            centreWithSize (getWidth(), getHeight());
+            setVisible (true);
+        }
+
+        void closeButtonPressed() override
+        {
+            juce::JUCEApplication::getInstance()->systemRequestedQuit();
+        }
+
+        LogViewerComponent* viewer = nullptr;   // owned by the window
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainWindow)
+    };
+
+    std::unique_ptr<MainWindow> mainWindow;
+};
+
+START_JUCE_APPLICATION (THDLogViewerApplication)
@@ -0,0 +1,417 @@
+/* ==============================================================================
+   Log Viewer Component Implementation
+   ============================================================================== */
+
+#include "LogViewerComponent.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// Same hex values as the plugin editor's palette.
+const juce::Colour backgroundTop = juce::Colour::fromString ("ff040810");
+const juce::Colour backgroundBottom = juce::Colour::fromString ("ff060b14");
+const juce::Colour surfaceB = juce::Colour::fromString ("ff0d1117");
+const juce::Colour borderA = juce::Colour::fromString ("ff1f2937");
+const juce::Colour textDim = juce::Colour::fromString ("ff94a3b8");
+const juce::Colour accentBlue = juce::Colour::fromString ("ff60a5fa");
+
+constexpr double minimumViewSeconds = 0.5;
+
+juce::Font makeMonoFont (float size, bool bold = false)
+{
+    juce::Font font (size, bold ? juce::Font::bold : juce::Font::plain);
+    font.setTypefaceName ("Geist Mono");
+
+    return font;
+}
+
+juce::String channelName (int channelId)
+{
+    return channelId < 0 ? juce::String ("MASTER") : "CH " + juce::String (channelId + 1);
+}
+
+juce::String formatTime (double seconds, double step)
+{
+    const auto whole = static_cast<int64_t> (std::floor (seconds));
+    auto text = juce::String::formatted ("%d:%02d:%02d", static_cast<int> (whole / 3600),
+                                         static_cast<int> ((whole / 60) % 60), static_cast<int> (whole % 60));
+
+    if (step < 1.0)
+        text << juce::String (seconds - static_cast<double> (whole), 1).substring (1);
+
+    return text;
+}
+
+/** Tick spacing giving at least minimumGap pixels between labels: 1-2-5 steps, then minutes and hours. */
+double tickStepFor (double secondsPerPixel, double minimumGap)
+{
+    static const double steps[] = { 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0, 15.0, 30.0, 60.0, 120.0, 300.0, 600.0,
+                                    900.0, 1800.0, 3600.0, 7200.0, 10800.0, 21600.0, 43200.0, 86400.0 };
+
+    for (const auto step : steps)
+        if (step / secondsPerPixel >= minimumGap)
+            return step;
+
+    return 86400.0 * std::ceil (secondsPerPixel * minimumGap / 86400.0);
+}
+}
+
+LogViewerComponent::LogViewerComponent()
+{
+    addAndMakeVisible (openButton);
+    openButton.onClick = [this] { chooseLog(); };
+
+    for (int column = 0; column < MeasurementLogIndex::numColumns; ++column)
+        columnBox.addItem (MeasurementLogIndex::getColumnName (static_cast<MeasurementLogIndex::Column> (column)), column + 1);
+
+    columnBox.setSelectedId (static_cast<int> (MeasurementLogIndex::Column::thdN) + 1, juce::dontSendNotification);
+    columnBox.onChange = [this] { repaint(); };
+    addAndMakeVisible (columnBox);
+
+    followButton.setToggleState (true, juce::dontSendNotification);
+    followButton.setColour (juce::ToggleButton::textColourId, textDim);
+    addAndMakeVisible (followButton);
+
+    statusLabel.setFont (makeMonoFont (11.0f));
+    statusLabel.setColour (juce::Label::textColourId, textDim);
+    statusLabel.setJustificationType (juce::Justification::centredRight);
+    addAndMakeVisible (statusLabel);
+
+    laneScrollBar.addListener (this);
+    addChildComponent (laneScrollBar);
+
+    updateStatus();
+    startTimer (1000);
+    setSize (1200, 760);
+}
+
+LogViewerComponent::~LogViewerComponent()
+{
+    // Rows indexed while following are only in memory until saved; best effort, like open().
+    if (index.isOpen())
+        index.save();
+}
+
+bool LogViewerComponent::openLog (const juce::File& file)
+{
+    if (index.isOpen())
+        index.save();
+
+    std::string error;
+    if (! index.open (file.getFullPathName().toStdString(), &error))
+    {
+        logFile = juce::File();
+        channelIds.clear();
+        statusLabel.setText (file.getFileName() + ": " + juce::String (error), juce::dontSendNotification);
+        updateLaneScrollBar();
+        repaint();
+        return false;
+    }
+
+    logFile = file;
+    channelIds = index.getChannelIds();
+    laneScrollBar.setCurrentRangeStart (0.0, juce::dontSendNotification);
+    showWholeLog();
+    updateLaneScrollBar();
+    updateStatus();
+    return true;
+}
+
+void LogViewerComponent::chooseLog()
+{
+    chooser = std::make_unique<juce::FileChooser> ("Open measurement log", logFile, "*.thdr");
+    chooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                          [this] (const juce::FileChooser& fc)
+                          {
+                              if (fc.getResult() != juce::File())
+                                  openLog (fc.getResult());
+                          });
+}
+
+void LogViewerComponent::showWholeLog()
+{
+    const auto start = index.getStartTime();
+    setView (start, juce::jmax (index.getEndTime(), start + minimumViewSeconds));
+}
+
+void LogViewerComponent::setView (double newStart, double newEnd)
+{
+    const auto width = juce::jmax (newEnd - newStart, minimumViewSeconds);
+    viewStart = newStart;
+    viewEnd = newStart + width;
+    updateStatus();
+    repaint();
+}
+
+//==============================================================================
+juce::Rectangle<int> LogViewerComponent::getPlotArea() const
+{
+    auto area = getLocalBounds().reduced (10);
+    area.removeFromTop (headerHeight);
+    area.removeFromBottom (axisHeight);
+
+    if (laneScrollBar.isVisible())
+        area.removeFromRight (laneScrollBar.getWidth() + 4);
+
+    return area;
+}
+
+int LogViewerComponent::getLaneHeight() const
+{
+    const auto numLanes = juce::jmax (1, static_cast<int> (channelIds.size()));
+    return juce::jmax (minLaneHeight, getPlotArea().getHeight() / numLanes);
+}
+
+double LogViewerComponent::timeAtX (float x) const
+{
+    const auto trace = getPlotArea().withTrimmedLeft (labelWidth);
+    const auto proportion = (static_cast<double> (x) - trace.getX()) / juce::jmax (1, trace.getWidth());
+    return viewStart + proportion * (viewEnd - viewStart);
+}
+
+void LogViewerComponent::updateLaneScrollBar()
+{
+    const auto numLanes = static_cast<double> (channelIds.size());
+    const auto visibleLanes = static_cast<double> (juce::jmax (1, getPlotArea().getHeight() / getLaneHeight()));
+
+    laneScrollBar.setRangeLimits (0.0, juce::jmax (numLanes, 1.0), juce::dontSendNotification);
+    laneScrollBar.setCurrentRange (laneScrollBar.getCurrentRangeStart(), visibleLanes, juce::dontSendNotification);
+    laneScrollBar.setVisible (numLanes > visibleLanes);
+}
+
+void LogViewerComponent::updateStatus()
+{
+    if (! index.isOpen())
+    {
+        if (logFile == juce::File())
+            statusLabel.setText ("Open a .thdr measurement log", juce::dontSendNotification);
+        return;
+    }
+
+    const auto source = lastLevelRead < 0 ? juce::String ("rows") : "level " + juce::String (lastLevelRead);
+    statusLabel.setText (logFile.getFileName() + "  |  " + juce::String (static_cast<juce::int64> (index.getNumRows())) + " rows, "
+                             + juce::String (static_cast<int> (channelIds.size())) + " channels  |  "
+                             + formatTime (viewEnd - viewStart, 1.0) + " in view (" + source + ")",
+                         juce::dontSendNotification);
+}
+
+//==============================================================================
+void LogViewerComponent::paint (juce::Graphics& g)
+{
+    g.setGradientFill (juce::ColourGradient (backgroundTop, 0.0f, 0.0f, backgroundBottom, 0.0f, static_cast<float> (getHeight()), false));
+    g.fillAll();
+
+    auto plot = getPlotArea();
+    paintTimeAxis (g, { plot.getX() + labelWidth, plot.getBottom(), plot.getWidth() - labelWidth, axisHeight });
+
+    if (channelIds.empty())
+        return;
+
+    const auto laneHeight = getLaneHeight();
+    const auto firstLane = static_cast<size_t> (laneScrollBar.isVisible() ? laneScrollBar.getCurrentRangeStart() : 0.0);
+
+    g.saveState();
+    g.reduceClipRegion (plot);
+
+    // Only lanes on screen are queried.
+    for (auto lane = firstLane; lane < channelIds.size() && plot.getHeight() > 0; ++lane)
+        paintLane (g, plot.removeFromTop (laneHeight).reduced (0, 2), channelIds[lane]);
+
+    g.restoreState();
+}
+
+void LogViewerComponent::paintLane (juce::Graphics& g, juce::Rectangle<int> lane, int channelId)
+{
+    const auto labelArea = lane.removeFromLeft (labelWidth);
+    g.setColour (textDim);
+    g.setFont (makeMonoFont (10.0f, true));
+    g.drawText (channelName (channelId), labelArea.reduced (6, 0), juce::Justification::centredLeft);
+
+    g.setColour (surfaceB.withAlpha (0.9f));
+    g.fillRect (lane);
+    g.setColour (borderA.withAlpha (0.8f));
+    g.drawRect (lane, 1);
+
+    const auto trace = lane.reduced (1, 3);
+    if (trace.getWidth() <= 0 || trace.getHeight() <= 0)
+        return;
+
+    const auto column = static_cast<MeasurementLogIndex::Column> (juce::jmax (0, columnBox.getSelectedId() - 1));
+    lastLevelRead = index.query (channelId, column, viewStart, viewEnd, trace.getWidth(), spans);
+
+    auto low = std::numeric_limits<float>::max();
+    auto high = std::numeric_limits<float>::lowest();
+
+    for (const auto& span : spans)
+    {
+        if (span.count == 0)
+            continue;
+
+        low = juce::jmin (low, span.minimum);
+        high = juce::jmax (high, span.maximum);
+    }
+
+    if (low > high)
+        return;
+
+    // Each lane scales to its own visible range, padded so flat traces stay off the border.
+    const auto padding = juce::jmax ((high - low) * 0.08f, std::abs (high) * 0.01f, 1.0e-6f);
+    low -= padding;
+    high += padding;
+
+    const auto top = static_cast<float> (trace.getY());
+    const auto height = static_cast<float> (trace.getHeight());
+    const auto toY = [top, height, low, high] (float value) { return top + height * (high - value) / (high - low); };
+
+    juce::Path meanLine;
+    auto lineOpen = false;
+
+    for (int x = 0; x < trace.getWidth(); ++x)
+    {
+        const auto& span = spans[static_cast<size_t> (x)];
+        if (span.count == 0)
+        {
+            lineOpen = false;   // gaps in the log stay gaps
+            continue;
+        }
+
+        const auto px = static_cast<float> (trace.getX() + x);
+        const auto yMax = toY (span.maximum);
+        const auto yMin = toY (span.minimum);
+
+        g.setColour (accentBlue.withAlpha (0.35f));
+        g.fillRect (px, yMax, 1.0f, juce::jmax (1.0f, yMin - yMax));
+
+        const auto yMean = toY (span.mean);
+        if (lineOpen)
+            meanLine.lineTo (px + 0.5f, yMean);
+        else
+            meanLine.startNewSubPath (px + 0.5f, yMean);
+
+        lineOpen = true;
+    }
+
+    g.setColour (accentBlue.withAlpha (0.9f));
+    g.strokePath (meanLine, juce::PathStrokeType (1.2f));
+
+    g.setColour (textDim.withAlpha (0.8f));
+    g.setFont (makeMonoFont (8.0f));
+    g.drawText (juce::String (high - padding, 3), trace.reduced (4, 0), juce::Justification::topRight);
+    g.drawText (juce::String (low + padding, 3), trace.reduced (4, 0), juce::Justification::bottomRight);
+}
+
+void LogViewerComponent::paintTimeAxis (juce::Graphics& g, juce::Rectangle<int> axis)
+{
+    if (axis.getWidth() <= 0)
+        return;
+
+    const auto secondsPerPixel = (viewEnd - viewStart) / axis.getWidth();
+    const auto step = tickStepFor (secondsPerPixel, 90.0);
+
+    g.setFont (makeMonoFont (9.0f));
+
+    for (auto tick = std::ceil (viewStart / step) * step; tick <= viewEnd; tick += step)
+    {
+        const auto x = axis.getX() + static_cast<int> ((tick - viewStart) / secondsPerPixel);
+        g.setColour (borderA);
+        g.drawVerticalLine (x, static_cast<float> (axis.getY()), static_cast<float> (axis.getY() + 4));
+        g.setColour (textDim);
+        g.drawText (formatTime (tick, step), x - 45, axis.getY() + 4, 90, axis.getHeight() - 4, juce::Justification::centredTop);
+    }
+}
+
+void LogViewerComponent::resized()
+{
+    auto header = getLocalBounds().reduced (10).removeFromTop (headerHeight).withTrimmedBottom (10);
+    openButton.setBounds (header.removeFromLeft (90));
+    header.removeFromLeft (8);
+    columnBox.setBounds (header.removeFromLeft (110));
+    header.removeFromLeft (8);
+    followButton.setBounds (header.removeFromLeft (80));
+    statusLabel.setBounds (header);
+
+    auto area = getLocalBounds().reduced (10);
+    area.removeFromTop (headerHeight);
+    area.removeFromBottom (axisHeight);
+    laneScrollBar.setBounds (area.removeFromRight (10));
+
+    updateLaneScrollBar();
+}
+
+//==============================================================================
+void LogViewerComponent::mouseDown (const juce::MouseEvent&)
+{
+    dragStartViewStart = viewStart;
+}
+
+void LogViewerComponent::mouseDrag (const juce::MouseEvent& e)
+{
+    if (! index.isOpen())
+        return;
+
+    const auto width = viewEnd - viewStart;
+    const auto secondsPerPixel = width / juce::jmax (1, getPlotArea().getWidth() - labelWidth);
+    const auto newStart = dragStartViewStart - e.getDistanceFromDragStartX() * secondsPerPixel;
+    setView (newStart, newStart + width);
+}
+
+void LogViewerComponent::mouseDoubleClick (const juce::MouseEvent&)
+{
+    if (index.isOpen())
+        showWholeLog();
+}
+
+void LogViewerComponent::mouseWheelMove (const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel)
+{
+    if (! index.isOpen())
+        return;
+
+    if (e.mods.isShiftDown() && laneScrollBar.isVisible())
+    {
+        laneScrollBar.mouseWheelMove (e, wheel);
+        return;
+    }
+
+    // Zoom around the time under the cursor, no further out than twice the whole log.
+    const auto anchor = timeAtX (e.position.x);
+    const auto logSpan = juce::jmax (index.getEndTime() - index.getStartTime(), minimumViewSeconds);
+    const auto scale = std::pow (0.5, static_cast<double> (wheel.deltaY) * 2.0);
+    const auto width = juce::jlimit (minimumViewSeconds, logSpan * 2.0, (viewEnd - viewStart) * scale);
+    const auto proportion = (anchor - viewStart) / (viewEnd - viewStart);
+
+    setView (anchor - proportion * width, anchor + (1.0 - proportion) * width);
+}
+
+void LogViewerComponent::scrollBarMoved (juce::ScrollBar*, double)
+{
+    repaint();
+}
+
+void LogViewerComponent::timerCallback()
+{
+    if (! index.isOpen() || ! followButton.getToggleState())
+        return;
+
+    const auto previousEnd = index.getEndTime();
+    const auto followingTail = viewEnd >= previousEnd;
+
+    if (! index.refresh())
+        return;
+
+    channelIds = index.getChannelIds();
+    updateLaneScrollBar();
+
+    if (followingTail)
+    {
+        const auto shift = index.getEndTime() - previousEnd;
+        setView (viewStart + shift, viewEnd + shift);
+    }
+    else
+    {
+        updateStatus();
+        repaint();
+    }
+}
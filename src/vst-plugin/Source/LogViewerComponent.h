@@ -0,0 +1,80 @@
+/* ==============================================================================
+   Log Viewer Component
+   Browses a binary measurement log (.thdr) as stacked per-channel lanes of
+   one column (THD, THD+N, level, a harmonic), drawn as a min/max band with
+   the mean through it.
+
+   All drawing goes through MeasurementLogIndex::query(), one span per pixel
+   column of each visible lane, so a repaint costs the same for a minute or a
+   day of log. Mouse wheel zooms around the cursor, dragging pans, a double
+   click shows the whole log. While "Follow" is on, the log is re-checked
+   every second and a view reaching the end keeps tracking the newest rows.
+   ============================================================================== */
+
+#pragma once
+
+#include "MeasurementLogIndex.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <vector>
+
+class LogViewerComponent final : public juce::Component,
+                                 private juce::ScrollBar::Listener,
+                                 private juce::Timer
+{
+public:
+    LogViewerComponent();
+    ~LogViewerComponent() override;
+
+    bool openLog (const juce::File& file);
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+    void mouseDown (const juce::MouseEvent&) override;
+    void mouseDrag (const juce::MouseEvent&) override;
+    void mouseDoubleClick (const juce::MouseEvent&) override;
+    void mouseWheelMove (const juce::MouseEvent&, const juce::MouseWheelDetails&) override;
+
+private:
+    void scrollBarMoved (juce::ScrollBar*, double newRangeStart) override;
+    void timerCallback() override;
+
+    void chooseLog();
+    void showWholeLog();
+    void setView (double newStart, double newEnd);
+    void updateLaneScrollBar();
+    void updateStatus();
+
+    juce::Rectangle<int> getPlotArea() const;
+    int getLaneHeight() const;
+    double timeAtX (float x) const;
+
+    void paintLane (juce::Graphics&, juce::Rectangle<int> lane, int channelId);
+    void paintTimeAxis (juce::Graphics&, juce::Rectangle<int> axis);
+
+    static constexpr int headerHeight = 40;
+    static constexpr int axisHeight = 22;
+    static constexpr int labelWidth = 72;
+    static constexpr int minLaneHeight = 36;
+
+    MeasurementLogIndex index;
+    juce::File logFile;
+    std::vector<int> channelIds;
+    std::vector<MeasurementLogIndex::Span> spans;   // reused by every lane
+
+    double viewStart = 0.0;
+    double viewEnd = 1.0;
+    double dragStartViewStart = 0.0;
+    int lastLevelRead = 0;
+
+    juce::TextButton openButton { "Open..." };
+    juce::ComboBox columnBox;
+    juce::ToggleButton followButton { "Follow" };
+    juce::Label statusLabel;
+    juce::ScrollBar laneScrollBar { true };
+    std::unique_ptr<juce::FileChooser> chooser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LogViewerComponent)
+};
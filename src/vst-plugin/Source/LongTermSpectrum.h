@@ -0,0 +1,135 @@
+/* ==============================================================================
+   Long-Term Spectrum
+   Third-octave long-term average spectrum (LTAS) of one channel, built up
+   from the power spectrum each analysis hop already computes.
+
+   prepare() maps the 31 bands (ISO centres, 20 Hz .. 20 kHz) to FFT bin
+   ranges once. Per hop, reduceBands() sums each band's bins in one pass over
+   the spectrum, and addBandPower() folds the band powers into the average:
+   the exact mean of every hop until averagingSeconds worth have been seen,
+   then an exponential average over that many hops, so the spectrum settles
+   quickly after a reset and then follows the programme slowly.
+
+   Bands narrower than one bin (the lowest ones at small FFT sizes) take the
+   bin containing their centre, scaled by their share of its width. Bands
+   above Nyquist read as minimumDb. Levels are in dB relative to a full-scale
+   sine, given a Hann window normalised to sum to the FFT size (as both
+   FFTAnalyzer and BatchedSpectrumAnalyzer use).
+   ============================================================================== */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+class LongTermSpectrum
+{
+public:
+    static constexpr int numBands = 31;
+    static constexpr int referenceBand = 17;            // 1 kHz
+    static constexpr float minimumDb = -140.0f;
+    static constexpr double defaultAveragingSeconds = 300.0;
+
+    using Bands = std::array<float, numBands>;
+
+    /** Exact base-2 third-octave centre (ISO 266 nominal values are these rounded). */
+    static float bandCentreHz (int band) noexcept
+    {
+        return 1000.0f * std::exp2 (static_cast<float> (band - referenceBand) / 3.0f);
+    }
+
+    void prepare (int fftSizeToUse, double sampleRate, double averagingSeconds, int hopSize) noexcept
+    {
+        const auto binHz = sampleRate / fftSizeToUse;
+        const auto numBins = fftSizeToUse / 2;
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            const auto centre = static_cast<double> (bandCentreHz (band));
+            const auto low = centre * std::exp2 (-1.0 / 6.0);
+            const auto high = centre * std::exp2 (1.0 / 6.0);
+            auto& range = ranges[static_cast<size_t> (band)];
+
+            // Bins whose centre falls inside the band, clipped to below Nyquist.
+            range.first = std::min (numBins, static_cast<int> (std::ceil (low / binHz)));
+            range.end = std::min (numBins, static_cast<int> (std::ceil (high / binHz)));
+            range.weight = 1.0f;
+
+            if (range.first == range.end && centre < sampleRate * 0.5)
+            {
+                range.first = std::min (numBins - 1, static_cast<int> (std::lround (centre / binHz)));
+                range.end = range.first + 1;
+                range.weight = static_cast<float> ((high - low) / binHz);
+            }
+        }
+
+        // Sine-referenced: a full-scale sine's bins sum to 3 N^2 / 8 with the sum-to-N Hann window.
+        powerScale = 8.0f / (3.0f * static_cast<float> (fftSizeToUse) * static_cast<float> (fftSizeToUse));
+        averagingHops = static_cast<uint32_t> (std::max (1.0, averagingSeconds * sampleRate / std::max (1, hopSize)));
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        average.fill (0.0f);
+        numHops = 0;
+    }
+
+    /** One pass over fftSize / 2 bin powers, read at power[bin * stride]. */
+    void reduceBands (const float* power, int stride, Bands& bandPower) const noexcept
+    {
+        for (int band = 0; band < numBands; ++band)
+        {
+            const auto& range = ranges[static_cast<size_t> (band)];
+            auto sum = 0.0f;
+
+            for (int bin = range.first; bin < range.end; ++bin)
+                sum += power[bin * stride];
+
+            bandPower[static_cast<size_t> (band)] = sum * range.weight * powerScale;
+        }
+    }
+
+    void addBandPower (const Bands& bandPower) noexcept
+    {
+        numHops = numHops < averagingHops ? numHops + 1 : averagingHops;
+        const auto rate = 1.0f / static_cast<float> (numHops);
+
+        for (size_t band = 0; band < average.size(); ++band)
+            average[band] += (std::max (0.0f, bandPower[band]) - average[band]) * rate;
+    }
+
+    void addPowerSpectrum (const float* power, int stride = 1) noexcept
+    {
+        Bands bandPower;
+        reduceBands (power, stride, bandPower);
+        addBandPower (bandPower);
+    }
+
+    /** Hops averaged so far, saturating at the averaging window. */
+    uint32_t getNumHops() const noexcept { return numHops; }
+
+    void getLevelsDb (Bands& levels) const noexcept
+    {
+        for (size_t band = 0; band < levels.size(); ++band)
+            levels[band] = numHops > 0 && ranges[band].end > ranges[band].first && average[band] > 0.0f
+                ? std::max (minimumDb, 10.0f * std::log10 (average[band]))
+                : minimumDb;
+    }
+
+private:
+    struct BinRange
+    {
+        int first = 0;
+        int end = 0;
+        float weight = 1.0f;
+    };
+
+    std::array<BinRange, numBands> ranges {};
+    Bands average {};
+    float powerScale = 1.0f;
+    uint32_t averagingHops = 1;
+    uint32_t numHops = 0;
+};
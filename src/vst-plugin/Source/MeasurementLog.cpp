@@ -0,0 +1,133 @@
+/* ==============================================================================
+   Measurement Log Implementation
+   ============================================================================== */
+
+#include "MeasurementLog.h"
+#include "THDRecordFormat.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+bool hasBinaryExtension (const std::string& path)
+{
+    static constexpr char extension[] = ".thdr";
+    const auto length = sizeof (extension) - 1;
+    return path.size() > length && path.compare (path.size() - length, length, extension) == 0;
+}
+}
+
+MeasurementLog::~MeasurementLog()
+{
+    close();
+}
+
+bool MeasurementLog::open (const std::string& path, std::string* errorMessage)
+{
+    close();
+
+    if (path == "-")
+    {
+        file = stdout;
+        ownsFile = false;
+    }
+    else
+    {
+        binary = hasBinaryExtension (path);
+        file = std::fopen (path.c_str(), binary ? "ab" : "a");
+        ownsFile = true;
+
+        if (file == nullptr)
+        {
+            if (errorMessage != nullptr)
+                *errorMessage = path + ": " + std::strerror (errno);
+
+            return false;
+        }
+    }
+
+    // Appending to an existing log keeps its header; new files get one.
+    if (ownsFile)
+        std::fseek (file, 0, SEEK_END);
+
+    const auto isNewFile = ! ownsFile || std::ftell (file) == 0;
+
+    if (binary && isNewFile)
+    {
+        auto header = THDRecord::make<THDRecord::StreamHeader>();
+        header.createdUnixMs = static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::milliseconds> (
+                                                          std::chrono::system_clock::now().time_since_epoch()).count());
+        std::fwrite (&header, sizeof (header), 1, file);
+    }
+    else if (isNewFile)
+    {
+        std::fputs ("time_s,channel,sequence,thd_pct,thdn_pct,level_rms,peak,h2,h3,h4,h5,h6,h7,h8\n", file);
+    }
+
+    numRowsWritten = 0;
+    return true;
+}
+
+void MeasurementLog::close()
+{
+    if (file == nullptr)
+        return;
+
+    std::fflush (file);
+
+    if (ownsFile)
+        std::fclose (file);
+
+    file = nullptr;
+    ownsFile = false;
+    binary = false;
+}
+
+void MeasurementLog::append (const Row& row)
+{
+    if (file == nullptr)
+        return;
+
+    if (binary)
+    {
+        auto record = THDRecord::makeMeasurement();
+        record.channelId = row.channelId;
+        record.groupIndex = row.groupIndex;
+        record.sequence = row.sequence;
+        record.timelineSample = row.timelineSample;
+        record.epoch = row.epoch;
+        record.timeSeconds = row.timeSeconds;
+        record.thd = row.thd;
+        record.thdN = row.thdN;
+        record.level = row.level;
+        record.peakLevel = row.peakLevel;
+        record.harmonics = row.harmonics;
+
+        std::fwrite (&record, sizeof (record), 1, file);
+        ++numRowsWritten;
+        return;
+    }
+
+    std::fprintf (file, "%.6f,%d,%llu,%.6g,%.6g,%.6g,%.6g",
+                  row.timeSeconds,
+                  row.channelId,
+                  static_cast<unsigned long long> (row.sequence),
+                  static_cast<double> (row.thd),
+                  static_cast<double> (row.thdN),
+                  static_cast<double> (row.level),
+                  static_cast<double> (row.peakLevel));
+
+    for (const auto harmonic : row.harmonics)
+        std::fprintf (file, ",%.6g", static_cast<double> (harmonic));
+
+    std::fputc ('\n', file);
+    ++numRowsWritten;
+}
+
+void MeasurementLog::flush()
+{
+    if (file != nullptr)
+        std::fflush (file);
+}
@@ -0,0 +1,68 @@
+/* ==============================================================================
+   Measurement Log
+   Append-only CSV log of per-channel and master measurements.
+
+   One row per channel per logged analysis update; the Master Brain aggregate
+   is logged with channel = -1. Writes go through a buffered FILE*, so call
+   append() from a reporting thread, never from the audio callback.
+
+   Columns:
+     time_s,channel,sequence,thd_pct,thdn_pct,level_rms,peak,h2,...,h8
+
+   A path ending in ".thdr" writes the binary record format instead
+   (THDRecordFormat.h): a StreamHeader, then one Measurement record per row.
+   Every row is a fixed 120-byte, 8-aligned struct, so the file can be mmap'd
+   and read in place, or indexed by row without scanning.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+class MeasurementLog
+{
+public:
+    static constexpr int masterChannel = -1;
+
+    struct Row
+    {
+        double timeSeconds = 0.0;
+        int channelId = masterChannel;
+        uint64_t sequence = 0;
+        float thd = 0.0f;
+        float thdN = 0.0f;
+        float level = 0.0f;
+        float peakLevel = 0.0f;
+        std::array<float, 7> harmonics {};
+        int groupIndex = -1;
+        int64_t timelineSample = std::numeric_limits<int64_t>::min();
+        uint64_t epoch = 0;
+    };
+
+    MeasurementLog() = default;
+    ~MeasurementLog();
+
+    MeasurementLog (const MeasurementLog&) = delete;
+    MeasurementLog& operator= (const MeasurementLog&) = delete;
+
+    /** Opens (appending) and writes the header if the file is new; "-" logs CSV to stdout. */
+    bool open (const std::string& path, std::string* errorMessage = nullptr);
+    void close();
+    bool isOpen() const noexcept { return file != nullptr; }
+    bool isBinary() const noexcept { return binary; }
+
+    void append (const Row& row);
+    void flush();
+
+    uint64_t getNumRowsWritten() const noexcept { return numRowsWritten; }
+
+private:
+    std::FILE* file = nullptr;
+    bool ownsFile = false;
+    bool binary = false;
+    uint64_t numRowsWritten = 0;
+};
@@ -0,0 +1,822 @@
+/* ==============================================================================
+   Measurement Log Index Implementation
+   ============================================================================== */
+
+#include "MeasurementLogIndex.h"
+#include "THDRecordFormat.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#if defined (__unix__) || defined (__APPLE__)
+ #define THD_LOG_INDEX_HAS_MMAP 1
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#else
+ #define THD_LOG_INDEX_HAS_MMAP 0
+#endif
+
+namespace
+{
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bucketSize;
+    uint32_t rowsPerBucket;
+    uint32_t fanOut;
+    uint32_t numChannels;
+    uint64_t numRows;
+    uint64_t logCreatedUnixMs;
+    uint64_t rowStride;
+    double startTime;
+    double endTime;
+};
+
+struct ChannelHeader
+{
+    int32_t id;
+    uint32_t numLevels;
+    uint64_t numRows;
+    uint64_t levelOffset[MeasurementLogIndex::maxLevels];   // bytes from the start of the file
+    uint64_t levelCount[MeasurementLogIndex::maxLevels];
+    uint64_t rowsOffset;                                     // numRows uint32 row offsets
+};
+
+static_assert (sizeof (FileHeader) == 64, "FileHeader layout");
+static_assert (sizeof (ChannelHeader) == 216, "ChannelHeader layout");
+
+// Channel ids are small (strips, plus -1 for the Master Brain), so rows find
+// their builder through a flat table while indexing.
+constexpr int minChannelId = THDRecord::Measurement::masterChannel;
+constexpr int maxChannelId = 4095;
+
+void setError (std::string* errorMessage, const std::string& text)
+{
+    if (errorMessage != nullptr)
+        *errorMessage = text;
+}
+
+float columnValue (const THDRecord::Measurement& row, int column) noexcept
+{
+    float value = 0.0f;
+
+    switch (static_cast<MeasurementLogIndex::Column> (column))
+    {
+        case MeasurementLogIndex::Column::thd:       value = row.thd; break;
+        case MeasurementLogIndex::Column::thdN:      value = row.thdN; break;
+        case MeasurementLogIndex::Column::level:     value = row.level; break;
+        case MeasurementLogIndex::Column::peakLevel: value = row.peakLevel; break;
+        case MeasurementLogIndex::Column::numColumns: break;
+        default:                                     value = row.harmonics[static_cast<size_t> (column - static_cast<int> (MeasurementLogIndex::Column::h2))]; break;
+    }
+
+    return std::isfinite (value) ? value : 0.0f;
+}
+
+/** Running summary of one channel's rows, emitted as a level-0 bucket. */
+struct BucketBuilder
+{
+    void add (const THDRecord::Measurement& row, uint64_t rowIndex) noexcept
+    {
+        if (count == 0)
+        {
+            bucket.startTime = row.timeSeconds;
+            bucket.firstRow = rowIndex;
+            numRowOffsets = 0;
+
+            for (int column = 0; column < MeasurementLogIndex::numColumns; ++column)
+            {
+                bucket.minimum[column] = std::numeric_limits<float>::max();
+                bucket.maximum[column] = std::numeric_limits<float>::lowest();
+                sums[column] = 0.0;
+            }
+        }
+
+        bucket.endTime = row.timeSeconds;
+        bucket.lastRow = rowIndex;
+        rowOffsets[numRowOffsets++] = static_cast<uint32_t> (rowIndex - bucket.firstRow);
+
+        for (int column = 0; column < MeasurementLogIndex::numColumns; ++column)
+        {
+            const auto value = columnValue (row, column);
+            bucket.minimum[column] = std::min (bucket.minimum[column], value);
+            bucket.maximum[column] = std::max (bucket.maximum[column], value);
+            sums[column] += value;
+        }
+
+        ++count;
+    }
+
+    MeasurementLogIndex::Bucket take() noexcept
+    {
+        bucket.count = count;
+
+        for (int column = 0; column < MeasurementLogIndex::numColumns; ++column)
+            bucket.mean[column] = static_cast<float> (sums[column] / count);
+
+        count = 0;
+        return bucket;
+    }
+
+    MeasurementLogIndex::Bucket bucket {};
+    double sums[MeasurementLogIndex::numColumns] {};
+    uint32_t rowOffsets[MeasurementLogIndex::rowsPerBucket] {};
+    uint32_t numRowOffsets = 0;
+    uint32_t count = 0;
+};
+
+void mergeBucket (MeasurementLogIndex::Bucket& into, const MeasurementLogIndex::Bucket& from) noexcept
+{
+    if (into.count == 0)
+    {
+        into = from;
+        return;
+    }
+
+    const auto total = static_cast<double> (into.count) + from.count;
+
+    for (int column = 0; column < MeasurementLogIndex::numColumns; ++column)
+    {
+        into.minimum[column] = std::min (into.minimum[column], from.minimum[column]);
+        into.maximum[column] = std::max (into.maximum[column], from.maximum[column]);
+        into.mean[column] = static_cast<float> ((static_cast<double> (into.mean[column]) * into.count
+                                                 + static_cast<double> (from.mean[column]) * from.count) / total);
+    }
+
+    into.startTime = std::min (into.startTime, from.startTime);
+    into.endTime = std::max (into.endTime, from.endTime);
+    into.firstRow = std::min (into.firstRow, from.firstRow);
+    into.lastRow = std::max (into.lastRow, from.lastRow);
+    into.count += from.count;
+}
+
+void mergeSpan (MeasurementLogIndex::Span& span, float minimum, float maximum, float mean, uint32_t count) noexcept
+{
+    if (span.count == 0)
+    {
+        span.minimum = minimum;
+        span.maximum = maximum;
+        span.mean = mean;
+        span.count = count;
+        return;
+    }
+
+    const auto total = span.count + count;
+    span.minimum = std::min (span.minimum, minimum);
+    span.maximum = std::max (span.maximum, maximum);
+    span.mean = static_cast<float> ((static_cast<double> (span.mean) * span.count + static_cast<double> (mean) * count) / total);
+    span.count = total;
+}
+}
+
+//==============================================================================
+MeasurementLogIndex::~MeasurementLogIndex()
+{
+    close();
+}
+
+const char* MeasurementLogIndex::getColumnName (Column column) noexcept
+{
+    static const char* const names[] = { "THD", "THD+N", "Level", "Peak", "H2", "H3", "H4", "H5", "H6", "H7", "H8" };
+    const auto index = static_cast<int> (column);
+    return index >= 0 && index < numColumns ? names[index] : "";
+}
+
+bool MeasurementLogIndex::mapFile (const std::string& path, Mapping& mapping, std::string* errorMessage)
+{
+    unmapFile (mapping);
+
+   #if THD_LOG_INDEX_HAS_MMAP
+    const auto fd = ::open (path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return false;
+    }
+
+    struct stat info {};
+    if (::fstat (fd, &info) != 0 || info.st_size <= 0)
+    {
+        ::close (fd);
+        setError (errorMessage, path + ": empty file");
+        return false;
+    }
+
+    const auto size = static_cast<size_t> (info.st_size);
+    auto* mapped = ::mmap (nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return false;
+    }
+
+    mapping.data = mapped;
+    mapping.size = size;
+   #else
+    auto* file = std::fopen (path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        setError (errorMessage, path + ": " + std::strerror (errno));
+        return false;
+    }
+
+    std::fseek (file, 0, SEEK_END);
+    const auto size = static_cast<size_t> (std::max (0L, std::ftell (file)));
+    std::fseek (file, 0, SEEK_SET);
+
+    mapping.heapCopy.resize ((size + sizeof (uint64_t) - 1) / sizeof (uint64_t));
+    const auto numRead = std::fread (mapping.heapCopy.data(), 1, size, file);
+    std::fclose (file);
+
+    if (size == 0 || numRead != size)
+    {
+        setError (errorMessage, path + ": read failed");
+        mapping.heapCopy = {};
+        return false;
+    }
+
+    mapping.data = mapping.heapCopy.data();
+    mapping.size = size;
+   #endif
+
+    return true;
+}
+
+void MeasurementLogIndex::unmapFile (Mapping& mapping)
+{
+   #if THD_LOG_INDEX_HAS_MMAP
+    if (mapping.data != nullptr)
+        ::munmap (const_cast<void*> (mapping.data), mapping.size);
+   #endif
+
+    mapping.data = nullptr;
+    mapping.size = 0;
+    mapping.heapCopy = {};
+}
+
+//==============================================================================
+bool MeasurementLogIndex::open (const std::string& pathToOpen, std::string* errorMessage)
+{
+    close();
+    logPath = pathToOpen;
+
+    if (! mapLog (errorMessage))
+    {
+        close();
+        return false;
+    }
+
+    const auto numRowsInLog = static_cast<uint64_t> ((logSize - firstRowOffset) / rowStride);
+    loadedFromDisk = loadIndex();
+
+    if (! loadedFromDisk)
+    {
+        channels.clear();
+        numRowsIndexed = 0;
+    }
+
+    if (numRowsIndexed < numRowsInLog)
+    {
+        indexRows (numRowsIndexed, numRowsInLog);
+        save();   // best effort: a read-only log directory just means indexing again next time
+    }
+
+    return true;
+}
+
+void MeasurementLogIndex::close()
+{
+    unmapFile (logMapping);
+    unmapFile (indexMapping);
+    logData = nullptr;
+    logSize = 0;
+    firstRowOffset = 0;
+    rowStride = 0;
+    logCreatedUnixMs = 0;
+    channels.clear();
+    numRowsIndexed = 0;
+    startTime = endTime = 0.0;
+    loadedFromDisk = false;
+    dirty = false;
+}
+
+bool MeasurementLogIndex::mapLog (std::string* errorMessage)
+{
+    logData = nullptr;
+
+    if (! mapFile (logPath, logMapping, errorMessage))
+        return false;
+
+    const auto* data = static_cast<const unsigned char*> (logMapping.data);
+    const auto* stream = THDRecord::view<THDRecord::StreamHeader> (data, logMapping.size);
+
+    if (stream == nullptr)
+    {
+        setError (errorMessage, logPath + ": not a binary measurement log (.thdr)");
+        return false;
+    }
+
+    // Rows all come from one writer, so the first one's size is the stride. A
+    // header without rows yet gets this build's size.
+    firstRowOffset = stream->header.size;
+    const auto* firstRow = THDRecord::view<THDRecord::Measurement> (data + firstRowOffset, logMapping.size - firstRowOffset);
+    rowStride = firstRow != nullptr ? firstRow->header.size : sizeof (THDRecord::Measurement);
+
+    if (logMapping.size > firstRowOffset + sizeof (THDRecord::Header) && firstRow == nullptr)
+    {
+        setError (errorMessage, logPath + ": unreadable first record");
+        return false;
+    }
+
+    logData = data;
+    logSize = logMapping.size;
+    logCreatedUnixMs = stream->createdUnixMs;
+    return true;
+}
+
+const unsigned char* MeasurementLogIndex::rowAt (uint64_t row) const noexcept
+{
+    return logData + firstRowOffset + static_cast<size_t> (row) * rowStride;
+}
+
+MeasurementLogIndex::Channel& MeasurementLogIndex::channelFor (int channelId)
+{
+    auto position = std::lower_bound (channels.begin(), channels.end(), channelId,
+                                      [] (const Channel& channel, int id) { return channel.id < id; });
+
+    if (position == channels.end() || position->id != channelId)
+    {
+        position = channels.insert (position, Channel());
+        position->id = channelId;
+    }
+
+    return *position;
+}
+
+const MeasurementLogIndex::Channel* MeasurementLogIndex::findChannel (int channelId) const noexcept
+{
+    const auto position = std::lower_bound (channels.begin(), channels.end(), channelId,
+                                            [] (const Channel& channel, int id) { return channel.id < id; });
+
+    return position != channels.end() && position->id == channelId ? &*position : nullptr;
+}
+
+std::vector<int> MeasurementLogIndex::getChannelIds() const
+{
+    std::vector<int> ids;
+    for (const auto& channel : channels)
+        ids.push_back (channel.id);
+
+    return ids;
+}
+
+int MeasurementLogIndex::getNumLevels (int channelId) const noexcept
+{
+    const auto* channel = findChannel (channelId);
+    return channel != nullptr ? channel->numLevels : 0;
+}
+
+//==============================================================================
+bool MeasurementLogIndex::loadIndex()
+{
+    if (! mapFile (indexPathFor (logPath), indexMapping, nullptr))
+        return false;
+
+    const auto* data = static_cast<const unsigned char*> (indexMapping.data);
+    const auto size = indexMapping.size;
+    const auto* header = reinterpret_cast<const FileHeader*> (data);
+    const auto numRowsInLog = static_cast<uint64_t> ((logSize - firstRowOffset) / rowStride);
+
+    // An index for another log, an older layout, or a log that has since been truncated is rebuilt.
+    if (size < sizeof (FileHeader) || header->magic != magic || header->version != formatVersion
+        || header->bucketSize != sizeof (Bucket) || header->rowsPerBucket != rowsPerBucket || header->fanOut != fanOut
+        || header->logCreatedUnixMs != logCreatedUnixMs || header->rowStride != rowStride || header->numRows > numRowsInLog
+        || size < sizeof (FileHeader) + static_cast<size_t> (header->numChannels) * sizeof (ChannelHeader))
+    {
+        unmapFile (indexMapping);
+        return false;
+    }
+
+    channels.assign (header->numChannels, Channel());
+
+    for (size_t index = 0; index < channels.size(); ++index)
+    {
+        const auto* entry = reinterpret_cast<const ChannelHeader*> (data + sizeof (FileHeader) + index * sizeof (ChannelHeader));
+        auto& channel = channels[index];
+
+        if (entry->numLevels > static_cast<uint32_t> (maxLevels) || (index > 0 && entry->id <= channels[index - 1].id))
+        {
+            unmapFile (indexMapping);
+            channels.clear();
+            return false;
+        }
+
+        channel.id = entry->id;
+        channel.numLevels = static_cast<int> (entry->numLevels);
+        channel.numRows = entry->numRows;
+
+        for (int level = 0; level < channel.numLevels; ++level)
+        {
+            const auto offset = entry->levelOffset[level];
+            const auto count = entry->levelCount[level];
+
+            if (offset % alignof (Bucket) != 0 || offset > size || count > (size - offset) / sizeof (Bucket))
+            {
+                unmapFile (indexMapping);
+                channels.clear();
+                return false;
+            }
+
+            channel.levels[static_cast<size_t> (level)].stored = reinterpret_cast<const Bucket*> (data + offset);
+            channel.levels[static_cast<size_t> (level)].numStored = static_cast<size_t> (count);
+        }
+
+        if (entry->rowsOffset % alignof (uint32_t) != 0 || entry->rowsOffset > size
+            || entry->numRows > (size - entry->rowsOffset) / sizeof (uint32_t))
+        {
+            unmapFile (indexMapping);
+            channels.clear();
+            return false;
+        }
+
+        channel.rows.stored = reinterpret_cast<const uint32_t*> (data + entry->rowsOffset);
+        channel.rows.numStored = static_cast<size_t> (entry->numRows);
+    }
+
+    numRowsIndexed = header->numRows;
+    startTime = header->startTime;
+    endTime = header->endTime;
+    dirty = false;
+    return true;
+}
+
+void MeasurementLogIndex::indexRows (uint64_t fromRow, uint64_t toRow)
+{
+    if (toRow <= fromRow)
+        return;
+
+    std::vector<int> builderForId (static_cast<size_t> (maxChannelId - minChannelId + 1), -1);
+    std::vector<BucketBuilder> builders;
+    std::vector<int> builderChannelIds;
+    std::vector<uint64_t> resumeRows;
+    std::vector<size_t> firstChangedBuckets;
+
+    auto haveTimeRange = numRowsIndexed > 0;
+
+    // Each channel's last level-0 bucket is usually partial: drop it and re-read its rows,
+    // so appended rows continue it rather than leaving a short bucket in the middle.
+    auto scanFrom = fromRow;
+
+    const auto builderFor = [&] (int channelId) -> int
+    {
+        auto& slot = builderForId[static_cast<size_t> (channelId - minChannelId)];
+        if (slot >= 0)
+            return slot;
+
+        slot = static_cast<int> (builders.size());
+        builders.emplace_back();
+        builderChannelIds.push_back (channelId);
+
+        auto& channel = channelFor (channelId);
+        auto& level0 = channel.levels[0];
+        auto resume = fromRow;
+        auto firstChanged = level0.size();
+
+        if (level0.size() > 0 && level0[level0.size() - 1].count < rowsPerBucket)
+        {
+            const auto& partial = level0[level0.size() - 1];
+            resume = partial.firstRow;
+            channel.numRows -= partial.count;
+            firstChanged = level0.size() - 1;
+            channel.rows.truncate (firstChanged * rowsPerBucket);
+
+            if (level0.appended.empty())
+                --level0.numStored;
+            else
+                level0.appended.pop_back();
+        }
+
+        resumeRows.push_back (resume);
+        firstChangedBuckets.push_back (firstChanged);
+        return slot;
+    };
+
+    const auto emitBucket = [&] (size_t slot)
+    {
+        auto& builder = builders[slot];
+        auto& channel = channelFor (builderChannelIds[slot]);
+
+        channel.rows.appended.insert (channel.rows.appended.end(), builder.rowOffsets, builder.rowOffsets + builder.numRowOffsets);
+        channel.numRows += builder.count;
+        channel.levels[0].appended.push_back (builder.take());
+    };
+
+    for (const auto& channel : channels)
+        if (channel.id >= minChannelId && channel.id <= maxChannelId)
+            scanFrom = std::min (scanFrom, resumeRows[static_cast<size_t> (builderFor (channel.id))]);
+
+    for (auto row = scanFrom; row < toRow; ++row)
+    {
+        const auto& record = *reinterpret_cast<const THDRecord::Measurement*> (rowAt (row));
+
+        if (record.header.type != static_cast<uint16_t> (THDRecord::Type::measurement)
+            || record.channelId < minChannelId || record.channelId > maxChannelId)
+            continue;
+
+        const auto slot = static_cast<size_t> (builderFor (record.channelId));
+        if (row < resumeRows[slot])
+            continue;
+
+        auto& builder = builders[slot];
+        builder.add (record, row);
+
+        if (builder.count == rowsPerBucket)
+            emitBucket (slot);
+
+        if (! haveTimeRange)
+        {
+            startTime = endTime = record.timeSeconds;
+            haveTimeRange = true;
+        }
+
+        startTime = std::min (startTime, record.timeSeconds);
+        endTime = std::max (endTime, record.timeSeconds);
+    }
+
+    for (size_t slot = 0; slot < builders.size(); ++slot)
+    {
+        if (builders[slot].count > 0)
+            emitBucket (slot);
+
+        rebuildLevels (channelFor (builderChannelIds[slot]), firstChangedBuckets[slot]);
+    }
+
+    numRowsIndexed = toRow;
+    dirty = true;
+}
+
+void MeasurementLogIndex::rebuildLevels (Channel& channel, size_t firstChangedBucket)
+{
+    auto changed = firstChangedBucket;
+    int level = 1;
+
+    for (; level < maxLevels && channel.levels[static_cast<size_t> (level - 1)].size() > 1; ++level)
+    {
+        const auto& below = channel.levels[static_cast<size_t> (level - 1)];
+        auto& current = channel.levels[static_cast<size_t> (level)];
+        changed /= fanOut;
+
+        // Keep the buckets whose children did not change; rebuild the rest.
+        if (changed < current.numStored)
+        {
+            current.numStored = changed;
+            current.appended.clear();
+        }
+        else
+        {
+            current.appended.resize (std::min (current.appended.size(), changed - current.numStored));
+        }
+
+        for (auto bucket = current.size(); bucket * fanOut < below.size(); ++bucket)
+        {
+            Bucket merged {};
+            const auto end = std::min (below.size(), (bucket + 1) * fanOut);
+
+            for (auto child = bucket * fanOut; child < end; ++child)
+                mergeBucket (merged, below[child]);
+
+            current.appended.push_back (merged);
+        }
+    }
+
+    channel.numLevels = channel.levels[0].size() > 0 ? level : 0;
+
+    for (auto unused = static_cast<size_t> (level); unused < channel.levels.size(); ++unused)
+        channel.levels[unused] = Level();
+}
+
+bool MeasurementLogIndex::refresh (std::string* errorMessage)
+{
+    if (! isOpen())
+        return false;
+
+    const auto previousCreated = logCreatedUnixMs;
+    const auto previousStride = rowStride;
+
+    if (! mapLog (errorMessage))
+        return false;
+
+    const auto numRowsInLog = static_cast<uint64_t> ((logSize - firstRowOffset) / rowStride);
+
+    if (logCreatedUnixMs != previousCreated || rowStride != previousStride || numRowsInLog < numRowsIndexed)
+        return open (logPath, errorMessage);
+
+    if (numRowsInLog == numRowsIndexed)
+        return false;
+
+    indexRows (numRowsIndexed, numRowsInLog);
+    return true;
+}
+
+bool MeasurementLogIndex::save (std::string* errorMessage)
+{
+    if (! isOpen())
+        return false;
+
+    if (! dirty)
+        return true;
+
+    FileHeader header {};
+    header.magic = magic;
+    header.version = formatVersion;
+    header.bucketSize = sizeof (Bucket);
+    header.rowsPerBucket = rowsPerBucket;
+    header.fanOut = fanOut;
+    header.numChannels = static_cast<uint32_t> (channels.size());
+    header.numRows = numRowsIndexed;
+    header.logCreatedUnixMs = logCreatedUnixMs;
+    header.rowStride = rowStride;
+    header.startTime = startTime;
+    header.endTime = endTime;
+
+    std::vector<ChannelHeader> entries (channels.size());
+    auto offset = static_cast<uint64_t> (sizeof (FileHeader) + entries.size() * sizeof (ChannelHeader));
+
+    for (size_t index = 0; index < channels.size(); ++index)
+    {
+        const auto& channel = channels[index];
+        auto& entry = entries[index];
+        std::memset (&entry, 0, sizeof (entry));
+        entry.id = channel.id;
+        entry.numLevels = static_cast<uint32_t> (channel.numLevels);
+        entry.numRows = channel.numRows;
+
+        for (int level = 0; level < channel.numLevels; ++level)
+        {
+            entry.levelOffset[level] = offset;
+            entry.levelCount[level] = channel.levels[static_cast<size_t> (level)].size();
+            offset += entry.levelCount[level] * sizeof (Bucket);
+        }
+
+        // Row lists are 4-byte entries; pad after them so the next channel's buckets stay 8-aligned.
+        entry.rowsOffset = offset;
+        offset += (channel.numRows * sizeof (uint32_t) + 7) & ~static_cast<uint64_t> (7);
+    }
+
+    const auto path = indexPathFor (logPath);
+    const auto temporaryPath = path + ".tmp";
+    auto* file = std::fopen (temporaryPath.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        setError (errorMessage, temporaryPath + ": " + std::strerror (errno));
+        return false;
+    }
+
+    auto written = std::fwrite (&header, sizeof (header), 1, file) == 1
+                && (entries.empty() || std::fwrite (entries.data(), sizeof (ChannelHeader), entries.size(), file) == entries.size());
+
+    for (const auto& channel : channels)
+    {
+        for (int level = 0; written && level < channel.numLevels; ++level)
+        {
+            const auto& buckets = channel.levels[static_cast<size_t> (level)];
+
+            written = (buckets.numStored == 0 || std::fwrite (buckets.stored, sizeof (Bucket), buckets.numStored, file) == buckets.numStored)
+                   && (buckets.appended.empty() || std::fwrite (buckets.appended.data(), sizeof (Bucket), buckets.appended.size(), file) == buckets.appended.size());
+        }
+
+        const auto& rows = channel.rows;
+        const uint32_t padding = 0;
+
+        written = written
+               && (rows.numStored == 0 || std::fwrite (rows.stored, sizeof (uint32_t), rows.numStored, file) == rows.numStored)
+               && (rows.appended.empty() || std::fwrite (rows.appended.data(), sizeof (uint32_t), rows.appended.size(), file) == rows.appended.size())
+               && (rows.size() % 2 == 0 || std::fwrite (&padding, sizeof (padding), 1, file) == 1);
+    }
+
+    if (std::fclose (file) != 0 || ! written || std::rename (temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        setError (errorMessage, path + ": write failed");
+        std::remove (temporaryPath.c_str());
+        return false;
+    }
+
+    // Point at the file just written; the in-memory buckets are no longer needed.
+    if (! loadIndex())
+    {
+        setError (errorMessage, path + ": could not re-read the index just written");
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+int MeasurementLogIndex::query (int channelId, Column column, double fromTime, double toTime, int numPoints, std::vector<Span>& spans) const
+{
+    spans.assign (static_cast<size_t> (std::max (0, numPoints)), Span());
+
+    if (numPoints <= 0 || toTime <= fromTime)
+        return 0;
+
+    const auto pointWidth = (toTime - fromTime) / numPoints;
+    for (int point = 0; point < numPoints; ++point)
+    {
+        spans[static_cast<size_t> (point)].startTime = fromTime + point * pointWidth;
+        spans[static_cast<size_t> (point)].endTime = fromTime + (point + 1) * pointWidth;
+    }
+
+    const auto* channel = findChannel (channelId);
+    if (channel == nullptr || channel->numLevels == 0)
+        return 0;
+
+    // Buckets are close to evenly spaced in time, so a level's bucket width is its span over its count.
+    const auto& level0 = channel->levels[0];
+    const auto channelDuration = std::max (1.0e-9, level0[level0.size() - 1].endTime - level0[0].startTime);
+    int level = -1;
+
+    for (int candidate = 0; candidate < channel->numLevels; ++candidate)
+    {
+        if (channelDuration / static_cast<double> (channel->levels[static_cast<size_t> (candidate)].size()) > pointWidth)
+            break;
+
+        level = candidate;
+    }
+
+    if (level < 0)
+    {
+        queryRows (*channel, column, fromTime, toTime, numPoints, spans);
+        return -1;
+    }
+
+    const auto& buckets = channel->levels[static_cast<size_t> (level)];
+    const auto columnIndex = static_cast<int> (column);
+
+    // First bucket ending at or after fromTime.
+    size_t low = 0, high = buckets.size();
+    while (low < high)
+    {
+        const auto middle = (low + high) / 2;
+        if (buckets[middle].endTime < fromTime)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (auto index = low; index < buckets.size() && buckets[index].startTime < toTime; ++index)
+    {
+        const auto& bucket = buckets[index];
+        const auto centre = 0.5 * (bucket.startTime + bucket.endTime);
+        const auto point = std::clamp (static_cast<int> ((centre - fromTime) / pointWidth), 0, numPoints - 1);
+
+        mergeSpan (spans[static_cast<size_t> (point)], bucket.minimum[columnIndex], bucket.maximum[columnIndex],
+                   bucket.mean[columnIndex], bucket.count);
+    }
+
+    return level;
+}
+
+void MeasurementLogIndex::queryRows (const Channel& channel, Column column, double fromTime, double toTime,
+                                     int numPoints, std::vector<Span>& spans) const
+{
+    const auto& buckets = channel.levels[0];
+    const auto pointWidth = (toTime - fromTime) / numPoints;
+    const auto columnIndex = static_cast<int> (column);
+
+    size_t low = 0, high = buckets.size();
+    while (low < high)
+    {
+        const auto middle = (low + high) / 2;
+        if (buckets[middle].endTime < fromTime)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (auto index = low; index < buckets.size() && buckets[index].startTime < toTime; ++index)
+    {
+        const auto& bucket = buckets[index];
+        const auto firstListed = index * rowsPerBucket;
+
+        for (auto listed = firstListed; listed < firstListed + bucket.count && listed < channel.rows.size(); ++listed)
+        {
+            const auto& record = *reinterpret_cast<const THDRecord::Measurement*> (rowAt (bucket.firstRow + channel.rows[listed]));
+            if (record.timeSeconds < fromTime || record.timeSeconds >= toTime)
+                continue;
+
+            const auto point = std::clamp (static_cast<int> ((record.timeSeconds - fromTime) / pointWidth), 0, numPoints - 1);
+            const auto value = columnValue (record, columnIndex);
+            mergeSpan (spans[static_cast<size_t> (point)], value, value, value, 1);
+        }
+    }
+}
@@ -0,0 +1,195 @@
+/* ==============================================================================
+   Measurement Log Index
+   Level-of-detail index over a binary measurement log (.thdr), so hours of
+   many-channel logs open and zoom instantly.
+
+   The log is memory-mapped and read in place; rows are fixed-size records,
+   so row r sits at a known offset. For every channel the index keeps a
+   pyramid of buckets: a level-0 bucket summarises 16 of that channel's rows,
+   and each bucket of level k + 1 summarises 8 of level k. A bucket holds its
+   time span, the log rows it covers and min / max / mean of every column.
+   Each channel also lists its own rows, so reading one channel's rows never
+   steps through the rows of the channels interleaved with it.
+
+   query() picks the coarsest level whose buckets are still narrower than one
+   output point, binary-searches the first bucket in view and merges what it
+   finds into one span per point. It touches only that level, at most a few
+   buckets per point, whatever the log length. Closer in than level 0, it
+   reads that channel's rows themselves, fewer than 16 per point.
+
+   The index persists next to the log as <log>.thdx and is memory-mapped on
+   the next open, so opening costs a few page faults instead of a pass over
+   the log. A log that has grown since (the daemon appends while it runs) is
+   extended from the last partial bucket; refresh() does the same for a log
+   being viewed live, keeping the new buckets in memory until save(). Logs
+   that were replaced or truncated are re-indexed from scratch.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MeasurementLogIndex
+{
+public:
+    enum class Column : int
+    {
+        thd = 0,
+        thdN,
+        level,
+        peakLevel,
+        h2, h3, h4, h5, h6, h7, h8,
+        numColumns
+    };
+
+    static constexpr int numColumns = static_cast<int> (Column::numColumns);
+    static constexpr uint32_t magic = 0x58444854;  // "THDX" in file order
+    static constexpr uint32_t formatVersion = 1;
+    static constexpr uint32_t rowsPerBucket = 16;  // level 0
+    static constexpr uint32_t fanOut = 8;          // level k buckets per level k + 1 bucket
+    static constexpr int maxLevels = 12;
+
+    struct Bucket
+    {
+        double startTime;
+        double endTime;
+        uint64_t firstRow;          // log rows spanned (all channels)
+        uint64_t lastRow;
+        uint32_t count;             // this channel's rows
+        uint32_t reserved[4];
+        float minimum[numColumns];
+        float maximum[numColumns];
+        float mean[numColumns];
+    };
+
+    static_assert (sizeof (Bucket) == 184, "Bucket layout");
+
+    /** One output point: the data of one channel and column within [startTime, endTime). */
+    struct Span
+    {
+        double startTime = 0.0;
+        double endTime = 0.0;
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        float mean = 0.0f;
+        uint32_t count = 0;         // 0 = no data in this span
+    };
+
+    MeasurementLogIndex() = default;
+    ~MeasurementLogIndex();
+
+    MeasurementLogIndex (const MeasurementLogIndex&) = delete;
+    MeasurementLogIndex& operator= (const MeasurementLogIndex&) = delete;
+
+    /** Maps the log and its index, building or extending the index (and saving it) as needed. */
+    bool open (const std::string& logPath, std::string* errorMessage = nullptr);
+    void close();
+    bool isOpen() const noexcept { return logData != nullptr; }
+
+    /** Indexes rows appended since open or the last refresh; false if nothing changed. */
+    bool refresh (std::string* errorMessage = nullptr);
+
+    /** Writes the index (including refreshed rows) to <log>.thdx; the log itself is never written. */
+    bool save (std::string* errorMessage = nullptr);
+
+    /** Whether open() found a usable index on disk rather than reading the whole log. */
+    bool wasLoadedFromDisk() const noexcept { return loadedFromDisk; }
+
+    uint64_t getNumRows() const noexcept { return numRowsIndexed; }
+    double getStartTime() const noexcept { return startTime; }
+    double getEndTime() const noexcept { return endTime; }
+
+    /** Channel ids in the log, ascending; the Master Brain aggregate is -1. */
+    std::vector<int> getChannelIds() const;
+
+    int getNumLevels (int channelId) const noexcept;
+
+    /** Fills numPoints spans evenly covering [fromTime, toTime) for one channel and column.
+        Returns the level read, or -1 when rows were read directly (closer in than level 0). */
+    int query (int channelId, Column column, double fromTime, double toTime, int numPoints, std::vector<Span>& spans) const;
+
+    static const char* getColumnName (Column column) noexcept;
+    static std::string indexPathFor (const std::string& logPath) { return logPath + ".thdx"; }
+
+private:
+    struct Level
+    {
+        const Bucket* stored = nullptr;     // in the mapped index file
+        size_t numStored = 0;               // leading stored buckets still valid
+        std::vector<Bucket> appended;       // buckets after those, built since the file was written
+
+        size_t size() const noexcept { return numStored + appended.size(); }
+        const Bucket& operator[] (size_t i) const noexcept { return i < numStored ? stored[i] : appended[i - numStored]; }
+    };
+
+    /** A channel's rows in log order, as offsets from the firstRow of their level-0 bucket. */
+    struct RowList
+    {
+        const uint32_t* stored = nullptr;
+        size_t numStored = 0;
+        std::vector<uint32_t> appended;
+
+        size_t size() const noexcept { return numStored + appended.size(); }
+        uint32_t operator[] (size_t i) const noexcept { return i < numStored ? stored[i] : appended[i - numStored]; }
+
+        void truncate (size_t newSize)
+        {
+            if (newSize < numStored)
+            {
+                numStored = newSize;
+                appended.clear();
+            }
+            else
+            {
+                appended.resize (newSize - numStored);
+            }
+        }
+    };
+
+    struct Channel
+    {
+        int id = 0;
+        std::array<Level, maxLevels> levels;
+        RowList rows;                       // rows[bucket * rowsPerBucket + i] for level-0 bucket i
+        int numLevels = 0;
+        uint64_t numRows = 0;
+    };
+
+    struct Mapping
+    {
+        const void* data = nullptr;
+        size_t size = 0;
+        std::vector<uint64_t> heapCopy;     // platforms without mmap
+    };
+
+    bool mapLog (std::string* errorMessage);
+    bool loadIndex();
+    void indexRows (uint64_t fromRow, uint64_t toRow);
+    void rebuildLevels (Channel& channel, size_t firstChangedBucket);
+    Channel& channelFor (int channelId);
+    const Channel* findChannel (int channelId) const noexcept;
+    const unsigned char* rowAt (uint64_t row) const noexcept;
+    void queryRows (const Channel& channel, Column column, double fromTime, double toTime, int numPoints, std::vector<Span>& spans) const;
+
+    static bool mapFile (const std::string& path, Mapping& mapping, std::string* errorMessage);
+    static void unmapFile (Mapping& mapping);
+
+    std::string logPath;
+    Mapping logMapping, indexMapping;
+    const unsigned char* logData = nullptr;
+    size_t logSize = 0;
+    size_t firstRowOffset = 0;
+    size_t rowStride = 0;
+    uint64_t logCreatedUnixMs = 0;
+
+    std::vector<Channel> channels;          // ascending id
+    uint64_t numRowsIndexed = 0;
+    double startTime = 0.0;
+    double endTime = 0.0;
+    bool loadedFromDisk = false;
+    bool dirty = false;
+};
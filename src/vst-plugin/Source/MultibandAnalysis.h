@@ -0,0 +1,234 @@
+/* ==============================================================================
+   Multiband Analysis
+   Per-band THD / THD+N from the power spectrum a hop has already computed,
+   so a bass saturator and a de-esser each show up in their own region
+   instead of only through the loudest partial.
+
+   The spectrum is split into 3 or 4 bands by crossover masks precomputed
+   once per band count. Each crossover fades its lower band out and its
+   upper band in with a raised cosine over +/- crossoverHalfWidthOctaves; the
+   weights of each bin sum to one across bands. The masks are real and
+   applied to bin power, so the split behaves like a linear-phase crossover,
+   and no extra FFT is needed.
+
+   Per band:
+     - the fundamental is the strongest masked bin where the band has at
+       least half the weight;
+     - harmonics of that fundamental are read from the unmasked spectrum,
+       since a band's distortion products usually land above its upper edge;
+     - THD+N adds the masked noise inside the band, with the harmonic
+       regions left out.
+   Each band makes one weighted pass over its bins plus the usual harmonic
+   peak search. A whole hop costs about one more pass over the spectrum.
+   ============================================================================== */
+
+#pragma once
+
+#include "HarmonicAnalysis.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+class MultibandAnalysis
+{
+public:
+    static constexpr int minBands = 3;
+    static constexpr int maxBands = 4;
+    static constexpr float crossoverHalfWidthOctaves = 1.0f / 3.0f;
+
+    struct BandReading
+    {
+        float fundamentalFrequency = 0.0f;
+        float thd = 0.0f;
+        float thdN = 0.0f;
+        float level = 0.0f;               // band RMS, linear
+        bool fundamentalValid = false;
+    };
+
+    using Readings = std::array<BandReading, maxBands>;
+
+    /** Crossover frequencies for a band count: low / mid / high, or low / low-mid / presence / sibilance. */
+    static float crossoverHz (int numBands, int crossover) noexcept
+    {
+        static constexpr std::array<float, minBands - 1> threeBands { 250.0f, 4000.0f };
+        static constexpr std::array<float, maxBands - 1> fourBands { 200.0f, 1000.0f, 5000.0f };
+
+        return numBands == minBands ? threeBands[static_cast<size_t> (crossover)]
+                                    : fourBands[static_cast<size_t> (crossover)];
+    }
+
+    /** Allocates the crossover table; call off the audio thread, then setNumBands() from anywhere. */
+    void prepare (int fftSizeToUse, float sampleRateToUse)
+    {
+        fftSize = fftSizeToUse;
+        sampleRate = sampleRateToUse;
+        upperShare.assign (static_cast<size_t> (fftSize / 2), 0.0f);
+
+        const auto bands = numBands;
+        numBands = 0;
+        setNumBands (bands);
+    }
+
+    /** Rebuilds the masks for 0 (off), 3 or 4 bands in place, without allocating. */
+    void setNumBands (int newNumBands) noexcept
+    {
+        newNumBands = newNumBands >= minBands ? std::min (newNumBands, maxBands) : 0;
+
+        if (newNumBands == numBands || upperShare.empty())
+        {
+            numBands = newNumBands;
+            return;
+        }
+
+        numBands = newNumBands;
+        const auto numBins = static_cast<int> (upperShare.size());
+        const auto binHz = sampleRate / static_cast<float> (fftSize);
+
+        for (int crossover = 0; crossover < numBands - 1; ++crossover)
+        {
+            const auto centre = crossoverHz (numBands, crossover);
+            auto& transition = transitions[static_cast<size_t> (crossover)];
+            transition.first = std::clamp (static_cast<int> (std::ceil (centre * std::exp2 (-crossoverHalfWidthOctaves) / binHz)), 1, numBins);
+            transition.end = std::clamp (static_cast<int> (std::ceil (centre * std::exp2 (crossoverHalfWidthOctaves) / binHz)), transition.first, numBins);
+
+            for (int bin = transition.first; bin < transition.end; ++bin)
+            {
+                const auto position = std::log2 (static_cast<float> (bin) * binHz / centre) / crossoverHalfWidthOctaves;
+                upperShare[static_cast<size_t> (bin)] = 0.5f - 0.5f * std::cos (0.5f * pi * (std::clamp (position, -1.0f, 1.0f) + 1.0f));
+            }
+        }
+    }
+
+    int getNumBands() const noexcept { return numBands; }
+
+    /** Analyses every band of a power spectrum read at power[bin * stride]; unused readings are cleared. */
+    void analyze (const float* power, size_t stride, Readings& readings) const noexcept
+    {
+        readings = {};
+
+        for (int band = 0; band < numBands; ++band)
+            analyzeBand (band, power, stride, readings[static_cast<size_t> (band)]);
+    }
+
+private:
+    static constexpr float pi = 3.14159265358979f;
+
+    struct Transition
+    {
+        int first = 1;
+        int end = 1;
+    };
+
+    /** Calls fn (bin, weight) over the bins band owns any share of, in ascending order. */
+    template <typename Fn>
+    void forEachBandBin (int band, int minBin, Fn&& fn) const noexcept
+    {
+        const auto numBins = static_cast<int> (upperShare.size());
+        const auto* below = band > 0 ? &transitions[static_cast<size_t> (band - 1)] : nullptr;
+        const auto* above = band < numBands - 1 ? &transitions[static_cast<size_t> (band)] : nullptr;
+
+        const auto riseEnd = below != nullptr ? below->end : minBin;
+        const auto fallFirst = above != nullptr ? above->first : numBins;
+
+        if (below != nullptr)
+            for (int bin = std::max (minBin, below->first); bin < below->end; ++bin)
+                fn (bin, upperShare[static_cast<size_t> (bin)]);
+
+        for (int bin = std::max (minBin, riseEnd); bin < fallFirst; ++bin)
+            fn (bin, 1.0f);
+
+        if (above != nullptr)
+            for (int bin = std::max (minBin, above->first); bin < above->end; ++bin)
+                fn (bin, 1.0f - upperShare[static_cast<size_t> (bin)]);
+    }
+
+    float weightOf (int band, int bin) const noexcept
+    {
+        if (band > 0)
+        {
+            const auto& below = transitions[static_cast<size_t> (band - 1)];
+            if (bin < below.first)
+                return 0.0f;
+            if (bin < below.end)
+                return upperShare[static_cast<size_t> (bin)];
+        }
+
+        if (band < numBands - 1)
+        {
+            const auto& above = transitions[static_cast<size_t> (band)];
+            if (bin >= above.end)
+                return 0.0f;
+            if (bin >= above.first)
+                return 1.0f - upperShare[static_cast<size_t> (bin)];
+        }
+
+        return 1.0f;
+    }
+
+    void analyzeBand (int band, const float* power, size_t stride, BandReading& reading) const noexcept
+    {
+        const auto searchBand = HarmonicAnalysis::fundamentalSearchBand (fftSize, sampleRate);
+        const auto at = [power, stride] (int bin) { return power[static_cast<size_t> (bin) * stride]; };
+
+        float totalPower = 0.0f;
+        float peakPower = 0.0f;
+        int peakBin = 0;
+
+        forEachBandBin (band, searchBand.minBin, [&] (int bin, float weight)
+        {
+            const auto weighted = at (bin) * weight;
+            totalPower += weighted;
+
+            if (weight >= 0.5f && weighted > peakPower)
+            {
+                peakPower = weighted;
+                peakBin = bin;
+            }
+        });
+
+        // Band RMS: a full-scale sine's bins sum to 3 N^2 / 8 with the sum-to-N Hann window.
+        const auto level = std::sqrt (totalPower * (4.0f / 3.0f)) / static_cast<float> (fftSize);
+        const auto fundamentalPower = peakBin > 0 ? at (peakBin) : 0.0f;
+
+        // Confidence is the fundamental's share of the masked band, scaled to its unmasked power.
+        const auto scaledTotalPower = peakPower > 0.0f ? totalPower * (fundamentalPower / peakPower) : 0.0f;
+
+        HarmonicAnalysis::Result result;
+        if (! HarmonicAnalysis::classifyFundamental (result, peakBin, fundamentalPower, scaledTotalPower, level, fftSize, sampleRate))
+        {
+            copyReading (result, reading);
+            return;
+        }
+
+        const auto harmonicBins = HarmonicAnalysis::harmonicBinsFor (result.fundamentalFrequency, fftSize, sampleRate);
+        const auto harmonicPower = HarmonicAnalysis::measureHarmonics (result, power, stride, fftSize, fundamentalPower, harmonicBins);
+
+        // In-band noise is the masked total less the masked harmonic regions.
+        auto excludedPower = 0.0f;
+        HarmonicAnalysis::forEachHarmonicRegion (harmonicBins, searchBand.minBin, fftSize, [&] (int first, int last)
+        {
+            for (int bin = first; bin <= last; ++bin)
+                excludedPower += at (bin) * weightOf (band, bin);
+        });
+
+        HarmonicAnalysis::finishNoise (result, harmonicPower, std::max (0.0f, totalPower - excludedPower), fundamentalPower);
+        copyReading (result, reading);
+    }
+
+    static void copyReading (const HarmonicAnalysis::Result& result, BandReading& reading) noexcept
+    {
+        reading.fundamentalFrequency = result.fundamentalFrequency;
+        reading.thd = result.fundamentalValid ? result.thd : 0.0f;
+        reading.thdN = result.fundamentalValid ? result.thdN : 0.0f;
+        reading.level = result.level;
+        reading.fundamentalValid = result.fundamentalValid;
+    }
+
+    std::vector<float> upperShare;                           // per bin, inside crossover transitions only
+    std::array<Transition, maxBands - 1> transitions {};
+    int fftSize = 1;
+    float sampleRate = 48000.0f;
+    int numBands = 0;
+};
@@ -0,0 +1,407 @@
+/* ==============================================================================
+   Reference Analysis
+   Dual-channel distortion measurement against a clean reference (sidechain).
+
+   The processed signal y is compared with the reference x it was made from.
+   Whatever part of y is linearly related to x (gain, EQ, delay) is coherent;
+   everything else (harmonics, intermodulation, aliasing, noise) counts as
+   distortion, so programme material works as well as a test tone:
+
+     gamma^2[k]   = |Gxy[k]|^2 / (Gxx[k] Gyy[k])
+     coherent     = sum gamma^2 Gyy,  non-coherent = sum (1 - gamma^2) Gyy
+     distortion % = sqrt (non-coherent / coherent) * 100
+
+   Gxy, Gxx and Gyy are cross- and auto-spectra averaged over recent hops. A
+   single frame is always fully coherent, so a result is only valid once a few
+   hops have been averaged.
+
+   The reference is delayed to line up with the processed frame. The delay is
+   found once by FFT cross-correlation (GCC-PHAT of the processed frame
+   against two frames of reference history, lags 0 .. fftSize) and is then
+   tracked every hop from the time-domain correlation at lag - 1, lag and
+   lag + 1. The FFT search only runs again if that correlation is lost.
+
+   Per hop this costs one two-lane BatchedSpectrumAnalyzer pass (processed
+   plus aligned reference; the processed lane's harmonic result comes from
+   the same FFT), one pass over the bins for the averages and three dot
+   products for tracking.
+   ============================================================================== */
+
+#pragma once
+
+#include "BatchedSpectrumAnalyzer.h"
+#include "HarmonicAnalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+template <int fftOrder>
+class ReferenceAnalysis
+{
+public:
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int maxLatencySamples = fftSize;
+
+    struct Result
+    {
+        HarmonicAnalysis::Result processed;
+        HarmonicAnalysis::Result reference;
+        float distortionPercent = 0.0f;  // non-coherent vs coherent output power
+        float coherence = 0.0f;          // output-power weighted mean gamma^2, 0 .. 1
+        int latencySamples = 0;          // processed lags the reference by this much
+        bool locked = false;
+        bool valid = false;              // locked and averaged over enough hops
+    };
+
+    ReferenceAnalysis()
+        : history (static_cast<size_t> (historySize), 0.0f),
+          searchReal (static_cast<size_t> (historySize), 0.0f),
+          searchImag (static_cast<size_t> (historySize), 0.0f),
+          aligned (static_cast<size_t> (fftSize), 0.0f),
+          neighbour (static_cast<size_t> (fftSize), 0.0f),
+          crossReal (static_cast<size_t> (halfSize), 0.0f),
+          crossImag (static_cast<size_t> (halfSize), 0.0f),
+          referencePower (static_cast<size_t> (halfSize), 0.0f),
+          processedPower (static_cast<size_t> (halfSize), 0.0f),
+          bitReversed (static_cast<size_t> (historySize)),
+          twiddleCos (static_cast<size_t> (historySize / 2)),
+          twiddleSin (static_cast<size_t> (historySize / 2))
+    {
+        constexpr double pi = 3.14159265358979323846;
+
+        for (int i = 0; i < historySize; ++i)
+        {
+            int reversed = 0;
+            for (int bit = 0; bit < searchOrder; ++bit)
+                reversed |= ((i >> bit) & 1) << (searchOrder - 1 - bit);
+
+            bitReversed[static_cast<size_t> (i)] = reversed;
+        }
+
+        for (int i = 0; i < historySize / 2; ++i)
+        {
+            twiddleCos[static_cast<size_t> (i)] = static_cast<float> (std::cos (2.0 * pi * i / historySize));
+            twiddleSin[static_cast<size_t> (i)] = static_cast<float> (std::sin (2.0 * pi * i / historySize));
+        }
+    }
+
+    void reset() noexcept
+    {
+        std::fill (history.begin(), history.end(), 0.0f);
+        writePosition = 0;
+        numPushed = 0;
+        locked = false;
+        latency = 0;
+        lostHops = 0;
+        resetAverages();
+    }
+
+    /** Appends reference samples. Push exactly as many samples as the processed signal advanced. */
+    void pushReference (const float* samples, int numSamples) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const auto chunk = std::min (numSamples, historySize - writePosition);
+            std::copy_n (samples, chunk, history.begin() + writePosition);
+            samples += chunk;
+            numSamples -= chunk;
+            writePosition = (writePosition + chunk) % historySize;
+            numPushed = std::min (numPushed + chunk, historySize);
+        }
+    }
+
+    /** processedFrame is the latest fftSize processed samples, oldest first, ending with the newest pushed reference sample. */
+    void analyze (const float* processedFrame, float sampleRate, Result& result) noexcept
+    {
+        result = {};
+
+        if (numPushed >= historySize && hasSignal (processedFrame))
+        {
+            if (! locked)
+                acquireLatency (processedFrame);
+            else
+                trackLatency (processedFrame);
+        }
+
+        gatherAligned (latency, aligned.data());
+
+        const float* lanes[] = { processedFrame, aligned.data() };
+        HarmonicAnalysis::Result laneResults[2];
+        analyzer.analyze (lanes, 2, sampleRate, laneResults);
+
+        result.processed = laneResults[0];
+        result.reference = laneResults[1];
+        result.latencySamples = latency;
+        result.locked = locked;
+
+        if (! locked || laneResults[1].level <= HarmonicAnalysis::minLevel)
+            return;
+
+        accumulateSpectra (HarmonicAnalysis::fundamentalSearchBand (fftSize, sampleRate).minBin, result);
+    }
+
+private:
+    static constexpr int halfSize = fftSize / 2;
+    static constexpr int searchOrder = fftOrder + 1;
+    static constexpr int historySize = fftSize + maxLatencySamples;
+    static_assert (historySize == 1 << searchOrder, "The latency search runs one power-of-two FFT over the whole history");
+
+    static constexpr float lockCorrelation = 0.5f;   // |normalised correlation| needed to accept a lag
+    static constexpr float lostCorrelation = 0.3f;   // below this for maxLostHops hops, search again
+    static constexpr int maxLostHops = 4;
+    static constexpr int averagingHops = 16;
+    static constexpr int minAveragedHops = 4;
+
+    void resetAverages() noexcept
+    {
+        std::fill (crossReal.begin(), crossReal.end(), 0.0f);
+        std::fill (crossImag.begin(), crossImag.end(), 0.0f);
+        std::fill (referencePower.begin(), referencePower.end(), 0.0f);
+        std::fill (processedPower.begin(), processedPower.end(), 0.0f);
+        numAveraged = 0;
+    }
+
+    static float energy (const float* samples) noexcept
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < fftSize; ++i)
+            sum += samples[i] * samples[i];
+
+        return sum;
+    }
+
+    static bool hasSignal (const float* samples) noexcept
+    {
+        const auto level = HarmonicAnalysis::minLevel;
+        return energy (samples) > level * level * static_cast<float> (fftSize);
+    }
+
+    /** Copies the fftSize reference samples that line up with the processed frame at the given lag. */
+    void gatherAligned (int lag, float* destination) const noexcept
+    {
+        // History is oldest-first from writePosition; the processed frame spans its last fftSize samples.
+        auto start = (writePosition + maxLatencySamples - lag) % historySize;
+        const auto firstChunk = std::min (fftSize, historySize - start);
+        std::copy_n (history.begin() + start, firstChunk, destination);
+        std::copy_n (history.begin(), fftSize - firstChunk, destination + firstChunk);
+    }
+
+    /** |normalised correlation| between the processed frame and the reference at lag, or -1 for a silent reference. */
+    float correlationAt (const float* processedFrame, float processedEnergy, int lag) noexcept
+    {
+        gatherAligned (lag, neighbour.data());
+        const auto referenceEnergy = energy (neighbour.data());
+
+        if (! (referenceEnergy > 0.0f) || ! (processedEnergy > 0.0f))
+            return -1.0f;
+
+        float dot = 0.0f;
+        for (int i = 0; i < fftSize; ++i)
+            dot += processedFrame[i] * neighbour[static_cast<size_t> (i)];
+
+        return std::abs (dot) / std::sqrt (processedEnergy * referenceEnergy);
+    }
+
+    void acquireLatency (const float* processedFrame) noexcept
+    {
+        // Both real signals go through one complex FFT: z = processed (zero-padded) + i * reference history.
+        for (int i = 0; i < historySize; ++i)
+        {
+            searchReal[static_cast<size_t> (i)] = i < fftSize ? processedFrame[i] : 0.0f;
+            searchImag[static_cast<size_t> (i)] = history[static_cast<size_t> ((writePosition + i) % historySize)];
+        }
+
+        transform();
+
+        // P[k] = (Z[k] + conj Z[-k]) / 2, R[k] = (Z[k] - conj Z[-k]) / 2i; keep the PHAT-weighted conj(P) R.
+        for (int k = 0; k <= historySize / 2; ++k)
+        {
+            const auto mirror = static_cast<size_t> ((historySize - k) % historySize);
+            const auto index = static_cast<size_t> (k);
+            const auto zRe = searchReal[index], zIm = searchImag[index];
+            const auto mRe = searchReal[mirror], mIm = searchImag[mirror];
+
+            const auto pRe = 0.5f * (zRe + mRe), pIm = 0.5f * (zIm - mIm);
+            const auto rRe = 0.5f * (zIm + mIm), rIm = -0.5f * (zRe - mRe);
+
+            auto cRe = pRe * rRe + pIm * rIm;
+            auto cIm = pRe * rIm - pIm * rRe;
+            const auto magnitude = std::sqrt (cRe * cRe + cIm * cIm);
+            cRe = magnitude > 1.0e-20f ? cRe / magnitude : 0.0f;
+            cIm = magnitude > 1.0e-20f ? cIm / magnitude : 0.0f;
+
+            // The correlation is real, so the spectrum is Hermitian; conjugated here for the inverse below.
+            searchReal[index] = cRe;
+            searchImag[index] = -cIm;
+            searchReal[mirror] = cRe;
+            searchImag[mirror] = cIm;
+        }
+
+        // Inverse FFT as conj (FFT (conj C)); only the real part is needed, which conjugation leaves alone.
+        transform();
+
+        // searchReal[s] ~ sum processed[n] reference[n + s]; lag = fftSize - s.
+        int bestShift = 0;
+        float bestValue = -1.0f;
+        for (int shift = 0; shift <= maxLatencySamples; ++shift)
+        {
+            const auto value = std::abs (searchReal[static_cast<size_t> (shift)]);
+            if (value > bestValue)
+            {
+                bestValue = value;
+                bestShift = shift;
+            }
+        }
+
+        const auto candidate = fftSize - bestShift;
+        if (correlationAt (processedFrame, energy (processedFrame), candidate) < lockCorrelation)
+            return;
+
+        locked = true;
+        latency = candidate;
+        lostHops = 0;
+        resetAverages();
+    }
+
+    void trackLatency (const float* processedFrame) noexcept
+    {
+        const auto processedEnergy = energy (processedFrame);
+        const auto centre = correlationAt (processedFrame, processedEnergy, latency);
+
+        // A silent reference says nothing about the lag; hold it.
+        if (centre < 0.0f)
+            return;
+
+        if (centre < lostCorrelation)
+        {
+            if (++lostHops >= maxLostHops)
+                locked = false;
+
+            return;
+        }
+
+        lostHops = 0;
+
+        const auto earlier = latency > 0 ? correlationAt (processedFrame, processedEnergy, latency - 1) : -1.0f;
+        const auto later = latency < maxLatencySamples ? correlationAt (processedFrame, processedEnergy, latency + 1) : -1.0f;
+
+        // Step one sample only when the parabola through the three points peaks clearly nearer a neighbour.
+        const auto curvature = earlier - 2.0f * centre + later;
+        auto step = 0;
+
+        if (earlier >= 0.0f && later >= 0.0f && curvature < 0.0f)
+        {
+            const auto offset = 0.5f * (earlier - later) / curvature;
+            step = offset > 0.6f ? 1 : (offset < -0.6f ? -1 : 0);
+        }
+        else if (std::max (earlier, later) > centre)
+        {
+            step = later > earlier ? 1 : -1;
+        }
+
+        // Averages taken at the old lag would read as distortion, so start them again.
+        if (step != 0 && latency + step >= 0 && latency + step <= maxLatencySamples)
+        {
+            latency += step;
+            resetAverages();
+        }
+    }
+
+    void accumulateSpectra (int minBin, Result& result) noexcept
+    {
+        const auto* real = analyzer.getSpectrumReal();
+        const auto* imag = analyzer.getSpectrumImag();
+        const auto alpha = 1.0f / static_cast<float> (std::min (numAveraged + 1, averagingHops));
+        ++numAveraged;
+
+        float coherentPower = 0.0f;
+        float totalPower = 0.0f;
+
+        for (int bin = minBin; bin < halfSize; ++bin)
+        {
+            const auto index = static_cast<size_t> (bin);
+            const auto yRe = real[index * 2], yIm = imag[index * 2];          // lane 0: processed
+            const auto xRe = real[index * 2 + 1], xIm = imag[index * 2 + 1];  // lane 1: aligned reference
+
+            crossReal[index] += alpha * ((xRe * yRe + xIm * yIm) - crossReal[index]);
+            crossImag[index] += alpha * ((xRe * yIm - xIm * yRe) - crossImag[index]);
+            referencePower[index] += alpha * ((xRe * xRe + xIm * xIm) - referencePower[index]);
+            processedPower[index] += alpha * ((yRe * yRe + yIm * yIm) - processedPower[index]);
+
+            const auto gxx = referencePower[index];
+            const auto gyy = processedPower[index];
+            const auto crossSquared = crossReal[index] * crossReal[index] + crossImag[index] * crossImag[index];
+
+            // gamma^2 Gyy = |Gxy|^2 / Gxx, capped at Gyy against rounding.
+            coherentPower += gxx > 0.0f ? std::min (crossSquared / gxx, gyy) : 0.0f;
+            totalPower += gyy;
+        }
+
+        result.valid = numAveraged >= minAveragedHops && lostHops == 0 && coherentPower > 0.0f;
+        if (! result.valid)
+            return;
+
+        result.coherence = std::clamp (coherentPower / totalPower, 0.0f, 1.0f);
+        result.distortionPercent = std::sqrt (std::max (0.0f, totalPower - coherentPower) / coherentPower) * 100.0f;
+    }
+
+    /** In-place forward complex FFT of searchReal/searchImag (historySize points). */
+    void transform() noexcept
+    {
+        for (int i = 0; i < historySize; ++i)
+        {
+            const auto j = bitReversed[static_cast<size_t> (i)];
+            if (j > i)
+            {
+                std::swap (searchReal[static_cast<size_t> (i)], searchReal[static_cast<size_t> (j)]);
+                std::swap (searchImag[static_cast<size_t> (i)], searchImag[static_cast<size_t> (j)]);
+            }
+        }
+
+        for (int span = 1; span < historySize; span *= 2)
+        {
+            const auto twiddleStride = historySize / (2 * span);
+
+            for (int start = 0; start < historySize; start += 2 * span)
+            {
+                for (int k = 0; k < span; ++k)
+                {
+                    const auto c = twiddleCos[static_cast<size_t> (k * twiddleStride)];
+                    const auto s = twiddleSin[static_cast<size_t> (k * twiddleStride)];
+                    const auto a = static_cast<size_t> (start + k);
+                    const auto b = a + static_cast<size_t> (span);
+
+                    const auto tRe = searchReal[b] * c + searchImag[b] * s;
+                    const auto tIm = searchImag[b] * c - searchReal[b] * s;
+                    searchReal[b] = searchReal[a] - tRe;
+                    searchImag[b] = searchImag[a] - tIm;
+                    searchReal[a] += tRe;
+                    searchImag[a] += tIm;
+                }
+            }
+        }
+    }
+
+    BatchedSpectrumAnalyzer<fftOrder, 2, true> analyzer;
+    std::vector<float> history;
+    std::vector<float> searchReal;
+    std::vector<float> searchImag;
+    std::vector<float> aligned;
+    std::vector<float> neighbour;
+    std::vector<float> crossReal;
+    std::vector<float> crossImag;
+    std::vector<float> referencePower;
+    std::vector<float> processedPower;
+    std::vector<int> bitReversed;
+    std::vector<float> twiddleCos;
+    std::vector<float> twiddleSin;
+
+    int writePosition = 0;
+    int numPushed = 0;
+    bool locked = false;
+    int latency = 0;
+    int lostHops = 0;
+    int numAveraged = 0;
+};
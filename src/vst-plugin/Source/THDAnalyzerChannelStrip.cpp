@@ -0,0 +1,1010 @@
+/* ==============================================================================
+   THD Analyzer - Channel Strip mode
+   Per-channel analysis: FIFOs, per-hop FFT jobs, reference (sidechain)
+   comparison, loopback calibration, display smoothing, offline bounce reports
+   and publishing into the process-wide shared slots.
+   Compiled to stubs when THD_WITH_CHANNEL_STRIP is 0.
+   ============================================================================== */
+
+#include "THDAnalyzerPlugin.h"
+
+#if THD_WITH_CHANNEL_STRIP
+
+#include "BatchedSpectrumAnalyzer.h"
+#include "BounceReport.h"
+#include <algorithm>
+
+namespace
+{
+// Per-side layout reports whichever valid side shows more distortion.
+const FFTAnalyzer::AnalysisResult& worseSideAnalysis (const FFTAnalyzer::AnalysisResult& left, const FFTAnalyzer::AnalysisResult& right) noexcept
+{
+    if (left.fundamentalValid != right.fundamentalValid)
+        return left.fundamentalValid ? left : right;
+
+    return right.thdN > left.thdN ? right : left;
+}
+
+// Multiband with Per Side does the same band by band.
+void worseSideBands (MultibandAnalysis::Readings& left, const MultibandAnalysis::Readings& right) noexcept
+{
+    for (size_t band = 0; band < left.size(); ++band)
+    {
+        const auto rightIsWorse = left[band].fundamentalValid != right[band].fundamentalValid
+            ? right[band].fundamentalValid
+            : right[band].thdN > left[band].thdN;
+
+        if (rightIsWorse)
+            left[band] = right[band];
+    }
+}
+}
+
+// Offline-only analysis state: one history ring and large-FFT analyzer per lane.
+// Allocated once when the first offline render is seen and kept afterwards.
+struct THDAnalyzerPlugin::DenseOfflineAnalysis
+{
+    static constexpr int fftSize = 1 << denseFftOrder;
+    static_assert (numAnalysisLanes <= BounceReport::maxLanes, "Bounce report must hold every analysis lane");
+
+    struct Lane
+    {
+        BatchedSpectrumAnalyzer<denseFftOrder, 1> analyzer;
+        std::vector<float> history = std::vector<float> (static_cast<size_t> (fftSize), 0.0f);
+        std::vector<float> orderedSamples = std::vector<float> (static_cast<size_t> (fftSize), 0.0f);
+        FFTAnalyzer::AnalysisResult result;
+    };
+
+    void restart()
+    {
+        for (auto& lane : lanes)
+            std::fill (lane.history.begin(), lane.history.end(), 0.0f);
+
+        writePosition = 0;
+        samplesSinceHop = 0;
+        filled = false;
+        renderedSamples = 0;
+        report.clear();
+    }
+
+    std::array<Lane, numAnalysisLanes> lanes;
+    int writePosition = 0;
+    int samplesSinceHop = 0;
+    bool filled = false;
+    int numActiveLanes = 1;
+    int64_t renderedSamples = 0;
+    BounceReport report;            // appended on the audio thread
+    BounceReport finishedReport;    // swapped in when a render ends, then written on the message thread
+};
+
+void THDAnalyzerPlugin::DenseOfflineAnalysisDeleter::operator() (DenseOfflineAnalysis* analysis) const noexcept
+{
+    delete analysis;
+}
+
+void THDAnalyzerPlugin::processChannelStripBlock (juce::AudioBuffer<float>& buffer)
+{
+    // Main input only; the Reference sidechain follows it in the buffer.
+    const auto totalNumInputChannels = getMainBusNumInputChannels();
+    const auto numSamples = buffer.getNumSamples();
+    ensureScratchBuffers (numSamples);
+
+    float peakLevel = 0.0f;
+
+    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    {
+        const auto* channelData = buffer.getReadPointer (channel);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            monoBufferScratch[static_cast<size_t> (i)] += channelData[i];
+            peakLevel = juce::jmax (peakLevel, std::abs (channelData[i]));
+        }
+    }
+
+    if (totalNumInputChannels > 0)
+    {
+        const auto invChannels = 1.0f / static_cast<float> (totalNumInputChannels);
+        for (auto& sample : monoBufferScratch)
+            sample *= invChannels;
+    }
+
+    pushSamplesToAnalysisFifos (buffer, totalNumInputChannels);
+
+    if (referenceAnalysis != nullptr)
+        pushReferenceSamples (buffer);
+
+    if (bounceReportPending.load (std::memory_order_acquire))
+        handOverBounceReport();
+
+    if (isNonRealtime() && denseOfflineArmed.load (std::memory_order_acquire))
+        runDenseOfflineAnalysis (buffer, totalNumInputChannels);
+
+    analysisSamplesSinceLastRun += numSamples;
+    fastFitSamplesSinceLastRun += numSamples;
+
+    // A calibration capture needs the raw mono-sum spectrum, so it overrides the layout.
+    const auto capturing = calibrationCaptureArmed.load (std::memory_order_acquire);
+    const auto layout = cachedAnalysisLayout.load (std::memory_order_acquire);
+    const auto fastFitLayout = ! capturing && layout == static_cast<int> (AnalysisLayout::fastFit);
+
+    if (fifoFilled && analysisSamplesSinceLastRun >= analysisHopSize)
+    {
+        analysisSamplesSinceLastRun = 0;
+
+        const auto analyzePerSide = ! capturing && totalNumInputChannels > 1 && layout == static_cast<int> (AnalysisLayout::perSide);
+        const auto analyzeReference = ! capturing && referenceAnalysis != nullptr && layout == static_cast<int> (AnalysisLayout::reference);
+
+        scheduledSampleRate = static_cast<float> (getSampleRate());
+        multibandAnalysis.setNumBands (capturing ? 0 : cachedMultibandBands.load (std::memory_order_acquire));
+
+        // Epoch first: the residual loaded after it is at least that new.
+        const auto residualEpoch = calibrationResidualEpoch.load (std::memory_order_acquire);
+        const auto* residual = getCalibrationResidual();
+        for (auto& lane : analysisLanes)
+            lane.analyzer.setResidualPower (residual);
+
+        // No lane holds an older residual now, so profiles retired up to this epoch can go.
+        acknowledgedCalibrationEpoch.store (residualEpoch, std::memory_order_release);
+
+        // The FIFO ends with this block, so the analysed frame is centred half an FFT before its end.
+        const auto frameCentre = blockTimelineSample == noTimelinePosition
+            ? noTimelinePosition
+            : blockTimelineSample + numSamples - FFTAnalyzer::fftSize / 2;
+
+        if (analyzeReference)
+        {
+            orderLaneSamples (monoSumLane);
+            applyBandHop ({}, 0);
+            applyAnalysisHop (analyzeAgainstReference (scheduledSampleRate), frameCentre, analysisHopSize, numSamples);
+        }
+        else if (auto* scheduler = batchedAnalysisScheduler.load (std::memory_order_acquire); scheduler != nullptr && ! analyzePerSide && ! capturing && ! fastFitLayout)
+        {
+            orderLaneSamples (monoSumLane);
+            batchedHopTimelineSample = frameCentre;
+            scheduler->submit (*this, analysisLanes[monoSumLane].orderedSamples.data(), scheduledSampleRate);
+        }
+        else
+        {
+            firstScheduledLane = analyzePerSide ? monoSumLane + 1 : monoSumLane;
+            analysisJobExecutor.load (std::memory_order_acquire)->run (analyzePerSide ? 2 : 1, &THDAnalyzerPlugin::runAnalysisLaneJob, this);
+
+            if (capturing)
+                addCalibrationHop (analysisLanes[monoSumLane].result);
+
+            // The LTAS takes the mono sum, or with Per Side the mean power of both sides.
+            if (analyzePerSide)
+            {
+                LongTermSpectrum::Bands left, right;
+                longTermSpectrum.reduceBands (analysisLanes[1].analyzer.getPowerSpectrum(), 1, left);
+                longTermSpectrum.reduceBands (analysisLanes[2].analyzer.getPowerSpectrum(), 1, right);
+
+                for (size_t band = 0; band < left.size(); ++band)
+                    left[band] = 0.5f * (left[band] + right[band]);
+
+                longTermSpectrum.addBandPower (left);
+            }
+            else
+            {
+                longTermSpectrum.addPowerSpectrum (analysisLanes[monoSumLane].analyzer.getPowerSpectrum());
+            }
+
+            MultibandAnalysis::Readings bandReadings;
+            if (analyzePerSide)
+            {
+                MultibandAnalysis::Readings rightReadings;
+                multibandAnalysis.analyze (analysisLanes[1].analyzer.getPowerSpectrum(), 1, bandReadings);
+                multibandAnalysis.analyze (analysisLanes[2].analyzer.getPowerSpectrum(), 1, rightReadings);
+                worseSideBands (bandReadings, rightReadings);
+            }
+            else
+            {
+                multibandAnalysis.analyze (analysisLanes[monoSumLane].analyzer.getPowerSpectrum(), 1, bandReadings);
+            }
+
+            applyBandHop (bandReadings, multibandAnalysis.getNumBands());
+
+            // Fast Fit publishes its own readings; this hop only guides it, unless the fit cannot lock.
+            if (! (fastFitLayout && fastFitLocked.load (std::memory_order_relaxed)))
+                applyAnalysisHop (analyzePerSide ? worseSideAnalysis (analysisLanes[1].result, analysisLanes[2].result)
+                                                 : analysisLanes[monoSumLane].result,
+                                  frameCentre, analysisHopSize, numSamples);
+        }
+    }
+
+    // Outside Fast Fit the count restarts, so it cannot overflow and a switch back starts fresh.
+    if (! fastFitLayout)
+    {
+        fastFitLocked.store (false, std::memory_order_relaxed);
+        fastFitSamplesSinceLastRun = 0;
+    }
+    else if (fifoFilled && fastFitSamplesSinceLastRun >= fastFitHopSize)
+        runFastFitHops (numSamples);
+
+    ltasSamplesSincePublish += numSamples;
+    if (ltasSamplesSincePublish >= ltasPublishIntervalSamples)
+    {
+        ltasSamplesSincePublish = 0;
+        longTermSpectrum.getLevelsDb (publishedLtasDb);
+        publishedLtasHops = longTermSpectrum.getNumHops();
+        sharedStateChanged = true;
+    }
+
+    publishSharedChannelData (realtimeAnalysisCache, peakLevel);
+}
+
+void THDAnalyzerPlugin::resetChannelStripState()
+{
+    for (auto& lane : analysisLanes)
+    {
+        lane.fifo.fill (0.0f);
+        lane.orderedSamples.fill (0.0f);
+        lane.result = FFTAnalyzer::AnalysisResult {};
+    }
+
+    monoBufferScratch.clear();
+    hopWaveform = ChannelWaveform {};
+
+    {
+        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+        realtimeAnalysisCache = FFTAnalyzer::AnalysisResult {};
+        smoothedAnalysisCache = FFTAnalyzer::AnalysisResult {};
+    }
+
+    if (referenceAnalysis != nullptr)
+        referenceAnalysis->reset();
+
+    referenceLatencySamples.store (-1, std::memory_order_relaxed);
+    referenceCoherence.store (0.0f, std::memory_order_relaxed);
+
+    fifoWritePosition = 0;
+    fifoFilled = false;
+    lastHopTimelineSample = noTimelinePosition;
+    analysisSamplesSinceLastRun = 0;
+    fastFitSamplesSinceLastRun = 0;
+    fastFitLocked.store (false, std::memory_order_relaxed);
+    samplesSinceLastSnapshotPush = 0;
+
+    longTermSpectrum.reset();
+    publishedLtasDb = ChannelData::makeSilentLtas();
+    publishedLtasHops = 0;
+    ltasSamplesSincePublish = 0;
+
+    smoothedBandReadings = {};
+    smoothedNumBands = 0;
+    sharedStateChanged = true;
+}
+
+void THDAnalyzerPlugin::ensureScratchBuffers (int numSamples)
+{
+    if (numSamples <= 0)
+    {
+        monoBufferScratch.clear();
+        return;
+    }
+
+    if (monoBufferScratch.size() != static_cast<size_t> (numSamples))
+        monoBufferScratch.assign (static_cast<size_t> (numSamples), 0.0f);
+    else
+        std::fill (monoBufferScratch.begin(), monoBufferScratch.end(), 0.0f);
+}
+
+void THDAnalyzerPlugin::pushSamplesToAnalysisFifos (const juce::AudioBuffer<float>& buffer, int numInputChannels)
+{
+    if (monoBufferScratch.empty())
+        return;
+
+    // Every lane is fed every block so switching layouts never waits for a refill.
+    const std::array<const float*, numAnalysisLanes> laneSources {
+        monoBufferScratch.data(),
+        numInputChannels > 0 ? buffer.getReadPointer (0) : monoBufferScratch.data(),
+        numInputChannels > 1 ? buffer.getReadPointer (1) : (numInputChannels > 0 ? buffer.getReadPointer (0) : monoBufferScratch.data())
+    };
+
+    size_t srcOffset = 0;
+    size_t samplesRemaining = monoBufferScratch.size();
+
+    while (samplesRemaining > 0)
+    {
+        const auto writePos = static_cast<size_t> (fifoWritePosition);
+        const auto contiguousSpace = static_cast<size_t> (FFTAnalyzer::fftSize) - writePos;
+        const auto chunkSize = std::min (samplesRemaining, contiguousSpace);
+
+        for (size_t lane = 0; lane < analysisLanes.size(); ++lane)
+            std::copy_n (laneSources[lane] + srcOffset,
+                         chunkSize,
+                         analysisLanes[lane].fifo.begin() + static_cast<int> (writePos));
+
+        srcOffset += chunkSize;
+        samplesRemaining -= chunkSize;
+        fifoWritePosition = static_cast<int> ((writePos + chunkSize) % static_cast<size_t> (FFTAnalyzer::fftSize));
+
+        if (fifoWritePosition == 0)
+            fifoFilled = true;
+    }
+}
+
+void THDAnalyzerPlugin::pushReferenceSamples (juce::AudioBuffer<float>& buffer)
+{
+    const auto referenceBuffer = getBusBuffer (buffer, true, referenceBusIndex);
+    const auto numChannels = referenceBuffer.getNumChannels();
+    const auto numSamples = referenceBuffer.getNumSamples();
+
+    // Mono-sum in small chunks so the audio thread needs no scratch allocation.
+    std::array<float, 256> chunk {};
+
+    for (int offset = 0; offset < numSamples; offset += static_cast<int> (chunk.size()))
+    {
+        const auto chunkSize = juce::jmin (static_cast<int> (chunk.size()), numSamples - offset);
+        std::fill_n (chunk.begin(), chunkSize, 0.0f);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            juce::FloatVectorOperations::add (chunk.data(), referenceBuffer.getReadPointer (channel, offset), chunkSize);
+
+        if (numChannels > 1)
+            juce::FloatVectorOperations::multiply (chunk.data(), 1.0f / static_cast<float> (numChannels), chunkSize);
+
+        referenceAnalysis->pushReference (chunk.data(), chunkSize);
+    }
+}
+
+FFTAnalyzer::AnalysisResult THDAnalyzerPlugin::analyzeAgainstReference (float sampleRate)
+{
+    ReferenceAnalysis<FFTAnalyzer::fftOrder>::Result reference;
+    referenceAnalysis->analyze (analysisLanes[monoSumLane].orderedSamples.data(), sampleRate, reference);
+
+    referenceLatencySamples.store (reference.locked ? reference.latencySamples : -1, std::memory_order_relaxed);
+    referenceCoherence.store (reference.coherence, std::memory_order_relaxed);
+
+    // Coherence cannot tell harmonics from noise, so THD and THD+N both carry the
+    // non-coherent distortion; level, f0 and the harmonic bars stay the input's own.
+    auto analysis = reference.processed;
+    analysis.thd = reference.distortionPercent;
+    analysis.thdN = reference.distortionPercent;
+    analysis.analysisConfidence = reference.coherence;
+    analysis.fundamentalValid = reference.valid;
+    analysisLanes[monoSumLane].result = analysis;
+    return analysis;
+}
+
+THDAnalyzerPlugin::ReferenceStatus THDAnalyzerPlugin::getReferenceStatus() const noexcept
+{
+    ReferenceStatus status;
+    const auto latency = referenceLatencySamples.load (std::memory_order_relaxed);
+    status.connected = referenceConnected.load (std::memory_order_acquire);
+    status.locked = status.connected && latency >= 0;
+    status.latencySamples = juce::jmax (0, latency);
+    status.coherence = referenceCoherence.load (std::memory_order_relaxed);
+    return status;
+}
+
+juce::File THDAnalyzerPlugin::getCalibrationProfileFile (double sampleRate)
+{
+    const auto key = CalibrationProfile::makeKey (sampleRate, FFTAnalyzer::fftSize);
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+        .getChildFile ("THD Analyzer")
+        .getChildFile ("Calibration")
+        .getChildFile (CalibrationProfile::fileNameFor (key));
+}
+
+void THDAnalyzerPlugin::loadCalibrationProfile (double sampleRate)
+{
+    const auto key = CalibrationProfile::makeKey (sampleRate, FFTAnalyzer::fftSize);
+    publishCalibrationProfile (sampleRate > 0.0
+        ? CalibrationProfile::acquire (getCalibrationProfileFile (sampleRate).getFullPathName().toStdString(), key)
+        : nullptr);
+
+    // Called from prepareToPlay, so the audio thread holds no residual at all.
+    retiredCalibrationProfiles.clear();
+}
+
+void THDAnalyzerPlugin::publishCalibrationProfile (std::shared_ptr<const CalibrationProfile::Profile> profile)
+{
+    auto previous = std::move (calibrationProfile);
+    calibrationProfile = std::move (profile);
+    calibrationResidual.store (calibrationProfile != nullptr ? calibrationProfile->getResidualPower() : nullptr,
+                               std::memory_order_release);
+
+    // The previous profile may be in use until a hop acknowledges this epoch.
+    const auto epoch = calibrationResidualEpoch.fetch_add (1, std::memory_order_acq_rel) + 1;
+    if (previous != nullptr)
+        retiredCalibrationProfiles.push_back ({ std::move (previous), epoch });
+
+    const auto acknowledged = acknowledgedCalibrationEpoch.load (std::memory_order_acquire);
+    retiredCalibrationProfiles.erase (std::remove_if (retiredCalibrationProfiles.begin(), retiredCalibrationProfiles.end(),
+                                                      [acknowledged] (const RetiredCalibrationProfile& retired)
+                                                      {
+                                                          return retired.retiredAtEpoch <= acknowledged;
+                                                      }),
+                                      retiredCalibrationProfiles.end());
+}
+
+bool THDAnalyzerPlugin::startCalibrationCapture (double seconds)
+{
+    const auto sampleRate = getSampleRate();
+    if (sampleRate <= 0.0 || getPluginMode() != PluginMode::ChannelStrip
+        || calibrationCaptureArmed.load (std::memory_order_acquire) || calibrationCapturePending.load (std::memory_order_acquire))
+        return false;
+
+    if (calibrationCapture == nullptr)
+        calibrationCapture = std::make_unique<CalibrationProfile::Capture>();
+
+    const auto numHops = juce::roundToInt (seconds * sampleRate / static_cast<double> (analysisHopSize));
+    calibrationCapture->begin (CalibrationProfile::makeKey (sampleRate, FFTAnalyzer::fftSize), numHops);
+    calibrationCaptureProgress.store (0.0f, std::memory_order_relaxed);
+    calibrationCaptureArmed.store (true, std::memory_order_release);
+    return true;
+}
+
+void THDAnalyzerPlugin::addCalibrationHop (const FFTAnalyzer::AnalysisResult& analysis)
+{
+    auto& capture = *calibrationCapture;
+    capture.add (analysisLanes[monoSumLane].analyzer.getPowerSpectrum(), analysis);
+    calibrationCaptureProgress.store (capture.getProgress(), std::memory_order_relaxed);
+
+    if (! capture.isComplete())
+        return;
+
+    // Pending before disarming, so a new capture cannot start until this one is written.
+    calibrationCapturePending.store (true, std::memory_order_release);
+    calibrationCaptureArmed.store (false, std::memory_order_release);
+    triggerAsyncUpdate();
+}
+
+void THDAnalyzerPlugin::writeCalibrationProfile()
+{
+    const auto& key = calibrationCapture->getKey();
+    const auto file = getCalibrationProfileFile (static_cast<double> (key.sampleRate));
+    file.getParentDirectory().createDirectory();
+
+    std::string error;
+    if (calibrationCapture->write (file.getFullPathName().toStdString(), &error))
+    {
+        publishCalibrationProfile (CalibrationProfile::reload (file.getFullPathName().toStdString(), key));
+    }
+    else
+    {
+        DBG ("Calibration profile not written: " << error);
+    }
+
+    calibrationCapturePending.store (false, std::memory_order_release);
+}
+
+THDAnalyzerPlugin::CalibrationStatus THDAnalyzerPlugin::getCalibrationStatus() const noexcept
+{
+    CalibrationStatus status;
+    status.profileLoaded = calibrationResidual.load (std::memory_order_acquire) != nullptr;
+    status.capturing = calibrationCaptureArmed.load (std::memory_order_acquire) || calibrationCapturePending.load (std::memory_order_acquire);
+    status.captureProgress = status.capturing ? calibrationCaptureProgress.load (std::memory_order_relaxed) : 0.0f;
+    return status;
+}
+
+const float* THDAnalyzerPlugin::getCalibrationResidual() const noexcept
+{
+    if (calibrationCaptureArmed.load (std::memory_order_acquire)
+        || (residualCorrectionParamValue != nullptr && residualCorrectionParamValue->load() < 0.5f))
+        return nullptr;
+
+    return calibrationResidual.load (std::memory_order_acquire);
+}
+
+void THDAnalyzerPlugin::orderLaneSamples (int laneIndex) noexcept
+{
+    auto& lane = analysisLanes[static_cast<size_t> (laneIndex)];
+
+    for (int i = 0; i < FFTAnalyzer::fftSize; ++i)
+    {
+        const int index = (fifoWritePosition + i) % FFTAnalyzer::fftSize;
+        lane.orderedSamples[static_cast<size_t> (i)] = lane.fifo[static_cast<size_t> (index)];
+    }
+}
+
+void THDAnalyzerPlugin::runAnalysisLaneJob (void* context, int jobIndex) noexcept
+{
+    auto& processor = *static_cast<THDAnalyzerPlugin*> (context);
+    const auto laneIndex = processor.firstScheduledLane + jobIndex;
+    auto& lane = processor.analysisLanes[static_cast<size_t> (laneIndex)];
+
+    processor.orderLaneSamples (laneIndex);
+    lane.result = lane.analyzer.analyze (lane.orderedSamples.data(), FFTAnalyzer::fftSize, processor.scheduledSampleRate);
+}
+
+void THDAnalyzerPlugin::setBatchedAnalysisScheduler (BatchedAnalysisScheduler* scheduler) noexcept
+{
+    batchedAnalysisScheduler.store (scheduler, std::memory_order_release);
+}
+
+void THDAnalyzerPlugin::completeBatchedAnalysis (const FFTAnalyzer::AnalysisResult& analysis,
+                                                  const float* powerSpectrum, int powerStride)
+{
+    MultibandAnalysis::Readings bandReadings;
+    if (powerSpectrum != nullptr)
+    {
+        longTermSpectrum.addPowerSpectrum (powerSpectrum, powerStride);
+        multibandAnalysis.analyze (powerSpectrum, static_cast<size_t> (powerStride), bandReadings);
+    }
+
+    applyBandHop (bandReadings, powerSpectrum != nullptr ? multibandAnalysis.getNumBands() : 0);
+
+    analysisLanes[monoSumLane].result = analysis;
+    applyAnalysisHop (analysis, batchedHopTimelineSample);
+}
+
+void THDAnalyzerPlugin::runFastFitHops (int numSamples)
+{
+    // Every fastFitHopSize boundary inside this block gets its own fit, on the frame ending there.
+    const auto samplesBeforeBlock = fastFitSamplesSinceLastRun - numSamples;
+    auto boundary = juce::jmax (0, fastFitHopSize - samplesBeforeBlock);
+    auto lastBoundary = boundary;
+
+    for (; boundary <= numSamples; boundary += fastFitHopSize)
+    {
+        runFastFitHop (boundary, numSamples);
+        lastBoundary = boundary;
+    }
+
+    fastFitSamplesSinceLastRun = numSamples - lastBoundary;
+}
+
+void THDAnalyzerPlugin::runFastFitHop (int blockOffset, int numSamples)
+{
+    // The latest FFT hop supplies the fundamental the fit starts from.
+    const auto& guide = analysisLanes[monoSumLane].result;
+    if (! guide.fundamentalValid)
+    {
+        fastFitLocked.store (false, std::memory_order_relaxed);
+        return;
+    }
+
+    // The FIFO already holds the whole block; a frame ending before its oldest sample is skipped.
+    const auto samplesAfterFrame = numSamples - blockOffset;
+    if (samplesAfterFrame + fastFitFrameSize > FFTAnalyzer::fftSize)
+        return;
+
+    // Copy straight from the FIFO; orderedSamples may still be out with a scheduler.
+    const auto& fifo = analysisLanes[monoSumLane].fifo;
+    for (int i = 0; i < fastFitFrameSize; ++i)
+    {
+        const int index = (fifoWritePosition + FFTAnalyzer::fftSize - samplesAfterFrame - fastFitFrameSize + i) % FFTAnalyzer::fftSize;
+        fastFitFrame[static_cast<size_t> (i)] = fifo[static_cast<size_t> (index)];
+    }
+
+    FFTAnalyzer::AnalysisResult analysis;
+    const auto locked = harmonicFit.analyze (fastFitFrame.data(), fastFitFrameSize, static_cast<float> (getSampleRate()),
+                                             guide.fundamentalFrequency, analysis);
+    fastFitLocked.store (locked, std::memory_order_relaxed);
+
+    if (! locked)
+        return;
+
+    const auto frameCentre = blockTimelineSample == noTimelinePosition
+        ? noTimelinePosition
+        : blockTimelineSample + blockOffset - fastFitFrameSize / 2;
+
+    applyAnalysisHop (analysis, frameCentre, fastFitHopSize, blockOffset);
+}
+
+bool THDAnalyzerPlugin::isFastFitLocked() const noexcept
+{
+    return fastFitLocked.load (std::memory_order_relaxed);
+}
+
+void THDAnalyzerPlugin::applyBandHop (const MultibandAnalysis::Readings& readings, int numBands) noexcept
+{
+    // Same display rule as the full-band reading: hold THD while a band has no valid fundamental.
+    if (numBands != smoothedNumBands)
+    {
+        smoothedBandReadings = readings;
+        smoothedNumBands = numBands;
+    }
+    else
+    {
+        const auto alpha = analysisSmoothingCoeff;
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            const auto& reading = readings[static_cast<size_t> (band)];
+            auto& smoothed = smoothedBandReadings[static_cast<size_t> (band)];
+
+            if (reading.fundamentalValid && smoothed.fundamentalValid)
+            {
+                smoothed.thd += alpha * (reading.thd - smoothed.thd);
+                smoothed.thdN += alpha * (reading.thdN - smoothed.thdN);
+            }
+            else if (reading.fundamentalValid)
+            {
+                smoothed.thd = reading.thd;
+                smoothed.thdN = reading.thdN;
+            }
+
+            smoothed.level += alpha * (reading.level - smoothed.level);
+            smoothed.fundamentalFrequency = reading.fundamentalFrequency;
+            smoothed.fundamentalValid = reading.fundamentalValid;
+        }
+    }
+
+    sharedStateChanged = true;
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    lastBandReadings = smoothedBandReadings;
+    lastNumBands = smoothedNumBands;
+}
+
+void THDAnalyzerPlugin::applyAnalysisHop (const FFTAnalyzer::AnalysisResult& analysis, int64_t frameCentreTimelineSample,
+                                          int hopSamples, int blockOffset)
+{
+    lastHopTimelineSample = frameCentreTimelineSample;
+
+    // The hop history keeps raw per-hop values; smoothing below is for display only.
+    if (const auto channelId = getChannelId(); juce::isPositiveAndBelow (channelId, maxDynamicChannels))
+    {
+        SharedHopRecord hop;
+        hop.timelineSample = frameCentreTimelineSample;
+        hop.thd = analysis.thd;
+        hop.thdN = analysis.thdN;
+        hop.level = analysis.level;
+        hop.fundamentalValid = analysis.fundamentalValid;
+        pushSharedHop (channelId, hop);
+    }
+
+    // Keep internal analysis continuous, but freeze THD/THD+N when fundamental confidence is too low.
+    auto displayAnalysis = realtimeAnalysisCache;
+    if (analysis.fundamentalValid)
+        displayAnalysis = analysis;
+
+    displayAnalysis.level = analysis.level;
+    displayAnalysis.fundamentalFrequency = analysis.fundamentalFrequency;
+    displayAnalysis.noiseFloor = analysis.noiseFloor;
+    displayAnalysis.analysisConfidence = analysis.analysisConfidence;
+    displayAnalysis.fundamentalValid = analysis.fundamentalValid;
+
+    if (! smoothedAnalysisCache.fundamentalValid)
+    {
+        smoothedAnalysisCache = displayAnalysis;
+    }
+    else
+    {
+        const auto alpha = analysisSmoothingCoeff;
+        smoothedAnalysisCache.thd += alpha * (displayAnalysis.thd - smoothedAnalysisCache.thd);
+        smoothedAnalysisCache.thdN += alpha * (displayAnalysis.thdN - smoothedAnalysisCache.thdN);
+        smoothedAnalysisCache.level += alpha * (displayAnalysis.level - smoothedAnalysisCache.level);
+        smoothedAnalysisCache.noiseFloor += alpha * (displayAnalysis.noiseFloor - smoothedAnalysisCache.noiseFloor);
+        smoothedAnalysisCache.analysisConfidence += alpha * (displayAnalysis.analysisConfidence - smoothedAnalysisCache.analysisConfidence);
+        smoothedAnalysisCache.fundamentalFrequency += alpha * (displayAnalysis.fundamentalFrequency - smoothedAnalysisCache.fundamentalFrequency);
+        for (size_t i = 0; i < smoothedAnalysisCache.harmonics.size(); ++i)
+            smoothedAnalysisCache.harmonics[i] += alpha * (displayAnalysis.harmonics[i] - smoothedAnalysisCache.harmonics[i]);
+
+        smoothedAnalysisCache.fundamentalValid = displayAnalysis.fundamentalValid;
+    }
+
+    realtimeAnalysisCache = smoothedAnalysisCache;
+    captureWaveform (analysis);
+    sharedStateChanged = true;
+    samplesSinceLastSnapshotPush += hopSamples;
+
+    // Rate-limit audio->GUI snapshots to keep meter updates legible and reduce visual jitter.
+    if (samplesSinceLastSnapshotPush >= snapshotIntervalSamples)
+    {
+        pushAnalysisSnapshotForEditor (smoothedAnalysisCache);
+        samplesSinceLastSnapshotPush = 0;
+    }
+
+    {
+        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+        lastAnalysis = smoothedAnalysisCache;
+    }
+
+    // The hop's frame ended blockOffset samples into this block, so its ramp starts there.
+    setMeasurementCvTargets (smoothedAnalysisCache.thd, smoothedAnalysisCache.thdN, smoothedAnalysisCache.level, hopSamples, blockOffset);
+}
+
+void THDAnalyzerPlugin::publishSharedChannelData (const FFTAnalyzer::AnalysisResult& analysis, float peakLevel)
+{
+    const auto channelId = getChannelId();
+    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels))
+        return;
+
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+    const auto groupIndex = cachedChannelGroup.load (std::memory_order_acquire);
+
+    // The full state carries the waveform, LTAS and bands, so it is only rewritten when a hop
+    // or LTAS refresh produced new data. Other blocks refresh just the peak meter and stamp.
+    if (! sharedStateChanged && channelId == publishedSharedChannelId && groupIndex == publishedSharedGroup)
+    {
+        writeSharedChannelMeter (channelId, peakLevel, nowMs);
+        return;
+    }
+
+    SharedChannelState shared;
+    shared.thd = analysis.thd;
+    shared.thdN = analysis.thdN;
+    shared.level = analysis.level;
+    shared.peakLevel = peakLevel;
+    for (size_t i = 0; i < shared.harmonics.size(); ++i)
+        shared.harmonics[i] = i < analysis.harmonics.size() ? analysis.harmonics[i] : 0.0f;
+
+    shared.lastPublishMs = nowMs;
+    shared.publisherInstanceId = instanceId;
+    shared.groupIndex = groupIndex;
+    shared.timelineSample = lastHopTimelineSample;
+    shared.waveform = hopWaveform;
+    shared.ltasDb = publishedLtasDb;
+    shared.ltasHops = publishedLtasHops;
+    shared.numBands = smoothedNumBands;
+    shared.bands = smoothedBandReadings;
+    shared.active = true;
+
+    // A strip colliding on this channel ID loses the write; keep trying on later blocks.
+    if (! writeSharedChannelSlot (channelId, shared))
+        return;
+
+    sharedStateChanged = false;
+    publishedSharedChannelId = channelId;
+    publishedSharedGroup = groupIndex;
+}
+
+void THDAnalyzerPlugin::captureWaveform (const FFTAnalyzer::AnalysisResult& analysis) noexcept
+{
+    constexpr int fifoSize = FFTAnalyzer::fftSize;
+    constexpr int numPoints = ChannelWaveform::numPoints;
+    const auto& fifo = analysisLanes[monoSumLane].fifo;
+
+    // Positions count from the oldest sample in the mono-sum FIFO.
+    const auto physical = [this] (int position) { return (fifoWritePosition + position) % fifoSize; };
+    const auto sampleAt = [&] (int position) { return fifo[static_cast<size_t> (physical (position))]; };
+
+    // Two periods of the fundamental when there is one, otherwise a free-running quarter FIFO.
+    const auto period = analysis.fundamentalValid && analysis.fundamentalFrequency > 0.0f
+        ? static_cast<int> (getSampleRate() / static_cast<double> (analysis.fundamentalFrequency))
+        : 0;
+    const auto span = period > 0 ? juce::jlimit (numPoints, fifoSize / 2, 2 * period) : fifoSize / 4;
+    auto start = fifoSize - span;
+    auto triggered = false;
+
+    // The steepest rising zero crossing in the period before the newest possible start is the
+    // fundamental's own, not one added by harmonics or noise, so the trace holds still hop to hop.
+    if (period > 0)
+    {
+        auto steepest = 0.0f;
+        for (int position = fifoSize - span; position > juce::jmax (0, fifoSize - span - period); --position)
+        {
+            const auto before = sampleAt (position - 1);
+            const auto after = sampleAt (position);
+
+            if (before < 0.0f && after >= 0.0f && after - before > steepest)
+            {
+                steepest = after - before;
+                start = position;
+                triggered = true;
+            }
+        }
+    }
+
+    // One SIMD min/max pass per point; a point whose samples wrap the FIFO takes two.
+    std::array<juce::Range<float>, numPoints> ranges;
+    auto peak = 0.0f;
+
+    for (int point = 0; point < numPoints; ++point)
+    {
+        const auto first = start + (point * span) / numPoints;
+        const auto count = start + ((point + 1) * span) / numPoints - first;
+        const auto physicalFirst = physical (first);
+        const auto firstRun = juce::jmin (count, fifoSize - physicalFirst);
+
+        auto range = juce::FloatVectorOperations::findMinAndMax (fifo.data() + physicalFirst, firstRun);
+        if (count > firstRun)
+            range = range.getUnionWith (juce::FloatVectorOperations::findMinAndMax (fifo.data(), count - firstRun));
+
+        ranges[static_cast<size_t> (point)] = range;
+        peak = juce::jmax (peak, std::abs (range.getStart()), std::abs (range.getEnd()));
+    }
+
+    hopWaveform.scale = peak;
+    hopWaveform.triggered = triggered;
+
+    const auto toSteps = peak > 0.0f ? 127.0f / peak : 0.0f;
+    for (size_t point = 0; point < ranges.size(); ++point)
+    {
+        hopWaveform.minimum[point] = static_cast<int8_t> (juce::roundToInt (ranges[point].getStart() * toSteps));
+        hopWaveform.maximum[point] = static_cast<int8_t> (juce::roundToInt (ranges[point].getEnd() * toSteps));
+    }
+}
+
+void THDAnalyzerPlugin::setNonRealtime (bool shouldBeNonRealtime) noexcept
+{
+    const auto wasNonRealtime = isNonRealtime();
+    AudioProcessor::setNonRealtime (shouldBeNonRealtime);
+
+    // This can arrive on any thread, so allocation and file output are deferred.
+    if (shouldBeNonRealtime && ! wasNonRealtime)
+        triggerAsyncUpdate();
+    else if (wasNonRealtime && ! shouldBeNonRealtime)
+        requestBounceReport();
+}
+
+void THDAnalyzerPlugin::armDenseOfflineAnalysis()
+{
+    if (denseOfflineArmed.load (std::memory_order_acquire))
+        return;
+
+    denseOfflineAnalysis.reset (new DenseOfflineAnalysis());
+    denseOfflineArmed.store (true, std::memory_order_release);
+}
+
+void THDAnalyzerPlugin::requestBounceReport() noexcept
+{
+    // The audio thread may still be appending, so it hands the report over on its next block.
+    bounceReportPending.store (true, std::memory_order_release);
+}
+
+void THDAnalyzerPlugin::handOverBounceReport() noexcept
+{
+    // The previous report is still being written; keep the request pending until it is.
+    if (! denseOfflineArmed.load (std::memory_order_acquire) || bounceReportReady.load (std::memory_order_acquire))
+        return;
+
+    if (! bounceReportPending.exchange (false, std::memory_order_acq_rel))
+        return;
+
+    // The finished report was cleared after its last write, so the next render starts a fresh one.
+    auto& dense = *denseOfflineAnalysis;
+    std::swap (dense.report, dense.finishedReport);
+
+    bounceReportReady.store (true, std::memory_order_release);
+    triggerAsyncUpdate();
+}
+
+void THDAnalyzerPlugin::writeBounceReport()
+{
+    if (! bounceReportReady.load (std::memory_order_acquire))
+        return;
+
+    auto& report = denseOfflineAnalysis->finishedReport;
+    const auto wantsReport = bounceReportParamValue == nullptr || bounceReportParamValue->load() >= 0.5f;
+
+    if (wantsReport && report.getNumHops() > 0)
+    {
+        const auto directory = juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                                   .getChildFile ("THD Analyzer")
+                                   .getChildFile ("Bounce Reports");
+        directory.createDirectory();
+
+        const auto file = directory.getNonexistentChildFile ("bounce-ch" + juce::String (getChannelId()) + "-"
+                                                                 + juce::Time::getCurrentTime().formatted ("%Y%m%d-%H%M%S"),
+                                                             ".csv",
+                                                             false);
+
+        std::string error;
+        if (! report.write (file.getFullPathName().toStdString(), &error))
+            DBG ("Bounce report not written: " << error);
+    }
+
+    report.clear();
+    bounceReportReady.store (false, std::memory_order_release);
+}
+
+void THDAnalyzerPlugin::runDenseOfflineAnalysis (const juce::AudioBuffer<float>& buffer, int numInputChannels)
+{
+    auto& dense = *denseOfflineAnalysis;
+    const auto sampleRate = getSampleRate();
+    if (sampleRate <= 0.0 || monoBufferScratch.empty())
+        return;
+
+    if (! dense.report.isStarted())
+    {
+        dense.restart();
+        dense.numActiveLanes = numInputChannels > 1 ? numAnalysisLanes : 1;
+        dense.report.begin (getChannelId(), sampleRate, DenseOfflineAnalysis::fftSize, denseHopSize, dense.numActiveLanes);
+    }
+
+    // Key hops to the host timeline when it reports one, else to samples rendered so far.
+    const auto blockStartSeconds = static_cast<double> (blockTimelineSample != noTimelinePosition ? blockTimelineSample
+                                                                                                  : dense.renderedSamples)
+                                 / sampleRate;
+
+    const std::array<const float*, numAnalysisLanes> laneSources {
+        monoBufferScratch.data(),
+        numInputChannels > 0 ? buffer.getReadPointer (0) : monoBufferScratch.data(),
+        numInputChannels > 1 ? buffer.getReadPointer (1) : monoBufferScratch.data()
+    };
+
+    const auto numSamples = static_cast<int> (monoBufferScratch.size());
+    int offset = 0;
+
+    while (offset < numSamples)
+    {
+        const auto chunkSize = std::min ({ numSamples - offset,
+                                           DenseOfflineAnalysis::fftSize - dense.writePosition,
+                                           denseHopSize - dense.samplesSinceHop });
+
+        for (int lane = 0; lane < dense.numActiveLanes; ++lane)
+            std::copy_n (laneSources[static_cast<size_t> (lane)] + offset,
+                         chunkSize,
+                         dense.lanes[static_cast<size_t> (lane)].history.begin() + dense.writePosition);
+
+        offset += chunkSize;
+        dense.samplesSinceHop += chunkSize;
+        dense.writePosition = (dense.writePosition + chunkSize) % DenseOfflineAnalysis::fftSize;
+
+        if (dense.writePosition == 0)
+            dense.filled = true;
+
+        if (dense.samplesSinceHop < denseHopSize)
+            continue;
+
+        dense.samplesSinceHop = 0;
+        if (! dense.filled)
+            continue;
+
+        // Every hop, not just the one at the end of the block, so long blocks lose nothing.
+        scheduledSampleRate = static_cast<float> (sampleRate);
+        analysisJobExecutor.load (std::memory_order_acquire)->run (dense.numActiveLanes, &THDAnalyzerPlugin::runDenseLaneJob, this);
+
+        BounceReport::Hop hop;
+        hop.timelineSeconds = blockStartSeconds + static_cast<double> (offset - DenseOfflineAnalysis::fftSize / 2) / sampleRate;
+        for (int lane = 0; lane < dense.numActiveLanes; ++lane)
+            hop.lanes[static_cast<size_t> (lane)] = dense.lanes[static_cast<size_t> (lane)].result;
+
+        dense.report.add (hop);
+    }
+
+    dense.renderedSamples += numSamples;
+}
+
+void THDAnalyzerPlugin::runDenseLaneJob (void* context, int jobIndex) noexcept
+{
+    auto& processor = *static_cast<THDAnalyzerPlugin*> (context);
+    auto& dense = *processor.denseOfflineAnalysis;
+    auto& lane = dense.lanes[static_cast<size_t> (jobIndex)];
+
+    const auto split = static_cast<size_t> (dense.writePosition);
+    std::copy (lane.history.begin() + static_cast<std::ptrdiff_t> (split), lane.history.end(), lane.orderedSamples.begin());
+    std::copy (lane.history.begin(), lane.history.begin() + static_cast<std::ptrdiff_t> (split),
+               lane.orderedSamples.begin() + static_cast<std::ptrdiff_t> (lane.history.size() - split));
+
+    const float* frame = lane.orderedSamples.data();
+    lane.analyzer.analyze (&frame, 1, processor.scheduledSampleRate, &lane.result);
+}
+
+#else
+
+// Master Brain-only build: the batching, reference and calibration hooks exist for API compatibility but never see a hop.
+void THDAnalyzerPlugin::setBatchedAnalysisScheduler (BatchedAnalysisScheduler*) noexcept
+{
+}
+
+void THDAnalyzerPlugin::completeBatchedAnalysis (const FFTAnalyzer::AnalysisResult&, const float*, int)
+{
+}
+
+THDAnalyzerPlugin::ReferenceStatus THDAnalyzerPlugin::getReferenceStatus() const noexcept
+{
+    return {};
+}
+
+bool THDAnalyzerPlugin::isFastFitLocked() const noexcept
+{
+    return false;
+}
+
+bool THDAnalyzerPlugin::startCalibrationCapture (double)
+{
+    return false;
+}
+
+THDAnalyzerPlugin::CalibrationStatus THDAnalyzerPlugin::getCalibrationStatus() const noexcept
+{
+    return {};
+}
+
+const float* THDAnalyzerPlugin::getCalibrationResidual() const noexcept
+{
+    return nullptr;
+}
+
+juce::File THDAnalyzerPlugin::getCalibrationProfileFile (double)
+{
+    return {};
+}
+
+#endif
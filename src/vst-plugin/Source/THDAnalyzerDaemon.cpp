@@ -0,0 +1,519 @@
+/* ==============================================================================
+   THD Analyzer Headless Daemon
+   Continuous THD monitoring without a DAW or editor (Linux, JACK/ALSA).
+
+   One Channel-mode THDAnalyzerPlugin instance is created per input channel and
+   a Master Brain instance aggregates them through the usual shared slots, so
+   the analysis is identical to the plugin. Results go to the measurement log
+   and, optionally, the local IPC server.
+
+   Every strip shares this one audio callback, so instead of each strip running
+   its own FFT at a hop, the daemon collects the hop frames of all strips and
+   analyses them eight at a time with BatchedSpectrumAnalyzer (one channel per
+   SIMD lane), then hands each strip its result. --no-batch restores per-strip
+   analysis.
+
+   Usage:
+     thd-analyzer-daemon [--type JACK|ALSA] [--device NAME] [--inputs N]
+                         [--first-input N] [--rate HZ] [--block N]
+                         [--log PATH|-] [--log-interval-ms N] [--ipc]
+                         [--no-batch] [--calibrate SECONDS] [--list-devices]
+   A --log path ending in .thdr writes binary records (THDRecordFormat.h)
+   instead of CSV.
+
+   --calibrate averages the first input (looped back from the interface's
+   output) into the residual profile for the device rate, writes it where the
+   plugin looks for it (CalibrationProfile.h) and exits. Every other run
+   subtracts that profile from each analysed spectrum.
+   ============================================================================== */
+
+#include "THDAnalyzerPlugin.h"
+#include "MeasurementLog.h"
+#include "BatchedSpectrumAnalyzer.h"
+
+#include <csignal>
+#include <iostream>
+
+namespace
+{
+std::atomic<bool> quitRequested { false };
+
+void requestQuit (int)
+{
+    quitRequested.store (true);
+}
+
+struct DaemonOptions
+{
+    juce::String deviceType = "JACK";
+    juce::String deviceName;
+    int numInputs = 8;
+    int firstInput = 0;
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    juce::String logPath = "-";
+    int logIntervalMs = 1000;
+    bool enableIpc = false;
+    bool batchAnalysis = true;
+    bool listDevices = false;
+    double calibrateSeconds = 0.0;
+};
+
+bool parseOptions (const juce::StringArray& args, DaemonOptions& options, juce::String& error)
+{
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const auto& arg = args[i];
+        const auto needsValue = arg != "--ipc" && arg != "--no-batch" && arg != "--list-devices";
+
+        if (needsValue && i + 1 >= args.size())
+        {
+            error = "missing value for " + arg;
+            return false;
+        }
+
+        if (arg == "--type")                 options.deviceType = args[++i];
+        else if (arg == "--device")          options.deviceName = args[++i];
+        else if (arg == "--inputs")          options.numInputs = args[++i].getIntValue();
+        else if (arg == "--first-input")     options.firstInput = args[++i].getIntValue();
+        else if (arg == "--rate")            options.sampleRate = args[++i].getDoubleValue();
+        else if (arg == "--block")           options.blockSize = args[++i].getIntValue();
+        else if (arg == "--log")             options.logPath = args[++i];
+        else if (arg == "--log-interval-ms") options.logIntervalMs = args[++i].getIntValue();
+        else if (arg == "--ipc")             options.enableIpc = true;
+        else if (arg == "--no-batch")        options.batchAnalysis = false;
+        else if (arg == "--calibrate")       options.calibrateSeconds = args[++i].getDoubleValue();
+        else if (arg == "--list-devices")    options.listDevices = true;
+        else
+        {
+            error = "unknown option " + arg;
+            return false;
+        }
+    }
+
+    if (! juce::isPositiveAndNotGreaterThan (options.numInputs, THDAnalyzerPlugin::maxDynamicChannels) || options.numInputs == 0)
+    {
+        error = "--inputs must be 1.." + juce::String (THDAnalyzerPlugin::maxDynamicChannels);
+        return false;
+    }
+
+    options.firstInput = juce::jmax (0, options.firstInput);
+    options.logIntervalMs = juce::jmax (10, options.logIntervalMs);
+    return true;
+}
+
+//==============================================================================
+/** Collects strip hop frames during one callback and analyses them in lane-parallel batches. */
+class BatchedStripAnalysis final : public THDAnalyzerPlugin::BatchedAnalysisScheduler
+{
+public:
+    static constexpr int lanesPerBatch = 8;
+
+    void reserve (int numStrips)
+    {
+        pending.reserve (static_cast<size_t> (numStrips));
+    }
+
+    void submit (THDAnalyzerPlugin& strip, const float* frame, float sampleRate) noexcept override
+    {
+        if (pending.size() < pending.capacity())
+            pending.push_back ({ &strip, frame, sampleRate, strip.getCalibrationResidual() });
+    }
+
+    /** Analyses everything submitted since the last flush and completes each strip's hop. */
+    void flush()
+    {
+        for (size_t first = 0; first < pending.size();)
+        {
+            // A batch shares one sample rate and residual; in the daemon every strip runs at the
+            // device rate and maps the same calibration profile, so batches still fill up.
+            const auto sampleRate = pending[first].sampleRate;
+            const auto* residualPower = pending[first].residualPower;
+            std::array<const float*, lanesPerBatch> frames {};
+            int numLanes = 0;
+
+            while (first + static_cast<size_t> (numLanes) < pending.size() && numLanes < lanesPerBatch
+                   && pending[first + static_cast<size_t> (numLanes)].sampleRate == sampleRate
+                   && pending[first + static_cast<size_t> (numLanes)].residualPower == residualPower)
+            {
+                frames[static_cast<size_t> (numLanes)] = pending[first + static_cast<size_t> (numLanes)].frame;
+                ++numLanes;
+            }
+
+            analyzer.setResidualPower (residualPower);
+            analyzer.analyze (frames.data(), numLanes, sampleRate, results.data());
+
+            // The batch's spectrum is bin-major, so each strip reads its LTAS from its own lane.
+            for (int lane = 0; lane < numLanes; ++lane)
+                pending[first + static_cast<size_t> (lane)].strip->completeBatchedAnalysis (results[static_cast<size_t> (lane)],
+                                                                                           analyzer.getPowerSpectrum() + lane, lanesPerBatch);
+
+            first += static_cast<size_t> (numLanes);
+        }
+
+        pending.clear();
+    }
+
+private:
+    struct PendingFrame
+    {
+        THDAnalyzerPlugin* strip = nullptr;
+        const float* frame = nullptr;
+        float sampleRate = 0.0f;
+        const float* residualPower = nullptr;
+    };
+
+    BatchedSpectrumAnalyzer<FFTAnalyzer::fftOrder, lanesPerBatch> analyzer;
+    std::array<FFTAnalyzer::AnalysisResult, lanesPerBatch> results {};
+    std::vector<PendingFrame> pending;
+};
+
+//==============================================================================
+/** Sample counter of the audio device, so every strip tags hops on one timeline. */
+class DeviceClockPlayHead final : public juce::AudioPlayHead
+{
+public:
+    juce::Optional<PositionInfo> getPosition() const override
+    {
+        PositionInfo position;
+        position.setTimeInSamples (samplesProcessed);
+        position.setTimeInSeconds (sampleRate > 0.0 ? static_cast<double> (samplesProcessed) / sampleRate : 0.0);
+        position.setIsPlaying (true);
+        return position;
+    }
+
+    void prepare (double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        samplesProcessed = 0;
+    }
+
+    void advance (int numSamples) noexcept { samplesProcessed += numSamples; }
+
+private:
+    double sampleRate = 0.0;
+    int64_t samplesProcessed = 0;
+};
+
+//==============================================================================
+class HeadlessAnalyzerHost final : public juce::AudioIODeviceCallback,
+                                   private juce::Timer
+{
+public:
+    explicit HeadlessAnalyzerHost (const DaemonOptions& optionsToUse)
+        : options (optionsToUse)
+    {
+        for (int i = 0; i < options.numInputs; ++i)
+        {
+            auto strip = std::make_unique<THDAnalyzerPlugin>();
+            strip->setPluginMode (PluginMode::ChannelStrip);
+            strip->setChannelId (i);
+            strip->setPlayHead (&playHead);
+
+            if (options.batchAnalysis)
+                strip->setBatchedAnalysisScheduler (&batchedAnalysis);
+
+            strips.push_back (std::move (strip));
+        }
+
+        batchedAnalysis.reserve (options.numInputs);
+
+        master = std::make_unique<THDAnalyzerPlugin>();
+        master->setPluginMode (PluginMode::MasterBrain);
+        master->setChannelId (0);
+        master->setPlayHead (&playHead);
+
+        if (options.enableIpc)
+            if (auto* ipcParam = master->getValueTreeState().getParameter ("ipcServerEnabled"))
+                ipcParam->setValueNotifyingHost (1.0f);
+    }
+
+    ~HeadlessAnalyzerHost() override
+    {
+        stopTimer();
+        deviceManager.removeAudioCallback (this);
+        deviceManager.closeAudioDevice();
+        log.close();
+    }
+
+    juce::String start()
+    {
+        std::string logError;
+        if (! log.open (options.logPath.toStdString(), &logError))
+            return "cannot open log: " + juce::String (logError);
+
+        if (auto error = deviceManager.initialise (0, 0, nullptr, false); error.isNotEmpty())
+            return error;
+
+        deviceManager.setCurrentAudioDeviceType (options.deviceType, true);
+        if (deviceManager.getCurrentDeviceTypeObject() == nullptr
+            || deviceManager.getCurrentDeviceTypeObject()->getTypeName() != options.deviceType)
+            return "audio device type not available: " + options.deviceType;
+
+        auto setup = deviceManager.getAudioDeviceSetup();
+        if (options.deviceName.isNotEmpty())
+            setup.inputDeviceName = options.deviceName;
+
+        setup.outputDeviceName = {};
+        setup.sampleRate = options.sampleRate;
+        setup.bufferSize = options.blockSize;
+        setup.useDefaultInputChannels = false;
+        setup.useDefaultOutputChannels = false;
+        setup.inputChannels.clear();
+        setup.inputChannels.setRange (options.firstInput, options.numInputs, true);
+        setup.outputChannels.clear();
+
+        if (auto error = deviceManager.setAudioDeviceSetup (setup, true); error.isNotEmpty())
+            return error;
+
+        auto* device = deviceManager.getCurrentAudioDevice();
+        if (device == nullptr)
+            return "no audio device opened";
+
+        const auto activeInputs = device->getActiveInputChannels().countNumberOfSetBits();
+        if (activeInputs < options.numInputs)
+            std::cerr << "warning: device opened " << activeInputs << " of " << options.numInputs << " requested inputs\n";
+
+        deviceManager.addAudioCallback (this);
+        startTimer (options.logIntervalMs);
+
+        std::cerr << "thd-analyzer-daemon: " << device->getTypeName() << " '" << device->getName() << "', "
+                  << activeInputs << " inputs @ " << device->getCurrentSampleRate() << " Hz, block "
+                  << device->getCurrentBufferSizeSamples() << "\n";
+        return {};
+    }
+
+    //==============================================================================
+    void audioDeviceAboutToStart (juce::AudioIODevice* device) override
+    {
+        const auto sampleRate = device->getCurrentSampleRate();
+        const auto blockSize = device->getCurrentBufferSizeSamples();
+
+        for (auto& strip : strips)
+            prepareProcessor (*strip, sampleRate, blockSize);
+
+        prepareProcessor (*master, sampleRate, blockSize);
+        playHead.prepare (sampleRate);
+        processBuffer.setSize (2, blockSize, false, true, false);
+    }
+
+    void audioDeviceStopped() override
+    {
+        for (auto& strip : strips)
+            strip->releaseResources();
+
+        master->releaseResources();
+    }
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData,
+                                           int numInputChannels,
+                                           float* const* outputChannelData,
+                                           int numOutputChannels,
+                                           int numSamples,
+                                           const juce::AudioIODeviceCallbackContext&) override
+    {
+        processBuffer.setSize (2, numSamples, false, false, true);
+
+        // Each strip sees its device input on both sides of its stereo bus.
+        for (size_t i = 0; i < strips.size(); ++i)
+        {
+            const auto* input = static_cast<int> (i) < numInputChannels ? inputChannelData[i] : nullptr;
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                if (input != nullptr)
+                    processBuffer.copyFrom (channel, 0, input, numSamples);
+                else
+                    processBuffer.clear (channel, 0, numSamples);
+            }
+
+            strips[i]->processBlock (processBuffer, midiScratch);
+        }
+
+        batchedAnalysis.flush();
+
+        processBuffer.clear();
+        master->processBlock (processBuffer, midiScratch);
+        midiScratch.clear();
+        playHead.advance (numSamples);
+
+        for (int channel = 0; channel < numOutputChannels; ++channel)
+            if (outputChannelData[channel] != nullptr)
+                juce::FloatVectorOperations::clear (outputChannelData[channel], numSamples);
+    }
+
+private:
+    static void prepareProcessor (THDAnalyzerPlugin& processor, double sampleRate, int blockSize)
+    {
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+    }
+
+    void timerCallback() override
+    {
+        if (quitRequested.load())
+        {
+            stopTimer();
+            juce::MessageManager::getInstance()->stopDispatchLoop();
+            return;
+        }
+
+        if (options.calibrateSeconds > 0.0)
+            updateCalibration();
+        else
+            writeLogRows();
+    }
+
+    void updateCalibration()
+    {
+        auto& strip = *strips.front();
+
+        if (! calibrationStarted)
+        {
+            calibrationStarted = strip.startCalibrationCapture (options.calibrateSeconds);
+            if (calibrationStarted)
+                std::cerr << "thd-analyzer-daemon: capturing " << options.calibrateSeconds << " s of loopback residual on input "
+                          << options.firstInput << "\n";
+            return;
+        }
+
+        const auto status = strip.getCalibrationStatus();
+        if (status.capturing)
+            return;
+
+        const auto file = THDAnalyzerPlugin::getCalibrationProfileFile (strip.getSampleRate());
+        if (status.profileLoaded)
+            std::cerr << "thd-analyzer-daemon: wrote " << file.getFullPathName() << "\n";
+        else
+            std::cerr << "thd-analyzer-daemon: calibration profile not written\n";
+
+        quitRequested.store (true);
+    }
+
+    void writeLogRows()
+    {
+        const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+        const auto timeSeconds = (nowMs - startMs) * 0.001;
+        float peakLevel = 0.0f;
+
+        for (int channelId = 0; channelId < static_cast<int> (strips.size()); ++channelId)
+        {
+            THDAnalyzerPlugin::SharedChannelState shared;
+            if (! THDAnalyzerPlugin::readSharedChannelSlot (channelId, shared) || THDAnalyzerPlugin::isSharedChannelStale (shared, nowMs))
+                continue;
+
+            auto& lastSequence = loggedSequences[static_cast<size_t> (channelId)];
+            if (shared.sequence == lastSequence)
+                continue;
+
+            lastSequence = shared.sequence;
+            peakLevel = juce::jmax (peakLevel, shared.peakLevel);
+
+            MeasurementLog::Row row;
+            row.timeSeconds = timeSeconds;
+            row.channelId = channelId;
+            row.sequence = shared.sequence;
+            row.thd = shared.thd;
+            row.thdN = shared.thdN;
+            row.level = shared.level;
+            row.peakLevel = shared.peakLevel;
+            row.harmonics = shared.harmonics;
+            row.groupIndex = shared.groupIndex;
+            row.timelineSample = shared.timelineSample;
+            row.epoch = shared.epoch;
+            log.append (row);
+        }
+
+        const auto aggregate = master->getMasterAggregate();
+        if (aggregate.numContributingChannels > 0)
+        {
+            MeasurementLog::Row row;
+            row.timeSeconds = timeSeconds;
+            row.channelId = MeasurementLog::masterChannel;
+            row.sequence = ++masterRowsLogged;
+            row.thd = aggregate.rssThd;
+            row.thdN = aggregate.rssThdN;
+            row.level = aggregate.averageLevel;
+            row.peakLevel = peakLevel;
+            row.harmonics = aggregate.harmonics;
+            log.append (row);
+        }
+
+        log.flush();
+    }
+
+    DaemonOptions options;
+    DeviceClockPlayHead playHead;
+    BatchedStripAnalysis batchedAnalysis;
+    juce::AudioDeviceManager deviceManager;
+    std::vector<std::unique_ptr<THDAnalyzerPlugin>> strips;
+    std::unique_ptr<THDAnalyzerPlugin> master;
+    juce::AudioBuffer<float> processBuffer;
+    juce::MidiBuffer midiScratch;
+
+    MeasurementLog log;
+    std::array<uint64_t, THDAnalyzerPlugin::maxDynamicChannels> loggedSequences {};
+    uint64_t masterRowsLogged = 0;
+    bool calibrationStarted = false;
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+};
+
+void listDevices()
+{
+    juce::AudioDeviceManager deviceManager;
+    juce::OwnedArray<juce::AudioIODeviceType> types;
+    deviceManager.createAudioDeviceTypes (types);
+
+    for (auto* type : types)
+    {
+        type->scanForDevices();
+        std::cout << type->getTypeName() << "\n";
+
+        for (const auto& name : type->getDeviceNames (true))
+            std::cout << "  " << name << "\n";
+    }
+}
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const auto startupMs = juce::Time::getMillisecondCounterHiRes();
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (juce::String::fromUTF8 (argv[i]));
+
+    DaemonOptions options;
+    juce::String error;
+    if (! parseOptions (args, options, error))
+    {
+        std::cerr << "thd-analyzer-daemon: " << error << "\n";
+        return 2;
+    }
+
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    if (options.listDevices)
+    {
+        listDevices();
+        return 0;
+    }
+
+    std::signal (SIGINT, requestQuit);
+    std::signal (SIGTERM, requestQuit);
+
+    auto host = std::make_unique<HeadlessAnalyzerHost> (options);
+    if (error = host->start(); error.isNotEmpty())
+    {
+        std::cerr << "thd-analyzer-daemon: " << error << "\n";
+        return 1;
+    }
+
+    std::cerr << "thd-analyzer-daemon: ready in "
+              << juce::roundToInt (juce::Time::getMillisecondCounterHiRes() - startupMs) << " ms\n";
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+    host.reset();
+    return 0;
+}
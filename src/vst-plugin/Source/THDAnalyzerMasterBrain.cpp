@@ -0,0 +1,568 @@
+/* ==============================================================================
+   THD Analyzer - Master Brain mode
+   Ingests the shared channel slots once per block, keeps the channel list,
+   the SIMD aggregate, the group tree and timeline joins.
+   Compiled to stubs when THD_WITH_MASTER_BRAIN is 0.
+   ============================================================================== */
+
+#include "THDAnalyzerPlugin.h"
+
+#if THD_WITH_MASTER_BRAIN
+
+#include <algorithm>
+
+namespace
+{
+using SIMDFloat = juce::dsp::SIMDRegister<float>;
+constexpr auto simdLanes = static_cast<int> (SIMDFloat::SIMDNumElements);
+
+// Sum of values[i] * mask[i]; mask entries are 0 or 1 so this is a masked sum.
+float maskedSum (const float* values, const float* mask, int numValues) noexcept
+{
+    jassert (numValues % simdLanes == 0);
+    auto accumulator = SIMDFloat::expand (0.0f);
+
+    for (int i = 0; i < numValues; i += simdLanes)
+        accumulator += SIMDFloat::fromRawArray (values + i) * SIMDFloat::fromRawArray (mask + i);
+
+    return accumulator.sum();
+}
+
+float maskedSumOfSquares (const float* values, const float* mask, int numValues) noexcept
+{
+    jassert (numValues % simdLanes == 0);
+    auto accumulator = SIMDFloat::expand (0.0f);
+
+    for (int i = 0; i < numValues; i += simdLanes)
+    {
+        const auto v = SIMDFloat::fromRawArray (values + i);
+        accumulator += v * v * SIMDFloat::fromRawArray (mask + i);
+    }
+
+    return accumulator.sum();
+}
+
+// Values are non-negative, so masking by multiplication leaves excluded lanes at 0.
+float maskedMaximum (const float* values, const float* mask, int numValues) noexcept
+{
+    jassert (numValues % simdLanes == 0);
+    auto peak = SIMDFloat::expand (0.0f);
+
+    for (int i = 0; i < numValues; i += simdLanes)
+        peak = SIMDFloat::max (peak, SIMDFloat::fromRawArray (values + i) * SIMDFloat::fromRawArray (mask + i));
+
+    float result = 0.0f;
+    for (size_t lane = 0; lane < SIMDFloat::SIMDNumElements; ++lane)
+        result = juce::jmax (result, peak.get (lane));
+
+    return result;
+}
+
+int countTrailingZeros (uint64_t value) noexcept
+{
+    jassert (value != 0);
+   #if JUCE_MSVC
+    unsigned long index = 0;
+    _BitScanForward64 (&index, value);
+    return static_cast<int> (index);
+   #else
+    return __builtin_ctzll (value);
+   #endif
+}
+}
+
+static_assert (THDAnalyzerPlugin::maxDynamicChannels % simdLanes == 0,
+               "Master aggregation SIMD passes assume whole registers per channel table");
+
+void THDAnalyzerPlugin::processMasterBrainBlock (juce::MidiBuffer& midiMessages, int numSamples)
+{
+    if (const auto sr = getSampleRate(); sr > 0.0)
+        internalClockSeconds += static_cast<double> (numSamples) / sr;
+
+    ingestSharedChannelData();
+    pruneStaleChannels();
+    updateMasterAggregate();
+    midiMessages.clear();
+}
+
+void THDAnalyzerPlugin::resetMasterBrainState()
+{
+    internalClockSeconds = 0.0;
+    consumedSharedSequences.fill (0);
+    for (int word = 0; word < channelMaskWords; ++word)
+        liveSlotBits.storeWord (word, 0);
+    slotContributionMask.fill (0.0f);
+    updatedSlotBits.fill (0);
+    previousContributingBits.fill (0);
+    groupTree.reset();
+    groupTopologyDirty.store (true, std::memory_order_release);
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    for (auto& channel : channels)
+    {
+        channel.thd = 0.0;
+        channel.thdN = 0.0;
+        channel.level = 0.0;
+        channel.peakLevel = 0.0;
+        channel.active = false;
+        channel.lastPublishMs = 0.0;
+        std::fill (channel.harmonics.begin(), channel.harmonics.end(), 0.0);
+        channel.ltasDb = ChannelData::makeSilentLtas();
+        channel.ltasHops = 0;
+        channel.numBands = 0;
+        channel.bands = {};
+    }
+
+    masterAggregate = MasterAggregate {};
+    groupSummaries = {};
+
+    // The clock restarts from zero, so earlier trend samples would no longer line up with it.
+    if (auto* trends = trendStore.load (std::memory_order_acquire))
+        trends->reset();
+}
+
+void THDAnalyzerPlugin::ensureTrendStore()
+{
+    if (ownedTrendStore != nullptr)
+        return;
+
+    ownedTrendStore = std::make_unique<TrendStore>();
+    trendStore.store (ownedTrendStore.get(), std::memory_order_release);
+}
+
+std::vector<ChannelData> THDAnalyzerPlugin::getChannelsSnapshot() const
+{
+    std::vector<ChannelData> snapshot;
+
+    {
+        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+        snapshot = channels;
+    }
+
+    for (auto& channel : snapshot)
+    {
+        channel.muted = mutedChannels.test (channel.channelId);
+        channel.soloed = soloedChannels.test (channel.channelId);
+    }
+
+    return snapshot;
+}
+
+THDAnalyzerPlugin::MasterAggregate THDAnalyzerPlugin::getMasterAggregate() const
+{
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    return masterAggregate;
+}
+
+bool THDAnalyzerPlugin::setChannelGroupParent (int group, int parent)
+{
+    if (! GroupTree::isValidGroup (group) || (parent != GroupTree::noGroup && ! GroupTree::isValidGroup (parent)))
+        return false;
+
+    // Reject cycles up front so the UI never requests a topology the audio thread would refuse.
+    for (auto ancestor = parent; ancestor != GroupTree::noGroup;
+         ancestor = requestedGroupParents[static_cast<size_t> (ancestor)].load (std::memory_order_acquire))
+    {
+        if (ancestor == group)
+            return false;
+    }
+
+    requestedGroupParents[static_cast<size_t> (group)].store (parent, std::memory_order_release);
+    groupTopologyDirty.store (true, std::memory_order_release);
+    return true;
+}
+
+int THDAnalyzerPlugin::getChannelGroupParent (int group) const noexcept
+{
+    return GroupTree::isValidGroup (group) ? requestedGroupParents[static_cast<size_t> (group)].load (std::memory_order_acquire)
+                                           : GroupTree::noGroup;
+}
+
+std::array<THDAnalyzerPlugin::GroupSummary, THDAnalyzerPlugin::maxChannelGroups> THDAnalyzerPlugin::getGroupSummaries() const
+{
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    return groupSummaries;
+}
+
+void THDAnalyzerPlugin::setChannelMuted (int channelId, bool shouldBeMuted)
+{
+    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels))
+        return;
+
+    if (channelId < numAutomatableMuteSoloChannels)
+        if (auto* mutedParam = state.getParameter (channelMutedParamId (channelId)))
+            mutedParam->setValueNotifyingHost (shouldBeMuted ? 1.0f : 0.0f);
+
+    mutedChannels.set (channelId, shouldBeMuted);
+}
+
+void THDAnalyzerPlugin::setChannelSoloed (int channelId, bool shouldBeSoloed)
+{
+    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels))
+        return;
+
+    if (channelId < numAutomatableMuteSoloChannels)
+        if (auto* soloedParam = state.getParameter (channelSoloedParamId (channelId)))
+            soloedParam->setValueNotifyingHost (shouldBeSoloed ? 1.0f : 0.0f);
+
+    soloedChannels.set (channelId, shouldBeSoloed);
+}
+
+bool THDAnalyzerPlugin::isChannelMuted (int channelId) const noexcept
+{
+    return mutedChannels.test (channelId);
+}
+
+bool THDAnalyzerPlugin::isChannelSoloed (int channelId) const noexcept
+{
+    return soloedChannels.test (channelId);
+}
+
+const THDAnalyzerPlugin::TrendStore* THDAnalyzerPlugin::getTrendStore() const noexcept
+{
+    return trendStore.load (std::memory_order_acquire);
+}
+
+void THDAnalyzerPlugin::ingestSharedChannelData()
+{
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+
+    // Close the current epoch and take every slot as of it. Strips publishing
+    // from now on stamp the next epoch, so channels that changed together in
+    // one round land in the same master snapshot. A slot with nothing at or
+    // before the epoch keeps its previous (older) values for this block.
+    snapshotEpoch = sharedAnalysisEpoch.fetch_add (1, std::memory_order_acq_rel);
+
+    for (int channelId = 0; channelId < maxDynamicChannels; ++channelId)
+    {
+        SharedChannelState shared;
+        if (! readSharedChannelSlotAtEpoch (channelId, snapshotEpoch, shared) || isSharedChannelStale (shared, nowMs))
+            continue;
+
+        if (shared.publisherInstanceId == instanceId)
+            continue;
+
+        // Between full publishes a strip only refreshes its peak meter and publish stamp.
+        const auto isNewPublish = shared.sequence != consumedSharedSequences[static_cast<size_t> (channelId)];
+        consumedSharedSequences[static_cast<size_t> (channelId)] = shared.sequence;
+
+        if (isNewPublish)
+            ensureChannelExists (channelId);
+
+        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+        auto it = std::find_if (channels.begin(), channels.end(), [channelId] (const ChannelData& c)
+        {
+            return c.channelId == channelId;
+        });
+
+        if (it == channels.end())
+            continue;
+
+        auto& channel = *it;
+        channel.peakLevel = shared.peakLevel;
+        channel.lastPublishMs = shared.lastPublishMs;
+
+        if (! isNewPublish)
+            continue;
+
+        channel.thd = shared.thd;
+        channel.thdN = shared.thdN;
+        channel.level = shared.level;
+        channel.waveform = shared.waveform;
+        channel.ltasDb = shared.ltasDb;
+        channel.ltasHops = shared.ltasHops;
+        channel.numBands = shared.numBands;
+        channel.bands = shared.bands;
+        channel.active = true;
+
+        for (size_t i = 0; i < channel.harmonics.size() && i < shared.harmonics.size(); ++i)
+            channel.harmonics[i] = shared.harmonics[i];
+
+        const auto slot = static_cast<size_t> (channelId);
+        slotThd[slot] = juce::jlimit (0.0f, 100.0f, shared.thd);
+        slotThdN[slot] = juce::jlimit (0.0f, 100.0f, shared.thdN);
+        slotLevel[slot] = juce::jmax (0.0f, shared.level);
+        for (size_t i = 0; i < slotHarmonics.size(); ++i)
+            slotHarmonics[i][slot] = juce::jlimit (0.0f, 1.0f, shared.harmonics[i]);
+
+        liveSlotBits.set (channelId, true);
+        updatedSlotBits[slot / 64] |= uint64_t { 1 } << (slot % 64);
+
+        if (auto* trends = trendStore.load (std::memory_order_acquire))
+            trends->add (channelId, internalClockSeconds, shared.thd, shared.thdN, shared.level);
+
+        if (groupTree.getChannelGroup (channelId) != shared.groupIndex)
+            groupTree.setChannelGroup (channelId, shared.groupIndex);
+    }
+}
+
+void THDAnalyzerPlugin::updateMasterAggregate()
+{
+    MasterAggregate aggregate;
+    const auto anySoloed = soloedChannels.any();
+
+    for (int word = 0; word < channelMaskWords; ++word)
+    {
+        auto audible = ~mutedChannels.loadWord (word);
+        if (anySoloed)
+            audible &= soloedChannels.loadWord (word);
+
+        sharedMasterChannelMask.storeWord (word, audible);
+
+        const auto contributing = liveSlotBits.loadWord (word) & audible;
+        aggregate.contributingChannels[static_cast<size_t> (word)] = contributing;
+
+        for (int bit = 0; bit < 64 && (word * 64) + bit < maxDynamicChannels; ++bit)
+            slotContributionMask[static_cast<size_t> ((word * 64) + bit)] = ((contributing >> bit) & 1u) != 0 ? 1.0f : 0.0f;
+    }
+
+    const auto* mask = slotContributionMask.data();
+    const auto count = maskedSum (slotContributionMask.data(), mask, maxDynamicChannels);
+    aggregate.numContributingChannels = juce::roundToInt (count);
+
+    if (aggregate.numContributingChannels > 0)
+    {
+        const auto invCount = 1.0f / count;
+        aggregate.averageThd = maskedSum (slotThd.data(), mask, maxDynamicChannels) * invCount;
+        aggregate.rssThd = std::sqrt (maskedSumOfSquares (slotThd.data(), mask, maxDynamicChannels) * invCount);
+        aggregate.rssThdN = std::sqrt (maskedSumOfSquares (slotThdN.data(), mask, maxDynamicChannels) * invCount);
+        aggregate.peakThd = maskedMaximum (slotThd.data(), mask, maxDynamicChannels);
+        aggregate.averageLevel = maskedSum (slotLevel.data(), mask, maxDynamicChannels) * invCount;
+
+        for (size_t i = 0; i < aggregate.harmonics.size(); ++i)
+            aggregate.harmonics[i] = maskedSum (slotHarmonics[i].data(), mask, maxDynamicChannels) * invCount;
+    }
+
+    aggregate.timelineSample = blockTimelineSample;
+    aggregate.epoch = snapshotEpoch;
+    sharedMasterChannelMaskMs.store (juce::Time::getMillisecondCounterHiRes(), std::memory_order_release);
+
+    // The aggregate above takes each channel's latest publish; this joins the same channels at one host position.
+    if (blockTimelineSample != noTimelinePosition)
+    {
+        const auto join = joinChannelsAtTimeline (blockTimelineSample - masterJoinLatencySamples,
+                                                  masterJoinToleranceSamples, aggregate.contributingChannels);
+        aggregate.alignedTimelineSample = join.timelineSample;
+        aggregate.numAlignedChannels = join.numChannels;
+        aggregate.alignedRssThd = join.rssThd;
+        aggregate.alignedPeakThd = join.peakThd;
+    }
+
+    updateGroupTree (aggregate.contributingChannels);
+    setMeasurementCvTargets (aggregate.rssThd, aggregate.rssThdN, aggregate.averageLevel);
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    masterAggregate = aggregate;
+}
+
+void THDAnalyzerPlugin::updateGroupTree (const std::array<uint64_t, channelMaskWords>& contributingBits)
+{
+    if (groupTopologyDirty.exchange (false, std::memory_order_acq_rel))
+    {
+        // Apply the requested topology as a whole: applying one group at a time
+        // can pass through a cycle on the way to a valid tree. A set caught
+        // mid-edit is retried on the next block.
+        std::array<int, maxChannelGroups> parents {};
+        for (int group = 0; group < maxChannelGroups; ++group)
+            parents[static_cast<size_t> (group)] = requestedGroupParents[static_cast<size_t> (group)].load (std::memory_order_acquire);
+
+        if (! groupTree.setGroupParents (parents))
+            groupTopologyDirty.store (true, std::memory_order_release);
+    }
+
+    // Only channels that published this block or flipped mute/solo/liveness are
+    // touched, and each one walks just its own ancestor chain.
+    bool anyChannelChanged = false;
+
+    for (int word = 0; word < channelMaskWords; ++word)
+    {
+        const auto w = static_cast<size_t> (word);
+        auto dirty = updatedSlotBits[w] | (contributingBits[w] ^ previousContributingBits[w]);
+        anyChannelChanged = anyChannelChanged || dirty != 0;
+
+        while (dirty != 0)
+        {
+            const auto bit = countTrailingZeros (dirty);
+            dirty &= dirty - 1;
+
+            const auto channelId = (word * 64) + bit;
+            const auto slot = static_cast<size_t> (channelId);
+
+            if (((contributingBits[w] >> bit) & 1u) != 0)
+                groupTree.updateChannel (channelId, GroupTree::Contribution::fromChannel (slotThd[slot], slotThdN[slot]));
+            else
+                groupTree.clearChannel (channelId);
+        }
+
+        previousContributingBits[w] = contributingBits[w];
+        updatedSlotBits[w] = 0;
+    }
+
+    if (anyChannelChanged)
+        editorDataVersion.fetch_add (1, std::memory_order_release);
+
+    if (groupTree.getVersion() == publishedGroupTreeVersion)
+        return;
+
+    publishedGroupTreeVersion = groupTree.getVersion();
+
+    std::array<GroupSummary, maxChannelGroups> summaries {};
+    for (int group = 0; group < maxChannelGroups; ++group)
+    {
+        const auto& node = groupTree.getGroup (group);
+        auto& summary = summaries[static_cast<size_t> (group)];
+        summary.parent = node.parent;
+        summary.depth = node.depth;
+        summary.numChannels = node.totals.numChannels;
+        summary.averageThd = node.averageThd();
+        summary.rssThd = node.rssThd();
+        summary.rssThdN = node.rssThdN();
+    }
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    groupSummaries = summaries;
+}
+
+void THDAnalyzerPlugin::removeChannel (int id)
+{
+    // The audio thread sets liveness bits without taking the lock, so clear with an atomic RMW.
+    liveSlotBits.set (id, false);
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+
+    channels.erase (std::remove_if (channels.begin(), channels.end(), [id] (const ChannelData& c)
+    {
+        return c.channelId == id;
+    }), channels.end());
+}
+
+juce::Colour THDAnalyzerPlugin::colorForChannelId (int channelId)
+{
+    static const std::array<juce::Colour, 10> palette {
+        juce::Colour::fromString ("fff97316"),
+        juce::Colour::fromString ("ff60a5fa"),
+        juce::Colour::fromString ("ffa78bfa"),
+        juce::Colour::fromString ("ff34d399"),
+        juce::Colour::fromString ("ff2dd4bf"),
+        juce::Colour::fromString ("fffbbf24"),
+        juce::Colour::fromString ("fff472b6"),
+        juce::Colour::fromString ("ff94a3b8"),
+        juce::Colour::fromString ("ff38bdf8"),
+        juce::Colour::fromString ("fffb923c")
+    };
+
+    const auto index = static_cast<size_t> (juce::jmax (0, channelId)) % palette.size();
+    return palette[index];
+}
+
+juce::String THDAnalyzerPlugin::defaultChannelNameForId (int channelId)
+{
+    return "CH " + juce::String (channelId + 1);
+}
+
+void THDAnalyzerPlugin::ensureChannelExists (int channelId)
+{
+    if (channelId < 0 || channelId >= maxDynamicChannels)
+        return;
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+
+    const auto it = std::find_if (channels.begin(), channels.end(), [channelId] (const ChannelData& c)
+    {
+        return c.channelId == channelId;
+    });
+
+    if (it != channels.end())
+        return;
+
+    ChannelData channel (channelId, defaultChannelNameForId (channelId), colorForChannelId (channelId));
+    channel.active = true;
+    channel.lastPublishMs = juce::Time::getMillisecondCounterHiRes();
+    channels.push_back (std::move (channel));
+
+    std::sort (channels.begin(), channels.end(), [] (const ChannelData& a, const ChannelData& b)
+    {
+        return a.channelId < b.channelId;
+    });
+}
+
+void THDAnalyzerPlugin::pruneStaleChannels()
+{
+    // Same clock and timeout as the slot check in ingestSharedChannelData(), so a channel is
+    // dropped exactly when its strip's slot stops being ingested.
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    channels.erase (std::remove_if (channels.begin(), channels.end(), [this, nowMs] (const ChannelData& c)
+    {
+        if (! c.active)
+            return false;
+
+        const auto isStale = isPublishStale (c.lastPublishMs, nowMs);
+        if (isStale)
+            liveSlotBits.set (c.channelId, false);
+
+        return isStale;
+    }), channels.end());
+}
+
+#else
+
+// Channel Strip-only build: nothing is aggregated, so the Master Brain queries report empty state.
+std::vector<ChannelData> THDAnalyzerPlugin::getChannelsSnapshot() const
+{
+    return {};
+}
+
+THDAnalyzerPlugin::MasterAggregate THDAnalyzerPlugin::getMasterAggregate() const
+{
+    return {};
+}
+
+bool THDAnalyzerPlugin::setChannelGroupParent (int, int)
+{
+    return false;
+}
+
+int THDAnalyzerPlugin::getChannelGroupParent (int) const noexcept
+{
+    return GroupTree::noGroup;
+}
+
+std::array<THDAnalyzerPlugin::GroupSummary, THDAnalyzerPlugin::maxChannelGroups> THDAnalyzerPlugin::getGroupSummaries() const
+{
+    return {};
+}
+
+void THDAnalyzerPlugin::setChannelMuted (int, bool)
+{
+}
+
+void THDAnalyzerPlugin::setChannelSoloed (int, bool)
+{
+}
+
+bool THDAnalyzerPlugin::isChannelMuted (int) const noexcept
+{
+    return false;
+}
+
+bool THDAnalyzerPlugin::isChannelSoloed (int) const noexcept
+{
+    return false;
+}
+
+const THDAnalyzerPlugin::TrendStore* THDAnalyzerPlugin::getTrendStore() const noexcept
+{
+    return nullptr;
+}
+
+void THDAnalyzerPlugin::removeChannel (int)
+{
+}
+
+void THDAnalyzerPlugin::ensureChannelExists (int)
+{
+}
+
+#endif
@@ -3,11 +3,125 @@
    ============================================================================== */
 
 #include "THDAnalyzerPlugin.h"
-#include "THDAnalyzerPluginEditor.h"
+#if ! THD_HEADLESS
+ #include "THDAnalyzerPluginEditor.h"
+#endif
+#include "THDIpcServer.h"
 #include <algorithm>
+#include <cstring>
+#include <mutex>
 
-std::array<THDAnalyzerPlugin::SharedChannelState, THDAnalyzerPlugin::maxDynamicChannels> THDAnalyzerPlugin::sharedChannelStates {};
-juce::SpinLock THDAnalyzerPlugin::sharedChannelStatesLock;
+namespace
+{
+#if THD_WITH_MASTER_BRAIN
+juce::String channelMaskToString (const AtomicChannelBitset<THDAnalyzerPlugin::maxDynamicChannels>& bits)
+{
+    juce::StringArray words;
+    for (int i = 0; i < THDAnalyzerPlugin::channelMaskWords; ++i)
+        words.add (juce::String::toHexString (static_cast<juce::int64> (bits.loadWord (i))));
+
+    return words.joinIntoString (",");
+}
+
+void channelMaskFromString (AtomicChannelBitset<THDAnalyzerPlugin::maxDynamicChannels>& bits, const juce::String& text)
+{
+    const auto words = juce::StringArray::fromTokens (text, ",", {});
+    for (int i = 0; i < THDAnalyzerPlugin::channelMaskWords; ++i)
+        bits.storeWord (i, i < words.size() ? static_cast<uint64_t> (words[i].trim().getHexValue64()) : 0);
+}
+#endif
+
+// One IPC server per process, shared by every instance that has it enabled.
+// It reads the same lock-free shared slots the Master Brain ingests.
+class SharedIpcServerHost
+{
+public:
+    void retain()
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        if (numUsers++ > 0)
+            return;
+
+        server = std::make_unique<THDIpcServer> (THDIpcServer::defaultSocketPath(), [] (std::vector<THDIpcChannelRecord>& records)
+        {
+            const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+
+            for (int channelId = 0; channelId < THDAnalyzerPlugin::maxDynamicChannels; ++channelId)
+            {
+                THDAnalyzerPlugin::SharedChannelState shared;
+                if (! THDAnalyzerPlugin::readSharedChannelSlot (channelId, shared) || THDAnalyzerPlugin::isSharedChannelStale (shared, nowMs))
+                    continue;
+
+                THDIpcChannelRecord record;
+                record.channelId = channelId;
+                record.sequence = shared.sequence;
+                record.thd = shared.thd;
+                record.thdN = shared.thdN;
+                record.level = shared.level;
+                record.peakLevel = shared.peakLevel;
+                record.groupIndex = shared.groupIndex;
+                record.harmonics = shared.harmonics;
+                record.timelineSample = shared.timelineSample;
+                records.push_back (record);
+            }
+        },
+        [] (int64_t timelineSample, int64_t toleranceSamples, std::vector<THDIpcChannelRecord>& records)
+        {
+            // The server filters by the query's channel list; muted and non-soloed channels stay out of the JOIN summary.
+            const auto channelMask = THDAnalyzerPlugin::getSharedMasterChannelMask (juce::Time::getMillisecondCounterHiRes());
+            const auto join = THDAnalyzerPlugin::joinChannelsAtTimeline (timelineSample, toleranceSamples, channelMask);
+
+            for (int channelId = 0; channelId < THDAnalyzerPlugin::maxDynamicChannels; ++channelId)
+            {
+                if (! join.contains (channelId))
+                    continue;
+
+                const auto& hop = join.hops[static_cast<size_t> (channelId)];
+                THDIpcChannelRecord record;
+                record.channelId = channelId;
+                record.sequence = hop.hopIndex;
+                record.thd = hop.thd;
+                record.thdN = hop.thdN;
+                record.level = hop.level;
+                record.timelineSample = hop.timelineSample;
+                record.fundamentalValid = hop.fundamentalValid;
+                records.push_back (record);
+            }
+        });
+
+        std::string error;
+        if (! server->start (&error))
+        {
+            DBG ("THD IPC server failed to start: " << error);
+            server.reset();
+        }
+    }
+
+    void release()
+    {
+        const std::lock_guard<std::mutex> lock (mutex);
+        if (numUsers > 0 && --numUsers == 0)
+            server.reset();
+    }
+
+private:
+    std::mutex mutex;
+    int numUsers = 0;
+    std::unique_ptr<THDIpcServer> server;
+};
+
+SharedIpcServerHost& getSharedIpcServerHost()
+{
+    static SharedIpcServerHost host;
+    return host;
+}
+}
+
+std::array<THDAnalyzerPlugin::SharedChannelSlot, THDAnalyzerPlugin::maxDynamicChannels> THDAnalyzerPlugin::sharedChannelSlots {};
+std::atomic<uint64_t> THDAnalyzerPlugin::sharedAnalysisEpoch { 1 };
+std::array<THDAnalyzerPlugin::SharedHopRing, THDAnalyzerPlugin::maxDynamicChannels> THDAnalyzerPlugin::sharedHopRings {};
+AtomicChannelBitset<THDAnalyzerPlugin::maxDynamicChannels> THDAnalyzerPlugin::sharedMasterChannelMask;
+std::atomic<double> THDAnalyzerPlugin::sharedMasterChannelMaskMs { 0.0 };
 std::atomic<uint32_t> THDAnalyzerPlugin::nextInstanceId { 1 };
 
 THDAnalyzerPlugin::THDAnalyzerPlugin()
@@ -15,8 +129,12 @@ THDAnalyzerPlugin::THDAnalyzerPlugin()
                     #if ! JucePlugin_IsMidiEffect
                      #if ! JucePlugin_IsSynth
                       .withInput ("Input", juce::AudioChannelSet::stereo(), true)
+                      #if THD_WITH_CHANNEL_STRIP
+                      .withInput ("Reference", juce::AudioChannelSet::stereo(), false)
+                      #endif
                      #endif
                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                      .withOutput ("Measurement CV", juce::AudioChannelSet::discreteChannels (numMeasurementCvChannels), false)
                     #endif
                       )
     , state (*this, nullptr, "THDAnalyzerParameters", createParameterLayout())
@@ -24,16 +142,28 @@ THDAnalyzerPlugin::THDAnalyzerPlugin()
 {
     cacheParameterPointers();
 
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     state.addParameterListener ("pluginMode", this);
+   #endif
     state.addParameterListener ("channelId", this);
+    state.addParameterListener ("ipcServerEnabled", this);
 
-    channels.clear();
+   #if THD_WITH_CHANNEL_STRIP
+    state.addParameterListener ("channelGroup", this);
+    state.addParameterListener ("analysisLayout", this);
+    state.addParameterListener ("multiband", this);
+   #endif
 
-    for (size_t i = 0; i < channels.size(); ++i)
+   #if THD_WITH_MASTER_BRAIN
+    for (auto& parent : requestedGroupParents)
+        parent.store (GroupTree::noGroup, std::memory_order_relaxed);
+
+    for (int i = 0; i < numAutomatableMuteSoloChannels; ++i)
     {
-        state.addParameterListener (channelMutedParamId (static_cast<int> (i)), this);
-        state.addParameterListener (channelSoloedParamId (static_cast<int> (i)), this);
+        state.addParameterListener (channelMutedParamId (i), this);
+        state.addParameterListener (channelSoloedParamId (i), this);
     }
+   #endif
 
     syncCachedParametersFromState();
 
@@ -54,18 +184,34 @@ THDAnalyzerPlugin::THDAnalyzerPlugin()
     }
 
     ensureChannelExists (getChannelId());
+    updateIpcServerRegistration();
 }
 
 THDAnalyzerPlugin::~THDAnalyzerPlugin()
 {
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     state.removeParameterListener ("pluginMode", this);
+   #endif
     state.removeParameterListener ("channelId", this);
+    state.removeParameterListener ("ipcServerEnabled", this);
+
+   #if THD_WITH_CHANNEL_STRIP
+    state.removeParameterListener ("channelGroup", this);
+    state.removeParameterListener ("analysisLayout", this);
+    state.removeParameterListener ("multiband", this);
+   #endif
 
-    for (size_t i = 0; i < channels.size(); ++i)
+    cancelPendingUpdate();
+    if (holdsIpcServer)
+        getSharedIpcServerHost().release();
+
+   #if THD_WITH_MASTER_BRAIN
+    for (int i = 0; i < numAutomatableMuteSoloChannels; ++i)
     {
-        state.removeParameterListener (channelMutedParamId (static_cast<int> (i)), this);
-        state.removeParameterListener (channelSoloedParamId (static_cast<int> (i)), this);
+        state.removeParameterListener (channelMutedParamId (i), this);
+        state.removeParameterListener (channelSoloedParamId (i), this);
     }
+   #endif
 }
 
 
@@ -73,11 +219,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout THDAnalyzerPlugin::createPar
 {
     std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
 
+    // Single-mode builds only carry the parameters their mode reads.
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     params.push_back (std::make_unique<juce::AudioParameterChoice> (
         juce::ParameterID { "pluginMode", 1 },
         "Plugin Mode",
         juce::StringArray { "Channel", "Master Brain" },
         static_cast<int> (PluginMode::ChannelStrip)));
+   #endif
 
     params.push_back (std::make_unique<juce::AudioParameterInt> (
         juce::ParameterID { "channelId", 1 },
@@ -86,6 +235,18 @@ juce::AudioProcessorValueTreeState::ParameterLayout THDAnalyzerPlugin::createPar
         maxDynamicChannels - 1,
         0));
 
+   #if THD_WITH_CHANNEL_STRIP
+    juce::StringArray groupChoices { "None" };
+    for (int group = 0; group < maxChannelGroups; ++group)
+        groupChoices.add ("Group " + juce::String (group + 1));
+
+    params.push_back (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { "channelGroup", 1 },
+        "Channel Group",
+        groupChoices,
+        0));
+   #endif
+
     params.push_back (std::make_unique<juce::AudioParameterFloat> (
         juce::ParameterID { "thdOutbound", 1 },
         "THD Outbound",
@@ -100,7 +261,42 @@ juce::AudioProcessorValueTreeState::ParameterLayout THDAnalyzerPlugin::createPar
         0.0f,
         juce::AudioParameterFloatAttributes().withAutomatable (false).withMeta (true)));
 
-    for (int i = 0; i < 8; ++i)
+   #if THD_WITH_CHANNEL_STRIP
+    params.push_back (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { "analysisLayout", 1 },
+        "Analysis Layout",
+        juce::StringArray { "Mono Sum", "Per Side", "Reference", "Fast Fit" },
+        static_cast<int> (AnalysisLayout::monoSum)));
+
+    params.push_back (std::make_unique<juce::AudioParameterChoice> (
+        juce::ParameterID { "multiband", 1 },
+        "Multiband",
+        juce::StringArray { "Off", "3 Bands", "4 Bands" },
+        0));
+   #endif
+
+    params.push_back (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { "ipcServerEnabled", 1 },
+        "IPC Server",
+        false,
+        juce::AudioParameterBoolAttributes().withAutomatable (false)));
+
+   #if THD_WITH_CHANNEL_STRIP
+    params.push_back (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { "bounceReport", 1 },
+        "Bounce Report",
+        true,
+        juce::AudioParameterBoolAttributes().withAutomatable (false)));
+
+    params.push_back (std::make_unique<juce::AudioParameterBool> (
+        juce::ParameterID { "residualCorrection", 1 },
+        "Residual Correction",
+        true,
+        juce::AudioParameterBoolAttributes().withAutomatable (false)));
+   #endif
+
+   #if THD_WITH_MASTER_BRAIN
+    for (int i = 0; i < numAutomatableMuteSoloChannels; ++i)
     {
         params.push_back (std::make_unique<juce::AudioParameterBool> (
             juce::ParameterID { channelMutedParamId (i), 1 },
@@ -112,6 +308,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout THDAnalyzerPlugin::createPar
             "Channel " + juce::String (i + 1) + " Soloed",
             false));
     }
+   #endif
 
     return { params.begin(), params.end() };
 }
@@ -128,52 +325,140 @@ juce::String THDAnalyzerPlugin::channelSoloedParamId (int channelIndex)
 
 void THDAnalyzerPlugin::cacheParameterPointers()
 {
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     pluginModeParamValue = state.getRawParameterValue ("pluginMode");
+   #endif
     channelIdParamValue = state.getRawParameterValue ("channelId");
+    channelGroupParamValue = state.getRawParameterValue ("channelGroup");
+    ipcServerEnabledParamValue = state.getRawParameterValue ("ipcServerEnabled");
+    analysisLayoutParamValue = state.getRawParameterValue ("analysisLayout");
+    bounceReportParamValue = state.getRawParameterValue ("bounceReport");
+    residualCorrectionParamValue = state.getRawParameterValue ("residualCorrection");
+    multibandParamValue = state.getRawParameterValue ("multiband");
+
+   #if THD_WITH_MASTER_BRAIN
     for (size_t i = 0; i < channelMutedParamValues.size(); ++i)
     {
         channelMutedParamValues[i] = state.getRawParameterValue (channelMutedParamId (static_cast<int> (i)));
         channelSoloedParamValues[i] = state.getRawParameterValue (channelSoloedParamId (static_cast<int> (i)));
     }
+   #endif
 }
 
-void THDAnalyzerPlugin::parameterChanged (const juce::String&, float)
+void THDAnalyzerPlugin::parameterChanged (const juce::String& parameterID, float newValue)
 {
+   #if THD_WITH_MASTER_BRAIN
+    // Mute/solo IDs carry their channel index, so each change touches exactly one bit.
+    if (parameterID.startsWith ("channelMuted"))
+    {
+        mutedChannels.set (parameterID.getTrailingIntValue(), newValue >= 0.5f);
+        return;
+    }
+
+    if (parameterID.startsWith ("channelSoloed"))
+    {
+        soloedChannels.set (parameterID.getTrailingIntValue(), newValue >= 0.5f);
+        return;
+    }
+   #else
+    juce::ignoreUnused (newValue);
+   #endif
+
+    // Sockets and threads are never created from whichever thread set the parameter.
+    if (parameterID == "ipcServerEnabled")
+    {
+        triggerAsyncUpdate();
+        return;
+    }
+
     syncCachedParametersFromState();
+
+   #if THD_WITH_MASTER_BRAIN
+    // The trend store is a few MB, so it is only allocated once the instance becomes a Master Brain.
+    if (parameterID == "pluginMode")
+        triggerAsyncUpdate();
+   #endif
+}
+
+void THDAnalyzerPlugin::handleAsyncUpdate()
+{
+    updateIpcServerRegistration();
+
+   #if THD_WITH_MASTER_BRAIN
+    if (getPluginMode() == PluginMode::MasterBrain)
+        ensureTrendStore();
+   #endif
+
+   #if THD_WITH_CHANNEL_STRIP
+    if (isNonRealtime())
+        armDenseOfflineAnalysis();
+
+    writeBounceReport();
+
+    if (calibrationCapturePending.load (std::memory_order_acquire))
+        writeCalibrationProfile();
+   #endif
+}
+
+void THDAnalyzerPlugin::updateIpcServerRegistration()
+{
+    const auto shouldHold = ipcServerEnabledParamValue != nullptr && ipcServerEnabledParamValue->load() >= 0.5f;
+    if (shouldHold == holdsIpcServer)
+        return;
+
+    holdsIpcServer = shouldHold;
+
+    if (shouldHold)
+        getSharedIpcServerHost().retain();
+    else
+        getSharedIpcServerHost().release();
 }
 
 void THDAnalyzerPlugin::syncCachedParametersFromState()
 {
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     if (pluginModeParamValue != nullptr)
         cachedPluginMode.store (juce::jlimit (0, 1, static_cast<int> (pluginModeParamValue->load())), std::memory_order_release);
+   #endif
 
     if (channelIdParamValue != nullptr)
         cachedChannelId.store (juce::jlimit (0, maxDynamicChannels - 1, static_cast<int> (channelIdParamValue->load())), std::memory_order_release);
 
-    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-    for (size_t i = 0; i < channels.size(); ++i)
+    // Choice index 0 is "None"; groups start at index 1.
+    if (channelGroupParamValue != nullptr)
+        cachedChannelGroup.store (juce::jlimit (0, maxChannelGroups, static_cast<int> (channelGroupParamValue->load())) - 1, std::memory_order_release);
+
+    if (analysisLayoutParamValue != nullptr)
+        cachedAnalysisLayout.store (juce::jlimit (0, 3, static_cast<int> (analysisLayoutParamValue->load())), std::memory_order_release);
+
+    if (multibandParamValue != nullptr)
+        cachedMultibandBands.store (multibandChoiceToNumBands (juce::jlimit (0, 2, static_cast<int> (multibandParamValue->load()))),
+                                    std::memory_order_release);
+
+   #if THD_WITH_MASTER_BRAIN
+    for (size_t i = 0; i < channelMutedParamValues.size(); ++i)
     {
         if (channelMutedParamValues[i] != nullptr)
-            channels[i].muted = channelMutedParamValues[i]->load() >= 0.5f;
+            mutedChannels.set (static_cast<int> (i), channelMutedParamValues[i]->load() >= 0.5f);
 
         if (channelSoloedParamValues[i] != nullptr)
-            channels[i].soloed = channelSoloedParamValues[i]->load() >= 0.5f;
+            soloedChannels.set (static_cast<int> (i), channelSoloedParamValues[i]->load() >= 0.5f);
     }
+   #endif
 }
 
 void THDAnalyzerPlugin::setPluginMode (PluginMode mode)
 {
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
     const auto normalized = state.getParameterRange ("pluginMode").convertTo0to1 (static_cast<float> (mode));
     if (auto* modeParam = state.getParameter ("pluginMode"))
     {
         modeParam->setValueNotifyingHost (normalized);
         cachedPluginMode.store (static_cast<int> (mode), std::memory_order_release);
     }
-}
-
-PluginMode THDAnalyzerPlugin::getPluginMode() const
-{
-    return static_cast<PluginMode> (cachedPluginMode.load (std::memory_order_acquire));
+   #else
+    juce::ignoreUnused (mode);
+   #endif
 }
 
 void THDAnalyzerPlugin::setChannelId (int id)
@@ -204,6 +489,13 @@ FFTAnalyzer::AnalysisResult THDAnalyzerPlugin::getLastAnalysisResult() const
     return lastAnalysis;
 }
 
+int THDAnalyzerPlugin::getLastBandReadings (MultibandAnalysis::Readings& destination) const
+{
+    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    destination = lastBandReadings;
+    return lastNumBands;
+}
+
 bool THDAnalyzerPlugin::popLatestAnalysisResultForEditor (FFTAnalyzer::AnalysisResult& destination)
 {
     int start1 = 0;
@@ -227,14 +519,10 @@ bool THDAnalyzerPlugin::popLatestAnalysisResultForEditor (FFTAnalyzer::AnalysisR
     return true;
 }
 
-std::vector<ChannelData> THDAnalyzerPlugin::getChannelsSnapshot() const
-{
-    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-    return channels;
-}
-
 void THDAnalyzerPlugin::pushAnalysisSnapshotForEditor (const FFTAnalyzer::AnalysisResult& analysis)
 {
+    editorDataVersion.fetch_add (1, std::memory_order_release);
+
     int start1 = 0;
     int size1 = 0;
     int start2 = 0;
@@ -289,394 +577,522 @@ void THDAnalyzerPlugin::updateOutboundParameters (float smoothedThd, float smoot
     lastOutboundPublishMs = nowMs;
 }
 
-void THDAnalyzerPlugin::publishDisplayOutboundValues (float thd, float thdN)
+void THDAnalyzerPlugin::setMeasurementCvTargets (float thd, float thdN, float level, int rampSamples, int blockOffset)
 {
-    updateOutboundParameters (thd, thdN);
+    MeasurementCvRamp ramp;
+    ramp.blockOffset = juce::jmax (0, blockOffset);
+    ramp.rampSamples = juce::jmax (1, rampSamples);
+    ramp.targets = { thd * 0.01f, thdN * 0.01f, level };
+
+    // Kept in offset order. A full queue gives up its latest ramp; only a block
+    // longer than maxPendingMeasurementCvRamps Fast Fit hops can fill it.
+    if (numPendingMeasurementCvRamps == maxPendingMeasurementCvRamps)
+        --numPendingMeasurementCvRamps;
+
+    auto position = numPendingMeasurementCvRamps;
+    for (; position > 0 && pendingMeasurementCvRamps[static_cast<size_t> (position - 1)].blockOffset > ramp.blockOffset; --position)
+        pendingMeasurementCvRamps[static_cast<size_t> (position)] = pendingMeasurementCvRamps[static_cast<size_t> (position - 1)];
+
+    pendingMeasurementCvRamps[static_cast<size_t> (position)] = ramp;
+    ++numPendingMeasurementCvRamps;
 }
 
-
-void THDAnalyzerPlugin::publishSharedChannelData (const FFTAnalyzer::AnalysisResult& analysis, float peakLevel)
+void THDAnalyzerPlugin::startMeasurementCvRamp (const MeasurementCvRamp& ramp) noexcept
 {
-    if (getPluginMode() != PluginMode::ChannelStrip)
+    if (ramp.targets == measurementCvTarget)
         return;
 
-    const auto channelId = getChannelId();
-    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels))
-        return;
+    // Ramp over one hop so the CV is continuous between measurements.
+    measurementCvTarget = ramp.targets;
+    measurementCvRampSamplesRemaining = ramp.rampSamples;
+    for (size_t i = 0; i < ramp.targets.size(); ++i)
+        measurementCvStep[i] = (ramp.targets[i] - measurementCvCurrent[i]) / static_cast<float> (ramp.rampSamples);
+}
 
-    const juce::SpinLock::ScopedLockType lock (sharedChannelStatesLock);
-    auto& shared = sharedChannelStates[static_cast<size_t> (channelId)];
-    shared.thd = analysis.thd;
-    shared.thdN = analysis.thdN;
-    shared.level = analysis.level;
-    shared.peakLevel = peakLevel;
-    for (size_t i = 0; i < shared.harmonics.size(); ++i)
-        shared.harmonics[i] = i < analysis.harmonics.size() ? analysis.harmonics[i] : 0.0f;
+void THDAnalyzerPlugin::renderMeasurementCv (juce::AudioBuffer<float>& buffer)
+{
+    auto cvBuffer = getBusBuffer (buffer, false, measurementCvBusIndex);
+    const auto numSamples = buffer.getNumSamples();
+    int position = 0;
+    int ramp = 0;
+
+    // Split the block at each queued hop so every ramp starts at its own sample.
+    while (position < numSamples)
+    {
+        for (; ramp < numPendingMeasurementCvRamps && pendingMeasurementCvRamps[static_cast<size_t> (ramp)].blockOffset <= position; ++ramp)
+            startMeasurementCvRamp (pendingMeasurementCvRamps[static_cast<size_t> (ramp)]);
+
+        const auto segmentEnd = ramp < numPendingMeasurementCvRamps
+            ? juce::jmin (numSamples, pendingMeasurementCvRamps[static_cast<size_t> (ramp)].blockOffset)
+            : numSamples;
+
+        renderMeasurementCvSegment (cvBuffer, position, segmentEnd - position);
+        position = segmentEnd;
+    }
 
-    ++shared.sequence;
-    shared.lastPublishMs = juce::Time::getMillisecondCounterHiRes();
-    shared.publisherInstanceId = instanceId;
-    shared.active = true;
+    // Hops that ended on or after the last sample start with the next block.
+    for (int remaining = ramp; remaining < numPendingMeasurementCvRamps; ++remaining)
+    {
+        auto& next = pendingMeasurementCvRamps[static_cast<size_t> (remaining - ramp)];
+        next = pendingMeasurementCvRamps[static_cast<size_t> (remaining)];
+        next.blockOffset = juce::jmax (0, next.blockOffset - numSamples);
+    }
+
+    numPendingMeasurementCvRamps -= ramp;
 }
 
-void THDAnalyzerPlugin::ingestSharedChannelData()
+void THDAnalyzerPlugin::renderMeasurementCvSegment (juce::AudioBuffer<float>& cvBuffer, int startSample, int numSamples) noexcept
 {
-    if (getPluginMode() != PluginMode::MasterBrain)
-        return;
-
-    const juce::SpinLock::ScopedLockType sharedLock (sharedChannelStatesLock);
+    const auto rampSamples = juce::jmin (numSamples, measurementCvRampSamplesRemaining);
+    const auto rampFinished = rampSamples == measurementCvRampSamplesRemaining;
 
-    for (int channelId = 0; channelId < maxDynamicChannels; ++channelId)
+    for (int cv = 0; cv < numMeasurementCvChannels; ++cv)
     {
-        auto& shared = sharedChannelStates[static_cast<size_t> (channelId)];
-        if (! shared.active || shared.sequence == 0)
-            continue;
+        const auto index = static_cast<size_t> (cv);
+        auto* destination = cv < cvBuffer.getNumChannels() ? cvBuffer.getWritePointer (cv, startSample) : nullptr;
+        auto value = measurementCvCurrent[index];
 
-        const auto ageMs = juce::Time::getMillisecondCounterHiRes() - shared.lastPublishMs;
-        if (ageMs > (channelStaleTimeoutSeconds * 1000.0))
+        if (destination != nullptr)
         {
-            shared.active = false;
-            continue;
+            for (int i = 0; i < rampSamples; ++i)
+            {
+                value += measurementCvStep[index];
+                destination[i] = value;
+            }
+        }
+        else
+        {
+            value += measurementCvStep[index] * static_cast<float> (rampSamples);
         }
 
-        if (shared.publisherInstanceId == instanceId)
-            continue;
+        if (rampFinished)
+            value = measurementCvTarget[index];
 
-        if (shared.sequence == consumedSharedSequences[static_cast<size_t> (channelId)])
-            continue;
+        if (destination != nullptr && numSamples > rampSamples)
+            juce::FloatVectorOperations::fill (destination + rampSamples, value, numSamples - rampSamples);
 
-        consumedSharedSequences[static_cast<size_t> (channelId)] = shared.sequence;
+        measurementCvCurrent[index] = value;
+    }
 
-        ensureChannelExists (channelId);
+    measurementCvRampSamplesRemaining -= rampSamples;
+}
 
-        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-        auto it = std::find_if (channels.begin(), channels.end(), [channelId] (const ChannelData& c)
-        {
-            return c.channelId == channelId;
-        });
+void THDAnalyzerPlugin::publishDisplayOutboundValues (float thd, float thdN)
+{
+    updateOutboundParameters (thd, thdN);
+}
 
-        if (it == channels.end())
-            continue;
 
-        auto& channel = *it;
-        channel.thd = shared.thd;
-        channel.thdN = shared.thdN;
-        channel.level = shared.level;
-        channel.peakLevel = shared.peakLevel;
-        channel.active = true;
-        channel.lastUpdateSeconds = internalClockSeconds;
+bool THDAnalyzerPlugin::writeSharedChannelSlot (int channelId, const SharedChannelState& newState) noexcept
+{
+    auto& slot = sharedChannelSlots[static_cast<size_t> (channelId)];
+    auto claim = slot.writeClaim.load (std::memory_order_relaxed);
 
-        for (size_t i = 0; i < channel.harmonics.size() && i < shared.harmonics.size(); ++i)
-            channel.harmonics[i] = shared.harmonics[i];
-    }
+    // Two strips configured with the same channel ID must not interleave writes; the loser skips this block.
+    if ((claim & 1u) != 0 || ! slot.writeClaim.compare_exchange_strong (claim, claim + 1, std::memory_order_acquire))
+        return false;
+
+    const auto writeIndex = slot.numWrites.load (std::memory_order_relaxed);
+    auto& version = slot.versions[static_cast<size_t> (writeIndex % sharedSlotVersions)];
+    const auto sequence = version.writeSequence.load (std::memory_order_relaxed);
+
+    version.writeSequence.store (sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    version.state = newState;
+    version.state.sequence = writeIndex + 1;
+    version.state.epoch = sharedAnalysisEpoch.load (std::memory_order_acquire);
+
+    version.writeSequence.store (sequence + 2, std::memory_order_release);
+    slot.numWrites.store (writeIndex + 1, std::memory_order_release);
+    slot.writeClaim.store (claim + 2, std::memory_order_release);
+
+    writeSharedChannelMeter (channelId, newState.peakLevel, newState.lastPublishMs);
+    return true;
 }
 
-void THDAnalyzerPlugin::prepareToPlay (double sampleRate, int)
+void THDAnalyzerPlugin::writeSharedChannelMeter (int channelId, float peakLevel, double publishMs) noexcept
 {
-    snapshotIntervalSamples = juce::jmax (1, static_cast<int> (sampleRate / static_cast<double> (targetSnapshotRateHz)));
-    editorDataReady.store (false, std::memory_order_release);
-    reset();
-    editorDataReady.store (true, std::memory_order_release);
+    auto& slot = sharedChannelSlots[static_cast<size_t> (channelId)];
+    slot.meterPeakLevel.store (peakLevel, std::memory_order_relaxed);
+    slot.meterPublishMs.store (publishMs, std::memory_order_release);
 }
 
-void THDAnalyzerPlugin::reset()
+void THDAnalyzerPlugin::applySharedChannelMeter (const SharedChannelSlot& slot, SharedChannelState& state) noexcept
 {
-    std::fill (analysisFifo.begin(), analysisFifo.end(), 0.0f);
-    std::fill (orderedSamplesScratch.begin(), orderedSamplesScratch.end(), 0.0f);
-    monoBufferScratch.clear();
+    const auto publishMs = slot.meterPublishMs.load (std::memory_order_acquire);
+    if (publishMs <= state.lastPublishMs)
+        return;
+
+    state.peakLevel = slot.meterPeakLevel.load (std::memory_order_relaxed);
+    state.lastPublishMs = publishMs;
+}
 
+bool THDAnalyzerPlugin::readSharedChannelVersion (const SharedChannelVersion& version, SharedChannelState& destination) noexcept
+{
+    for (int attempt = 0; attempt < 4; ++attempt)
     {
-        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-        lastAnalysis = FFTAnalyzer::AnalysisResult {};
-        realtimeAnalysisCache = FFTAnalyzer::AnalysisResult {};
-        smoothedAnalysisCache = FFTAnalyzer::AnalysisResult {};
-    }
-    fifoWritePosition = 0;
-    fifoFilled = false;
-    analysisSamplesSinceLastRun = 0;
-    samplesSinceLastSnapshotPush = 0;
-    internalClockSeconds = 0.0;
-    consumedSharedSequences.fill (0);
-    analysisSnapshotFifo.reset();
-    lastPublishedThd = -1.0f;
-    lastPublishedThdN = -1.0f;
-    lastOutboundPublishMs = 0.0;
+        const auto before = version.writeSequence.load (std::memory_order_acquire);
+        if ((before & 1u) != 0)
+            continue;
 
+        destination = version.state;
+        std::atomic_thread_fence (std::memory_order_acquire);
 
-    {
-        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-        for (auto& channel : channels)
-        {
-            channel.thd = 0.0;
-            channel.thdN = 0.0;
-            channel.level = 0.0;
-            channel.peakLevel = 0.0;
-            channel.active = false;
-            channel.lastUpdateSeconds = 0.0;
-            std::fill (channel.harmonics.begin(), channel.harmonics.end(), 0.0);
-        }
+        if (version.writeSequence.load (std::memory_order_relaxed) == before)
+            return true;
     }
-}
 
-void THDAnalyzerPlugin::releaseResources()
-{
-    editorDataReady.store (false, std::memory_order_release);
+    return false;
 }
 
-bool THDAnalyzerPlugin::isBusesLayoutSupported (const BusesLayout& layouts) const
+bool THDAnalyzerPlugin::readSharedChannelSlot (int channelId, SharedChannelState& destination) noexcept
 {
-   #if JucePlugin_IsMidiEffect
-    juce::ignoreUnused (layouts);
-    return true;
-   #else
-    if (layouts.inputBuses.size() != 1 || layouts.outputBuses.size() != 1)
+    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels))
         return false;
 
-    const auto inputSet = layouts.getMainInputChannelSet();
-    const auto outputSet = layouts.getMainOutputChannelSet();
+    const auto& slot = sharedChannelSlots[static_cast<size_t> (channelId)];
+    const auto numWrites = slot.numWrites.load (std::memory_order_acquire);
 
-    if (inputSet.isDisabled() || outputSet.isDisabled())
+    if (numWrites == 0)
+    {
+        destination = SharedChannelState {};
+        return true;
+    }
+
+    if (! readSharedChannelVersion (slot.versions[static_cast<size_t> ((numWrites - 1) % sharedSlotVersions)], destination))
         return false;
 
-    return inputSet == juce::AudioChannelSet::stereo()
-        && outputSet == juce::AudioChannelSet::stereo();
-   #endif
+    applySharedChannelMeter (slot, destination);
+    return true;
 }
 
-void THDAnalyzerPlugin::pushSamplesToAnalysisFifo (const std::vector<float>& monoBuffer)
+bool THDAnalyzerPlugin::readSharedChannelSlotAtEpoch (int channelId, uint64_t epoch, SharedChannelState& destination) noexcept
 {
-    if (monoBuffer.empty())
-        return;
-
-    size_t srcOffset = 0;
-    size_t samplesRemaining = monoBuffer.size();
+    const auto& slot = sharedChannelSlots[static_cast<size_t> (channelId)];
+    const auto numWrites = slot.numWrites.load (std::memory_order_acquire);
+    const auto oldest = numWrites > sharedSlotVersions ? numWrites - sharedSlotVersions : uint64_t { 0 };
 
-    while (samplesRemaining > 0)
+    // Newest first: the first consistent version at or before the epoch is the one to use.
+    for (auto writeIndex = numWrites; writeIndex > oldest; --writeIndex)
     {
-        const auto writePos = static_cast<size_t> (fifoWritePosition);
-        const auto contiguousSpace = static_cast<size_t> (FFTAnalyzer::fftSize) - writePos;
-        const auto chunkSize = std::min (samplesRemaining, contiguousSpace);
-
-        std::copy_n (monoBuffer.data() + srcOffset,
-                     chunkSize,
-                     analysisFifo.begin() + static_cast<int> (writePos));
+        SharedChannelState candidate;
+        if (! readSharedChannelVersion (slot.versions[static_cast<size_t> ((writeIndex - 1) % sharedSlotVersions)], candidate))
+            continue;
 
-        srcOffset += chunkSize;
-        samplesRemaining -= chunkSize;
-        fifoWritePosition = static_cast<int> ((writePos + chunkSize) % static_cast<size_t> (FFTAnalyzer::fftSize));
+        // Overwritten by a newer publish while scanning; anything older is gone too.
+        if (candidate.sequence != writeIndex)
+            return false;
 
-        if (fifoWritePosition == 0)
-            fifoFilled = true;
+        if (candidate.epoch <= epoch)
+        {
+            destination = candidate;
+            applySharedChannelMeter (slot, destination);
+            return true;
+        }
     }
+
+    return false;
 }
 
-void THDAnalyzerPlugin::ensureScratchBuffers (int numSamples)
+bool THDAnalyzerPlugin::isSharedChannelStale (const SharedChannelState& shared, double nowMs) noexcept
 {
-    if (numSamples <= 0)
-    {
-        monoBufferScratch.clear();
-        return;
-    }
+    return ! shared.active || shared.sequence == 0 || isPublishStale (shared.lastPublishMs, nowMs);
+}
 
-    if (monoBufferScratch.size() != static_cast<size_t> (numSamples))
-        monoBufferScratch.assign (static_cast<size_t> (numSamples), 0.0f);
-    else
-        std::fill (monoBufferScratch.begin(), monoBufferScratch.end(), 0.0f);
+bool THDAnalyzerPlugin::isPublishStale (double lastPublishMs, double nowMs) noexcept
+{
+    return (nowMs - lastPublishMs) > (channelStaleTimeoutSeconds * 1000.0);
 }
 
-void THDAnalyzerPlugin::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+void THDAnalyzerPlugin::pushSharedHop (int channelId, SharedHopRecord record) noexcept
 {
-    juce::ScopedNoDenormals noDenormals;
+    auto& ring = sharedHopRings[static_cast<size_t> (channelId)];
+    const auto hopIndex = ring.numHopsWritten.load (std::memory_order_relaxed);
+    auto& entry = ring.entries[static_cast<size_t> (hopIndex % sharedHopHistorySize)];
+    auto sequence = entry.writeSequence.load (std::memory_order_relaxed);
 
-    const auto totalNumInputChannels = getTotalNumInputChannels();
-    const auto totalNumOutputChannels = getTotalNumOutputChannels();
+    // Same policy as the channel slot: a strip that collides on a channel ID drops this hop.
+    if ((sequence & 1u) != 0 || ! entry.writeSequence.compare_exchange_strong (sequence, sequence + 1, std::memory_order_acquire))
+        return;
 
-    for (auto channel = totalNumInputChannels; channel < totalNumOutputChannels; ++channel)
-        buffer.clear (channel, 0, buffer.getNumSamples());
+    std::atomic_thread_fence (std::memory_order_release);
 
-    const auto numSamples = buffer.getNumSamples();
-    ensureScratchBuffers (numSamples);
+    record.hopIndex = hopIndex;
+    entry.record = record;
 
-    if (const auto sr = getSampleRate(); sr > 0.0)
-        internalClockSeconds += static_cast<double> (numSamples) / sr;
+    entry.writeSequence.store (sequence + 2, std::memory_order_release);
+    ring.numHopsWritten.store (hopIndex + 1, std::memory_order_release);
+}
 
-    float peakLevel = 0.0f;
+bool THDAnalyzerPlugin::readSharedHopNearest (int channelId, int64_t timelineSample, int64_t toleranceSamples,
+                                              SharedHopRecord& destination) noexcept
+{
+    if (! juce::isPositiveAndBelow (channelId, maxDynamicChannels) || timelineSample == noTimelinePosition)
+        return false;
+
+    const auto& ring = sharedHopRings[static_cast<size_t> (channelId)];
+    const auto numWritten = ring.numHopsWritten.load (std::memory_order_acquire);
+    const auto firstHop = numWritten > sharedHopHistorySize ? numWritten - sharedHopHistorySize : uint64_t { 0 };
+
+    auto bestDistance = toleranceSamples;
+    auto found = false;
 
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    for (auto hopIndex = firstHop; hopIndex < numWritten; ++hopIndex)
     {
-        const auto* channelData = buffer.getReadPointer (channel);
+        const auto& entry = ring.entries[static_cast<size_t> (hopIndex % sharedHopHistorySize)];
+        SharedHopRecord record;
+        auto consistent = false;
 
-        for (int i = 0; i < numSamples; ++i)
+        for (int attempt = 0; attempt < 4 && ! consistent; ++attempt)
         {
-            monoBufferScratch[static_cast<size_t> (i)] += channelData[i];
-            peakLevel = juce::jmax (peakLevel, std::abs (channelData[i]));
+            const auto before = entry.writeSequence.load (std::memory_order_acquire);
+            if ((before & 1u) != 0)
+                continue;
+
+            record = entry.record;
+            std::atomic_thread_fence (std::memory_order_acquire);
+            consistent = entry.writeSequence.load (std::memory_order_relaxed) == before;
         }
-    }
 
-    if (totalNumInputChannels > 0)
-    {
-        const auto invChannels = 1.0f / static_cast<float> (totalNumInputChannels);
-        for (auto& sample : monoBufferScratch)
-            sample *= invChannels;
+        // A newer hop may have overwritten this entry while we scanned; skip it rather than mislabel it.
+        if (! consistent || record.hopIndex != hopIndex || record.timelineSample == noTimelinePosition)
+            continue;
+
+        const auto distance = record.timelineSample > timelineSample ? record.timelineSample - timelineSample
+                                                                     : timelineSample - record.timelineSample;
+        if (distance <= bestDistance)
+        {
+            bestDistance = distance;
+            destination = record;
+            found = true;
+        }
     }
 
-    pushSamplesToAnalysisFifo (monoBufferScratch);
+    return found;
+}
+
+THDAnalyzerPlugin::TimelineJoin THDAnalyzerPlugin::joinChannelsAtTimeline (int64_t timelineSample, int64_t toleranceSamples,
+                                                                          const std::array<uint64_t, channelMaskWords>& include) noexcept
+{
+    TimelineJoin join;
+    join.timelineSample = timelineSample;
 
-    const auto pluginMode = getPluginMode();
-    const bool shouldAnalyzeAudio = pluginMode == PluginMode::ChannelStrip;
-    if (shouldAnalyzeAudio)
-        analysisSamplesSinceLastRun += numSamples;
+    float sumSquares = 0.0f;
+    int numValid = 0;
 
-    if (shouldAnalyzeAudio && fifoFilled && analysisSamplesSinceLastRun >= analysisHopSize)
+    for (int channelId = 0; channelId < maxDynamicChannels; ++channelId)
     {
-        analysisSamplesSinceLastRun = 0;
+        if ((include[static_cast<size_t> (channelId / 64)] & (uint64_t { 1 } << (channelId % 64))) == 0)
+            continue;
 
-        for (int i = 0; i < FFTAnalyzer::fftSize; ++i)
-        {
-            const int index = (fifoWritePosition + i) % FFTAnalyzer::fftSize;
-            orderedSamplesScratch[static_cast<size_t> (i)] = analysisFifo[static_cast<size_t> (index)];
-        }
+        auto& hop = join.hops[static_cast<size_t> (channelId)];
+        if (! readSharedHopNearest (channelId, timelineSample, toleranceSamples, hop))
+            continue;
 
-        const auto analysis = fftAnalyzer.analyze (orderedSamplesScratch.data(), FFTAnalyzer::fftSize, static_cast<float> (getSampleRate()));
+        join.channels[static_cast<size_t> (channelId / 64)] |= uint64_t { 1 } << (channelId % 64);
+        ++join.numChannels;
 
-        // Keep internal analysis continuous, but freeze THD/THD+N when fundamental confidence is too low.
-        auto displayAnalysis = realtimeAnalysisCache;
-        if (analysis.fundamentalValid)
-            displayAnalysis = analysis;
+        if (! hop.fundamentalValid)
+            continue;
 
-        displayAnalysis.level = analysis.level;
-        displayAnalysis.fundamentalFrequency = analysis.fundamentalFrequency;
-        displayAnalysis.noiseFloor = analysis.noiseFloor;
-        displayAnalysis.analysisConfidence = analysis.analysisConfidence;
-        displayAnalysis.fundamentalValid = analysis.fundamentalValid;
+        sumSquares += hop.thd * hop.thd;
+        join.peakThd = juce::jmax (join.peakThd, hop.thd);
+        ++numValid;
+    }
 
-        if (! smoothedAnalysisCache.fundamentalValid)
-        {
-            smoothedAnalysisCache = displayAnalysis;
-        }
-        else
-        {
-            const auto alpha = analysisSmoothingCoeff;
-            smoothedAnalysisCache.thd += alpha * (displayAnalysis.thd - smoothedAnalysisCache.thd);
-            smoothedAnalysisCache.thdN += alpha * (displayAnalysis.thdN - smoothedAnalysisCache.thdN);
-            smoothedAnalysisCache.level += alpha * (displayAnalysis.level - smoothedAnalysisCache.level);
-            smoothedAnalysisCache.noiseFloor += alpha * (displayAnalysis.noiseFloor - smoothedAnalysisCache.noiseFloor);
-            smoothedAnalysisCache.analysisConfidence += alpha * (displayAnalysis.analysisConfidence - smoothedAnalysisCache.analysisConfidence);
-            smoothedAnalysisCache.fundamentalFrequency += alpha * (displayAnalysis.fundamentalFrequency - smoothedAnalysisCache.fundamentalFrequency);
-            for (size_t i = 0; i < smoothedAnalysisCache.harmonics.size(); ++i)
-                smoothedAnalysisCache.harmonics[i] += alpha * (displayAnalysis.harmonics[i] - smoothedAnalysisCache.harmonics[i]);
-
-            smoothedAnalysisCache.fundamentalValid = displayAnalysis.fundamentalValid;
-        }
+    if (numValid > 0)
+        join.rssThd = std::sqrt (sumSquares / static_cast<float> (numValid));
 
-        realtimeAnalysisCache = smoothedAnalysisCache;
-        samplesSinceLastSnapshotPush += analysisHopSize;
+    return join;
+}
 
-        // Rate-limit audio->GUI snapshots to keep meter updates legible and reduce visual jitter.
-        if (samplesSinceLastSnapshotPush >= snapshotIntervalSamples)
-        {
-            pushAnalysisSnapshotForEditor (smoothedAnalysisCache);
-            samplesSinceLastSnapshotPush = 0;
-        }
+std::array<uint64_t, THDAnalyzerPlugin::channelMaskWords> THDAnalyzerPlugin::getSharedMasterChannelMask (double nowMs) noexcept
+{
+    std::array<uint64_t, channelMaskWords> mask;
 
-        {
-            const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-            lastAnalysis = smoothedAnalysisCache;
-        }
+    // Without a running Master Brain nothing is muted, so every channel counts.
+    const auto publishMs = sharedMasterChannelMaskMs.load (std::memory_order_acquire);
+    if (publishMs <= 0.0 || isPublishStale (publishMs, nowMs))
+    {
+        mask.fill (~uint64_t { 0 });
+        return mask;
     }
 
-    if (pluginMode == PluginMode::ChannelStrip)
+    for (int word = 0; word < channelMaskWords; ++word)
+        mask[static_cast<size_t> (word)] = sharedMasterChannelMask.loadWord (word);
+
+    return mask;
+}
+
+void THDAnalyzerPlugin::prepareToPlay (double sampleRate, int)
+{
+   #if THD_WITH_CHANNEL_STRIP
+    if (isNonRealtime())
+        armDenseOfflineAnalysis();
+
+    snapshotIntervalSamples = juce::jmax (1, static_cast<int> (sampleRate / static_cast<double> (targetSnapshotRateHz)));
+    ltasPublishIntervalSamples = juce::jmax (1, static_cast<int> (sampleRate * ltasPublishIntervalSeconds));
+    longTermSpectrum.prepare (FFTAnalyzer::fftSize, sampleRate, LongTermSpectrum::defaultAveragingSeconds, analysisHopSize);
+    multibandAnalysis.prepare (FFTAnalyzer::fftSize, static_cast<float> (sampleRate));
+
+    // The sidechain can only be connected or removed while the strip is not playing.
+    const auto hasReference = getChannelCountOfBus (true, referenceBusIndex) > 0;
+    if (hasReference && referenceAnalysis == nullptr)
+        referenceAnalysis = std::make_unique<ReferenceAnalysis<FFTAnalyzer::fftOrder>>();
+    else if (! hasReference)
+        referenceAnalysis.reset();
+
+    referenceConnected.store (hasReference, std::memory_order_release);
+
+    // A capture in progress was for the previous rate; the profile follows the new one.
+    calibrationCaptureArmed.store (false, std::memory_order_release);
+    loadCalibrationProfile (sampleRate);
+   #else
+    juce::ignoreUnused (sampleRate);
+   #endif
+   #if THD_WITH_MASTER_BRAIN
+    if (getPluginMode() == PluginMode::MasterBrain)
+        ensureTrendStore();
+   #endif
+    editorDataReady.store (false, std::memory_order_release);
+    reset();
+    editorDataReady.store (true, std::memory_order_release);
+}
+
+void THDAnalyzerPlugin::reset()
+{
+   #if THD_WITH_CHANNEL_STRIP
+    resetChannelStripState();
+   #endif
+   #if THD_WITH_MASTER_BRAIN
+    resetMasterBrainState();
+   #endif
+
     {
-        publishSharedChannelData (realtimeAnalysisCache, peakLevel);
+        const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+        lastAnalysis = FFTAnalyzer::AnalysisResult {};
     }
-    else if (pluginMode == PluginMode::MasterBrain)
+
+    analysisSnapshotFifo.reset();
+    lastPublishedThd = -1.0f;
+    lastPublishedThdN = -1.0f;
+    lastOutboundPublishMs = 0.0;
+    measurementCvCurrent.fill (0.0f);
+    measurementCvTarget.fill (0.0f);
+    measurementCvStep.fill (0.0f);
+    measurementCvRampSamplesRemaining = 0;
+    numPendingMeasurementCvRamps = 0;
+}
+
+void THDAnalyzerPlugin::releaseResources()
+{
+    editorDataReady.store (false, std::memory_order_release);
+
+   #if THD_WITH_CHANNEL_STRIP
+    // Hosts that leave the offline flag set between renders still get a report per render.
+    // processBlock is not running here, so the report is handed over directly.
+    if (isNonRealtime())
     {
-        ingestSharedChannelData();
-        pruneStaleChannels();
-        midiMessages.clear();
+        writeBounceReport();
+        requestBounceReport();
+        handOverBounceReport();
+        writeBounceReport();
     }
+   #endif
 }
 
-bool THDAnalyzerPlugin::hasEditor() const
+bool THDAnalyzerPlugin::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
+   #if JucePlugin_IsMidiEffect
+    juce::ignoreUnused (layouts);
     return true;
-}
+   #else
+    const auto maxInputBuses = hasChannelStripMode ? 2 : 1;
+    if (layouts.inputBuses.isEmpty() || layouts.inputBuses.size() > maxInputBuses
+        || layouts.outputBuses.isEmpty() || layouts.outputBuses.size() > 2)
+        return false;
 
+    const auto inputSet = layouts.getMainInputChannelSet();
+    const auto outputSet = layouts.getMainOutputChannelSet();
 
-void THDAnalyzerPlugin::removeChannel (int id)
-{
-    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-    channels.erase (std::remove_if (channels.begin(), channels.end(), [id] (const ChannelData& c)
+    if (inputSet.isDisabled() || outputSet.isDisabled())
+        return false;
+
+    if (layouts.inputBuses.size() > referenceBusIndex)
     {
-        return c.channelId == id;
-    }), channels.end());
-}
+        const auto referenceSet = layouts.getChannelSet (true, referenceBusIndex);
+        if (referenceSet.size() > 2)
+            return false;
+    }
 
-juce::Colour THDAnalyzerPlugin::colorForChannelId (int channelId)
-{
-    static const std::array<juce::Colour, 10> palette {
-        juce::Colour::fromString ("fff97316"),
-        juce::Colour::fromString ("ff60a5fa"),
-        juce::Colour::fromString ("ffa78bfa"),
-        juce::Colour::fromString ("ff34d399"),
-        juce::Colour::fromString ("ff2dd4bf"),
-        juce::Colour::fromString ("fffbbf24"),
-        juce::Colour::fromString ("fff472b6"),
-        juce::Colour::fromString ("ff94a3b8"),
-        juce::Colour::fromString ("ff38bdf8"),
-        juce::Colour::fromString ("fffb923c")
-    };
+    if (layouts.outputBuses.size() > measurementCvBusIndex)
+    {
+        const auto cvSet = layouts.getChannelSet (false, measurementCvBusIndex);
+        if (! cvSet.isDisabled() && cvSet.size() != numMeasurementCvChannels)
+            return false;
+    }
 
-    const auto index = static_cast<size_t> (juce::jmax (0, channelId)) % palette.size();
-    return palette[index];
+    return inputSet == juce::AudioChannelSet::stereo()
+        && outputSet == juce::AudioChannelSet::stereo();
+   #endif
 }
 
-juce::String THDAnalyzerPlugin::defaultChannelNameForId (int channelId)
+void THDAnalyzerPlugin::updateBlockTimelinePosition()
 {
-    return "CH " + juce::String (channelId + 1);
+    blockTimelineSample = noTimelinePosition;
+
+    if (auto* playHead = getPlayHead())
+        if (const auto position = playHead->getPosition())
+            if (const auto timeInSamples = position->getTimeInSamples())
+                blockTimelineSample = *timeInSamples;
 }
 
-void THDAnalyzerPlugin::ensureChannelExists (int channelId)
+void THDAnalyzerPlugin::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    if (channelId < 0 || channelId >= maxDynamicChannels)
-        return;
+    juce::ScopedNoDenormals noDenormals;
 
-    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
+    const auto totalNumInputChannels = getTotalNumInputChannels();
+    const auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    const auto it = std::find_if (channels.begin(), channels.end(), [channelId] (const ChannelData& c)
-    {
-        return c.channelId == channelId;
-    });
+    for (auto channel = totalNumInputChannels; channel < totalNumOutputChannels; ++channel)
+        buffer.clear (channel, 0, buffer.getNumSamples());
 
-    if (it != channels.end())
-        return;
+    updateBlockTimelinePosition();
 
-    ChannelData channel (channelId, defaultChannelNameForId (channelId), colorForChannelId (channelId));
-    channel.active = true;
-    channel.lastUpdateSeconds = internalClockSeconds;
-    channels.push_back (std::move (channel));
+    // Dedicated targets compile a single mode, so only the combined build branches here.
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
+    if (getPluginMode() == PluginMode::MasterBrain)
+        processMasterBrainBlock (midiMessages, buffer.getNumSamples());
+    else
+        processChannelStripBlock (buffer);
+   #elif THD_WITH_MASTER_BRAIN
+    processMasterBrainBlock (midiMessages, buffer.getNumSamples());
+   #else
+    juce::ignoreUnused (midiMessages);
+    processChannelStripBlock (buffer);
+   #endif
 
-    std::sort (channels.begin(), channels.end(), [] (const ChannelData& a, const ChannelData& b)
-    {
-        return a.channelId < b.channelId;
-    });
+    renderMeasurementCv (buffer);
 }
 
-void THDAnalyzerPlugin::pruneStaleChannels()
+bool THDAnalyzerPlugin::hasEditor() const
 {
-    const juce::SpinLock::ScopedLockType lock (analysisDataLock);
-    channels.erase (std::remove_if (channels.begin(), channels.end(), [this] (const ChannelData& c)
-    {
-        if (! c.active)
-            return false;
-
-        return (internalClockSeconds - c.lastUpdateSeconds) > channelStaleTimeoutSeconds;
-    }), channels.end());
+   #if THD_HEADLESS
+    return false;
+   #else
+    return true;
+   #endif
 }
 
+
 juce::AudioProcessorEditor* THDAnalyzerPlugin::createEditor()
 {
+   #if THD_HEADLESS
+    return nullptr;
+   #else
     return new THDAnalyzerPluginEditor (*this);
+   #endif
 }
 
 const juce::AudioProcessorValueTreeState& THDAnalyzerPlugin::getValueTreeState() const noexcept
@@ -766,23 +1182,57 @@ bool THDAnalyzerPlugin::restoreLegacyStateIfNeeded (const juce::XmlElement& xml)
     forEachXmlChildElementWithTagName (xml, channelXml, "channel")
     {
         const int channelIndex = channelXml->getIntAttribute ("id", -1);
-        if (! juce::isPositiveAndBelow (channelIndex, static_cast<int> (channels.size())))
+        if (! juce::isPositiveAndBelow (channelIndex, maxDynamicChannels))
             continue;
 
-        if (auto* mutedParam = state.getParameter (channelMutedParamId (channelIndex)))
-            mutedParam->setValueNotifyingHost (channelXml->getBoolAttribute ("muted", false) ? 1.0f : 0.0f);
-
-        if (auto* soloedParam = state.getParameter (channelSoloedParamId (channelIndex)))
-            soloedParam->setValueNotifyingHost (channelXml->getBoolAttribute ("soloed", false) ? 1.0f : 0.0f);
+        setChannelMuted (channelIndex, channelXml->getBoolAttribute ("muted", false));
+        setChannelSoloed (channelIndex, channelXml->getBoolAttribute ("soloed", false));
     }
 
     syncCachedParametersFromState();
     return true;
 }
 
+#if THD_WITH_CLAP
+bool THDAnalyzerPlugin::supportsExtension (const char* name)
+{
+    // Only Channel Strip analysis hops are spread over the host's thread pool.
+    return hasChannelStripMode && std::strcmp (name, CLAP_EXT_THREAD_POOL) == 0;
+}
+
+const void* THDAnalyzerPlugin::getExtension (const char* name)
+{
+    return supportsExtension (name) ? ClapThreadPoolExecutor::getPluginExtension() : nullptr;
+}
+
+void THDAnalyzerPlugin::attachClapHost (const clap_host* host, const clap_plugin* plugin)
+{
+   #if THD_WITH_CHANNEL_STRIP
+    analysisJobExecutor.store (&serialAnalysisJobExecutor, std::memory_order_release);
+    clapThreadPoolExecutor.attach (host, plugin);
+
+    if (clapThreadPoolExecutor.hasHostThreadPool())
+        analysisJobExecutor.store (&clapThreadPoolExecutor, std::memory_order_release);
+   #else
+    juce::ignoreUnused (host, plugin);
+   #endif
+}
+#endif
+
 void THDAnalyzerPlugin::getStateInformation (juce::MemoryBlock& destData)
 {
     auto stateCopy = state.copyState();
+
+   #if THD_WITH_MASTER_BRAIN
+    stateCopy.setProperty ("mutedChannelMask", channelMaskToString (mutedChannels), nullptr);
+    stateCopy.setProperty ("soloedChannelMask", channelMaskToString (soloedChannels), nullptr);
+
+    juce::StringArray groupParents;
+    for (int group = 0; group < maxChannelGroups; ++group)
+        groupParents.add (juce::String (getChannelGroupParent (group)));
+
+    stateCopy.setProperty ("groupParents", groupParents.joinIntoString (","), nullptr);
+   #endif
     std::unique_ptr<juce::XmlElement> xml (stateCopy.createXml());
     copyXmlToBinary (*xml, destData);
 }
@@ -799,8 +1249,24 @@ void THDAnalyzerPlugin::setStateInformation (const void* data, int sizeInBytes)
 
     const auto restoredState = juce::ValueTree::fromXml (*xml);
     if (restoredState.isValid())
+    {
         state.replaceState (restoredState);
 
+       #if THD_WITH_MASTER_BRAIN
+        // Masks cover every channel; the automatable subset is re-applied from its parameters below.
+        channelMaskFromString (mutedChannels, restoredState.getProperty ("mutedChannelMask").toString());
+        channelMaskFromString (soloedChannels, restoredState.getProperty ("soloedChannelMask").toString());
+
+        // Detach every group first so restored parents never form a cycle with stale ones.
+        const auto groupParents = juce::StringArray::fromTokens (restoredState.getProperty ("groupParents").toString(), ",", {});
+        for (int group = 0; group < maxChannelGroups; ++group)
+            setChannelGroupParent (group, GroupTree::noGroup);
+
+        for (int group = 0; group < maxChannelGroups && group < groupParents.size(); ++group)
+            setChannelGroupParent (group, groupParents[group].getIntValue());
+       #endif
+    }
+
     syncCachedParametersFromState();
 }
 
@@ -6,6 +6,11 @@
    Two plugins:
    1. THD Channel Analyzer - for individual channel strips
    2. THD Master Brain - for master bus analysis
+
+   THD_WITH_CHANNEL_STRIP / THD_WITH_MASTER_BRAIN select which modes a build
+   contains. The dedicated plugin targets compile one mode each, so a strip
+   carries no aggregation tables and the Master Brain no analysis FIFOs; the
+   combined target (and the headless daemon) keep both and switch at runtime.
    ============================================================================== */
 
 #pragma once
@@ -18,6 +23,33 @@
 #include <cmath>
 #include <atomic>
 #include <cstdint>
+#include <limits>
+#include "AnalysisJobExecutor.h"
+#include "CalibrationProfile.h"
+#include "ChannelGroupTree.h"
+#include "ChannelTrendStore.h"
+#include "HarmonicAnalysis.h"
+#include "HarmonicFit.h"
+#include "LongTermSpectrum.h"
+#include "MultibandAnalysis.h"
+#include "ReferenceAnalysis.h"
+
+#ifndef THD_WITH_CHANNEL_STRIP
+ #define THD_WITH_CHANNEL_STRIP 1
+#endif
+
+#ifndef THD_WITH_MASTER_BRAIN
+ #define THD_WITH_MASTER_BRAIN 1
+#endif
+
+#if ! THD_WITH_CHANNEL_STRIP && ! THD_WITH_MASTER_BRAIN
+ #error "At least one of THD_WITH_CHANNEL_STRIP and THD_WITH_MASTER_BRAIN must be enabled"
+#endif
+
+#if THD_WITH_CLAP
+ #include <clap-juce-extensions/clap-juce-extensions.h>
+ #include "ClapThreadPoolExecutor.h"
+#endif
 
 //==============================================================================
 // FFT Analyzer Class - Ported from TypeScript implementation
@@ -36,17 +68,7 @@ public:
         magnitudeSquaredBuffer.resize (fftSize / 2, 0.0f);
     }
 
-    struct AnalysisResult
-    {
-        float fundamentalFrequency = 0.0f;
-        float thd = 0.0f;
-        float thdN = 0.0f;
-        float level = 0.0f;
-        float analysisConfidence = 0.0f;
-        bool fundamentalValid = false;
-        std::array<float, 7> harmonics {}; // H2-H8
-        float noiseFloor = 0.0f;
-    };
+    using AnalysisResult = HarmonicAnalysis::Result;
 
     AnalysisResult analyze (const float* input, int numSamples, float sampleRate)
     {
@@ -71,13 +93,15 @@ public:
             magnitudeSquaredBuffer[static_cast<size_t> (i)] = (real * real) + (imag * imag);
         }
 
-        const int minBin = juce::jlimit (1, (fftSize / 2) - 1, static_cast<int> ((20.0f * static_cast<float> (fftSize)) / sampleRate));
-        const int maxBin = juce::jlimit (minBin, (fftSize / 2) - 1, static_cast<int> ((2000.0f * static_cast<float> (fftSize)) / sampleRate));
+        if (residualPower != nullptr)
+            HarmonicAnalysis::subtractResidualPower<1> (magnitudeSquaredBuffer.data(), residualPower, fftSize / 2);
+
+        const auto band = HarmonicAnalysis::fundamentalSearchBand (fftSize, sampleRate);
 
         float maxMagSquared = 0.0f;
         int fundamentalBin = 0;
 
-        for (int i = minBin; i <= maxBin; ++i)
+        for (int i = band.minBin; i <= band.maxBin; ++i)
         {
             if (magnitudeSquaredBuffer[static_cast<size_t> (i)] > maxMagSquared)
             {
@@ -86,95 +110,51 @@ public:
             }
         }
 
-        result.fundamentalFrequency = static_cast<float> (fundamentalBin) * sampleRate / static_cast<float> (fftSize);
-
         float sumSquares = 0.0f;
         for (int i = 0; i < numSamples; ++i)
             sumSquares += input[i] * input[i];
 
-        result.level = std::sqrt (sumSquares / static_cast<float> (numSamples));
-
-        if (result.fundamentalFrequency <= 0.0f || result.level <= 0.0001f || maxMagSquared <= 0.0f)
-            return result;
-
-        const auto fundamentalRms = std::sqrt (maxMagSquared) / static_cast<float> (fftSize);
-        const auto fundamentalDb = juce::Decibels::gainToDecibels (juce::jmax (fundamentalRms, 1.0e-12f));
-
         float totalSpectralPower = 0.0f;
-        for (int i = minBin; i < fftSize / 2; ++i)
+        for (int i = band.minBin; i < fftSize / 2; ++i)
             totalSpectralPower += magnitudeSquaredBuffer[static_cast<size_t> (i)];
 
-        const auto fundamentalPowerRatio = totalSpectralPower > 0.0f ? (maxMagSquared / totalSpectralPower) : 0.0f;
-        result.analysisConfidence = juce::jlimit (0.0f, 1.0f, fundamentalPowerRatio);
-        result.fundamentalValid = (fundamentalDb >= -60.0f) && (fundamentalPowerRatio >= 0.1f);
-
-        if (! result.fundamentalValid)
+        const auto level = std::sqrt (sumSquares / static_cast<float> (numSamples));
+        if (! HarmonicAnalysis::classifyFundamental (result, fundamentalBin, maxMagSquared, totalSpectralPower, level, fftSize, sampleRate))
             return result;
 
-        std::array<int, 8> harmonicBins {};
-        for (int harmonic = 1; harmonic <= 8; ++harmonic)
-            harmonicBins[static_cast<size_t> (harmonic - 1)] = static_cast<int> (static_cast<float> (harmonic) * result.fundamentalFrequency * static_cast<float> (fftSize) / sampleRate);
-
-        float harmonicSumSquared = 0.0f;
-
-        for (int harmonic = 2; harmonic <= 8; ++harmonic)
-        {
-            const int harmonicBin = harmonicBins[static_cast<size_t> (harmonic - 1)];
-            if (harmonicBin >= 1 && harmonicBin < fftSize / 2)
-            {
-                float harmonicMagSquared = 0.0f;
-                const int lowerBin = juce::jmax (1, harmonicBin - 2);
-                const int upperBin = juce::jmin ((fftSize / 2) - 1, harmonicBin + 2);
-
-                for (int bin = lowerBin; bin <= upperBin; ++bin)
-                    harmonicMagSquared = juce::jmax (harmonicMagSquared, magnitudeSquaredBuffer[static_cast<size_t> (bin)]);
-
-                const float harmonicMag = std::sqrt (harmonicMagSquared);
-                result.harmonics[static_cast<size_t> (harmonic - 2)] = harmonicMag;
-                harmonicSumSquared += harmonicMagSquared;
-            }
-        }
-
-        const float harmonicLevel = std::sqrt (harmonicSumSquared);
-        const float fundamentalLevel = std::sqrt (maxMagSquared);
-        result.thd = (harmonicLevel / fundamentalLevel) * 100.0f;
-
-        float noiseSum = 0.0f;
-        int noiseBins = 0;
-
-        for (int i = minBin; i < fftSize / 2; ++i)
-        {
-            bool isHarmonicRegion = false;
-
-            for (int harmonic = 1; harmonic <= 8; ++harmonic)
-            {
-                const int harmonicBin = harmonicBins[static_cast<size_t> (harmonic - 1)];
-                if (std::abs (i - harmonicBin) < 10)
-                {
-                    isHarmonicRegion = true;
-                    break;
-                }
-            }
-
-            if (! isHarmonicRegion)
-            {
-                noiseSum += magnitudeSquaredBuffer[static_cast<size_t> (i)];
-                ++noiseBins;
-            }
-        }
-
-        const float noiseLevel = std::sqrt (noiseSum);
-        result.thdN = (std::sqrt (harmonicSumSquared + noiseSum) / fundamentalLevel) * 100.0f;
-        result.noiseFloor = noiseLevel;
+        const auto harmonicBins = HarmonicAnalysis::harmonicBinsFor (result.fundamentalFrequency, fftSize, sampleRate);
+        const auto harmonicSumSquared = HarmonicAnalysis::measureHarmonics (result, magnitudeSquaredBuffer.data(), 1, fftSize, maxMagSquared, harmonicBins);
+        const auto noiseSum = HarmonicAnalysis::noisePower (magnitudeSquaredBuffer.data(), 1, band.minBin, fftSize, harmonicBins);
+        HarmonicAnalysis::finishNoise (result, harmonicSumSquared, noiseSum, maxMagSquared);
 
         return result;
     }
 
+    /** Calibration residual subtracted from each spectrum (fftSize / 2 bins, read in place), or nullptr. */
+    void setResidualPower (const float* residualPowerPerBin) noexcept { residualPower = residualPowerPerBin; }
+
+    /** Power spectrum of the last analysed frame, after any residual subtraction. */
+    const float* getPowerSpectrum() const noexcept { return magnitudeSquaredBuffer.data(); }
+
 private:
     juce::dsp::FFT fft;
     juce::dsp::WindowingFunction<float> window;
     std::vector<float> fftData;
     std::vector<float> magnitudeSquaredBuffer;
+    const float* residualPower = nullptr;
+};
+
+// Oscilloscope thumbnail a strip publishes with each hop: min/max pairs over
+// a span triggered on a rising zero crossing of the fundamental, quantised to
+// int8 steps of scale / 127 so it adds little to the shared slot.
+struct ChannelWaveform
+{
+    static constexpr int numPoints = 128;
+
+    float scale = 0.0f;        // linear peak of the span; 0 until the first hop
+    bool triggered = false;    // span starts on a fundamental zero crossing
+    std::array<int8_t, numPoints> minimum {};
+    std::array<int8_t, numPoints> maximum {};
 };
 
 struct ChannelData
@@ -186,10 +166,15 @@ struct ChannelData
     double level = 0.0;
     double peakLevel = 0.0;
     std::vector<double> harmonics = std::vector<double> (7, 0.0);
+    ChannelWaveform waveform;
+    LongTermSpectrum::Bands ltasDb = makeSilentLtas();   // third-octave LTAS, dB re full-scale sine
+    uint32_t ltasHops = 0;                               // 0 until the strip has averaged a hop
+    int numBands = 0;                                    // 0 unless the strip runs Multiband
+    MultibandAnalysis::Readings bands {};
     bool muted = false;
     bool soloed = false;
     bool active = false;
-    double lastUpdateSeconds = 0.0;
+    double lastPublishMs = 0.0;        // wall clock of the strip's latest publish
     juce::Colour channelColor;
 
     ChannelData() = default;
@@ -198,6 +183,69 @@ struct ChannelData
         : channelId (id), channelName (std::move (name)), channelColor (color)
     {
     }
+
+    static LongTermSpectrum::Bands makeSilentLtas() noexcept
+    {
+        LongTermSpectrum::Bands bands;
+        bands.fill (LongTermSpectrum::minimumDb);
+        return bands;
+    }
+};
+
+//==============================================================================
+// Wait-free per-channel flag set used for mute/solo and slot liveness. Writers
+// flip bits with atomic RMW on the owning word, so a bit cleared on one thread
+// never loses a bit set concurrently on another.
+//==============================================================================
+template <int numBits>
+class AtomicChannelBitset
+{
+public:
+    static constexpr int numWords = (numBits + 63) / 64;
+
+    void set (int index, bool shouldBeSet) noexcept
+    {
+        if (! juce::isPositiveAndBelow (index, numBits))
+            return;
+
+        auto& word = words[static_cast<size_t> (index / 64)];
+        const auto bit = uint64_t { 1 } << (index % 64);
+
+        if (shouldBeSet)
+            word.fetch_or (bit, std::memory_order_acq_rel);
+        else
+            word.fetch_and (~bit, std::memory_order_acq_rel);
+    }
+
+    bool test (int index) const noexcept
+    {
+        if (! juce::isPositiveAndBelow (index, numBits))
+            return false;
+
+        return (loadWord (index / 64) & (uint64_t { 1 } << (index % 64))) != 0;
+    }
+
+    uint64_t loadWord (int wordIndex) const noexcept
+    {
+        return words[static_cast<size_t> (wordIndex)].load (std::memory_order_acquire);
+    }
+
+    void storeWord (int wordIndex, uint64_t value) noexcept
+    {
+        words[static_cast<size_t> (wordIndex)].store (value, std::memory_order_release);
+    }
+
+    bool any() const noexcept
+    {
+        for (int i = 0; i < numWords; ++i)
+            if (loadWord (i) != 0)
+                return true;
+
+        return false;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, numWords> words {};
 };
 
 enum class PluginMode
@@ -207,20 +255,41 @@ enum class PluginMode
 };
 
 class THDAnalyzerPlugin : public juce::AudioProcessor,
-                          private juce::AudioProcessorValueTreeState::Listener
+                          private juce::AudioProcessorValueTreeState::Listener,
+                          private juce::AsyncUpdater
+                         #if THD_WITH_CLAP
+                          , public clap_juce_extensions::clap_juce_audio_processor_capabilities
+                         #endif
 {
 public:
     THDAnalyzerPlugin();
     ~THDAnalyzerPlugin() override;
 
+    static constexpr bool hasChannelStripMode = THD_WITH_CHANNEL_STRIP != 0;
+    static constexpr bool hasMasterBrainMode = THD_WITH_MASTER_BRAIN != 0;
+    static constexpr bool hasSwitchableMode = hasChannelStripMode && hasMasterBrainMode;
 
+    /** Only switchable builds have a "pluginMode" parameter; single-mode builds ignore other modes. */
     void setPluginMode (PluginMode mode);
-    PluginMode getPluginMode() const;
+    PluginMode getPluginMode() const noexcept
+    {
+       #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
+        return static_cast<PluginMode> (cachedPluginMode.load (std::memory_order_acquire));
+       #elif THD_WITH_MASTER_BRAIN
+        return PluginMode::MasterBrain;
+       #else
+        return PluginMode::ChannelStrip;
+       #endif
+    }
 
     void setChannelId (int id);
     int getChannelId() const;
     bool isEditorDataReady() const noexcept;
+    /** Bumped whenever editors have something new to show (a strip snapshot, or master channel changes). */
+    uint64_t getEditorDataVersion() const noexcept { return editorDataVersion.load (std::memory_order_acquire); }
     FFTAnalyzer::AnalysisResult getLastAnalysisResult() const;
+    /** Smoothed per-band readings of the latest hop; returns the band count, 0 while Multiband is off. */
+    int getLastBandReadings (MultibandAnalysis::Readings& destination) const;
     bool popLatestAnalysisResultForEditor (FFTAnalyzer::AnalysisResult& destination);
     std::vector<ChannelData> getChannelsSnapshot() const;
     void publishDisplayOutboundValues (float thd, float thdN);
@@ -229,6 +298,76 @@ public:
     void ensureChannelExists (int channelId);
 
     static constexpr int maxDynamicChannels = 64;
+    static constexpr int channelMaskWords = AtomicChannelBitset<maxDynamicChannels>::numWords;
+
+   #ifndef THD_AUTOMATABLE_MUTE_SOLO_CHANNELS
+    #define THD_AUTOMATABLE_MUTE_SOLO_CHANNELS 8
+   #endif
+    // Only the first N channels get host-automatable mute/solo parameters;
+    // the bitsets below cover the full channel range regardless.
+    static constexpr int numAutomatableMuteSoloChannels = THD_AUTOMATABLE_MUTE_SOLO_CHANNELS;
+    static_assert (numAutomatableMuteSoloChannels >= 0 && numAutomatableMuteSoloChannels <= maxDynamicChannels,
+                   "THD_AUTOMATABLE_MUTE_SOLO_CHANNELS must be within the dynamic channel range");
+
+    void setChannelMuted (int channelId, bool shouldBeMuted);
+    void setChannelSoloed (int channelId, bool shouldBeSoloed);
+    bool isChannelMuted (int channelId) const noexcept;
+    bool isChannelSoloed (int channelId) const noexcept;
+
+    struct MasterAggregate
+    {
+        float averageThd = 0.0f;
+        float rssThd = 0.0f;
+        float rssThdN = 0.0f;
+        float peakThd = 0.0f;
+        float averageLevel = 0.0f;
+        std::array<float, 7> harmonics {};
+        int numContributingChannels = 0;
+        std::array<uint64_t, channelMaskWords> contributingChannels {};
+        int64_t timelineSample = noTimelinePosition; // Master Brain block the aggregate was built in
+        uint64_t epoch = 0;                         // every channel value is from this epoch or earlier
+
+        // The contributing channels joined by host time: each one's hop nearest alignedTimelineSample.
+        int64_t alignedTimelineSample = noTimelinePosition;
+        int numAlignedChannels = 0;
+        float alignedRssThd = 0.0f;
+        float alignedPeakThd = 0.0f;
+
+        bool isContributing (int channelId) const noexcept
+        {
+            return juce::isPositiveAndBelow (channelId, maxDynamicChannels)
+                && (contributingChannels[static_cast<size_t> (channelId / 64)] & (uint64_t { 1 } << (channelId % 64))) != 0;
+        }
+    };
+
+    MasterAggregate getMasterAggregate() const;
+
+    // Channel strips pick a group via the "channelGroup" parameter; groups may
+    // be nested by giving them a parent group in the Master Brain.
+    static constexpr int maxChannelGroups = 16;
+    using GroupTree = ChannelGroupTree<maxDynamicChannels, maxChannelGroups>;
+
+    struct GroupSummary
+    {
+        int parent = GroupTree::noGroup;
+        int depth = 0;
+        int numChannels = 0;
+        float averageThd = 0.0f;
+        float rssThd = 0.0f;
+        float rssThdN = 0.0f;
+    };
+
+    bool setChannelGroupParent (int group, int parent);
+    int getChannelGroupParent (int group) const noexcept;
+    std::array<GroupSummary, maxChannelGroups> getGroupSummaries() const;
+
+    // The Master Brain keeps about an hour of THD / THD+N / level per channel
+    // (ChannelTrendStore.h). It is allocated on the message thread the first
+    // time the instance runs as Master Brain and kept from then on.
+    using TrendStore = ChannelTrendStore<maxDynamicChannels>;
+
+    /** Lock-free reads from any thread; nullptr until this instance has been a Master Brain. */
+    const TrendStore* getTrendStore() const noexcept;
 
 
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
@@ -237,8 +376,67 @@ public:
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
+    // Optional auxiliary output carrying THD ratio, THD+N ratio and RMS level as
+    // audio-rate control signals (0.01 == 1%), ramped linearly between hops.
+    static constexpr int measurementCvBusIndex = 1;
+    static constexpr int numMeasurementCvChannels = 3;
+
+    // Channel strips have an optional "Reference" sidechain input carrying the
+    // clean signal the main input was made from (see the Reference layout).
+    static constexpr int referenceBusIndex = 1;
+
+    struct ReferenceStatus
+    {
+        bool connected = false;   // sidechain enabled when the strip was prepared
+        bool locked = false;      // latency found and being tracked
+        int latencySamples = 0;   // main input lags the reference by this much
+        float coherence = 0.0f;   // output-power weighted coherence, 0 .. 1
+    };
+
+    ReferenceStatus getReferenceStatus() const noexcept;
+
+    // The "Fast Fit" layout reads THD from a least-squares harmonic fit of the
+    // last fastFitFrameSize samples every fastFitHopSize (HarmonicFit.h), using
+    // the FFT hop only for the fundamental guess and as a fallback.
+    static constexpr int fastFitFrameSize = 2048;
+    static constexpr int fastFitHopSize = 512;
+
+    /** True while Fast Fit readings are being published (false while it falls back to the FFT). */
+    bool isFastFitLocked() const noexcept;
+
+    // Loopback calibration: the interface's own residual spectrum, captured
+    // once per sample rate and subtracted from every analysed spectrum while
+    // "residualCorrection" is on. Profiles are shared by all instances.
+    struct CalibrationStatus
+    {
+        bool profileLoaded = false;   // a profile matches the prepared sample rate
+        bool capturing = false;
+        float captureProgress = 0.0f; // 0 .. 1 while capturing
+    };
+
+    static constexpr double defaultCalibrationSeconds = 10.0;
+
+    /** Message thread: starts averaging this strip's input as the new residual; false if busy or not prepared. */
+    bool startCalibrationCapture (double seconds = defaultCalibrationSeconds);
+    CalibrationStatus getCalibrationStatus() const noexcept;
+    /** Residual to subtract this hop, or nullptr (correction off, capturing, or no profile). */
+    const float* getCalibrationResidual() const noexcept;
+    static juce::File getCalibrationProfileFile (double sampleRate);
+
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
+   #if THD_WITH_CHANNEL_STRIP
+    // Offline renders additionally run a dense, unsmoothed analysis (larger FFT,
+    // shorter hop, every lane) and write a bounce report when the render ends.
+    void setNonRealtime (bool isNonRealtime) noexcept override;
+   #endif
+    // Each strip averages its analysed spectra into a third-octave long-term
+    // average spectrum (LongTermSpectrum.h) and republishes it twice a second.
+    static constexpr double ltasPublishIntervalSeconds = 0.5;
+
+    static constexpr int denseFftOrder = 15;
+    static constexpr int denseHopSize = FFTAnalyzer::fftSize / 8;
+
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
 
@@ -257,6 +455,107 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+   #if THD_WITH_CLAP
+    // CLAP thread-pool: once attached, per-hop analysis jobs run on host workers.
+    bool supportsExtension (const char* name) override;
+    const void* getExtension (const char* name) override;
+    void attachClapHost (const clap_host* host, const clap_plugin* plugin);
+   #endif
+
+    // Hosts running many strips in one callback (the headless daemon) can take
+    // over mono-sum hops and analyse several strips' frames in one batch.
+    class BatchedAnalysisScheduler
+    {
+    public:
+        virtual ~BatchedAnalysisScheduler() = default;
+
+        /** Called at a hop; frame (fftSize samples, oldest first) stays valid until completeBatchedAnalysis(). */
+        virtual void submit (THDAnalyzerPlugin& strip, const float* frame, float sampleRate) noexcept = 0;
+    };
+
+    void setBatchedAnalysisScheduler (BatchedAnalysisScheduler* scheduler) noexcept;
+    /** Call on the audio thread after the strip's processBlock; the result is published with its next block.
+        powerSpectrum (fftSize / 2 bins at powerSpectrum[bin * powerStride]) feeds the strip's LTAS and
+        Multiband readings if given. */
+    void completeBatchedAnalysis (const FFTAnalyzer::AnalysisResult& analysis,
+                                  const float* powerSpectrum = nullptr, int powerStride = 1);
+
+    // Host timeline position in samples (AudioPlayHead::getTimeInSamples);
+    // noTimelinePosition when the host does not report one.
+    static constexpr int64_t noTimelinePosition = std::numeric_limits<int64_t>::min();
+
+    // Telemetry a Channel instance publishes for Master Brain / IPC readers.
+    struct SharedChannelState
+    {
+        float thd = 0.0f;
+        float thdN = 0.0f;
+        float level = 0.0f;
+        float peakLevel = 0.0f;
+        std::array<float, 7> harmonics {};
+        ChannelWaveform waveform;
+        LongTermSpectrum::Bands ltasDb = ChannelData::makeSilentLtas();   // refreshed every ltasPublishIntervalSeconds
+        uint32_t ltasHops = 0;
+        int numBands = 0;
+        MultibandAnalysis::Readings bands {};
+        uint64_t sequence = 0;
+        double lastPublishMs = 0.0;
+        uint32_t publisherInstanceId = 0;
+        int groupIndex = GroupTree::noGroup;
+        int64_t timelineSample = noTimelinePosition; // centre of the latest analysed frame
+        uint64_t epoch = 0;                         // sharedAnalysisEpoch when published
+        bool active = false;
+    };
+
+    // Each Channel strip also keeps its recent hops, tagged with the timeline
+    // position of the analysed frame centre, so readers can line channels up
+    // by host time instead of by when each strip happened to publish.
+    struct SharedHopRecord
+    {
+        int64_t timelineSample = noTimelinePosition;
+        uint64_t hopIndex = 0;
+        float thd = 0.0f;
+        float thdN = 0.0f;
+        float level = 0.0f;
+        bool fundamentalValid = false;
+    };
+
+    static constexpr int sharedHopHistorySize = 32;
+
+    /** Lock-free lookup of the hop nearest timelineSample (within tolerance) in a channel's recent history. */
+    static bool readSharedHopNearest (int channelId, int64_t timelineSample, int64_t toleranceSamples,
+                                      SharedHopRecord& destination) noexcept;
+
+    struct TimelineJoin
+    {
+        int64_t timelineSample = noTimelinePosition;
+        int numChannels = 0;
+        std::array<uint64_t, channelMaskWords> channels {};
+        std::array<SharedHopRecord, maxDynamicChannels> hops {};
+        float rssThd = 0.0f;
+        float peakThd = 0.0f;
+
+        bool contains (int channelId) const noexcept
+        {
+            return juce::isPositiveAndBelow (channelId, maxDynamicChannels)
+                && (channels[static_cast<size_t> (channelId / 64)] & (uint64_t { 1 } << (channelId % 64))) != 0;
+        }
+    };
+
+    /** The hop at (or nearest to) one timeline position of every channel in the include mask.
+        Served to QC scripts by the IPC "AT" query. */
+    static TimelineJoin joinChannelsAtTimeline (int64_t timelineSample, int64_t toleranceSamples,
+                                                const std::array<uint64_t, channelMaskWords>& include) noexcept;
+
+    /** Channels the most recent Master Brain block left unmuted (and soloed, when any solo is on);
+        every channel when no Master Brain in this process has published a mask lately. */
+    static std::array<uint64_t, channelMaskWords> getSharedMasterChannelMask (double nowMs) noexcept;
+
+    /** Lock-free read of one process-wide shared slot; false if no consistent copy was obtained. */
+    static bool readSharedChannelSlot (int channelId, SharedChannelState& destination) noexcept;
+    static bool isSharedChannelStale (const SharedChannelState& shared, double nowMs) noexcept;
+    /** Staleness for slots and Master Brain channels alike, on the wall clock strips publish with. */
+    static bool isPublishStale (double lastPublishMs, double nowMs) noexcept;
+
     juce::AudioProcessorValueTreeState& getValueTreeState() noexcept;
     const juce::AudioProcessorValueTreeState& getValueTreeState() const noexcept;
     static juce::String channelMutedParamId (int channelIndex);
@@ -269,37 +568,196 @@ private:
     bool restoreLegacyStateIfNeeded (const juce::XmlElement& xml);
 
     void parameterChanged (const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void updateIpcServerRegistration();
+
+    void updateBlockTimelinePosition();
 
+   #if THD_WITH_CHANNEL_STRIP
+    // Channel Strip mode (THDAnalyzerChannelStrip.cpp)
+    void processChannelStripBlock (juce::AudioBuffer<float>& buffer);
+    void resetChannelStripState();
     void ensureScratchBuffers (int numSamples);
-    void pushSamplesToAnalysisFifo (const std::vector<float>& monoBuffer);
+    void pushSamplesToAnalysisFifos (const juce::AudioBuffer<float>& buffer, int numInputChannels);
+    static void runAnalysisLaneJob (void* context, int jobIndex) noexcept;
+    void orderLaneSamples (int laneIndex) noexcept;
+    void applyAnalysisHop (const FFTAnalyzer::AnalysisResult& analysis, int64_t frameCentreTimelineSample,
+                           int hopSamples = analysisHopSize, int blockOffset = 0);
+    void runFastFitHops (int numSamples);
+    void runFastFitHop (int blockOffset, int numSamples);
+    void applyBandHop (const MultibandAnalysis::Readings& readings, int numBands) noexcept;
+    void publishSharedChannelData (const FFTAnalyzer::AnalysisResult& analysis, float peakLevel);
+    void captureWaveform (const FFTAnalyzer::AnalysisResult& analysis) noexcept;
+    void pushReferenceSamples (juce::AudioBuffer<float>& buffer);
+    FFTAnalyzer::AnalysisResult analyzeAgainstReference (float sampleRate);
+    void loadCalibrationProfile (double sampleRate);
+    void publishCalibrationProfile (std::shared_ptr<const CalibrationProfile::Profile> profile);
+    void addCalibrationHop (const FFTAnalyzer::AnalysisResult& analysis);
+    void writeCalibrationProfile();
+
+    struct DenseOfflineAnalysis;
+    void armDenseOfflineAnalysis();
+    void runDenseOfflineAnalysis (const juce::AudioBuffer<float>& buffer, int numInputChannels);
+    static void runDenseLaneJob (void* context, int jobIndex) noexcept;
+    void requestBounceReport() noexcept;
+    void handOverBounceReport() noexcept;
+    void writeBounceReport();
+   #endif
+
+   #if THD_WITH_MASTER_BRAIN
+    // Master Brain mode (THDAnalyzerMasterBrain.cpp)
+    void processMasterBrainBlock (juce::MidiBuffer& midiMessages, int numSamples);
+    void resetMasterBrainState();
+    static juce::Colour colorForChannelId (int channelId);
+    static juce::String defaultChannelNameForId (int channelId);
+    void pruneStaleChannels();
+    void updateMasterAggregate();
+    void updateGroupTree (const std::array<uint64_t, channelMaskWords>& contributingBits);
+    void ingestSharedChannelData();
+    void ensureTrendStore();
+   #endif
+
+    // Lane 0 analyses the mono sum; with the "Per Side" layout lanes 1 and 2
+    // analyse left and right as independent jobs and the worse side is reported.
+    // "Reference" compares the mono sum with the sidechain (ReferenceAnalysis.h)
+    // and falls back to the mono sum while no sidechain is connected. "Fast Fit"
+    // fits the mono sum's harmonics over a short frame between FFT hops.
+    enum class AnalysisLayout
+    {
+        monoSum = 0,
+        perSide = 1,
+        reference = 2,
+        fastFit = 3
+    };
+
+    // "Multiband" adds per-band THD (MultibandAnalysis.h) to the mono sum
+    // hop, or the worse side per band with Per Side; choices Off / 3 / 4 bands.
+    static int multibandChoiceToNumBands (int choice) noexcept { return choice > 0 ? MultibandAnalysis::minBands + choice - 1 : 0; }
+
+    static constexpr int monoSumLane = 0;
+    static constexpr int numAnalysisLanes = 3;
+
+   #if THD_WITH_CHANNEL_STRIP
+    struct AnalysisLane
+    {
+        FFTAnalyzer analyzer;
+        std::array<float, FFTAnalyzer::fftSize> fifo {};
+        std::array<float, FFTAnalyzer::fftSize> orderedSamples {};
+        FFTAnalyzer::AnalysisResult result;
+    };
+
+    std::array<AnalysisLane, numAnalysisLanes> analysisLanes;
+    int firstScheduledLane = monoSumLane;
+    float scheduledSampleRate = 0.0f;
+    SerialAnalysisJobExecutor serialAnalysisJobExecutor;
+    std::atomic<AnalysisJobExecutor*> analysisJobExecutor { &serialAnalysisJobExecutor };
+   #if THD_WITH_CLAP
+    ClapThreadPoolExecutor clapThreadPoolExecutor;
+   #endif
+    std::atomic<BatchedAnalysisScheduler*> batchedAnalysisScheduler { nullptr };
+    int64_t lastHopTimelineSample = noTimelinePosition;
+    int64_t batchedHopTimelineSample = noTimelinePosition;
+
+    // Defined in THDAnalyzerChannelStrip.cpp, so the deleter lives there too.
+    struct DenseOfflineAnalysisDeleter { void operator() (DenseOfflineAnalysis*) const noexcept; };
+    std::unique_ptr<DenseOfflineAnalysis, DenseOfflineAnalysisDeleter> denseOfflineAnalysis;
+    std::atomic<bool> denseOfflineArmed { false };
+    std::atomic<bool> bounceReportPending { false };   // render ended; the audio thread hands the report over
+    std::atomic<bool> bounceReportReady { false };     // finishedReport belongs to the message thread until written
+
+    // Allocated in prepareToPlay only while the Reference sidechain is enabled.
+    std::unique_ptr<ReferenceAnalysis<FFTAnalyzer::fftOrder>> referenceAnalysis;
+    std::atomic<bool> referenceConnected { false };
+    std::atomic<int> referenceLatencySamples { -1 };
+    std::atomic<float> referenceCoherence { 0.0f };
+
+    // The profile is mapped in prepareToPlay. A fresh capture swaps it on the
+    // message thread and bumps calibrationResidualEpoch. Each replaced profile
+    // stays on the retire list until the audio thread has picked up a residual
+    // at least that new at a hop, so no lane can still be reading it.
+    struct RetiredCalibrationProfile
+    {
+        std::shared_ptr<const CalibrationProfile::Profile> profile;
+        uint64_t retiredAtEpoch = 0;
+    };
+
+    std::shared_ptr<const CalibrationProfile::Profile> calibrationProfile;
+    std::vector<RetiredCalibrationProfile> retiredCalibrationProfiles;
+    std::atomic<const float*> calibrationResidual { nullptr };
+    std::atomic<uint64_t> calibrationResidualEpoch { 0 };
+    std::atomic<uint64_t> acknowledgedCalibrationEpoch { 0 };
+    std::unique_ptr<CalibrationProfile::Capture> calibrationCapture;
+    std::atomic<bool> calibrationCaptureArmed { false };
+    std::atomic<bool> calibrationCapturePending { false };
+    std::atomic<float> calibrationCaptureProgress { 0.0f };
+
+    HarmonicFit<fastFitFrameSize> harmonicFit { FFTAnalyzer::fftSize };
+    std::array<float, fastFitFrameSize> fastFitFrame {};
+    int fastFitSamplesSinceLastRun = 0;
+    std::atomic<bool> fastFitLocked { false };
+
+    LongTermSpectrum longTermSpectrum;
+    LongTermSpectrum::Bands publishedLtasDb = ChannelData::makeSilentLtas();
+    uint32_t publishedLtasHops = 0;
+    int ltasSamplesSincePublish = 0;
+    int ltasPublishIntervalSamples = 1;
+
+    MultibandAnalysis multibandAnalysis;
+    MultibandAnalysis::Readings smoothedBandReadings {};
+    int smoothedNumBands = 0;
 
-    FFTAnalyzer fftAnalyzer;
-    FFTAnalyzer::AnalysisResult lastAnalysis;
     FFTAnalyzer::AnalysisResult realtimeAnalysisCache;
     FFTAnalyzer::AnalysisResult smoothedAnalysisCache;
-
-    juce::AudioProcessorValueTreeState state;
-    std::atomic<float>* pluginModeParamValue = nullptr;
-    std::atomic<float>* channelIdParamValue = nullptr;
-    std::array<std::atomic<float>*, 8> channelMutedParamValues {};
-    std::array<std::atomic<float>*, 8> channelSoloedParamValues {};
-    std::atomic<int> cachedPluginMode { static_cast<int> (PluginMode::ChannelStrip) };
-    std::atomic<int> cachedChannelId { 0 };
-    std::atomic<bool> editorDataReady { false };
-    std::array<float, FFTAnalyzer::fftSize> analysisFifo {};
-    std::array<float, FFTAnalyzer::fftSize> orderedSamplesScratch {};
+    ChannelWaveform hopWaveform;
+    bool sharedStateChanged = true;          // a hop or LTAS refresh since the last full publish
+    int publishedSharedChannelId = -1;
+    int publishedSharedGroup = GroupTree::noGroup;
     std::vector<float> monoBufferScratch;
     int fifoWritePosition = 0;
     bool fifoFilled = false;
     int analysisSamplesSinceLastRun = 0;
     int samplesSinceLastSnapshotPush = 0;
     int snapshotIntervalSamples = 1;
+   #endif
+
+    int64_t blockTimelineSample = noTimelinePosition;
+    FFTAnalyzer::AnalysisResult lastAnalysis;
+    MultibandAnalysis::Readings lastBandReadings {};
+    int lastNumBands = 0;
+
+    juce::AudioProcessorValueTreeState state;
+    std::atomic<float>* channelIdParamValue = nullptr;
+    std::atomic<float>* channelGroupParamValue = nullptr;
+    std::atomic<float>* ipcServerEnabledParamValue = nullptr;
+    std::atomic<float>* analysisLayoutParamValue = nullptr;
+    std::atomic<float>* bounceReportParamValue = nullptr;
+    std::atomic<float>* residualCorrectionParamValue = nullptr;
+    std::atomic<float>* multibandParamValue = nullptr;
+   #if THD_WITH_MASTER_BRAIN
+    std::array<std::atomic<float>*, numAutomatableMuteSoloChannels> channelMutedParamValues {};
+    std::array<std::atomic<float>*, numAutomatableMuteSoloChannels> channelSoloedParamValues {};
+    AtomicChannelBitset<maxDynamicChannels> mutedChannels;
+    AtomicChannelBitset<maxDynamicChannels> soloedChannels;
+   #endif
+   #if THD_WITH_CHANNEL_STRIP && THD_WITH_MASTER_BRAIN
+    std::atomic<float>* pluginModeParamValue = nullptr;
+    std::atomic<int> cachedPluginMode { static_cast<int> (PluginMode::ChannelStrip) };
+   #endif
+    std::atomic<int> cachedChannelId { 0 };
+    std::atomic<int> cachedChannelGroup { GroupTree::noGroup };
+    std::atomic<int> cachedAnalysisLayout { static_cast<int> (AnalysisLayout::monoSum) };
+    std::atomic<int> cachedMultibandBands { 0 };
+    std::atomic<bool> editorDataReady { false };
+    std::atomic<uint64_t> editorDataVersion { 0 };
+    bool holdsIpcServer = false;
     static constexpr int analysisHopSize = FFTAnalyzer::fftSize / 4;
     static constexpr float targetSnapshotRateHz = 25.0f;
     static constexpr float analysisSmoothingCoeff = 0.15f;
 
+   #if THD_WITH_MASTER_BRAIN
     std::vector<ChannelData> channels;
     double internalClockSeconds = 0.0;
+   #endif
     static constexpr double channelStaleTimeoutSeconds = 3.0;
     mutable juce::SpinLock analysisDataLock;
 
@@ -318,33 +776,128 @@ private:
     static constexpr double outboundPublishIntervalMs = 33.0;
     static constexpr float outboundPublishDeltaThreshold = 0.1f;
 
+    std::array<float, numMeasurementCvChannels> measurementCvCurrent {};
+    std::array<float, numMeasurementCvChannels> measurementCvTarget {};
+    std::array<float, numMeasurementCvChannels> measurementCvStep {};
+    int measurementCvRampSamplesRemaining = 0;
+
+    // Hops queue their targets at the block offset their frame ended on, so
+    // several hops in one block each start their ramp at the right sample.
+    struct MeasurementCvRamp
+    {
+        int blockOffset = 0;
+        int rampSamples = 1;
+        std::array<float, numMeasurementCvChannels> targets {};
+    };
+
+    static constexpr int maxPendingMeasurementCvRamps = 16;
+    std::array<MeasurementCvRamp, maxPendingMeasurementCvRamps> pendingMeasurementCvRamps {};
+    int numPendingMeasurementCvRamps = 0;
+
     void pushAnalysisSnapshotForEditor (const FFTAnalyzer::AnalysisResult& analysis);
+    /** Queues a ramp starting blockOffset samples into the current block; offsets past its end carry into the next. */
+    void setMeasurementCvTargets (float thd, float thdN, float level, int rampSamples = analysisHopSize, int blockOffset = 0);
+    void startMeasurementCvRamp (const MeasurementCvRamp& ramp) noexcept;
+    void renderMeasurementCv (juce::AudioBuffer<float>& buffer);
+    void renderMeasurementCvSegment (juce::AudioBuffer<float>& cvBuffer, int startSample, int numSamples) noexcept;
     void updateOutboundParameters (float smoothedThd, float smoothedThdN);
 
-    static juce::Colour colorForChannelId (int channelId);
-    static juce::String defaultChannelNameForId (int channelId);
-    void pruneStaleChannels();
-    void publishSharedChannelData (const FFTAnalyzer::AnalysisResult& analysis, float peakLevel);
-    void ingestSharedChannelData();
 
-    struct SharedChannelState
+    // Each slot keeps its last few published versions, every one behind its own
+    // sequence lock (odd while being written). writeClaim is odd while a
+    // publisher owns the slot; a second strip on the same channel ID skips
+    // that block instead of waiting. Readers retry, so nothing stalls an audio
+    // thread, and a writer only ever touches the oldest version, leaving older
+    // epochs readable while it publishes.
+    static constexpr int sharedSlotVersions = 4;
+
+    struct SharedChannelVersion
     {
-        float thd = 0.0f;
-        float thdN = 0.0f;
-        float level = 0.0f;
-        float peakLevel = 0.0f;
-        std::array<float, 7> harmonics {};
-        uint64_t sequence = 0;
-        double lastPublishMs = 0.0;
-        uint32_t publisherInstanceId = 0;
-        bool active = false;
+        std::atomic<uint32_t> writeSequence { 0 };
+        SharedChannelState state;
     };
 
-    static std::array<SharedChannelState, maxDynamicChannels> sharedChannelStates;
-    static juce::SpinLock sharedChannelStatesLock;
+    struct SharedChannelSlot
+    {
+        std::atomic<uint32_t> writeClaim { 0 };
+        std::atomic<uint64_t> numWrites { 0 };
+        std::array<SharedChannelVersion, sharedSlotVersions> versions;
+
+        // Refreshed every block between full publishes and overlaid on reads, so
+        // the peak meter and staleness stay live without rewriting the state.
+        std::atomic<float> meterPeakLevel { 0.0f };
+        std::atomic<double> meterPublishMs { 0.0 };
+    };
+
+    static bool writeSharedChannelSlot (int channelId, const SharedChannelState& newState) noexcept;
+    static void writeSharedChannelMeter (int channelId, float peakLevel, double publishMs) noexcept;
+    static void applySharedChannelMeter (const SharedChannelSlot& slot, SharedChannelState& state) noexcept;
+    static bool readSharedChannelVersion (const SharedChannelVersion& version, SharedChannelState& destination) noexcept;
+    static bool readSharedChannelSlotAtEpoch (int channelId, uint64_t epoch, SharedChannelState& destination) noexcept;
+
+    static std::array<SharedChannelSlot, maxDynamicChannels> sharedChannelSlots;
+
+    // Advanced by each Master Brain block; publishers stamp versions with the
+    // value they saw, so a master can take every slot "as of" one epoch.
+    static std::atomic<uint64_t> sharedAnalysisEpoch;
+
+    // Per-entry sequence locks; the hop counter only ever grows, so readers can
+    // tell which entries are current without locking the whole ring.
+    struct SharedHopEntry
+    {
+        std::atomic<uint32_t> writeSequence { 0 };
+        SharedHopRecord record;
+    };
+
+    struct SharedHopRing
+    {
+        std::atomic<uint64_t> numHopsWritten { 0 };
+        std::array<SharedHopEntry, sharedHopHistorySize> entries;
+    };
+
+    static void pushSharedHop (int channelId, SharedHopRecord record) noexcept;
+    static std::array<SharedHopRing, maxDynamicChannels> sharedHopRings;
+
+    // Mute/solo mask of the newest Master Brain block, so process-wide readers
+    // such as the IPC "AT" query count the same channels the aggregate does.
+    static AtomicChannelBitset<maxDynamicChannels> sharedMasterChannelMask;
+    static std::atomic<double> sharedMasterChannelMaskMs;
     static std::atomic<uint32_t> nextInstanceId;
     const uint32_t instanceId = 0;
+
+   #if THD_WITH_MASTER_BRAIN
     std::array<uint64_t, maxDynamicChannels> consumedSharedSequences {};
+    uint64_t snapshotEpoch = 0;
+
+    // Master Brain aggregation inputs, laid out structure-of-arrays so the
+    // mute/solo mask can be applied with SIMD multiply-accumulate passes.
+    alignas (32) std::array<float, maxDynamicChannels> slotThd {};
+    alignas (32) std::array<float, maxDynamicChannels> slotThdN {};
+    alignas (32) std::array<float, maxDynamicChannels> slotLevel {};
+    alignas (32) std::array<std::array<float, maxDynamicChannels>, 7> slotHarmonics {};
+    alignas (32) std::array<float, maxDynamicChannels> slotContributionMask {};
+    AtomicChannelBitset<maxDynamicChannels> liveSlotBits;   // set on ingest; cleared on removal from either thread
+    MasterAggregate masterAggregate;
+
+    // A frame is tagged with its centre, so the newest frame every strip has
+    // finished by the start of a Master Brain block sits half an FFT back,
+    // whichever order the host runs them in. Hops land one analysis hop apart.
+    static constexpr int64_t masterJoinLatencySamples = FFTAnalyzer::fftSize / 2;
+    static constexpr int64_t masterJoinToleranceSamples = analysisHopSize;
+
+    // Group tree is owned by the audio thread; parent edits arrive through
+    // requestedGroupParents and are applied on the next Master Brain block.
+    GroupTree groupTree;
+    std::array<std::atomic<int>, maxChannelGroups> requestedGroupParents {};
+    std::atomic<bool> groupTopologyDirty { true };
+    std::array<uint64_t, channelMaskWords> updatedSlotBits {};
+    std::array<uint64_t, channelMaskWords> previousContributingBits {};
+    uint64_t publishedGroupTreeVersion = 0;
+    std::array<GroupSummary, maxChannelGroups> groupSummaries {};
+
+    std::unique_ptr<TrendStore> ownedTrendStore;
+    std::atomic<TrendStore*> trendStore { nullptr };
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (THDAnalyzerPlugin)
 };
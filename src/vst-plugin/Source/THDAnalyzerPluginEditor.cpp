@@ -81,14 +81,44 @@ juce::String statusTextForThd (float thd)
 
     return "CRITICAL";
 }
+
+juce::String crossoverText (int numBands, int crossover)
+{
+    const auto hz = MultibandAnalysis::crossoverHz (numBands, crossover);
+    return hz >= 1000.0f ? juce::String (juce::roundToInt (hz / 1000.0f)) + "k" : juce::String (juce::roundToInt (hz));
+}
+
+juce::String bandRangeText (int numBands, int band)
+{
+    if (band == 0)
+        return "<" + crossoverText (numBands, 0);
+    if (band == numBands - 1)
+        return ">" + crossoverText (numBands, band - 1);
+
+    return crossoverText (numBands, band - 1) + "-" + crossoverText (numBands, band);
+}
+
+// "<250 0.42%  250-4k --  >4k 5.00%"; bands without a valid fundamental read "--".
+juce::String describeBands (const MultibandAnalysis::Readings& bands, int numBands)
+{
+    juce::StringArray parts;
+    for (int band = 0; band < numBands; ++band)
+    {
+        const auto& reading = bands[static_cast<size_t> (band)];
+        parts.add (bandRangeText (numBands, band) + " "
+                   + (reading.fundamentalValid ? juce::String (reading.thd, 2) + "%" : juce::String ("--")));
+    }
+
+    return parts.joinIntoString ("  ");
+}
 }
 
 class THDAnalyzerPluginEditor::WaveformMiniDisplay final : public juce::Component
 {
 public:
-    void setLevel (float newLevel)
+    void setWaveform (const ChannelWaveform& newWaveform)
     {
-        targetLevel = juce::jlimit (0.0f, 1.0f, newLevel);
+        waveform = newWaveform;
         repaint();
     }
 
@@ -100,32 +130,44 @@ public:
         g.setColour (ColorPalette::borderA.withAlpha (0.8f));
         g.drawRoundedRectangle (bounds.reduced (0.5f), 8.0f, 1.0f);
 
-        level = (level * 0.8f) + (targetLevel * 0.2f);
+        auto trace = bounds.reduced (6.0f, 4.0f);
+        const auto centreY = trace.getCentreY();
 
-        juce::Path wave;
-        const auto width = juce::jmax (1.0f, bounds.getWidth() - 12.0f);
-        const auto centreY = bounds.getCentreY();
-        const auto amplitude = 4.0f + (level * 12.0f);
-        wave.startNewSubPath (bounds.getX() + 6.0f, centreY);
+        // Points are steps of the span's own peak; the peak maps to height on a -60..0 dB scale,
+        // so the shape stays readable on quiet channels while louder ones still fill more.
+        const auto peakDb = juce::Decibels::gainToDecibels (waveform.scale, -60.0f);
+        const auto halfHeight = 0.5f * trace.getHeight() * juce::jmap (peakDb, -60.0f, 0.0f, 0.12f, 1.0f);
+        const auto toY = [centreY, halfHeight] (int8_t step) { return centreY - halfHeight * static_cast<float> (step) / 127.0f; };
 
-        constexpr int points = 40;
-        for (int i = 1; i <= points; ++i)
-        {
-            const auto x = bounds.getX() + 6.0f + (width * static_cast<float> (i) / static_cast<float> (points));
-            const auto t = (phase + static_cast<float> (i) * 0.35f);
-            const auto y = centreY + amplitude * std::sin (t) * std::exp (-0.02f * static_cast<float> (i));
-            wave.lineTo (x, y);
-        }
+        g.setColour (ColorPalette::borderA.withAlpha (0.5f));
+        g.drawHorizontalLine (juce::roundToInt (centreY), trace.getX(), trace.getRight());
 
-        phase += 0.18f;
-        g.setColour (ColorPalette::accentBlue.withAlpha (0.85f));
-        g.strokePath (wave, juce::PathStrokeType (1.4f, juce::PathStrokeType::curved, juce::PathStrokeType::rounded));
+        if (waveform.scale <= 0.0f)
+            return;
+
+        // Min/max envelope: along the maxima, then back along the minima.
+        juce::Path envelope;
+        const auto xStep = trace.getWidth() / static_cast<float> (ChannelWaveform::numPoints - 1);
+        envelope.startNewSubPath (trace.getX(), toY (waveform.maximum[0]));
+
+        for (int i = 1; i < ChannelWaveform::numPoints; ++i)
+            envelope.lineTo (trace.getX() + xStep * static_cast<float> (i), toY (waveform.maximum[static_cast<size_t> (i)]));
+
+        for (int i = ChannelWaveform::numPoints - 1; i >= 0; --i)
+            envelope.lineTo (trace.getX() + xStep * static_cast<float> (i), toY (waveform.minimum[static_cast<size_t> (i)]));
+
+        envelope.closeSubPath();
+
+        // Free-running (no fundamental to trigger on) traces are drawn dimmer.
+        const auto alpha = waveform.triggered ? 0.85f : 0.45f;
+        g.setColour (ColorPalette::accentBlue.withAlpha (alpha * 0.45f));
+        g.fillPath (envelope);
+        g.setColour (ColorPalette::accentBlue.withAlpha (alpha));
+        g.strokePath (envelope, juce::PathStrokeType (1.0f));
     }
 
 private:
-    float level = 0.0f;
-    float targetLevel = 0.0f;
-    float phase = 0.0f;
+    ChannelWaveform waveform;
 };
 
 class THDAnalyzerPluginEditor::MasterGaugeDisplay final : public juce::Component,
@@ -265,6 +307,94 @@ private:
     bool masterHotspotMode = false;
 };
 
+// Last hour of one channel's THD+N, one column per trend block: the block's
+// min..max as a band, its mean as the line. Drawn straight from the block
+// summaries, so no samples are decoded.
+class THDAnalyzerPluginEditor::TrendSparkline final : public juce::Component,
+                                                       public juce::SettableTooltipClient
+{
+public:
+    explicit TrendSparkline (juce::Colour colourToUse)
+        : colour (colourToUse)
+    {
+        setTooltip ("THD+N, last " + juce::String (juce::roundToInt (THDAnalyzerPlugin::TrendStore::defaultSamplePeriodSeconds
+                                                                    * THDAnalyzerPlugin::TrendStore::samplesPerSeries / 60.0))
+                    + " min (min / max band, mean line)");
+    }
+
+    void update (const THDAnalyzerPlugin::TrendStore& trends, int channelId)
+    {
+        const auto newestBlock = trends.getNewestBlock();
+        const auto hadData = hasData;
+
+        if (! trends.readSummaries (channelId, THDAnalyzerPlugin::TrendStore::thdN, newestBlock, summaries))
+            return;
+
+        hasData = std::any_of (summaries.begin(), summaries.end(), [] (const auto& block) { return block.count > 0; });
+
+        // Within a block only the newest column changes, but its band can still grow, so repaint either way.
+        if (hasData || hadData)
+            repaint();
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+        g.setColour (ColorPalette::surfaceB.withAlpha (0.9f));
+        g.fillRoundedRectangle (bounds, 4.0f);
+
+        auto plotArea = bounds.reduced (3.0f, 2.0f);
+        if (! hasData)
+            return;
+
+        float peak = 0.0f;
+        for (const auto& block : summaries)
+            if (block.count > 0)
+                peak = juce::jmax (peak, block.maximum);
+
+        const auto scale = juce::jmax (0.5f, peak);
+        const auto toY = [&plotArea, scale] (float value)
+        {
+            return plotArea.getBottom() - plotArea.getHeight() * juce::jlimit (0.0f, 1.0f, value / scale);
+        };
+
+        const auto columnWidth = plotArea.getWidth() / static_cast<float> (summaries.size());
+        juce::Path meanLine;
+        auto lineOpen = false;
+
+        for (size_t i = 0; i < summaries.size(); ++i)
+        {
+            const auto& block = summaries[i];
+            if (block.count == 0)
+            {
+                lineOpen = false;
+                continue;
+            }
+
+            const auto x = plotArea.getX() + columnWidth * static_cast<float> (i);
+            const auto top = toY (block.maximum);
+            g.setColour (colour.withAlpha (0.3f));
+            g.fillRect (x, top, juce::jmax (1.0f, columnWidth), juce::jmax (1.0f, toY (block.minimum) - top));
+
+            const auto centre = x + columnWidth * 0.5f;
+            if (lineOpen)
+                meanLine.lineTo (centre, toY (block.mean));
+            else
+                meanLine.startNewSubPath (centre, toY (block.mean));
+
+            lineOpen = true;
+        }
+
+        g.setColour (colour.withAlpha (0.9f));
+        g.strokePath (meanLine, juce::PathStrokeType (1.0f));
+    }
+
+private:
+    juce::Colour colour;
+    THDAnalyzerPlugin::TrendStore::Summaries summaries {};
+    bool hasData = false;
+};
+
 class THDAnalyzerPluginEditor::HistoryTimelineDisplay final : public juce::Component,
                                                                public juce::SettableTooltipClient
 {
@@ -313,6 +443,132 @@ private:
     std::vector<float> history;
 };
 
+#if THD_WITH_MASTER_BRAIN
+class THDAnalyzerPluginEditor::GroupTreeDisplay final : public juce::Component
+{
+public:
+    using Summaries = std::array<THDAnalyzerPlugin::GroupSummary, THDAnalyzerPlugin::maxChannelGroups>;
+
+    std::function<void (int group, int parent)> onParentChosen;
+
+    void setGroups (const Summaries& summariesToUse)
+    {
+        summaries = summariesToUse;
+        rebuildRowOrder();
+        repaint();
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+        g.setColour (ColorPalette::surfaceB.withAlpha (0.9f));
+        g.fillRoundedRectangle (bounds, 8.0f);
+        g.setColour (ColorPalette::borderA.withAlpha (0.8f));
+        g.drawRoundedRectangle (bounds.reduced (0.5f), 8.0f, 1.0f);
+
+        auto area = getLocalBounds().reduced (10, 6);
+        g.setColour (juce::Colours::white.withAlpha (0.45f));
+        g.setFont (makeMonoFont (8.0f, true));
+        g.drawText ("GROUPS (RIGHT-CLICK TO NEST)", area.removeFromTop (rowHeight), juce::Justification::centredLeft);
+
+        if (rowOrder.empty())
+        {
+            g.setColour (juce::Colours::white.withAlpha (0.35f));
+            g.setFont (makeMonoFont (8.0f));
+            g.drawText ("No grouped channels", area.removeFromTop (rowHeight), juce::Justification::centredLeft);
+            return;
+        }
+
+        for (const auto group : rowOrder)
+        {
+            if (area.getHeight() < rowHeight)
+                break;
+
+            const auto& summary = summaries[static_cast<size_t> (group)];
+            auto row = area.removeFromTop (rowHeight);
+            row.removeFromLeft (summary.depth * 10);
+
+            g.setColour (juce::Colours::white.withAlpha (0.78f));
+            g.setFont (makeMonoFont (8.0f, true));
+            g.drawText ("GRP " + juce::String (group + 1), row.removeFromLeft (48), juce::Justification::centredLeft);
+
+            g.setColour (juce::Colours::white.withAlpha (0.45f));
+            g.setFont (makeMonoFont (8.0f));
+            g.drawText (juce::String (summary.numChannels) + "ch", row.removeFromLeft (34), juce::Justification::centredLeft);
+
+            g.setColour (statusColourForThd (summary.rssThd).withAlpha (0.92f));
+            g.drawText ("THD " + juce::String (summary.rssThd, 2) + "%", row.removeFromLeft (86), juce::Justification::centredLeft);
+            g.setColour (ColorPalette::clean.withAlpha (0.85f));
+            g.drawText ("THD+N " + juce::String (summary.rssThdN, 2) + "%", row, juce::Justification::centredLeft);
+        }
+    }
+
+    void mouseDown (const juce::MouseEvent& event) override
+    {
+        if (! event.mods.isPopupMenu())
+            return;
+
+        const auto rowIndex = (event.getPosition().y - 6) / rowHeight - 1;
+        if (! juce::isPositiveAndBelow (rowIndex, static_cast<int> (rowOrder.size())))
+            return;
+
+        const auto group = rowOrder[static_cast<size_t> (rowIndex)];
+        const auto currentParent = summaries[static_cast<size_t> (group)].parent;
+
+        juce::PopupMenu menu;
+        menu.addSectionHeader ("GRP " + juce::String (group + 1) + " parent");
+        menu.addItem (1, "Master", true, currentParent == THDAnalyzerPlugin::GroupTree::noGroup);
+
+        for (int parent = 0; parent < THDAnalyzerPlugin::maxChannelGroups; ++parent)
+            if (parent != group)
+                menu.addItem (parent + 2, "GRP " + juce::String (parent + 1), true, currentParent == parent);
+
+        juce::Component::SafePointer<GroupTreeDisplay> safeThis (this);
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (this), [safeThis, group] (int result)
+        {
+            if (safeThis == nullptr || result == 0 || safeThis->onParentChosen == nullptr)
+                return;
+
+            safeThis->onParentChosen (group, result == 1 ? THDAnalyzerPlugin::GroupTree::noGroup : result - 2);
+        });
+    }
+
+private:
+    static constexpr int rowHeight = 14;
+
+    // Depth-first order so nested groups render directly under their parent.
+    void rebuildRowOrder()
+    {
+        rowOrder.clear();
+
+        std::function<void (int)> visit = [this, &visit] (int parent)
+        {
+            for (int group = 0; group < THDAnalyzerPlugin::maxChannelGroups; ++group)
+            {
+                const auto& summary = summaries[static_cast<size_t> (group)];
+                if (summary.parent != parent)
+                    continue;
+
+                if (summary.numChannels > 0 || summary.parent != THDAnalyzerPlugin::GroupTree::noGroup || hasChildren (group))
+                    rowOrder.push_back (group);
+
+                visit (group);
+            }
+        };
+
+        visit (THDAnalyzerPlugin::GroupTree::noGroup);
+    }
+
+    bool hasChildren (int group) const
+    {
+        return std::any_of (summaries.begin(), summaries.end(), [group] (const THDAnalyzerPlugin::GroupSummary& s) { return s.parent == group; });
+    }
+
+    Summaries summaries {};
+    std::vector<int> rowOrder;
+};
+#endif
+
 class Badge final : public juce::Component
 {
 public:
@@ -427,13 +683,125 @@ private:
     float value = 0.0f;
 };
 
+#if THD_WITH_MASTER_BRAIN
+// Every channel's third-octave long-term average spectrum on one log-frequency
+// axis, in its channel colour; muted (or un-soloed) channels are drawn faint.
+class THDAnalyzerPluginEditor::LtasOverlayDisplay final : public juce::Component
+{
+public:
+    void setChannels (const std::vector<ChannelData>& channels)
+    {
+        std::vector<Trace> newTraces;
+        newTraces.reserve (channels.size());
+
+        const auto anySoloed = std::any_of (channels.begin(), channels.end(), [] (const ChannelData& c) { return c.soloed; });
+
+        for (const auto& channel : channels)
+            if (channel.ltasHops > 0)
+                newTraces.push_back ({ channel.channelColor, channel.ltasDb, channel.muted || (anySoloed && ! channel.soloed) });
+
+        if (newTraces == traces)
+            return;
+
+        traces = std::move (newTraces);
+        repaint();
+    }
+
+    void paint (juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+        g.setColour (ColorPalette::surfaceB.withAlpha (0.9f));
+        g.fillRoundedRectangle (bounds, 8.0f);
+        g.setColour (ColorPalette::borderA.withAlpha (0.8f));
+        g.drawRoundedRectangle (bounds.reduced (0.5f), 8.0f, 1.0f);
+
+        auto area = bounds.reduced (10.0f, 6.0f);
+        g.setColour (juce::Colours::white.withAlpha (0.45f));
+        g.setFont (makeMonoFont (8.0f, true));
+        g.drawText ("LTAS 1/3 OCT (dB FS)", area.removeFromTop (12.0f).toNearestInt(), juce::Justification::centredLeft);
+
+        auto plotArea = area.withTrimmedTop (2.0f).withTrimmedBottom (10.0f);
+        const auto lastBand = static_cast<float> (LongTermSpectrum::numBands - 1);
+        const auto toX = [&plotArea, lastBand] (int band) { return plotArea.getX() + plotArea.getWidth() * static_cast<float> (band) / lastBand; };
+        const auto toY = [&plotArea] (float db) { return plotArea.getY() + plotArea.getHeight() * juce::jlimit (0.0f, 1.0f, db / floorDb); };
+
+        // Decade lines at 100 Hz, 1 kHz, 10 kHz (bands 7, 17, 27) and every 20 dB.
+        g.setFont (makeMonoFont (7.0f));
+        static const std::pair<int, const char*> decades[] = { { 7, "100" }, { 17, "1k" }, { 27, "10k" } };
+        for (const auto& [band, label] : decades)
+        {
+            g.setColour (ColorPalette::borderA.withAlpha (0.7f));
+            g.drawVerticalLine (juce::roundToInt (toX (band)), plotArea.getY(), plotArea.getBottom());
+            g.setColour (juce::Colours::white.withAlpha (0.35f));
+            g.drawText (label, juce::Rectangle<float> (toX (band) - 15.0f, plotArea.getBottom(), 30.0f, 10.0f).toNearestInt(),
+                        juce::Justification::centred);
+        }
+
+        g.setColour (ColorPalette::borderA.withAlpha (0.5f));
+        for (auto db = -20.0f; db > floorDb; db -= 20.0f)
+            g.drawHorizontalLine (juce::roundToInt (toY (db)), plotArea.getX(), plotArea.getRight());
+
+        // Faint traces first, so the contributing channels sit on top.
+        for (const auto drawFaint : { true, false })
+        {
+            for (const auto& trace : traces)
+            {
+                if (trace.faint != drawFaint)
+                    continue;
+
+                juce::Path line;
+                auto lineOpen = false;
+
+                for (int band = 0; band < LongTermSpectrum::numBands; ++band)
+                {
+                    const auto db = trace.levelsDb[static_cast<size_t> (band)];
+                    if (db <= LongTermSpectrum::minimumDb)
+                    {
+                        lineOpen = false;
+                        continue;
+                    }
+
+                    if (lineOpen)
+                        line.lineTo (toX (band), toY (db));
+                    else
+                        line.startNewSubPath (toX (band), toY (db));
+
+                    lineOpen = true;
+                }
+
+                g.setColour (trace.colour.withAlpha (trace.faint ? 0.25f : 0.85f));
+                g.strokePath (line, juce::PathStrokeType (1.2f));
+            }
+        }
+    }
+
+private:
+    static constexpr float floorDb = -100.0f;
+
+    struct Trace
+    {
+        juce::Colour colour;
+        LongTermSpectrum::Bands levelsDb;
+        bool faint = false;
+
+        bool operator== (const Trace& other) const noexcept
+        {
+            return colour == other.colour && levelsDb == other.levelsDb && faint == other.faint;
+        }
+    };
+
+    std::vector<Trace> traces;
+};
+#endif
+
 class THDAnalyzerPluginEditor::ChannelCard final : public juce::Component
 {
 public:
     ChannelCard (THDAnalyzerPlugin& processorToUse, UIChannelModel channel)
-        : processor (processorToUse), model (std::move (channel))
+        : processor (processorToUse), model (std::move (channel)), sparkline (model.color)
     {
         addAndMakeVisible (waveform);
+        addAndMakeVisible (sparkline);
         addAndMakeVisible (badge);
         addAndMakeVisible (vuMeter);
 
@@ -444,7 +812,7 @@ public:
         configureButton (muteButton, "M");
         configureButton (soloButton, "S");
 
-        if (juce::isPositiveAndBelow (model.channelId, 8))
+        if (juce::isPositiveAndBelow (model.channelId, THDAnalyzerPlugin::numAutomatableMuteSoloChannels))
         {
             auto& state = processor.getValueTreeState();
             muteAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment> (
@@ -459,8 +827,11 @@ public:
         }
         else
         {
-            muteButton.setEnabled (false);
-            soloButton.setEnabled (false);
+            // Channels beyond the automatable subset write straight into the processor bitsets.
+            muteButton.setTooltip ("Mute/solo for this channel is stored with the session but not host-automatable.");
+            soloButton.setTooltip ("Mute/solo for this channel is stored with the session but not host-automatable.");
+            muteButton.onClick = [this] { processor.setChannelMuted (model.channelId, muteButton.getToggleState()); };
+            soloButton.onClick = [this] { processor.setChannelSoloed (model.channelId, soloButton.getToggleState()); };
         }
 
         setInterceptsMouseClicks (true, true);
@@ -507,7 +878,9 @@ public:
         auto area = getLocalBounds().reduced (7);
         area.removeFromTop (18);
 
-        waveform.setBounds (area.removeFromTop (50));
+        waveform.setBounds (area.removeFromTop (32));
+        area.removeFromTop (2);
+        sparkline.setBounds (area.removeFromTop (16));
         area.removeFromTop (4);
         thdLabel.setBounds (area.removeFromTop (15));
         badge.setBounds (area.removeFromTop (14).withTrimmedLeft (10).withTrimmedRight (10));
@@ -539,13 +912,24 @@ public:
         const auto& channelData = *it;
         model.thdN = static_cast<float> (channelData.thdN);
 
+        if (muteAttachment == nullptr)
+        {
+            muteButton.setToggleState (channelData.muted, juce::dontSendNotification);
+            soloButton.setToggleState (channelData.soloed, juce::dontSendNotification);
+        }
+
         const auto statusColour = statusColourForThd (model.thdN);
         thdLabel.setText (juce::String (model.thdN, 2) + "% THD+N", juce::dontSendNotification);
         thdLabel.setColour (juce::Label::textColourId, statusColour);
+        thdLabel.setTooltip (channelData.numBands > 0 ? "THD by band: " + describeBands (channelData.bands, channelData.numBands)
+                                                      : juce::String());
         badge.setBadge (statusTextForThd (model.thdN), statusColour);
         const auto channelPeak = juce::jlimit (0.0f, 1.0f, static_cast<float> (channelData.peakLevel));
         vuMeter.setLevel (channelPeak);
-        waveform.setLevel (channelPeak + juce::jlimit (0.0f, 0.2f, static_cast<float> (channelData.level) * 0.15f));
+        waveform.setWaveform (channelData.waveform);
+
+        if (const auto* trends = processor.getTrendStore())
+            sparkline.update (*trends, model.channelId);
 
         hoverMix = juce::jlimit (0.35f, 1.0f, hoverMix + (hovered ? 0.08f : -0.08f));
         repaint();
@@ -570,6 +954,7 @@ private:
     THDAnalyzerPlugin& processor;
     UIChannelModel model;
     WaveformMiniDisplay waveform;
+    TrendSparkline sparkline;
     Badge badge;
     VUMeter vuMeter;
     juce::Label thdLabel;
@@ -692,8 +1077,81 @@ void THDAnalyzerPluginEditor::configureModeControls()
     };
     addAndMakeVisible (displayModeCombo);
 
+    channelGroupLabel.setText ("GROUP", juce::dontSendNotification);
+    channelGroupLabel.setFont (makeMonoFont (8.0f, true));
+    channelGroupLabel.setColour (juce::Label::textColourId, juce::Colours::white.withAlpha (0.7f));
+    addAndMakeVisible (channelGroupLabel);
+
+    channelGroupCombo.addItem ("None", 1);
+    for (int group = 0; group < THDAnalyzerPlugin::maxChannelGroups; ++group)
+        channelGroupCombo.addItem ("Group " + juce::String (group + 1), group + 2);
+    channelGroupCombo.setTooltip ("Group/bus this channel aggregates into on the Master Brain");
+    channelGroupCombo.setColour (juce::ComboBox::backgroundColourId, ColorPalette::surfaceA.brighter (0.35f));
+    channelGroupCombo.setColour (juce::ComboBox::outlineColourId, ColorPalette::borderA.brighter (0.2f));
+    channelGroupCombo.setColour (juce::ComboBox::textColourId, juce::Colours::white.withAlpha (0.92f));
+    addAndMakeVisible (channelGroupCombo);
+
+    analysisLayoutLabel.setText ("ANALYSIS", juce::dontSendNotification);
+    analysisLayoutLabel.setFont (makeMonoFont (8.0f, true));
+    analysisLayoutLabel.setColour (juce::Label::textColourId, juce::Colours::white.withAlpha (0.7f));
+    addAndMakeVisible (analysisLayoutLabel);
+
+    analysisLayoutCombo.addItem ("Mono Sum", 1);
+    analysisLayoutCombo.addItem ("Per Side", 2);
+    analysisLayoutCombo.addItem ("Reference", 3);
+    analysisLayoutCombo.addItem ("Fast Fit", 4);
+    analysisLayoutCombo.setTooltip ("Per Side analyses left and right independently and reports the worse side; "
+                                    "Reference measures distortion against the clean signal on the Reference sidechain; "
+                                    "Fast Fit reads THD from a harmonic fit of the last 2048 samples, four times per FFT hop");
+    analysisLayoutCombo.setColour (juce::ComboBox::backgroundColourId, ColorPalette::surfaceA.brighter (0.35f));
+    analysisLayoutCombo.setColour (juce::ComboBox::outlineColourId, ColorPalette::borderA.brighter (0.2f));
+    analysisLayoutCombo.setColour (juce::ComboBox::textColourId, juce::Colours::white.withAlpha (0.92f));
+    addAndMakeVisible (analysisLayoutCombo);
+
+    multibandLabel.setText ("BANDS", juce::dontSendNotification);
+    multibandLabel.setFont (makeMonoFont (8.0f, true));
+    multibandLabel.setColour (juce::Label::textColourId, juce::Colours::white.withAlpha (0.7f));
+    addAndMakeVisible (multibandLabel);
+
+    multibandCombo.addItem ("Off", 1);
+    multibandCombo.addItem ("3 Bands", 2);
+    multibandCombo.addItem ("4 Bands", 3);
+    multibandCombo.setTooltip ("Also reports THD per frequency band (crossovers at 250 Hz and 4 kHz, or 200 Hz, 1 kHz and 5 kHz), "
+                               "split from the same FFT; not available with the Reference layout");
+    multibandCombo.setColour (juce::ComboBox::backgroundColourId, ColorPalette::surfaceA.brighter (0.35f));
+    multibandCombo.setColour (juce::ComboBox::outlineColourId, ColorPalette::borderA.brighter (0.2f));
+    multibandCombo.setColour (juce::ComboBox::textColourId, juce::Colours::white.withAlpha (0.92f));
+    addAndMakeVisible (multibandCombo);
+
+    calibrateButton.setButtonText ("CAL");
+    calibrateButton.setColour (juce::TextButton::buttonColourId, ColorPalette::surfaceA.brighter (0.35f));
+    calibrateButton.setColour (juce::TextButton::buttonOnColourId, ColorPalette::accentBlue.withAlpha (0.35f));
+    calibrateButton.setColour (juce::TextButton::textColourOffId, juce::Colours::white.withAlpha (0.75f));
+    calibrateButton.setColour (juce::TextButton::textColourOnId, juce::Colours::white);
+    calibrateButton.onClick = [this] { processor.startCalibrationCapture(); };
+    addAndMakeVisible (calibrateButton);
+
+    // Single-mode builds have no "pluginMode" parameter (and only their own mode's
+    // controls); the mode combo then just shows which plugin this is.
     auto& state = processor.getValueTreeState();
-    pluginModeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (state, "pluginMode", pluginModeCombo);
+    const auto attach = [&state] (const juce::String& parameterId, juce::ComboBox& combo)
+    {
+        return state.getParameter (parameterId) != nullptr
+            ? std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (state, parameterId, combo)
+            : nullptr;
+    };
+
+    pluginModeAttachment = attach ("pluginMode", pluginModeCombo);
+    channelGroupAttachment = attach ("channelGroup", channelGroupCombo);
+    analysisLayoutAttachment = attach ("analysisLayout", analysisLayoutCombo);
+    multibandAttachment = attach ("multiband", multibandCombo);
+
+    if (pluginModeAttachment == nullptr)
+    {
+        pluginModeCombo.setSelectedId (processor.getPluginMode() == PluginMode::MasterBrain ? 2 : 1, juce::dontSendNotification);
+        pluginModeCombo.setEnabled (false);
+        pluginModeCombo.setTooltip ("This build runs a single mode");
+    }
 
     updateControlVisibility();
 }
@@ -703,6 +1161,21 @@ void THDAnalyzerPluginEditor::updateControlVisibility()
     const auto isMasterMode = pluginModeCombo.getSelectedId() == 2;
     displayModeLabel.setVisible (isMasterMode);
     displayModeCombo.setVisible (isMasterMode);
+    channelGroupLabel.setVisible (! isMasterMode);
+    channelGroupCombo.setVisible (! isMasterMode);
+    analysisLayoutLabel.setVisible (! isMasterMode);
+    analysisLayoutCombo.setVisible (! isMasterMode);
+    multibandLabel.setVisible (! isMasterMode);
+    multibandCombo.setVisible (! isMasterMode);
+    calibrateButton.setVisible (! isMasterMode);
+
+   #if THD_WITH_MASTER_BRAIN
+    if (groupTreeDisplay != nullptr)
+        groupTreeDisplay->setVisible (isMasterMode);
+
+    if (ltasOverlayDisplay != nullptr)
+        ltasOverlayDisplay->setVisible (isMasterMode);
+   #endif
 
     channelViewport.setVisible (isMasterMode);
 
@@ -762,14 +1235,28 @@ THDAnalyzerPluginEditor::THDAnalyzerPluginEditor (THDAnalyzerPlugin& p)
     addAndMakeVisible (*harmonicSpectrumDisplay);
     addAndMakeVisible (*historyTimelineDisplay);
 
+   #if THD_WITH_MASTER_BRAIN
+    groupTreeDisplay = std::make_unique<GroupTreeDisplay>();
+    groupTreeDisplay->onParentChosen = [this] (int group, int parent)
+    {
+        processor.setChannelGroupParent (group, parent);
+    };
+    addChildComponent (*groupTreeDisplay);
+
+    ltasOverlayDisplay = std::make_unique<LtasOverlayDisplay>();
+    addChildComponent (*ltasOverlayDisplay);
+   #endif
+    updateControlVisibility();
+
     setSize (1120, 760);
 
-    startTimerHz (20);
+    // All editors in the process share one budgeted frame tick (about 20 Hz each).
+    tickDispatcher->add (*this, *this);
 }
 
 THDAnalyzerPluginEditor::~THDAnalyzerPluginEditor()
 {
-    stopTimer();
+    tickDispatcher->remove (*this);
 }
 
 void THDAnalyzerPluginEditor::paint (juce::Graphics& g)
@@ -809,6 +1296,18 @@ void THDAnalyzerPluginEditor::paint (juce::Graphics& g)
         g.setColour (juce::Colours::white.withAlpha (0.85f));
         g.setFont (makeMonoFont (10.0f, true));
         g.drawText ("CHANNEL STRIP MODE - LOCAL ANALYZER", channelSection.reduced (14, 10), juce::Justification::centredLeft);
+
+        MultibandAnalysis::Readings bands;
+        if (const auto numBands = processor.getLastBandReadings (bands); numBands > 0)
+        {
+            auto bandRow = channelSection.reduced (14, 8).removeFromBottom (12);
+            g.setColour (juce::Colours::white.withAlpha (0.45f));
+            g.setFont (makeMonoFont (8.0f, true));
+            g.drawText ("THD BY BAND", bandRow.removeFromLeft (80), juce::Justification::centredLeft);
+            g.setColour (juce::Colours::white.withAlpha (0.8f));
+            g.setFont (makeMonoFont (8.5f));
+            g.drawText (describeBands (bands, numBands), bandRow, juce::Justification::centredLeft);
+        }
     }
 
     auto masterArea = isMasterMode
@@ -902,6 +1401,13 @@ void THDAnalyzerPluginEditor::resized()
     pluginModeCombo.setBounds (24, 74, 148, 24);
     displayModeLabel.setBounds (184, 58, 70, 16);
     displayModeCombo.setBounds (184, 74, 120, 24);
+    channelGroupLabel.setBounds (184, 58, 70, 16);
+    channelGroupCombo.setBounds (184, 74, 120, 24);
+    analysisLayoutLabel.setBounds (316, 58, 70, 16);
+    analysisLayoutCombo.setBounds (316, 74, 120, 24);
+    calibrateButton.setBounds (442, 74, 44, 24);
+    multibandLabel.setBounds (498, 58, 70, 16);
+    multibandCombo.setBounds (498, 74, 92, 24);
 
     const auto isMasterMode = pluginModeCombo.getSelectedId() == 2;
 
@@ -936,6 +1442,14 @@ void THDAnalyzerPluginEditor::resized()
     const int rightX = statsX + columnWidth + columnGap;
     harmonicSpectrumDisplay->setBounds (rightX, contentTop, columnWidth, 122);
     historyTimelineDisplay->setBounds (rightX, contentTop + 142, columnWidth, 80);
+
+   #if THD_WITH_MASTER_BRAIN
+    if (groupTreeDisplay != nullptr)
+        groupTreeDisplay->setBounds (contentLeft, contentTop + 172, columnWidth, 150);
+
+    if (ltasOverlayDisplay != nullptr)
+        ltasOverlayDisplay->setBounds (rightX, contentTop + 232, columnWidth, 120);
+   #endif
 }
 
 float THDAnalyzerPluginEditor::applyBallistics (float input, float previous, double dtSeconds, double attackTauSeconds, double releaseTauSeconds)
@@ -947,7 +1461,12 @@ float THDAnalyzerPluginEditor::applyBallistics (float input, float previous, dou
     return input + (previous - input) * static_cast<float> (coeff);
 }
 
-void THDAnalyzerPluginEditor::timerCallback()
+uint64_t THDAnalyzerPluginEditor::getTickDataVersion() const
+{
+    return processor.getEditorDataVersion();
+}
+
+void THDAnalyzerPluginEditor::tick()
 {
     if (! processor.isEditorDataReady())
         return;
@@ -980,51 +1499,33 @@ void THDAnalyzerPluginEditor::timerCallback()
     float averageThd = measuredThd;
     float maxPeak = measuredThd;
 
+    // Master-mode aggregation (mute/solo aware) is computed on the audio thread.
+    const auto masterAggregate = processor.getMasterAggregate();
+
     if (isMasterMode)
     {
-        double sumThd = 0.0;
-        double sumThdSquared = 0.0;
-        double sumThdNSquared = 0.0;
-        float maxChannelThd = 0.0f;
-        int countedChannels = 0;
-
-        for (const auto& channel : snapshotChannels)
-        {
-            const auto chThd = juce::jlimit (0.0f, 100.0f, static_cast<float> (channel.thd));
-            const auto chThdN = juce::jlimit (0.0f, 100.0f, static_cast<float> (channel.thdN));
-
-            sumThd += chThd;
-            sumThdSquared += static_cast<double> (chThd) * chThd;
-            sumThdNSquared += static_cast<double> (chThdN) * chThdN;
-            maxChannelThd = juce::jmax (maxChannelThd, chThd);
-            ++countedChannels;
-        }
-
-        if (countedChannels > 0)
-        {
-            const auto invCount = 1.0 / static_cast<double> (countedChannels);
-            averageThd = static_cast<float> (sumThd * invCount);
-            aggregateMasterThd = static_cast<float> (std::sqrt (sumThdSquared * invCount));
-            aggregateMasterThdN = static_cast<float> (std::sqrt (sumThdNSquared * invCount));
-            maxPeak = maxChannelThd;
-        }
-        else
-        {
-            aggregateMasterThd = 0.0f;
-            aggregateMasterThdN = 0.0f;
-            averageThd = 0.0f;
-            maxPeak = 0.0f;
-        }
+       #if THD_WITH_MASTER_BRAIN
+        if (groupTreeDisplay != nullptr)
+            groupTreeDisplay->setGroups (processor.getGroupSummaries());
+
+        if (ltasOverlayDisplay != nullptr)
+            ltasOverlayDisplay->setChannels (snapshotChannels);
+       #endif
+
+        averageThd = masterAggregate.averageThd;
+        aggregateMasterThd = masterAggregate.rssThd;
+        aggregateMasterThdN = masterAggregate.rssThdN;
+        maxPeak = masterAggregate.peakThd;
     }
 
     const auto nowMs = juce::Time::getMillisecondCounterHiRes();
     double dtSeconds = 1.0 / 20.0;
-    if (lastTimerCallbackMs > 0.0)
-        dtSeconds = (nowMs - lastTimerCallbackMs) / 1000.0;
-    lastTimerCallbackMs = nowMs;
+    if (lastTickMs > 0.0)
+        dtSeconds = (nowMs - lastTickMs) / 1000.0;
+    lastTickMs = nowMs;
 
     latestAnalysisConfidence = juce::jlimit (0.0f, 1.0f, analysis.analysisConfidence);
-    const bool analysisValid = isMasterMode ? (! snapshotChannels.empty()) : analysis.fundamentalValid;
+    const bool analysisValid = isMasterMode ? (masterAggregate.numContributingChannels > 0) : analysis.fundamentalValid;
     if (analysisValid)
     {
         lastValidMasterThd = aggregateMasterThd;
@@ -1054,19 +1555,8 @@ void THDAnalyzerPluginEditor::timerCallback()
     if (isMasterMode)
     {
         std::fill (harmonicTargets.begin(), harmonicTargets.end(), 0.0f);
-
-        if (! snapshotChannels.empty())
-        {
-            for (const auto& channel : snapshotChannels)
-            {
-                for (size_t i = 0; i < harmonicTargets.size() && i < channel.harmonics.size(); ++i)
-                    harmonicTargets[i] += juce::jlimit (0.0f, 1.0f, static_cast<float> (channel.harmonics[i]));
-            }
-
-            const auto invCount = 1.0f / static_cast<float> (snapshotChannels.size());
-            for (auto& value : harmonicTargets)
-                value *= invCount;
-        }
+        for (size_t i = 0; i < harmonicTargets.size() && i < masterAggregate.harmonics.size(); ++i)
+            harmonicTargets[i] = masterAggregate.harmonics[i];
     }
 
     for (size_t i = 0; i < smoothedHarmonics.size(); ++i)
@@ -1090,7 +1580,7 @@ void THDAnalyzerPluginEditor::timerCallback()
 
             for (const auto& channel : snapshotChannels)
             {
-                if (i >= channel.harmonics.size())
+                if (i >= channel.harmonics.size() || ! masterAggregate.isContributing (channel.channelId))
                     continue;
 
                 const auto contribution = juce::jlimit (0.0f, 1.0f,
@@ -1117,6 +1607,39 @@ void THDAnalyzerPluginEditor::timerCallback()
         ? "THD hotspot map by harmonic; bar colour follows dominant channel colour"
         : ("Fundamental " + juce::String (analysis.fundamentalFrequency, 1) + " Hz | Confidence " + juce::String (latestAnalysisConfidence, 2)));
 
+    if (! isMasterMode)
+    {
+        // The Reference layout shows the sidechain latency it locked to, Fast Fit whether it is fitting.
+        auto layoutText = juce::String ("ANALYSIS");
+        if (analysisLayoutCombo.getSelectedId() == 3)
+        {
+            const auto reference = processor.getReferenceStatus();
+            layoutText = ! reference.connected ? "NO SIDECHAIN"
+                       : reference.locked      ? "REF " + juce::String (reference.latencySamples) + " SMP"
+                                               : "REF SEARCHING";
+        }
+        else if (analysisLayoutCombo.getSelectedId() == 4)
+        {
+            layoutText = processor.isFastFitLocked() ? "FIT " + juce::String (THDAnalyzerPlugin::fastFitFrameSize) + " SMP"
+                                                     : "FIT FFT FALLBACK";
+        }
+
+        // A calibration capture overrides the layout while it runs.
+        const auto calibration = processor.getCalibrationStatus();
+        if (calibration.capturing)
+            layoutText = "CAL " + juce::String (juce::roundToInt (calibration.captureProgress * 100.0f)) + "%";
+
+        analysisLayoutLabel.setText (layoutText, juce::dontSendNotification);
+
+        calibrateButton.setEnabled (! calibration.capturing);
+        calibrateButton.setToggleState (calibration.profileLoaded, juce::dontSendNotification);
+        calibrateButton.setTooltip (calibration.profileLoaded
+            ? "Residual correction profile loaded for this sample rate. Click to capture a new one "
+              "(10 s, interface output looped back to this input)"
+            : "No residual correction profile for this sample rate. Loop the interface output back to this input, "
+              "optionally with a test tone, and click to capture one (10 s)");
+    }
+
     historyTimelineDisplay->pushValue (smoothedMasterThdN);
     historyTimelineDisplay->setTooltip ("Noise floor " + juce::String (smoothedNoiseFloor, 5));
 
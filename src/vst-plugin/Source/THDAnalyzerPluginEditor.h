@@ -1,10 +1,11 @@
 #pragma once
 
+#include "EditorTickDispatcher.h"
 #include "THDAnalyzerPlugin.h"
 #include <array>
 
 class THDAnalyzerPluginEditor final : public juce::AudioProcessorEditor,
-                                      private juce::Timer
+                                      private EditorTickDispatcher::Client
 {
 public:
     explicit THDAnalyzerPluginEditor (THDAnalyzerPlugin&);
@@ -14,7 +15,8 @@ public:
     void resized() override;
 
 private:
-    void timerCallback() override;
+    uint64_t getTickDataVersion() const override;
+    void tick() override;
 
     static float applyBallistics (float input, float previous, double dtSeconds, double attackTauSeconds, double releaseTauSeconds);
 
@@ -22,34 +24,52 @@ private:
     class ChannelCard;
     class ProgressBarRow;
     class WaveformMiniDisplay;
+    class TrendSparkline;
     class MasterGaugeDisplay;
     class HarmonicSpectrumDisplay;
     class HistoryTimelineDisplay;
+   #if THD_WITH_MASTER_BRAIN
+    class GroupTreeDisplay;
+    class LtasOverlayDisplay;
+   #endif
 
     void configureModeControls();
     void updateControlVisibility();
     void rebuildChannelCards();
 
     THDAnalyzerPlugin& processor;
+    EditorTickDispatcher::Pointer tickDispatcher;
 
     std::unique_ptr<HeaderBar> headerBar;
     juce::Component channelViewportContent;
     juce::Viewport channelViewport;
     std::vector<std::unique_ptr<ChannelCard>> channelCards;
-    std::array<std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>, 8> muteAttachments;
-    std::array<std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>, 8> soloAttachments;
 
     juce::ComboBox pluginModeCombo;
     juce::ComboBox displayModeCombo;
     juce::Label pluginModeLabel;
     juce::Label displayModeLabel;
+    juce::ComboBox channelGroupCombo;
+    juce::Label channelGroupLabel;
+    juce::ComboBox analysisLayoutCombo;
+    juce::Label analysisLayoutLabel;
+    juce::ComboBox multibandCombo;
+    juce::Label multibandLabel;
+    juce::TextButton calibrateButton;
 
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> pluginModeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> channelGroupAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> analysisLayoutAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> multibandAttachment;
 
 
     std::unique_ptr<MasterGaugeDisplay> masterGaugeDisplay;
     std::unique_ptr<HarmonicSpectrumDisplay> harmonicSpectrumDisplay;
     std::unique_ptr<HistoryTimelineDisplay> historyTimelineDisplay;
+   #if THD_WITH_MASTER_BRAIN
+    std::unique_ptr<GroupTreeDisplay> groupTreeDisplay;
+    std::unique_ptr<LtasOverlayDisplay> ltasOverlayDisplay;
+   #endif
     std::vector<std::unique_ptr<ProgressBarRow>> progressRows;
 
     enum class DisplaySpeed
@@ -69,7 +89,7 @@ private:
     float lastValidMasterThdN = 0.0f;
     float latestAnalysisConfidence = 0.0f;
     bool hasSeenValidAnalysis = false;
-    double lastTimerCallbackMs = 0.0;
+    double lastTickMs = 0.0;
     std::vector<float> smoothedHarmonics = std::vector<float> (7, 0.0f);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (THDAnalyzerPluginEditor)
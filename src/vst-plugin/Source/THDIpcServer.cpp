@@ -0,0 +1,605 @@
+/* ==============================================================================
+   THD Analyzer Local IPC Server Implementation
+   ============================================================================== */
+
+#include "THDIpcServer.h"
+#include "THDRecordFormat.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if defined (__unix__) || defined (__APPLE__)
+ #define THD_IPC_HAS_UNIX_SOCKETS 1
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <sys/stat.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#else
+ #define THD_IPC_HAS_UNIX_SOCKETS 0
+#endif
+
+namespace
+{
+constexpr size_t maxPendingOutputBytes = 1u << 20;
+constexpr size_t maxLineBytes = 4096;
+
+double nowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli> (steady_clock::now().time_since_epoch()).count();
+}
+
+std::string trim (const std::string& text)
+{
+    const auto first = text.find_first_not_of (" \t\r\n");
+    if (first == std::string::npos)
+        return {};
+
+    const auto last = text.find_last_not_of (" \t\r\n");
+    return text.substr (first, last - first + 1);
+}
+
+bool parseInteger (const std::string& text, int64_t& value)
+{
+    if (text.empty())
+        return false;
+
+    char* end = nullptr;
+    errno = 0;
+    const auto parsed = std::strtoll (text.c_str(), &end, 10);
+    if (errno != 0 || end == nullptr || *end != 0)
+        return false;
+
+    value = static_cast<int64_t> (parsed);
+    return true;
+}
+}
+
+struct THDIpcServer::Client
+{
+    int fd = -1;
+    std::string inbox;
+    std::string outbox;
+    bool subscribed = false;
+    bool closeAfterFlush = false;
+    bool binaryFrames = false;
+    uint64_t subscribedMask = 0;
+    double intervalMs = 0.0;
+    double nextSendMs = 0.0;
+
+    /** Ends the subscription and marks the connection for closing, so no more frames are queued. */
+    void beginClose (bool discardPendingOutput) noexcept
+    {
+        subscribed = false;
+        closeAfterFlush = true;
+
+        if (discardPendingOutput)
+            outbox.clear();
+    }
+};
+
+THDIpcServer::THDIpcServer (std::string socketPathToUse, SnapshotProvider providerToUse, TimelineProvider timelineProviderToUse)
+    : socketPath (std::move (socketPathToUse)), provider (std::move (providerToUse)), timelineProvider (std::move (timelineProviderToUse))
+{
+    scratchRecords.reserve (maxChannels);
+}
+
+THDIpcServer::~THDIpcServer()
+{
+    stop();
+}
+
+std::string THDIpcServer::defaultSocketPath()
+{
+    if (const auto* configured = std::getenv ("THD_ANALYZER_SOCKET"); configured != nullptr && *configured != 0)
+        return configured;
+
+   #if THD_IPC_HAS_UNIX_SOCKETS
+    std::string directory = "/tmp";
+    if (const auto* runtimeDir = std::getenv ("XDG_RUNTIME_DIR"); runtimeDir != nullptr && *runtimeDir != 0)
+        directory = runtimeDir;
+
+    return directory + "/thd-analyzer-" + std::to_string (static_cast<long> (::getpid())) + ".sock";
+   #else
+    return {};
+   #endif
+}
+
+bool THDIpcServer::parseChannelList (const std::string& text, uint64_t& mask)
+{
+    static_assert (maxChannels == 64, "channel masks are a single 64-bit word");
+
+    const auto spec = trim (text);
+    if (spec == "all" || spec == "*")
+    {
+        mask = ~uint64_t { 0 };
+        return true;
+    }
+
+    mask = 0;
+    std::stringstream stream (spec);
+    std::string token;
+
+    while (std::getline (stream, token, ','))
+    {
+        token = trim (token);
+        if (token.empty())
+            return false;
+
+        int first = 0;
+        int last = 0;
+        char dash = 0;
+        std::stringstream tokenStream (token);
+
+        if (! (tokenStream >> first))
+            return false;
+
+        last = first;
+        if (tokenStream >> dash)
+        {
+            if (dash != '-' || ! (tokenStream >> last))
+                return false;
+        }
+
+        if (first < 0 || last >= maxChannels || first > last)
+            return false;
+
+        for (int channel = first; channel <= last; ++channel)
+            mask |= uint64_t { 1 } << channel;
+    }
+
+    return mask != 0;
+}
+
+std::string THDIpcServer::formatRecord (const THDIpcChannelRecord& record)
+{
+    char buffer[512];
+    auto written = std::snprintf (buffer, sizeof (buffer),
+                                  "CH id=%d seq=%llu thd=%.6g thdn=%.6g level=%.6g peak=%.6g group=%d h=",
+                                  record.channelId,
+                                  static_cast<unsigned long long> (record.sequence),
+                                  static_cast<double> (record.thd),
+                                  static_cast<double> (record.thdN),
+                                  static_cast<double> (record.level),
+                                  static_cast<double> (record.peakLevel),
+                                  record.groupIndex);
+
+    for (size_t i = 0; i < record.harmonics.size() && written > 0 && static_cast<size_t> (written) < sizeof (buffer); ++i)
+        written += std::snprintf (buffer + written, sizeof (buffer) - static_cast<size_t> (written),
+                                  i == 0 ? "%.6g" : ",%.6g", static_cast<double> (record.harmonics[i]));
+
+    if (record.timelineSample != THDIpcChannelRecord::noTimelineSample && written > 0 && static_cast<size_t> (written) < sizeof (buffer))
+        written += std::snprintf (buffer + written, sizeof (buffer) - static_cast<size_t> (written),
+                                  " t=%lld", static_cast<long long> (record.timelineSample));
+
+    if (! record.fundamentalValid && written > 0 && static_cast<size_t> (written) < sizeof (buffer))
+        std::snprintf (buffer + written, sizeof (buffer) - static_cast<size_t> (written), " valid=0");
+
+    return std::string (buffer) + "\n";
+}
+
+void THDIpcServer::appendBinaryFrame (std::string& out, const THDIpcChannelRecord* records, size_t numRecords)
+{
+    auto header = THDRecord::make<THDRecord::StreamHeader>();
+    header.numRecords = static_cast<uint32_t> (numRecords);
+    header.createdUnixMs = static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::milliseconds> (
+                                                      std::chrono::system_clock::now().time_since_epoch()).count());
+
+    const auto frameBytes = sizeof (header) + numRecords * sizeof (THDRecord::Measurement);
+    out += "BIN " + std::to_string (frameBytes) + "\n";
+    out.append (reinterpret_cast<const char*> (&header), sizeof (header));
+
+    const auto timeSeconds = nowMs() * 0.001;
+
+    for (size_t i = 0; i < numRecords; ++i)
+    {
+        const auto& source = records[i];
+        auto record = THDRecord::makeMeasurement();
+        record.channelId = source.channelId;
+        record.groupIndex = source.groupIndex;
+        record.sequence = source.sequence;
+        record.timeSeconds = timeSeconds;
+        record.thd = source.thd;
+        record.thdN = source.thdN;
+        record.level = source.level;
+        record.peakLevel = source.peakLevel;
+        record.harmonics = source.harmonics;
+        out.append (reinterpret_cast<const char*> (&record), sizeof (record));
+    }
+}
+
+void THDIpcServer::appendChannels (std::string& out, uint64_t mask, bool binary)
+{
+    scratchRecords.clear();
+    if (provider != nullptr)
+        provider (scratchRecords);
+
+    scratchRecords.erase (std::remove_if (scratchRecords.begin(), scratchRecords.end(), [mask] (const THDIpcChannelRecord& record)
+    {
+        return record.channelId < 0 || record.channelId >= maxChannels || ((mask >> record.channelId) & 1u) == 0;
+    }), scratchRecords.end());
+
+    if (binary)
+    {
+        appendBinaryFrame (out, scratchRecords.data(), scratchRecords.size());
+        return;
+    }
+
+    for (const auto& record : scratchRecords)
+        out += formatRecord (record);
+
+    out += "END\n";
+}
+
+void THDIpcServer::appendTimelineJoin (std::string& out, int64_t timelineSample, int64_t toleranceSamples, uint64_t mask)
+{
+    scratchRecords.clear();
+    if (timelineProvider != nullptr)
+        timelineProvider (timelineSample, toleranceSamples, scratchRecords);
+
+    float sumSquares = 0.0f;
+    float peakThd = 0.0f;
+    int numFound = 0;
+    int numValid = 0;
+
+    for (const auto& record : scratchRecords)
+    {
+        if (record.channelId < 0 || record.channelId >= maxChannels || ((mask >> record.channelId) & 1u) == 0)
+            continue;
+
+        out += formatRecord (record);
+        ++numFound;
+
+        if (record.fundamentalValid)
+        {
+            sumSquares += record.thd * record.thd;
+            peakThd = std::max (peakThd, record.thd);
+            ++numValid;
+        }
+    }
+
+    char summary[128];
+    std::snprintf (summary, sizeof (summary), "JOIN t=%lld n=%d rss=%.6g peak=%.6g\n",
+                   static_cast<long long> (timelineSample), numFound,
+                   numValid > 0 ? std::sqrt (static_cast<double> (sumSquares) / numValid) : 0.0,
+                   static_cast<double> (peakThd));
+    out += summary;
+    out += "END\n";
+}
+
+void THDIpcServer::handleLine (Client& client, const std::string& rawLine)
+{
+    std::stringstream stream (trim (rawLine));
+    std::string command;
+    stream >> command;
+
+    for (auto& c : command)
+        c = static_cast<char> (std::toupper (static_cast<unsigned char> (c)));
+
+    if (command.empty())
+        return;
+
+    if (command == "PING")
+    {
+        client.outbox += "PONG\n";
+    }
+    else if (command == "SNAPSHOT")
+    {
+        std::string channelSpec = "all";
+        stream >> channelSpec;
+
+        uint64_t mask = 0;
+        if (! parseChannelList (channelSpec, mask))
+            client.outbox += "ERR bad channel list\n";
+        else
+            appendChannels (client.outbox, mask, client.binaryFrames);
+    }
+    else if (command == "SUBSCRIBE")
+    {
+        std::string channelSpec;
+        double rateHz = 0.0;
+        stream >> channelSpec >> rateHz;
+
+        uint64_t mask = 0;
+        if (! parseChannelList (channelSpec, mask))
+        {
+            client.outbox += "ERR bad channel list\n";
+        }
+        else if (! (rateHz > 0.0))
+        {
+            client.outbox += "ERR bad rate\n";
+        }
+        else
+        {
+            client.subscribed = true;
+            client.subscribedMask = mask;
+            client.intervalMs = 1000.0 / std::min (rateHz, maxStreamRateHz);
+            client.nextSendMs = nowMs();
+            client.outbox += "OK\n";
+        }
+    }
+    else if (command == "UNSUBSCRIBE")
+    {
+        client.subscribed = false;
+        client.outbox += "OK\n";
+    }
+    else if (command == "FORMAT")
+    {
+        std::string format;
+        stream >> format;
+
+        for (auto& c : format)
+            c = static_cast<char> (std::toupper (static_cast<unsigned char> (c)));
+
+        if (format == "TEXT" || format == "BINARY")
+        {
+            client.binaryFrames = format == "BINARY";
+            client.outbox += "OK\n";
+        }
+        else
+        {
+            client.outbox += "ERR bad format\n";
+        }
+    }
+    else if (command == "AT")
+    {
+        std::string sampleText, toleranceText, channelSpec;
+        stream >> sampleText >> toleranceText >> channelSpec;
+
+        int64_t timelineSample = 0;
+        int64_t toleranceSamples = defaultTimelineToleranceSamples;
+        uint64_t mask = 0;
+
+        if (! parseInteger (sampleText, timelineSample))
+            client.outbox += "ERR bad timeline sample\n";
+        else if (! toleranceText.empty() && (! parseInteger (toleranceText, toleranceSamples) || toleranceSamples < 0))
+            client.outbox += "ERR bad tolerance\n";
+        else if (! parseChannelList (channelSpec.empty() ? "all" : channelSpec, mask))
+            client.outbox += "ERR bad channel list\n";
+        else if (timelineProvider == nullptr)
+            client.outbox += "ERR timeline queries unavailable\n";
+        else
+            appendTimelineJoin (client.outbox, timelineSample, toleranceSamples, mask);
+    }
+    else if (command == "QUIT")
+    {
+        client.beginClose (false);
+    }
+    else
+    {
+        client.outbox += "ERR unknown command\n";
+    }
+}
+
+#if THD_IPC_HAS_UNIX_SOCKETS
+
+bool THDIpcServer::start (std::string* errorMessage)
+{
+    if (isRunning())
+        return true;
+
+    const auto fail = [errorMessage, this] (const std::string& message)
+    {
+        if (errorMessage != nullptr)
+            *errorMessage = message + ": " + std::strerror (errno);
+
+        if (listenFd >= 0)
+            ::close (listenFd);
+
+        for (auto& fd : wakePipe)
+        {
+            if (fd >= 0)
+                ::close (fd);
+
+            fd = -1;
+        }
+
+        listenFd = -1;
+        return false;
+    };
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.empty() || socketPath.size() >= sizeof (address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return fail ("invalid socket path");
+    }
+
+    std::memcpy (address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    if (::pipe (wakePipe) != 0)
+        return fail ("pipe");
+
+    listenFd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return fail ("socket");
+
+    ::fcntl (listenFd, F_SETFD, FD_CLOEXEC);
+    ::fcntl (listenFd, F_SETFL, ::fcntl (listenFd, F_GETFL, 0) | O_NONBLOCK);
+
+    // A previous crash can leave the socket file behind.
+    ::unlink (socketPath.c_str());
+
+    if (::bind (listenFd, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) != 0)
+        return fail ("bind " + socketPath);
+
+    ::chmod (socketPath.c_str(), 0600);
+
+    if (::listen (listenFd, 8) != 0)
+        return fail ("listen");
+
+    shouldStop.store (false, std::memory_order_release);
+    running.store (true, std::memory_order_release);
+    thread = std::thread ([this] { run(); });
+    return true;
+}
+
+void THDIpcServer::stop()
+{
+    if (! thread.joinable())
+        return;
+
+    shouldStop.store (true, std::memory_order_release);
+    const char wake = 1;
+    [[maybe_unused]] const auto ignored = ::write (wakePipe[1], &wake, 1);
+    thread.join();
+
+    ::close (listenFd);
+    ::close (wakePipe[0]);
+    ::close (wakePipe[1]);
+    listenFd = -1;
+    wakePipe[0] = wakePipe[1] = -1;
+    ::unlink (socketPath.c_str());
+    running.store (false, std::memory_order_release);
+}
+
+void THDIpcServer::run()
+{
+    std::vector<Client> clients;
+    std::vector<pollfd> pollFds;
+
+    while (! shouldStop.load (std::memory_order_acquire))
+    {
+        // Sleep until the next subscriber is due, bounded so shutdown stays responsive.
+        auto now = nowMs();
+        double waitMs = 250.0;
+        for (const auto& client : clients)
+            if (client.subscribed)
+                waitMs = std::min (waitMs, std::max (0.0, client.nextSendMs - now));
+
+        pollFds.clear();
+        pollFds.push_back ({ wakePipe[0], POLLIN, 0 });
+        pollFds.push_back ({ listenFd, POLLIN, 0 });
+        for (const auto& client : clients)
+            pollFds.push_back ({ client.fd, static_cast<short> (POLLIN | (client.outbox.empty() ? 0 : POLLOUT)), 0 });
+
+        if (::poll (pollFds.data(), static_cast<nfds_t> (pollFds.size()), static_cast<int> (waitMs)) < 0 && errno != EINTR)
+            break;
+
+        if ((pollFds[1].revents & POLLIN) != 0)
+        {
+            for (;;)
+            {
+                const auto fd = ::accept (listenFd, nullptr, nullptr);
+                if (fd < 0)
+                    break;
+
+                ::fcntl (fd, F_SETFD, FD_CLOEXEC);
+                ::fcntl (fd, F_SETFL, ::fcntl (fd, F_GETFL, 0) | O_NONBLOCK);
+                Client client;
+                client.fd = fd;
+                clients.push_back (std::move (client));
+            }
+        }
+
+        for (size_t i = 0; i + 2 < pollFds.size() && i < clients.size(); ++i)
+        {
+            auto& client = clients[i];
+            const auto events = pollFds[i + 2].revents;
+
+            if ((events & (POLLIN | POLLHUP | POLLERR)) != 0)
+            {
+                char buffer[1024];
+                const auto bytesRead = ::read (client.fd, buffer, sizeof (buffer));
+
+                if (bytesRead <= 0)
+                {
+                    if (bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                        client.beginClose (true);
+                }
+                else
+                {
+                    client.inbox.append (buffer, static_cast<size_t> (bytesRead));
+
+                    // Lines pipelined after QUIT are ignored, so nothing can re-subscribe a closing connection.
+                    for (auto newline = client.inbox.find ('\n'); newline != std::string::npos && ! client.closeAfterFlush;
+                         newline = client.inbox.find ('\n'))
+                    {
+                        const auto line = client.inbox.substr (0, newline);
+                        client.inbox.erase (0, newline + 1);
+                        handleLine (client, line);
+                    }
+
+                    if (client.inbox.size() > maxLineBytes && ! client.closeAfterFlush)
+                    {
+                        client.beginClose (true);
+                        client.outbox = "ERR line too long\n";
+                    }
+                }
+            }
+        }
+
+        now = nowMs();
+        for (auto& client : clients)
+        {
+            if (client.subscribed && now >= client.nextSendMs)
+            {
+                appendChannels (client.outbox, client.subscribedMask, client.binaryFrames);
+                client.nextSendMs = std::max (client.nextSendMs + client.intervalMs, now);
+            }
+
+            if (! client.outbox.empty())
+            {
+                const auto written = ::send (client.fd, client.outbox.data(), client.outbox.size(),
+                                            #ifdef MSG_NOSIGNAL
+                                             MSG_NOSIGNAL
+                                            #else
+                                             0
+                                            #endif
+                                             );
+
+                if (written > 0)
+                    client.outbox.erase (0, static_cast<size_t> (written));
+                else if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                    client.beginClose (true);
+            }
+
+            // Slow consumers are dropped rather than buffering unbounded history.
+            if (client.outbox.size() > maxPendingOutputBytes)
+                client.beginClose (true);
+        }
+
+        clients.erase (std::remove_if (clients.begin(), clients.end(), [] (const Client& client)
+        {
+            if (! client.closeAfterFlush || ! client.outbox.empty())
+                return false;
+
+            ::close (client.fd);
+            return true;
+        }), clients.end());
+    }
+
+    for (const auto& client : clients)
+        ::close (client.fd);
+}
+
+#else
+
+bool THDIpcServer::start (std::string* errorMessage)
+{
+    if (errorMessage != nullptr)
+        *errorMessage = "Unix domain sockets are not available on this platform";
+
+    return false;
+}
+
+void THDIpcServer::stop()
+{
+}
+
+void THDIpcServer::run()
+{
+}
+
+#endif
@@ -0,0 +1,112 @@
+/* ==============================================================================
+   THD Analyzer Local IPC Server
+   Line-delimited query/stream protocol over a Unix domain socket.
+
+   Runs entirely on its own background thread; the audio path is never touched.
+   Data comes from a snapshot provider (the plugin wires this to the lock-free
+   shared channel slots). Kept free of JUCE so the same server can be reused by
+   headless tools.
+
+   Protocol (one command per line, responses are line-delimited text):
+     PING                          -> PONG
+     SNAPSHOT [channels]           -> CH ... lines, then END
+     SUBSCRIBE <channels> <rateHz> -> OK, then CH ... / END frames at rateHz
+     UNSUBSCRIBE                   -> OK
+     FORMAT TEXT|BINARY            -> OK; sets how later frames are sent
+     AT <sample> [tolerance] [channels]
+                                   -> each channel's hop nearest that host
+                                      timeline sample (within tolerance,
+                                      default 2048 samples) as CH lines, a
+                                      JOIN summary line, then END; always text
+     QUIT                          -> subscription ended, connection closed
+                                      once pending replies flush
+   <channels> is "all" or a comma list of IDs/ranges, e.g. "0,3,8-15".
+   Each CH line is key=value pairs:
+     CH id=3 seq=812 thd=0.1234 thdn=0.2345 level=0.0712 peak=0.3010 group=-1 h=...
+   followed by t=<timeline sample> when the hop is tagged, and valid=0 when it
+   had no valid fundamental. The JOIN line carries the requested sample, the
+   number of channels found, and RSS and peak THD over the valid ones:
+     JOIN t=1584000 n=12 rss=0.0812 peak=0.3120
+   In BINARY format a frame is the line "BIN <bytes>" followed by exactly that
+   many bytes: a THDRecord::StreamHeader and one THDRecord::Measurement per
+   channel (THDRecordFormat.h). Replies to PING/SUBSCRIBE/etc. stay text.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct THDIpcChannelRecord
+{
+    int channelId = 0;
+    uint64_t sequence = 0;
+    float thd = 0.0f;
+    float thdN = 0.0f;
+    float level = 0.0f;
+    float peakLevel = 0.0f;
+    int groupIndex = -1;
+    std::array<float, 7> harmonics {};
+    int64_t timelineSample = noTimelineSample;
+    bool fundamentalValid = true;
+
+    static constexpr int64_t noTimelineSample = std::numeric_limits<int64_t>::min();
+};
+
+class THDIpcServer
+{
+public:
+    /** Fills the vector with all currently live channels; called on the server thread. */
+    using SnapshotProvider = std::function<void (std::vector<THDIpcChannelRecord>&)>;
+    /** Fills the vector with each channel's hop nearest a host timeline sample; called on the server thread. */
+    using TimelineProvider = std::function<void (int64_t timelineSample, int64_t toleranceSamples, std::vector<THDIpcChannelRecord>&)>;
+
+    static constexpr int maxChannels = 64;
+    static constexpr double maxStreamRateHz = 200.0;
+    static constexpr int64_t defaultTimelineToleranceSamples = 2048;
+
+    THDIpcServer (std::string socketPathToUse, SnapshotProvider providerToUse, TimelineProvider timelineProviderToUse = nullptr);
+    ~THDIpcServer();
+
+    /** Binds the socket and starts the server thread. */
+    bool start (std::string* errorMessage = nullptr);
+    void stop();
+    bool isRunning() const noexcept { return running.load (std::memory_order_acquire); }
+
+    const std::string& getSocketPath() const noexcept { return socketPath; }
+
+    /** THD_ANALYZER_SOCKET if set, else a per-process path under XDG_RUNTIME_DIR (or /tmp). */
+    static std::string defaultSocketPath();
+
+    /** Parses "all" / "0,3,8-15" into a channel mask; returns false on malformed input. */
+    static bool parseChannelList (const std::string& text, uint64_t& mask);
+
+    static std::string formatRecord (const THDIpcChannelRecord& record);
+
+    /** Appends one binary frame ("BIN <bytes>" line plus records) for the given records. */
+    static void appendBinaryFrame (std::string& out, const THDIpcChannelRecord* records, size_t numRecords);
+
+private:
+    struct Client;
+
+    void run();
+    void handleLine (Client& client, const std::string& line);
+    void appendChannels (std::string& out, uint64_t mask, bool binary);
+    void appendTimelineJoin (std::string& out, int64_t timelineSample, int64_t toleranceSamples, uint64_t mask);
+
+    std::string socketPath;
+    SnapshotProvider provider;
+    TimelineProvider timelineProvider;
+    std::vector<THDIpcChannelRecord> scratchRecords;
+    std::thread thread;
+    std::atomic<bool> running { false };
+    std::atomic<bool> shouldStop { false };
+    int listenFd = -1;
+    int wakePipe[2] { -1, -1 };
+};
@@ -0,0 +1,209 @@
+/* ==============================================================================
+   THD Record Format
+   One binary layout for measurements leaving the process: IPC frames, binary
+   measurement logs, shared memory and datagrams.
+
+   Records are flat, 8-byte aligned, little-endian structs. The structs below
+   are the wire layout (every offset is pinned by a static_assert), so writing
+   a record is a struct copy and reading one is a pointer cast after a bounds
+   check. Nothing is parsed or converted.
+
+   Every record starts with a 16-byte Header:
+     magic "THDR" | type u16 | major u8 | minor u8 | size u32 | reserved u32
+   size covers the whole record including the header and is a multiple of 8,
+   so a reader steps from one record to the next with size alone.
+
+   A stream (log file, IPC frame, datagram) starts with a StreamHeader record
+   followed by Measurement records.
+
+   Schema evolution:
+   - New fields are only ever appended to the end of a record; existing
+     offsets, types and meanings never change. Appending bumps minor.
+   - Readers use fields up to header.size. Anything appended after the size
+     a reader was built with is ignored; a field a reader knows but an older
+     writer did not send is absent (check with hasField) and reads as its
+     default.
+   - Readers skip record types they do not know.
+   - Removing, reordering or retyping a field is a breaking change: it bumps
+     major, and readers reject records whose major differs from theirs.
+   ============================================================================== */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+ #error "THD records are little-endian; add byte-swapping accessors before using them on this target"
+#endif
+
+namespace THDRecord
+{
+constexpr uint32_t magic = 0x52444854; // "THDR" in file order
+constexpr uint8_t majorVersion = 1;
+constexpr uint8_t minorVersion = 0;
+constexpr size_t alignment = 8;
+
+enum class Type : uint16_t
+{
+    stream = 1,
+    measurement = 2
+};
+
+struct Header
+{
+    uint32_t magic;
+    uint16_t type;
+    uint8_t major;
+    uint8_t minor;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+/** Starts a stream: a log file, one IPC frame or one datagram. */
+struct StreamHeader
+{
+    static constexpr Type recordType = Type::stream;
+
+    Header header;
+    uint32_t numRecords;        // records following in this frame; 0 = open-ended (logs)
+    uint32_t flags;
+    uint64_t createdUnixMs;
+};
+
+/** One channel's (or, with channelId == masterChannel, the Master Brain's) measurement. */
+struct Measurement
+{
+    static constexpr Type recordType = Type::measurement;
+    static constexpr int32_t masterChannel = -1;
+    static constexpr uint32_t fundamentalValidFlag = 1u << 0;
+
+    Header header;
+    int32_t channelId;
+    int32_t groupIndex;
+    uint64_t sequence;
+    int64_t timelineSample;     // INT64_MIN when the host gave no position
+    uint64_t epoch;
+    double timeSeconds;         // writer's clock (log time, publish time)
+    float thd;                  // percent
+    float thdN;                 // percent
+    float level;                // RMS
+    float peakLevel;
+    float fundamentalHz;
+    float noiseFloor;
+    float confidence;
+    uint32_t flags;
+    std::array<float, 7> harmonics; // H2 .. H8
+    uint32_t reserved;
+};
+
+// The layout is the schema: any change here must follow the rules above.
+static_assert (sizeof (Header) == 16, "Header layout");
+static_assert (offsetof (Header, type) == 4 && offsetof (Header, major) == 6 && offsetof (Header, size) == 8, "Header layout");
+static_assert (sizeof (StreamHeader) == 32, "StreamHeader layout");
+static_assert (offsetof (StreamHeader, numRecords) == 16 && offsetof (StreamHeader, createdUnixMs) == 24, "StreamHeader layout");
+static_assert (sizeof (Measurement) == 120, "Measurement layout");
+static_assert (offsetof (Measurement, channelId) == 16 && offsetof (Measurement, sequence) == 24
+                   && offsetof (Measurement, timelineSample) == 32 && offsetof (Measurement, epoch) == 40
+                   && offsetof (Measurement, timeSeconds) == 48 && offsetof (Measurement, thd) == 56
+                   && offsetof (Measurement, flags) == 84 && offsetof (Measurement, harmonics) == 88,
+               "Measurement layout");
+static_assert (std::is_trivially_copyable<StreamHeader>::value && std::is_standard_layout<StreamHeader>::value, "StreamHeader must be flat");
+static_assert (std::is_trivially_copyable<Measurement>::value && std::is_standard_layout<Measurement>::value, "Measurement must be flat");
+static_assert (sizeof (StreamHeader) % alignment == 0 && sizeof (Measurement) % alignment == 0, "Records keep 8-byte alignment");
+
+/** A zeroed record with its header filled in for this schema version. */
+template <typename Record>
+Record make() noexcept
+{
+    Record record;
+    std::memset (&record, 0, sizeof (record));
+    record.header.magic = magic;
+    record.header.type = static_cast<uint16_t> (Record::recordType);
+    record.header.major = majorVersion;
+    record.header.minor = minorVersion;
+    record.header.size = static_cast<uint32_t> (sizeof (Record));
+    return record;
+}
+
+inline Measurement makeMeasurement() noexcept
+{
+    auto record = make<Measurement>();
+    record.channelId = Measurement::masterChannel;
+    record.groupIndex = -1;
+    record.timelineSample = INT64_MIN;
+    return record;
+}
+
+/** True if the record, as written, includes the field at [offset, offset + size). */
+inline bool hasField (const Header& header, size_t offset, size_t size) noexcept
+{
+    return offset + size <= header.size;
+}
+
+/** Validates the header at data; returns it in place, or nullptr if it is not a readable record. */
+inline const Header* viewHeader (const void* data, size_t available) noexcept
+{
+    if (data == nullptr || available < sizeof (Header) || (reinterpret_cast<uintptr_t> (data) % alignment) != 0)
+        return nullptr;
+
+    const auto* header = static_cast<const Header*> (data);
+    if (header->magic != magic || header->major != majorVersion
+        || header->size < sizeof (Header) || header->size % alignment != 0 || header->size > available)
+        return nullptr;
+
+    return header;
+}
+
+/** The record at data as a Record, read in place; nullptr if the type or size does not match. */
+template <typename Record>
+const Record* view (const void* data, size_t available) noexcept
+{
+    const auto* header = viewHeader (data, available);
+    if (header == nullptr || header->type != static_cast<uint16_t> (Record::recordType) || header->size < sizeof (Record))
+        return nullptr;
+
+    return static_cast<const Record*> (data);
+}
+
+/** Steps through the records of a buffer. Stops at the first malformed one. */
+class Cursor
+{
+public:
+    Cursor (const void* dataToRead, size_t numBytes) noexcept
+        : data (static_cast<const unsigned char*> (dataToRead)), size (numBytes) {}
+
+    /** The next record's header, or nullptr at the end (or at a malformed record). */
+    const Header* next() noexcept
+    {
+        const auto* header = viewHeader (data + position, size - position);
+        if (header == nullptr)
+            return nullptr;
+
+        position += header->size;
+        return header;
+    }
+
+    size_t getPosition() const noexcept { return position; }
+    bool isAtEnd() const noexcept { return position == size; }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+};
+
+/** Copies a record into dest (8-byte aligned, capacity bytes); returns bytes written or 0 if it does not fit. */
+template <typename Record>
+size_t write (void* dest, size_t capacity, const Record& record) noexcept
+{
+    if (capacity < sizeof (Record))
+        return 0;
+
+    std::memcpy (dest, &record, sizeof (Record));
+    return sizeof (Record);
+}
+}
@@ -0,0 +1,275 @@
+/* ==============================================================================
+   libthdcore Implementation
+   Wraps BatchedSpectrumAnalyzer / HarmonicAnalysis behind the C API in
+   thdcore.h. The FFT size and lane count are template parameters, so each
+   engine picks the smallest lane width that fits its channel count.
+   ============================================================================== */
+
+#include "thdcore.h"
+
+#include "BatchedSpectrumAnalyzer.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace
+{
+class SpectrumEngine
+{
+public:
+    virtual ~SpectrumEngine() = default;
+
+    virtual void analyze (const float* const* laneInputs, int numActiveLanes, float sampleRate,
+                          HarmonicAnalysis::Result* results, size_t inputStride) = 0;
+    virtual const float* getPowerSpectrum() const noexcept = 0;
+    virtual int getNumLanes() const noexcept = 0;
+};
+
+template <int fftOrder, int numLanes>
+class BatchedSpectrumEngine final : public SpectrumEngine
+{
+public:
+    void analyze (const float* const* laneInputs, int numActiveLanes, float sampleRate,
+                  HarmonicAnalysis::Result* results, size_t inputStride) override
+    {
+        analyzer.analyze (laneInputs, numActiveLanes, sampleRate, results, inputStride);
+    }
+
+    const float* getPowerSpectrum() const noexcept override { return analyzer.getPowerSpectrum(); }
+    int getNumLanes() const noexcept override { return numLanes; }
+
+private:
+    BatchedSpectrumAnalyzer<fftOrder, numLanes> analyzer;
+};
+
+template <int fftOrder>
+std::unique_ptr<SpectrumEngine> makeSpectrumEngineForLanes (int numChannels)
+{
+    // Unused lanes still run through the FFT, so round up only as far as needed.
+    if (numChannels <= 1) return std::make_unique<BatchedSpectrumEngine<fftOrder, 1>>();
+    if (numChannels <= 2) return std::make_unique<BatchedSpectrumEngine<fftOrder, 2>>();
+    if (numChannels <= 4) return std::make_unique<BatchedSpectrumEngine<fftOrder, 4>>();
+    return std::make_unique<BatchedSpectrumEngine<fftOrder, THD_MAX_CHANNELS>>();
+}
+
+std::unique_ptr<SpectrumEngine> makeSpectrumEngine (int fftOrder, int numChannels)
+{
+    static_assert (THD_MIN_FFT_ORDER == 10 && THD_MAX_FFT_ORDER == 16, "Update the order switch below");
+
+    switch (fftOrder)
+    {
+        case 10: return makeSpectrumEngineForLanes<10> (numChannels);
+        case 11: return makeSpectrumEngineForLanes<11> (numChannels);
+        case 12: return makeSpectrumEngineForLanes<12> (numChannels);
+        case 13: return makeSpectrumEngineForLanes<13> (numChannels);
+        case 14: return makeSpectrumEngineForLanes<14> (numChannels);
+        case 15: return makeSpectrumEngineForLanes<15> (numChannels);
+        case 16: return makeSpectrumEngineForLanes<16> (numChannels);
+        default: return nullptr;
+    }
+}
+
+bool isValidBuffer (const thd_buffer* buffer, int maxChannels) noexcept
+{
+    if (buffer == nullptr || buffer->channels == nullptr || buffer->sample_stride < 1
+        || buffer->num_channels < 1 || buffer->num_channels > maxChannels || buffer->num_samples < 0)
+        return false;
+
+    for (int32_t channel = 0; channel < buffer->num_channels; ++channel)
+        if (buffer->channels[channel] == nullptr)
+            return false;
+
+    return true;
+}
+
+void toCResult (const HarmonicAnalysis::Result& source, int64_t frameStart, int32_t channel, thd_result& destination) noexcept
+{
+    destination.frame_start = frameStart;
+    destination.channel = channel;
+    destination.fundamental_valid = source.fundamentalValid ? 1 : 0;
+    destination.fundamental_hz = source.fundamentalFrequency;
+    destination.thd_percent = source.thd;
+    destination.thdn_percent = source.thdN;
+    destination.level_rms = source.level;
+    destination.noise_floor = source.noiseFloor;
+    destination.confidence = source.analysisConfidence;
+
+    static_assert (THD_NUM_HARMONICS == std::tuple_size<decltype (source.harmonics)>::value, "Harmonic count mismatch");
+    for (size_t i = 0; i < source.harmonics.size(); ++i)
+        destination.harmonics[i] = source.harmonics[i];
+}
+}
+
+struct thd_engine
+{
+    std::mutex lock;
+    std::unique_ptr<SpectrumEngine> spectrum;
+    float sampleRate = 0.0f;
+    int32_t fftSize = 0;
+    int32_t hopSize = 0;
+    int32_t numChannels = 0;
+    int32_t numAnalysedChannels = 0; // channels in the most recent frame; bounds spectrum views
+    std::array<HarmonicAnalysis::Result, THD_MAX_CHANNELS> laneResults {};
+
+    // Caller holds the lock.
+    void analyzeFrame (const thd_buffer& buffer, int64_t frameStart, thd_result* results)
+    {
+        std::array<const float*, THD_MAX_CHANNELS> laneInputs {};
+        const auto offset = static_cast<size_t> (frameStart) * static_cast<size_t> (buffer.sample_stride);
+
+        for (int32_t channel = 0; channel < buffer.num_channels; ++channel)
+            laneInputs[static_cast<size_t> (channel)] = buffer.channels[channel] + offset;
+
+        spectrum->analyze (laneInputs.data(), buffer.num_channels, sampleRate, laneResults.data(),
+                           static_cast<size_t> (buffer.sample_stride));
+        numAnalysedChannels = buffer.num_channels;
+
+        for (int32_t channel = 0; channel < buffer.num_channels; ++channel)
+            toCResult (laneResults[static_cast<size_t> (channel)], frameStart, channel, results[channel]);
+    }
+};
+
+extern "C"
+{
+uint32_t thd_api_version (void)
+{
+    return THDCORE_API_VERSION;
+}
+
+const char* thd_status_string (thd_status status)
+{
+    switch (status)
+    {
+        case THD_OK: return "ok";
+        case THD_ERROR_INVALID_ARGUMENT: return "invalid argument";
+        case THD_ERROR_OUT_OF_MEMORY: return "out of memory";
+        case THD_ERROR_BUFFER_TOO_SMALL: return "result buffer too small";
+        default: return "unknown status";
+    }
+}
+
+void thd_config_init (thd_config* config)
+{
+    if (config == nullptr)
+        return;
+
+    *config = thd_config {};
+    config->struct_size = sizeof (thd_config);
+    config->sample_rate = 48000.0;
+    config->fft_order = THD_DEFAULT_FFT_ORDER;
+    config->hop_size = 0;
+    config->num_channels = 1;
+}
+
+thd_status thd_engine_create (const thd_config* config, thd_engine** engine)
+{
+    if (engine == nullptr)
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    *engine = nullptr;
+
+    // struct_size lets later versions append fields without breaking older callers.
+    if (config == nullptr || config->struct_size < sizeof (thd_config)
+        || ! (config->sample_rate > 0.0)
+        || config->fft_order < THD_MIN_FFT_ORDER || config->fft_order > THD_MAX_FFT_ORDER
+        || config->num_channels < 1 || config->num_channels > THD_MAX_CHANNELS
+        || config->hop_size < 0)
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    // Exceptions must not cross the C boundary.
+    try
+    {
+        auto created = std::make_unique<thd_engine>();
+        created->spectrum = makeSpectrumEngine (config->fft_order, config->num_channels);
+        if (created->spectrum == nullptr)
+            return THD_ERROR_INVALID_ARGUMENT;
+
+        created->sampleRate = static_cast<float> (config->sample_rate);
+        created->fftSize = int32_t { 1 } << config->fft_order;
+        created->hopSize = config->hop_size > 0 ? config->hop_size : created->fftSize / 4;
+        created->numChannels = config->num_channels;
+        *engine = created.release();
+        return THD_OK;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return THD_ERROR_OUT_OF_MEMORY;
+    }
+}
+
+void thd_engine_destroy (thd_engine* engine)
+{
+    delete engine;
+}
+
+int32_t thd_engine_fft_size (const thd_engine* engine)
+{
+    return engine != nullptr ? engine->fftSize : 0;
+}
+
+int32_t thd_engine_hop_size (const thd_engine* engine)
+{
+    return engine != nullptr ? engine->hopSize : 0;
+}
+
+int64_t thd_engine_count_frames (const thd_engine* engine, int64_t num_samples)
+{
+    if (engine == nullptr || num_samples < engine->fftSize)
+        return 0;
+
+    return (num_samples - engine->fftSize) / engine->hopSize + 1;
+}
+
+thd_status thd_engine_analyze_frame (thd_engine* engine, const thd_buffer* buffer, thd_result* results)
+{
+    if (engine == nullptr || results == nullptr || ! isValidBuffer (buffer, engine->numChannels)
+        || buffer->num_samples < engine->fftSize)
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    const std::lock_guard<std::mutex> scoped (engine->lock);
+    engine->analyzeFrame (*buffer, 0, results);
+    return THD_OK;
+}
+
+thd_status thd_engine_analyze_buffer (thd_engine* engine, const thd_buffer* buffer,
+                                      thd_result* results, int64_t max_frames, int64_t* num_frames)
+{
+    if (num_frames != nullptr)
+        *num_frames = 0;
+
+    if (engine == nullptr || num_frames == nullptr || max_frames < 0 || (results == nullptr && max_frames > 0)
+        || ! isValidBuffer (buffer, engine->numChannels))
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    const auto available = thd_engine_count_frames (engine, buffer->num_samples);
+    const auto toWrite = available < max_frames ? available : max_frames;
+
+    const std::lock_guard<std::mutex> scoped (engine->lock);
+
+    for (int64_t frame = 0; frame < toWrite; ++frame)
+        engine->analyzeFrame (*buffer, frame * engine->hopSize, results + frame * buffer->num_channels);
+
+    *num_frames = toWrite;
+    return toWrite < available ? THD_ERROR_BUFFER_TOO_SMALL : THD_OK;
+}
+
+thd_status thd_engine_get_spectrum (thd_engine* engine, int32_t channel, thd_spectrum_view* view)
+{
+    if (engine == nullptr || view == nullptr)
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    const std::lock_guard<std::mutex> scoped (engine->lock);
+
+    if (channel < 0 || channel >= engine->numAnalysedChannels)
+        return THD_ERROR_INVALID_ARGUMENT;
+
+    // The analyzer keeps its power spectrum bin-major across lanes; expose one lane in place.
+    view->power = engine->spectrum->getPowerSpectrum() + channel;
+    view->num_bins = engine->fftSize / 2;
+    view->stride = engine->spectrum->getNumLanes();
+    view->bin_hz = engine->sampleRate / static_cast<float> (engine->fftSize);
+    return THD_OK;
+}
+}
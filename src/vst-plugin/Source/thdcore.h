@@ -0,0 +1,145 @@
+/* ==============================================================================
+   libthdcore - THD Analyzer analysis core, C API
+   The plugin's THD / THD+N / harmonic analysis as a JUCE-free shared library
+   for tools outside the DAW (render-farm QC, dataset labelling, scripts).
+
+   Usage:
+     thd_config config;
+     thd_config_init (&config);
+     config.sample_rate = 48000.0;
+     config.num_channels = 2;
+
+     thd_engine* engine = NULL;
+     if (thd_engine_create (&config, &engine) != THD_OK) ...
+
+     thd_buffer buffer = { channelPointers, 2, numSamples, 1 };
+     int64_t numFrames = thd_engine_count_frames (engine, numSamples);
+     thd_result* results = malloc (numFrames * 2 * sizeof (thd_result));
+     thd_engine_analyze_buffer (engine, &buffer, results, numFrames, &numFrames);
+     thd_engine_destroy (engine);
+
+   Zero copy: the engine never buffers input. Every frame is read straight
+   from the caller's memory (planar or interleaved, via sample_stride) into
+   the windowed FFT block, and results land in caller-owned arrays.
+
+   Threading: engines share no state, so run one engine per core for
+   parallel work. Calls on one handle may come from any thread; they are
+   serialised by a lock inside the engine.
+   ============================================================================== */
+
+#ifndef THDCORE_H
+#define THDCORE_H
+
+#include <stdint.h>
+
+#if defined (_WIN32)
+ #if defined (THDCORE_BUILDING)
+  #define THDCORE_API __declspec(dllexport)
+ #else
+  #define THDCORE_API __declspec(dllimport)
+ #endif
+#else
+ #define THDCORE_API __attribute__ ((visibility ("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THDCORE_API_VERSION 1
+
+#define THD_NUM_HARMONICS 7      /* H2 .. H8 */
+#define THD_MAX_CHANNELS 8       /* channels analysed together, one SIMD lane each */
+#define THD_MIN_FFT_ORDER 10
+#define THD_MAX_FFT_ORDER 16
+#define THD_DEFAULT_FFT_ORDER 13 /* the plugin's 8192-point analysis */
+
+typedef enum thd_status
+{
+    THD_OK = 0,
+    THD_ERROR_INVALID_ARGUMENT = -1,
+    THD_ERROR_OUT_OF_MEMORY = -2,
+    THD_ERROR_BUFFER_TOO_SMALL = -3
+} thd_status;
+
+typedef struct thd_engine thd_engine;
+
+typedef struct thd_config
+{
+    uint32_t struct_size;   /* sizeof (thd_config); set by thd_config_init */
+    double sample_rate;     /* Hz */
+    int32_t fft_order;      /* THD_MIN_FFT_ORDER .. THD_MAX_FFT_ORDER */
+    int32_t hop_size;       /* samples between frames in thd_engine_analyze_buffer; 0 = fft_size / 4 */
+    int32_t num_channels;   /* 1 .. THD_MAX_CHANNELS */
+} thd_config;
+
+typedef struct thd_result
+{
+    int64_t frame_start;    /* first sample of the analysed frame */
+    int32_t channel;
+    int32_t fundamental_valid;
+    float fundamental_hz;
+    float thd_percent;
+    float thdn_percent;
+    float level_rms;
+    float noise_floor;
+    float confidence;       /* fundamental power / total power, 0 .. 1 */
+    float harmonics[THD_NUM_HARMONICS];
+} thd_result;
+
+/* Caller-owned input; sample i of channel c is channels[c][i * sample_stride].
+   Planar buffers use sample_stride 1. For interleaved buffers, point channels[c]
+   at base + c and set sample_stride to the channel count. */
+typedef struct thd_buffer
+{
+    const float* const* channels;
+    int32_t num_channels;
+    int64_t num_samples;
+    int32_t sample_stride;
+} thd_buffer;
+
+/* Power spectrum (|X[k]|^2 of the Hann-windowed frame) of one channel's most
+   recent frame: bin k is power[k * stride]. Points into the engine and stays
+   valid until the next analyse call or thd_engine_destroy on that handle. */
+typedef struct thd_spectrum_view
+{
+    const float* power;
+    int32_t num_bins;
+    int32_t stride;
+    float bin_hz;
+} thd_spectrum_view;
+
+THDCORE_API uint32_t thd_api_version (void);
+THDCORE_API const char* thd_status_string (thd_status status);
+
+/* Fills defaults: 48 kHz, THD_DEFAULT_FFT_ORDER, hop fft_size / 4, one channel. */
+THDCORE_API void thd_config_init (thd_config* config);
+
+THDCORE_API thd_status thd_engine_create (const thd_config* config, thd_engine** engine);
+THDCORE_API void thd_engine_destroy (thd_engine* engine);
+
+THDCORE_API int32_t thd_engine_fft_size (const thd_engine* engine);
+THDCORE_API int32_t thd_engine_hop_size (const thd_engine* engine);
+
+/* Number of frames thd_engine_analyze_buffer produces for num_samples. */
+THDCORE_API int64_t thd_engine_count_frames (const thd_engine* engine, int64_t num_samples);
+
+/* Analyses one frame: the first fft_size samples of every channel.
+   results receives buffer->num_channels entries. */
+THDCORE_API thd_status thd_engine_analyze_frame (thd_engine* engine, const thd_buffer* buffer, thd_result* results);
+
+/* Analyses every whole frame in the buffer, frames starting hop_size apart.
+   results is frame-major (results[frame * num_channels + channel]) and holds
+   max_frames frames; *num_frames receives the number written. If the buffer
+   holds more frames than max_frames, the first max_frames are written and
+   THD_ERROR_BUFFER_TOO_SMALL is returned. */
+THDCORE_API thd_status thd_engine_analyze_buffer (thd_engine* engine, const thd_buffer* buffer,
+                                                  thd_result* results, int64_t max_frames, int64_t* num_frames);
+
+THDCORE_API thd_status thd_engine_get_spectrum (thd_engine* engine, int32_t channel, thd_spectrum_view* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1661 @@
+/* ==============================================================================
+   THD Analyzer Offline Analysis
+   Analyses WAV files with libthdcore and prints one CSV row per analysis
+   frame and channel. Per-chunk results are cached on disk (AnalysisCache.h),
+   so after an edit only the chunks whose audio changed are re-analysed, and
+   a file whose size and modification time are unchanged is answered from
+   its manifest without reading any audio.
+
+   Usage:
+     thd-analyze [options] FILE...
+     thd-analyze --raw FORMAT --rate HZ --channels N [options] [- | FIFO]...
+     thd-analyze --coordinator [--workers N] [--socket PATH] [options] FILE...
+     thd-analyze --worker SOCKET [--cache DIR | --no-cache]
+
+     --cache DIR         cache directory (default $THD_ANALYZE_CACHE,
+                         $XDG_CACHE_HOME/thd-analyzer or ~/.cache/thd-analyzer)
+     --no-cache          analyse everything; read and write no cache
+     --rehash            skip the manifest shortcut and hash every chunk
+     --fft-order N       10..16 (default 13, the plugin's 8192-point analysis)
+     --hop N             samples between frames (default FFT size / 4)
+     --chunk-frames N    analysis frames per cached chunk (default 256)
+     --quiet             no per-file summary on stderr
+     --raw FORMAT        read headerless interleaved little-endian PCM
+                         (s16, s24, s32 or f32) from stdin ("-", the default)
+                         or a FIFO/file; needs --rate and --channels
+     --block-kb N        raw read block size (default 1024)
+     --coordinator       shard the files over worker processes (below)
+     --workers N         local workers to start (default: one per core; 0 =
+                         only workers started elsewhere with --worker)
+     --socket PATH       coordinator socket (default /tmp/thd-analyze-PID.sock)
+     --segment-chunks N  chunks per job (default 4)
+
+   Columns match the bounce report: time_s (frame centre), channel, valid,
+   f0_hz, thd_pct, thdn_pct, level_rms, noise_floor, h2..h8. With several
+   files, each file's rows follow a "# file=PATH" line.
+
+   WAV input: 16/24/32-bit PCM or 32-bit float, 1..8 channels, plain or
+   WAVE_FORMAT_EXTENSIBLE. Files are memory-mapped and chunks decoded on
+   demand, so cached chunks are hashed straight from the mapped bytes.
+
+   Raw input streams through three threads joined by queues of a fixed pool
+   of blocks: a reader read()s straight into free raw blocks, a converter
+   turns them into float blocks, and the main thread analyses every frame
+   that has become complete and prints its rows at once, flushing after
+   each block. When analysis falls behind, the pool runs dry and the reader
+   stops reading, so memory stays bounded and back-pressure reaches the
+   producer through the pipe. Streams are never cached.
+
+   A coordinator plans every file (answering unchanged ones from their
+   manifests), cuts the rest into jobs of whole cache chunks and serves them
+   over a Unix socket to workers, which analyse through the shared cache and
+   send back the chunk keys and a THDRecord measurement stream. Files are
+   printed in command-line order as soon as they are complete, so the output
+   is the same as a single-process run. A job whose worker disconnects is
+   queued again (up to three attempts), and dead local workers are replaced.
+   ============================================================================== */
+
+#include "../Source/AnalysisCache.h"
+#include "../Source/THDRecordFormat.h"
+#include "../Source/thdcore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <memory>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr int defaultFramesPerChunk = 256;
+constexpr int defaultRawBlockKb = 1024;
+constexpr int numPoolBlocks = 4;     // per stage; bounds what is in flight between threads
+constexpr int defaultSegmentChunks = 4;
+constexpr int maxJobAttempts = 3;    // a segment whose worker dies this often fails its file
+
+int printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: thd-analyze [--cache DIR | --no-cache] [--rehash] [--fft-order N] [--hop N]\n"
+                  "                   [--chunk-frames N] [--quiet] FILE...\n"
+                  "       thd-analyze --raw s16|s24|s32|f32 --rate HZ --channels N [--block-kb N]\n"
+                  "                   [--fft-order N] [--hop N] [--quiet] [- | FIFO]...\n"
+                  "       thd-analyze --coordinator [--workers N] [--socket PATH] [--segment-chunks N] [options] FILE...\n"
+                  "       thd-analyze --worker SOCKET [--cache DIR | --no-cache]\n");
+    return 2;
+}
+
+enum class SampleFormat : uint32_t
+{
+    pcm16 = 1,
+    pcm24 = 2,
+    pcm32 = 3,
+    float32 = 4
+};
+
+uint16_t readU16 (const unsigned char* bytes) noexcept { return static_cast<uint16_t> (bytes[0] | (bytes[1] << 8)); }
+
+uint32_t readU32 (const unsigned char* bytes) noexcept
+{
+    return static_cast<uint32_t> (bytes[0]) | (static_cast<uint32_t> (bytes[1]) << 8)
+         | (static_cast<uint32_t> (bytes[2]) << 16) | (static_cast<uint32_t> (bytes[3]) << 24);
+}
+
+int bytesPerSample (SampleFormat format) noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::pcm16:   return 2;
+        case SampleFormat::pcm24:   return 3;
+        case SampleFormat::pcm32:   return 4;
+        case SampleFormat::float32: return 4;
+    }
+
+    return 0;
+}
+
+/** Converts numValues little-endian samples to floats in [-1, 1). */
+void decodeSamples (SampleFormat format, const unsigned char* source, size_t numValues, float* destination) noexcept
+{
+    switch (format)
+    {
+        case SampleFormat::pcm16:
+            for (size_t i = 0; i < numValues; ++i)
+                destination[i] = static_cast<float> (static_cast<int16_t> (readU16 (source + i * 2))) * (1.0f / 32768.0f);
+            break;
+
+        case SampleFormat::pcm24:
+            for (size_t i = 0; i < numValues; ++i)
+            {
+                const auto* value = source + i * 3;
+                const auto packed = static_cast<int32_t> ((static_cast<uint32_t> (value[0]) << 8) | (static_cast<uint32_t> (value[1]) << 16)
+                                                        | (static_cast<uint32_t> (value[2]) << 24));
+                destination[i] = static_cast<float> (packed >> 8) * (1.0f / 8388608.0f);
+            }
+            break;
+
+        case SampleFormat::pcm32:
+            for (size_t i = 0; i < numValues; ++i)
+                destination[i] = static_cast<float> (static_cast<int32_t> (readU32 (source + i * 4))) * (1.0f / 2147483648.0f);
+            break;
+
+        case SampleFormat::float32:
+            std::memcpy (destination, source, numValues * sizeof (float));
+            break;
+    }
+}
+
+/** A memory-mapped WAV file: format and the location of its sample data. */
+struct WavFile
+{
+    ~WavFile()
+    {
+        if (mapping != nullptr)
+            ::munmap (mapping, mappingSize);
+    }
+
+    bool open (const std::string& path, std::string& error)
+    {
+        const auto fd = ::open (path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            error = std::strerror (errno);
+            return false;
+        }
+
+        struct stat info {};
+        if (::fstat (fd, &info) != 0 || info.st_size < 44)
+        {
+            ::close (fd);
+            error = "not a WAV file";
+            return false;
+        }
+
+        fileSize = static_cast<uint64_t> (info.st_size);
+       #if defined (__APPLE__)
+        modifiedNs = static_cast<int64_t> (info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+       #else
+        modifiedNs = static_cast<int64_t> (info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+       #endif
+
+        mappingSize = static_cast<size_t> (info.st_size);
+        auto* mapped = ::mmap (nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close (fd);
+
+        if (mapped == MAP_FAILED)
+        {
+            error = std::strerror (errno);
+            return false;
+        }
+
+        mapping = mapped;
+        return parse (static_cast<const unsigned char*> (mapped), mappingSize, error);
+    }
+
+    bool parse (const unsigned char* bytes, size_t size, std::string& error)
+    {
+        if (std::memcmp (bytes, "RIFF", 4) != 0 || std::memcmp (bytes + 8, "WAVE", 4) != 0)
+        {
+            error = "not a RIFF/WAVE file";
+            return false;
+        }
+
+        bool haveFormat = false;
+        uint16_t formatTag = 0;
+        uint16_t bitsPerSample = 0;
+
+        for (size_t offset = 12; offset + 8 <= size;)
+        {
+            const auto* chunk = bytes + offset;
+            const auto chunkSize = static_cast<size_t> (readU32 (chunk + 4));
+            const auto* body = chunk + 8;
+            const auto available = std::min (chunkSize, size - offset - 8);
+
+            if (std::memcmp (chunk, "fmt ", 4) == 0 && available >= 16)
+            {
+                formatTag = readU16 (body);
+                numChannels = readU16 (body + 2);
+                sampleRate = readU32 (body + 4);
+                bytesPerFrame = readU16 (body + 12);
+                bitsPerSample = readU16 (body + 14);
+
+                // WAVE_FORMAT_EXTENSIBLE: the real tag leads the sub-format GUID.
+                if (formatTag == 0xFFFE && available >= 26)
+                    formatTag = readU16 (body + 24);
+
+                haveFormat = true;
+            }
+            else if (std::memcmp (chunk, "data", 4) == 0)
+            {
+                samples = body;
+                numFrames = static_cast<int64_t> (available / std::max<uint32_t> (1, bytesPerFrame));
+                break;
+            }
+
+            offset += 8 + chunkSize + (chunkSize & 1);
+        }
+
+        if (! haveFormat || samples == nullptr)
+        {
+            error = "missing fmt or data chunk";
+            return false;
+        }
+
+        if (formatTag == 1 && bitsPerSample == 16)      format = SampleFormat::pcm16;
+        else if (formatTag == 1 && bitsPerSample == 24) format = SampleFormat::pcm24;
+        else if (formatTag == 1 && bitsPerSample == 32) format = SampleFormat::pcm32;
+        else if (formatTag == 3 && bitsPerSample == 32) format = SampleFormat::float32;
+        else
+        {
+            error = "unsupported sample format (tag " + std::to_string (formatTag) + ", " + std::to_string (bitsPerSample) + " bits)";
+            return false;
+        }
+
+        if (numChannels < 1 || numChannels > THD_MAX_CHANNELS || bytesPerFrame != numChannels * (bitsPerSample / 8) || sampleRate == 0)
+        {
+            error = "unsupported layout (" + std::to_string (numChannels) + " channels)";
+            return false;
+        }
+
+        return true;
+    }
+
+    /** Decodes numFramesToDecode interleaved frames from firstFrame into destination. */
+    void decode (int64_t firstFrame, int64_t numFramesToDecode, float* destination) const noexcept
+    {
+        decodeSamples (format, samples + static_cast<size_t> (firstFrame) * bytesPerFrame,
+                       static_cast<size_t> (numFramesToDecode) * numChannels, destination);
+    }
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    uint64_t fileSize = 0;
+    int64_t modifiedNs = 0;
+    const unsigned char* samples = nullptr;
+    int64_t numFrames = 0;
+    uint32_t sampleRate = 0;
+    uint32_t numChannels = 0;
+    uint32_t bytesPerFrame = 0;
+    SampleFormat format = SampleFormat::pcm16;
+};
+
+struct Options
+{
+    std::string cacheDirectory = AnalysisCache::Store::defaultDirectory();
+    bool useCache = true;
+    bool rehash = false;
+    bool quiet = false;
+    int fftOrder = THD_DEFAULT_FFT_ORDER;
+    int hopSize = 0;
+    int framesPerChunk = defaultFramesPerChunk;
+
+    bool raw = false;
+    SampleFormat rawFormat = SampleFormat::pcm16;
+    uint32_t rawSampleRate = 0;
+    uint32_t rawChannels = 0;
+    size_t rawBlockBytes = defaultRawBlockKb * 1024;
+
+    bool coordinator = false;
+    int numWorkers = static_cast<int> (std::max (1u, std::thread::hardware_concurrency()));
+    int segmentChunks = defaultSegmentChunks;
+    std::string socketPath;
+    std::string workerSocketPath;
+    std::string executablePath;
+};
+
+/** One result as a THDRecord measurement: what the CSV prints and what workers send back. */
+THDRecord::Measurement toMeasurement (const thd_result& result, int64_t frameIndex, int64_t spanStartSample,
+                                      int fftSize, double sampleRate) noexcept
+{
+    auto record = THDRecord::makeMeasurement();
+    record.channelId = result.channel;
+    record.sequence = static_cast<uint64_t> (frameIndex);
+    record.timelineSample = spanStartSample + result.frame_start;
+    record.timeSeconds = static_cast<double> (record.timelineSample + fftSize / 2) / sampleRate;
+    record.thd = result.thd_percent;
+    record.thdN = result.thdn_percent;
+    record.level = result.level_rms;
+    record.fundamentalHz = result.fundamental_hz;
+    record.noiseFloor = result.noise_floor;
+    record.confidence = result.confidence;
+    record.flags = result.fundamental_valid != 0 ? THDRecord::Measurement::fundamentalValidFlag : 0u;
+    std::copy (std::begin (result.harmonics), std::end (result.harmonics), record.harmonics.begin());
+    return record;
+}
+
+void printMeasurement (const THDRecord::Measurement& record)
+{
+    const auto valid = (record.flags & THDRecord::Measurement::fundamentalValidFlag) != 0 ? 1 : 0;
+
+    std::printf ("%.6f,%d,%d,%.6g,%.6g,%.6g,%.6g,%.6g", record.timeSeconds, record.channelId, valid,
+                 static_cast<double> (record.fundamentalHz), static_cast<double> (record.thd),
+                 static_cast<double> (record.thdN), static_cast<double> (record.level),
+                 static_cast<double> (record.noiseFloor));
+
+    for (const auto harmonic : record.harmonics)
+        std::printf (",%.6g", static_cast<double> (harmonic));
+
+    std::printf ("\n");
+}
+
+/** Prints frame-major results whose frame_start is relative to spanStartSample. */
+void printResults (const thd_result* results, size_t numResults, int64_t firstFrameIndex, int64_t spanStartSample,
+                   int numChannels, int fftSize, double sampleRate)
+{
+    for (size_t i = 0; i < numResults; ++i)
+        printMeasurement (toMeasurement (results[i], firstFrameIndex + static_cast<int64_t> (i) / numChannels,
+                                         spanStartSample, fftSize, sampleRate));
+}
+
+/** A WAV file opened for chunked analysis: its engine and cache identity. */
+class InputFile
+{
+public:
+    ~InputFile()
+    {
+        if (engine != nullptr)
+            thd_engine_destroy (engine);
+    }
+
+    bool open (const std::string& path, const Options& options, std::string& error)
+    {
+        if (! wav.open (path, error))
+            return false;
+
+        thd_config config;
+        thd_config_init (&config);
+        config.sample_rate = static_cast<double> (wav.sampleRate);
+        config.fft_order = options.fftOrder;
+        config.hop_size = options.hopSize;
+        config.num_channels = static_cast<int32_t> (wav.numChannels);
+
+        if (const auto status = thd_engine_create (&config, &engine); status != THD_OK)
+        {
+            error = thd_status_string (status);
+            return false;
+        }
+
+        fftSize = thd_engine_fft_size (engine);
+        hopSize = thd_engine_hop_size (engine);
+        framesPerChunk = options.framesPerChunk;
+        totalFrames = thd_engine_count_frames (engine, wav.numFrames);
+        numChunks = static_cast<size_t> ((totalFrames + framesPerChunk - 1) / framesPerChunk);
+
+        cacheConfig.sampleRate = wav.sampleRate;
+        cacheConfig.numChannels = wav.numChannels;
+        cacheConfig.sampleFormat = static_cast<uint32_t> (wav.format);
+        cacheConfig.bytesPerFrame = wav.bytesPerFrame;
+        cacheConfig.fftOrder = options.fftOrder;
+        cacheConfig.hopSize = hopSize;
+        cacheConfig.framesPerChunk = options.framesPerChunk;
+        configDigest = cacheConfig.digest();
+
+        char canonical[PATH_MAX];
+        const std::string canonicalPath = ::realpath (path.c_str(), canonical) != nullptr ? canonical : path;
+        manifestKey = AnalysisCache::Store::manifestKeyFor (canonicalPath, cacheConfig);
+        return true;
+    }
+
+    int64_t chunkFirstFrame (size_t chunk) const noexcept { return static_cast<int64_t> (chunk) * framesPerChunk; }
+    int64_t chunkStartSample (size_t chunk) const noexcept { return chunkFirstFrame (chunk) * hopSize; }
+
+    /** Unchanged size and mtime: every chunk by its recorded key, without touching the audio. */
+    bool loadFromManifest (const AnalysisCache::Store& store, std::vector<std::vector<thd_result>>& results) const
+    {
+        AnalysisCache::Manifest manifest;
+        if (! store.loadManifest (manifestKey, manifest) || manifest.fileSize != wav.fileSize
+            || manifest.modifiedNs != wav.modifiedNs || manifest.chunkKeys.size() != numChunks)
+            return false;
+
+        results.resize (numChunks);
+        for (size_t chunk = 0; chunk < numChunks; ++chunk)
+            if (! store.loadChunk (manifest.chunkKeys[chunk], wav.numChannels, results[chunk]))
+                return false;
+
+        return true;
+    }
+
+    bool storeManifest (const AnalysisCache::Store& store, std::vector<AnalysisCache::Digest> chunkKeys, std::string& error) const
+    {
+        AnalysisCache::Manifest manifest;
+        manifest.fileSize = wav.fileSize;
+        manifest.modifiedNs = wav.modifiedNs;
+        manifest.chunkKeys = std::move (chunkKeys);
+        return store.storeManifest (manifestKey, manifest, &error);
+    }
+
+    /** Recalls or analyses chunks [firstChunk, endChunk) into results[chunk - firstChunk], with their keys. */
+    bool analyzeChunks (size_t firstChunk, size_t endChunk, const AnalysisCache::Store* store,
+                        std::vector<thd_result>* results, AnalysisCache::Digest* keys,
+                        size_t& numCached, size_t& numAnalysed, std::string& error)
+    {
+        std::vector<const float*> channelPointers (wav.numChannels);
+
+        for (auto chunk = firstChunk; chunk < endChunk; ++chunk)
+        {
+            const auto numFrames = std::min<int64_t> (framesPerChunk, totalFrames - chunkFirstFrame (chunk));
+            const auto spanStart = chunkStartSample (chunk);
+            const auto spanLength = (numFrames - 1) * hopSize + fftSize;
+            auto& chunkResults = results[chunk - firstChunk];
+
+            // The key covers exactly the bytes this chunk's frames read, overlap included.
+            const auto key = AnalysisCache::hashBytes (wav.samples + static_cast<size_t> (spanStart) * wav.bytesPerFrame,
+                                                       static_cast<size_t> (spanLength) * wav.bytesPerFrame, configDigest);
+            keys[chunk - firstChunk] = key;
+
+            if (store != nullptr && store->loadChunk (key, wav.numChannels, chunkResults)
+                && chunkResults.size() == static_cast<size_t> (numFrames) * wav.numChannels)
+            {
+                ++numCached;
+                continue;
+            }
+
+            decoded.resize (static_cast<size_t> (spanLength) * wav.numChannels);
+            wav.decode (spanStart, spanLength, decoded.data());
+
+            for (size_t channel = 0; channel < channelPointers.size(); ++channel)
+                channelPointers[channel] = decoded.data() + channel;
+
+            const thd_buffer buffer { channelPointers.data(), static_cast<int32_t> (wav.numChannels), spanLength,
+                                      static_cast<int32_t> (wav.numChannels) };
+
+            chunkResults.resize (static_cast<size_t> (numFrames) * wav.numChannels);
+            int64_t numWritten = 0;
+
+            if (const auto status = thd_engine_analyze_buffer (engine, &buffer, chunkResults.data(), numFrames, &numWritten); status != THD_OK)
+            {
+                error = thd_status_string (status);
+                return false;
+            }
+
+            ++numAnalysed;
+
+            std::string cacheError;
+            if (store != nullptr && ! store->storeChunk (key, wav.numChannels, chunkResults.data(), static_cast<size_t> (numWritten), &cacheError))
+                std::fprintf (stderr, "thd-analyze: cache: %s\n", cacheError.c_str());
+        }
+
+        return true;
+    }
+
+    void printChunks (const std::vector<std::vector<thd_result>>& results) const
+    {
+        for (size_t chunk = 0; chunk < results.size(); ++chunk)
+            printResults (results[chunk].data(), results[chunk].size(), chunkFirstFrame (chunk), chunkStartSample (chunk),
+                          static_cast<int> (wav.numChannels), fftSize, static_cast<double> (wav.sampleRate));
+    }
+
+    WavFile wav;
+    thd_engine* engine = nullptr;
+    int fftSize = 0;
+    int hopSize = 0;
+    int framesPerChunk = defaultFramesPerChunk;
+    int64_t totalFrames = 0;
+    size_t numChunks = 0;
+    AnalysisCache::Config cacheConfig;
+    AnalysisCache::Digest configDigest;
+    AnalysisCache::Digest manifestKey;
+
+private:
+    std::vector<float> decoded;
+};
+
+/** Analyses (or recalls) one file and prints its rows; false on error. */
+bool analyzeFile (const std::string& path, const Options& options, const AnalysisCache::Store* store)
+{
+    const auto started = std::chrono::steady_clock::now();
+
+    InputFile input;
+    std::string error;
+    if (! input.open (path, options, error))
+    {
+        std::fprintf (stderr, "thd-analyze: %s: %s\n", path.c_str(), error.c_str());
+        return false;
+    }
+
+    std::vector<std::vector<thd_result>> results;
+    const auto fromManifest = store != nullptr && ! options.rehash && input.loadFromManifest (*store, results);
+    size_t numCached = fromManifest ? input.numChunks : 0;
+    size_t numAnalysed = 0;
+
+    if (! fromManifest)
+    {
+        std::vector<AnalysisCache::Digest> keys (input.numChunks);
+        results.assign (input.numChunks, {});
+
+        if (! input.analyzeChunks (0, input.numChunks, store, results.data(), keys.data(), numCached, numAnalysed, error))
+        {
+            std::fprintf (stderr, "thd-analyze: %s: %s\n", path.c_str(), error.c_str());
+            return false;
+        }
+
+        if (store != nullptr && ! input.storeManifest (*store, std::move (keys), error))
+            std::fprintf (stderr, "thd-analyze: cache: %s\n", error.c_str());
+    }
+
+    input.printChunks (results);
+
+    if (! options.quiet)
+    {
+        const auto seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - started).count();
+        std::fprintf (stderr, "thd-analyze: %s: %zu chunks, %zu cached, %zu analysed%s, %.3f s\n",
+                      path.c_str(), input.numChunks, numCached, numAnalysed, fromManifest ? " (manifest)" : "", seconds);
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool parseRawFormat (const std::string& name, SampleFormat& format)
+{
+    if (name == "s16")      format = SampleFormat::pcm16;
+    else if (name == "s24") format = SampleFormat::pcm24;
+    else if (name == "s32") format = SampleFormat::pcm32;
+    else if (name == "f32") format = SampleFormat::float32;
+    else                    return false;
+
+    return true;
+}
+
+struct RawBlock
+{
+    std::vector<unsigned char> bytes;
+    size_t size = 0;                 // whole frames only
+};
+
+struct FloatBlock
+{
+    std::vector<float> samples;      // interleaved
+    int64_t numFrames = 0;
+};
+
+/** FIFO of blocks between two pipeline stages. It needs no capacity of its
+    own: only the fixed pool of blocks ever circulates through the queues. */
+template <typename Block>
+class BlockQueue
+{
+public:
+    void push (Block* block)
+    {
+        {
+            const std::lock_guard<std::mutex> scoped (lock);
+            blocks.push_back (block);
+        }
+
+        ready.notify_one();
+    }
+
+    /** Waits for the next block; nullptr once closed and empty. */
+    Block* pop()
+    {
+        std::unique_lock<std::mutex> scoped (lock);
+        ready.wait (scoped, [this] { return closed || ! blocks.empty(); });
+
+        if (blocks.empty())
+            return nullptr;
+
+        auto* block = blocks.front();
+        blocks.pop_front();
+        return block;
+    }
+
+    void close()
+    {
+        {
+            const std::lock_guard<std::mutex> scoped (lock);
+            closed = true;
+        }
+
+        ready.notify_all();
+    }
+
+private:
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<Block*> blocks;
+    bool closed = false;
+};
+
+/** Streams headerless PCM from fd through reader, converter and analysis, printing rows as frames complete. */
+bool analyzeStream (int fd, const std::string& name, const Options& options)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const auto numChannels = options.rawChannels;
+    const auto bytesPerFrame = static_cast<size_t> (bytesPerSample (options.rawFormat)) * numChannels;
+    const auto blockFrames = std::max<size_t> (1, options.rawBlockBytes / bytesPerFrame);
+
+    thd_config config;
+    thd_config_init (&config);
+    config.sample_rate = static_cast<double> (options.rawSampleRate);
+    config.fft_order = options.fftOrder;
+    config.hop_size = options.hopSize;
+    config.num_channels = static_cast<int32_t> (numChannels);
+
+    thd_engine* engine = nullptr;
+    if (const auto status = thd_engine_create (&config, &engine); status != THD_OK)
+    {
+        std::fprintf (stderr, "thd-analyze: %s: %s\n", name.c_str(), thd_status_string (status));
+        return false;
+    }
+
+    const auto fftSize = static_cast<int64_t> (thd_engine_fft_size (engine));
+    const auto hopSize = static_cast<int64_t> (thd_engine_hop_size (engine));
+
+   #if defined (F_SETPIPE_SZ)
+    // Larger pipe buffers let each read() return a whole block; harmless if refused or not a pipe.
+    ::fcntl (fd, F_SETPIPE_SZ, static_cast<int> (std::min<size_t> (options.rawBlockBytes, 1 << 20)));
+   #endif
+
+    std::vector<RawBlock> rawPool (numPoolBlocks);
+    std::vector<FloatBlock> floatPool (numPoolBlocks);
+    BlockQueue<RawBlock> freeRaw, filledRaw;
+    BlockQueue<FloatBlock> freeFloat, filledFloat;
+
+    for (auto& block : rawPool)
+    {
+        block.bytes.resize (blockFrames * bytesPerFrame);
+        freeRaw.push (&block);
+    }
+
+    for (auto& block : floatPool)
+    {
+        block.samples.resize (blockFrames * numChannels);
+        freeFloat.push (&block);
+    }
+
+    std::string readError;
+    size_t trailingBytes = 0;
+    std::atomic<bool> stopReading { false };
+
+    // Reader: read() lands directly in pool blocks. A block is handed on as soon
+    // as the source has nothing more buffered, so live pipes stream with low
+    // latency while files and busy pipes fill whole blocks.
+    std::thread reader ([&]
+    {
+        unsigned char partialFrame[THD_MAX_CHANNELS * 4];
+        size_t numPartial = 0;
+
+        for (bool endOfInput = false; ! endOfInput && ! stopReading;)
+        {
+            auto* block = freeRaw.pop();
+
+            std::memcpy (block->bytes.data(), partialFrame, numPartial);
+            auto size = numPartial;
+
+            while (size < block->bytes.size())
+            {
+                const auto wanted = block->bytes.size() - size;
+                const auto numRead = ::read (fd, block->bytes.data() + size, wanted);
+
+                if (numRead < 0 && errno == EINTR)
+                    continue;
+
+                if (numRead <= 0)
+                {
+                    if (numRead < 0)
+                        readError = std::strerror (errno);
+
+                    endOfInput = true;
+                    break;
+                }
+
+                size += static_cast<size_t> (numRead);
+
+                if (static_cast<size_t> (numRead) < wanted && size >= bytesPerFrame)
+                    break;
+            }
+
+            numPartial = size % bytesPerFrame;
+            block->size = size - numPartial;
+            std::memcpy (partialFrame, block->bytes.data() + block->size, numPartial);
+
+            if (block->size > 0)
+                filledRaw.push (block);
+            else
+                freeRaw.push (block);
+        }
+
+        trailingBytes = numPartial;
+        filledRaw.close();
+    });
+
+    // Converter: raw blocks to float blocks, returning each raw block for reuse.
+    std::thread converter ([&]
+    {
+        while (auto* raw = filledRaw.pop())
+        {
+            auto* converted = freeFloat.pop();
+            converted->numFrames = static_cast<int64_t> (raw->size / bytesPerFrame);
+            decodeSamples (options.rawFormat, raw->bytes.data(), static_cast<size_t> (converted->numFrames) * numChannels,
+                           converted->samples.data());
+
+            freeRaw.push (raw);
+            filledFloat.push (converted);
+        }
+
+        filledFloat.close();
+    });
+
+    // Analysis on this thread: pending holds the samples not yet covered by a
+    // completed frame, never more than one FFT plus one block.
+    std::vector<float> pending (static_cast<size_t> (fftSize + static_cast<int64_t> (blockFrames)) * numChannels);
+    std::vector<thd_result> results (static_cast<size_t> ((fftSize + static_cast<int64_t> (blockFrames)) / hopSize + 1) * numChannels);
+    std::vector<const float*> channelPointers (numChannels);
+    int64_t pendingFrames = 0;
+    int64_t pendingStart = 0;       // stream position of pending[0]
+    int64_t samplesToSkip = 0;      // when the hop is longer than the FFT
+    int64_t numSamples = 0;
+    int64_t numAnalysed = 0;
+    bool failed = false;
+
+    while (auto* block = filledFloat.pop())
+    {
+        numSamples += block->numFrames;
+
+        if (! failed)
+        {
+            const auto skipped = std::min (samplesToSkip, block->numFrames);
+            samplesToSkip -= skipped;
+            pendingStart += skipped;
+
+            std::memcpy (pending.data() + static_cast<size_t> (pendingFrames) * numChannels,
+                         block->samples.data() + static_cast<size_t> (skipped) * numChannels,
+                         static_cast<size_t> (block->numFrames - skipped) * numChannels * sizeof (float));
+            pendingFrames += block->numFrames - skipped;
+        }
+
+        freeFloat.push (block);
+
+        const auto numFrames = failed ? 0 : thd_engine_count_frames (engine, pendingFrames);
+        if (numFrames == 0)
+            continue;
+
+        for (size_t channel = 0; channel < channelPointers.size(); ++channel)
+            channelPointers[channel] = pending.data() + channel;
+
+        const thd_buffer buffer { channelPointers.data(), static_cast<int32_t> (numChannels), pendingFrames,
+                                  static_cast<int32_t> (numChannels) };
+        int64_t numWritten = 0;
+
+        if (const auto status = thd_engine_analyze_buffer (engine, &buffer, results.data(), numFrames, &numWritten); status != THD_OK)
+        {
+            std::fprintf (stderr, "thd-analyze: %s: %s\n", name.c_str(), thd_status_string (status));
+            failed = true;
+
+            // The reader stops at its next block; the loop keeps draining what is in flight.
+            stopReading = true;
+            continue;
+        }
+
+        printResults (results.data(), static_cast<size_t> (numWritten) * numChannels, numAnalysed, pendingStart,
+                      static_cast<int> (numChannels), static_cast<int> (fftSize), static_cast<double> (options.rawSampleRate));
+        std::fflush (stdout);
+        numAnalysed += numWritten;
+
+        const auto consumed = numWritten * hopSize;
+        const auto kept = std::max<int64_t> (0, pendingFrames - consumed);
+        std::memmove (pending.data(), pending.data() + static_cast<size_t> (pendingFrames - kept) * numChannels,
+                      static_cast<size_t> (kept) * numChannels * sizeof (float));
+
+        samplesToSkip = consumed - (pendingFrames - kept);
+        pendingStart += pendingFrames - kept;
+        pendingFrames = kept;
+    }
+
+    reader.join();
+    converter.join();
+    thd_engine_destroy (engine);
+
+    if (! readError.empty())
+    {
+        std::fprintf (stderr, "thd-analyze: %s: %s\n", name.c_str(), readError.c_str());
+        failed = true;
+    }
+
+    if (trailingBytes != 0)
+        std::fprintf (stderr, "thd-analyze: %s: ignored %zu bytes of an incomplete final frame\n", name.c_str(), trailingBytes);
+
+    if (! options.quiet)
+    {
+        const auto seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - started).count();
+        const auto audioSeconds = static_cast<double> (numSamples) / options.rawSampleRate;
+        std::fprintf (stderr, "thd-analyze: %s: %.1f s of audio, %lld frames, %.3f s (%.0fx real time)\n",
+                      name.c_str(), audioSeconds, static_cast<long long> (numAnalysed), seconds,
+                      seconds > 0.0 ? audioSeconds / seconds : 0.0);
+    }
+
+    return ! failed;
+}
+
+//==============================================================================
+// Distributed batches: a coordinator shards files into segments of whole
+// chunks and serves them over a Unix stream socket to worker processes, which
+// reply with the segment's chunk keys and a THDRecord stream of its results.
+// Every message is a MessageHeader followed by size bytes of payload.
+enum class MessageType : uint32_t
+{
+    request = 1,    // worker: ready for a job
+    job = 2,        // coordinator: JobMessage + path
+    result = 3,     // worker: ResultMessage + chunk keys + THDRecord stream
+    failure = 4,    // worker: job id + error text; the job is not retried
+    shutdown = 5    // coordinator: no more work
+};
+
+struct MessageHeader
+{
+    uint32_t type;
+    uint32_t size;
+};
+
+struct JobMessage
+{
+    uint64_t jobId;
+    uint32_t firstChunk;
+    uint32_t endChunk;
+    int32_t fftOrder;
+    int32_t hopSize;
+    int32_t framesPerChunk;
+    uint32_t pathLength;
+};
+
+struct ResultMessage
+{
+    uint64_t jobId;
+    uint32_t numChunks;
+    uint32_t numCached;
+};
+
+static_assert (sizeof (JobMessage) == 32 && sizeof (ResultMessage) == 16, "Message layout");
+static_assert (sizeof (ResultMessage) % THDRecord::alignment == 0, "Keys and records stay 8-byte aligned");
+
+constexpr uint32_t maxMessageSize = 1u << 30;
+
+bool writeAll (int fd, const void* data, size_t size)
+{
+    const auto* bytes = static_cast<const unsigned char*> (data);
+
+    while (size > 0)
+    {
+       #if defined (MSG_NOSIGNAL)
+        const auto written = ::send (fd, bytes, size, MSG_NOSIGNAL);
+       #else
+        const auto written = ::write (fd, bytes, size);
+       #endif
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        size -= static_cast<size_t> (written);
+    }
+
+    return true;
+}
+
+bool readAll (int fd, void* data, size_t size)
+{
+    auto* bytes = static_cast<unsigned char*> (data);
+
+    while (size > 0)
+    {
+        const auto numRead = ::read (fd, bytes, size);
+
+        if (numRead < 0 && errno == EINTR)
+            continue;
+
+        if (numRead <= 0)
+            return false;
+
+        bytes += numRead;
+        size -= static_cast<size_t> (numRead);
+    }
+
+    return true;
+}
+
+bool sendMessage (int fd, MessageType type, const void* payload = nullptr, size_t size = 0)
+{
+    const MessageHeader header { static_cast<uint32_t> (type), static_cast<uint32_t> (size) };
+    return writeAll (fd, &header, sizeof (header)) && (size == 0 || writeAll (fd, payload, size));
+}
+
+/** Payloads land in 8-byte aligned storage so THDRecord::Cursor can read them in place. */
+bool receiveMessage (int fd, MessageHeader& header, std::vector<uint64_t>& payload)
+{
+    if (! readAll (fd, &header, sizeof (header)) || header.size > maxMessageSize)
+        return false;
+
+    payload.resize ((header.size + 7) / 8);
+    return readAll (fd, payload.data(), header.size);
+}
+
+sockaddr_un socketAddress (const std::string& path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy (address.sun_path, path.c_str(), sizeof (address.sun_path) - 1);
+    return address;
+}
+
+//==============================================================================
+int runWorker (const std::string& socketPath, const Options& options)
+{
+    std::signal (SIGPIPE, SIG_IGN);
+
+    const auto fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    const auto address = socketAddress (socketPath);
+
+    // The coordinator may still be starting up.
+    bool connected = false;
+    for (int attempt = 0; fd >= 0 && attempt < 50 && ! connected; ++attempt)
+    {
+        connected = ::connect (fd, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) == 0;
+        if (! connected)
+            ::usleep (100 * 1000);
+    }
+
+    if (! connected)
+    {
+        std::fprintf (stderr, "thd-analyze worker: %s: %s\n", socketPath.c_str(), std::strerror (errno));
+        return 1;
+    }
+
+    AnalysisCache::Store store (options.cacheDirectory);
+    const auto useCache = options.useCache && store.open();
+
+    std::unique_ptr<InputFile> input;
+    std::string inputKey;
+    std::vector<uint64_t> payload;
+    std::vector<unsigned char> reply;
+    MessageHeader header {};
+
+    while (sendMessage (fd, MessageType::request) && receiveMessage (fd, header, payload)
+           && header.type == static_cast<uint32_t> (MessageType::job) && header.size >= sizeof (JobMessage))
+    {
+        JobMessage job;
+        std::memcpy (&job, payload.data(), sizeof (job));
+        const std::string path (reinterpret_cast<const char*> (payload.data()) + sizeof (job),
+                                std::min<size_t> (job.pathLength, header.size - sizeof (job)));
+
+        std::string error;
+        const auto fail = [&]
+        {
+            std::vector<unsigned char> message (sizeof (uint64_t) + error.size());
+            std::memcpy (message.data(), &job.jobId, sizeof (uint64_t));
+            std::memcpy (message.data() + sizeof (uint64_t), error.data(), error.size());
+            return sendMessage (fd, MessageType::failure, message.data(), message.size());
+        };
+
+        // Consecutive segments of one file reuse its mapping and engine.
+        const auto key = path + '\n' + std::to_string (job.fftOrder) + ' ' + std::to_string (job.hopSize) + ' ' + std::to_string (job.framesPerChunk);
+        if (input == nullptr || key != inputKey)
+        {
+            auto jobOptions = options;
+            jobOptions.fftOrder = job.fftOrder;
+            jobOptions.hopSize = job.hopSize;
+            jobOptions.framesPerChunk = job.framesPerChunk;
+
+            input = std::make_unique<InputFile>();
+            inputKey = key;
+
+            if (! input->open (path, jobOptions, error))
+            {
+                input.reset();
+                if (! fail())
+                    break;
+
+                continue;
+            }
+        }
+
+        if (job.firstChunk >= job.endChunk || job.endChunk > input->numChunks)
+        {
+            error = "file changed since it was planned";
+            if (! fail())
+                break;
+
+            continue;
+        }
+
+        const auto numChunks = static_cast<size_t> (job.endChunk - job.firstChunk);
+        std::vector<std::vector<thd_result>> results (numChunks);
+        std::vector<AnalysisCache::Digest> keys (numChunks);
+        size_t numCached = 0, numAnalysed = 0;
+
+        if (! input->analyzeChunks (job.firstChunk, job.endChunk, useCache ? &store : nullptr,
+                                    results.data(), keys.data(), numCached, numAnalysed, error))
+        {
+            if (! fail())
+                break;
+
+            continue;
+        }
+
+        size_t numRecords = 0;
+        for (const auto& chunkResults : results)
+            numRecords += chunkResults.size();
+
+        const ResultMessage result { job.jobId, static_cast<uint32_t> (numChunks), static_cast<uint32_t> (numCached) };
+        auto stream = THDRecord::make<THDRecord::StreamHeader>();
+        stream.numRecords = static_cast<uint32_t> (numRecords);
+
+        reply.resize (sizeof (result) + numChunks * 2 * sizeof (uint64_t) + sizeof (stream)
+                      + numRecords * sizeof (THDRecord::Measurement));
+        auto* write = reply.data();
+        std::memcpy (write, &result, sizeof (result));
+        write += sizeof (result);
+
+        for (const auto& chunkKey : keys)
+        {
+            const uint64_t words[] = { chunkKey.high, chunkKey.low };
+            std::memcpy (write, words, sizeof (words));
+            write += sizeof (words);
+        }
+
+        std::memcpy (write, &stream, sizeof (stream));
+        write += sizeof (stream);
+
+        for (size_t chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const auto absoluteChunk = job.firstChunk + chunk;
+
+            for (size_t i = 0; i < results[chunk].size(); ++i)
+            {
+                const auto record = toMeasurement (results[chunk][i],
+                                                   input->chunkFirstFrame (absoluteChunk) + static_cast<int64_t> (i / input->wav.numChannels),
+                                                   input->chunkStartSample (absoluteChunk), input->fftSize,
+                                                   static_cast<double> (input->wav.sampleRate));
+                std::memcpy (write, &record, sizeof (record));
+                write += sizeof (record);
+            }
+        }
+
+        if (! sendMessage (fd, MessageType::result, reply.data(), reply.size()))
+            break;
+    }
+
+    ::close (fd);
+    return 0;
+}
+
+//==============================================================================
+/** Runs a batch across local (and any externally started) workers; returns the exit code. */
+int runCoordinator (const std::vector<std::string>& files, const Options& options, const AnalysisCache::Store* store)
+{
+    const auto started = std::chrono::steady_clock::now();
+    std::signal (SIGPIPE, SIG_IGN);
+
+    const auto socketPath = ! options.socketPath.empty() ? options.socketPath
+                                                         : "/tmp/thd-analyze-" + std::to_string (static_cast<long> (::getpid())) + ".sock";
+    const auto listener = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    const auto address = socketAddress (socketPath);
+    ::unlink (socketPath.c_str());
+
+    if (listener >= 0)
+        ::fcntl (listener, F_SETFD, FD_CLOEXEC);
+
+    if (listener < 0 || ::bind (listener, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) != 0
+        || ::listen (listener, 64) != 0)
+    {
+        std::fprintf (stderr, "thd-analyze: %s: %s\n", socketPath.c_str(), std::strerror (errno));
+        return 1;
+    }
+
+    struct FilePlan
+    {
+        std::string path;
+        size_t numChunks = 0;
+        size_t numJobsLeft = 0;
+        uint64_t fileSize = 0;
+        int64_t modifiedNs = 0;
+        AnalysisCache::Digest manifestKey;
+        std::vector<AnalysisCache::Digest> chunkKeys;
+        std::vector<std::vector<THDRecord::Measurement>> segments;
+        bool planned = false;
+        bool fromManifest = false;
+        bool failed = false;
+    };
+
+    struct Job
+    {
+        size_t file = 0;
+        size_t segment = 0;
+        uint32_t firstChunk = 0;
+        uint32_t endChunk = 0;
+        int attempts = 0;
+    };
+
+    struct Connection
+    {
+        int fd = -1;
+        std::vector<unsigned char> inbox;
+        size_t job = SIZE_MAX;          // in flight on this worker
+        bool waiting = false;           // asked for work while none was queued
+    };
+
+    std::vector<FilePlan> plans (files.size());
+    std::vector<Job> jobs;
+    std::deque<size_t> queue;
+    std::vector<Connection> connections;
+    std::vector<pid_t> children;
+    size_t numPrinted = 0, numFailed = 0, numFromManifest = 0, numRetries = 0, numCached = 0, numChunks = 0;
+    size_t numSpawned = 0;
+    const auto maxSpawns = static_cast<size_t> (options.numWorkers) * maxJobAttempts;
+
+    const auto spawnWorker = [&]
+    {
+        char selfPath[PATH_MAX] = {};
+        if (::readlink ("/proc/self/exe", selfPath, sizeof (selfPath) - 1) <= 0)
+            std::strncpy (selfPath, options.executablePath.c_str(), sizeof (selfPath) - 1);
+
+        std::vector<std::string> arguments { selfPath, "--worker", socketPath };
+        if (store != nullptr)
+            arguments.insert (arguments.end(), { "--cache", store->getDirectory() });
+        else
+            arguments.push_back ("--no-cache");
+
+        const auto pid = ::fork();
+        if (pid == 0)
+        {
+            std::vector<char*> argv;
+            for (auto& argument : arguments)
+                argv.push_back (argument.data());
+
+            argv.push_back (nullptr);
+            ::execv (argv[0], argv.data());
+            ::_exit (127);
+        }
+
+        if (pid > 0)
+        {
+            children.push_back (pid);
+            ++numSpawned;
+        }
+    };
+
+    // Prints finished files in command-line order and frees their results.
+    const auto printFinished = [&]
+    {
+        for (; numPrinted < plans.size(); ++numPrinted)
+        {
+            auto& plan = plans[numPrinted];
+            if (! plan.planned || (! plan.failed && plan.numJobsLeft > 0))
+                break;
+
+            if (plans.size() > 1)
+                std::printf ("# file=%s\n", plan.path.c_str());
+
+            for (const auto& segment : plan.segments)
+                for (const auto& record : segment)
+                    printMeasurement (record);
+
+            std::fflush (stdout);
+
+            if (! plan.failed && ! plan.fromManifest && store != nullptr)
+            {
+                AnalysisCache::Manifest manifest;
+                manifest.fileSize = plan.fileSize;
+                manifest.modifiedNs = plan.modifiedNs;
+                manifest.chunkKeys = std::move (plan.chunkKeys);
+
+                std::string error;
+                if (! store->storeManifest (plan.manifestKey, manifest, &error))
+                    std::fprintf (stderr, "thd-analyze: cache: %s\n", error.c_str());
+            }
+
+            plan.segments = {};
+            plan.chunkKeys = {};
+        }
+    };
+
+    const auto failFile = [&] (size_t file, const std::string& error)
+    {
+        if (plans[file].failed)
+            return;
+
+        std::fprintf (stderr, "thd-analyze: %s: %s\n", plans[file].path.c_str(), error.c_str());
+        plans[file].failed = true;
+        plans[file].segments = {};
+        ++numFailed;
+    };
+
+    const auto sendJob = [&] (Connection& connection) -> bool
+    {
+        while (! queue.empty() && plans[jobs[queue.front()].file].failed)
+            queue.pop_front();
+
+        if (queue.empty())
+            return true;
+
+        const auto index = queue.front();
+        queue.pop_front();
+
+        const auto& job = jobs[index];
+        const auto& path = plans[job.file].path;
+        const JobMessage message { index, job.firstChunk, job.endChunk, options.fftOrder, options.hopSize,
+                                   options.framesPerChunk, static_cast<uint32_t> (path.size()) };
+
+        std::vector<unsigned char> payload (sizeof (message) + path.size());
+        std::memcpy (payload.data(), &message, sizeof (message));
+        std::memcpy (payload.data() + sizeof (message), path.data(), path.size());
+
+        connection.job = index;
+        connection.waiting = false;
+        return sendMessage (connection.fd, MessageType::job, payload.data(), payload.size());
+    };
+
+    // A worker that vanished with a job hands it back to the queue, up to maxJobAttempts.
+    const auto dropConnection = [&] (size_t index)
+    {
+        auto& connection = connections[index];
+        ::close (connection.fd);
+
+        if (connection.job != SIZE_MAX)
+        {
+            auto& job = jobs[connection.job];
+
+            if (++job.attempts >= maxJobAttempts)
+                failFile (job.file, "worker died " + std::to_string (job.attempts) + " times on chunks "
+                                      + std::to_string (job.firstChunk) + ".." + std::to_string (job.endChunk - 1));
+            else if (! plans[job.file].failed)
+            {
+                queue.push_front (connection.job);
+                ++numRetries;
+            }
+        }
+
+        connections.erase (connections.begin() + static_cast<std::ptrdiff_t> (index));
+    };
+
+    const auto handleMessage = [&] (Connection& connection, const MessageHeader& header, const unsigned char* payload) -> bool
+    {
+        switch (static_cast<MessageType> (header.type))
+        {
+            case MessageType::request:
+                connection.waiting = true;
+                return sendJob (connection);
+
+            case MessageType::failure:
+            {
+                uint64_t jobId = 0;
+                if (header.size < sizeof (jobId))
+                    return false;
+
+                std::memcpy (&jobId, payload, sizeof (jobId));
+                if (jobId != connection.job)
+                    return false;
+
+                connection.job = SIZE_MAX;
+                failFile (jobs[jobId].file, std::string (reinterpret_cast<const char*> (payload) + sizeof (jobId),
+                                                         header.size - sizeof (jobId)));
+                return true;
+            }
+
+            case MessageType::result:
+            {
+                ResultMessage result;
+                if (header.size < sizeof (result))
+                    return false;
+
+                std::memcpy (&result, payload, sizeof (result));
+                if (result.jobId != connection.job)
+                    return false;
+
+                const auto& job = jobs[result.jobId];
+                auto& plan = plans[job.file];
+                const auto keysSize = static_cast<size_t> (result.numChunks) * 2 * sizeof (uint64_t);
+
+                if (result.numChunks != job.endChunk - job.firstChunk || header.size < sizeof (result) + keysSize)
+                    return false;
+
+                connection.job = SIZE_MAX;
+                if (plan.failed)
+                    return true;
+
+                for (size_t chunk = 0; chunk < result.numChunks; ++chunk)
+                {
+                    uint64_t words[2];
+                    std::memcpy (words, payload + sizeof (result) + chunk * sizeof (words), sizeof (words));
+                    plan.chunkKeys[job.firstChunk + chunk] = { words[0], words[1] };
+                }
+
+                auto& records = plan.segments[job.segment];
+                records.clear();
+
+                THDRecord::Cursor cursor (payload + sizeof (result) + keysSize, header.size - sizeof (result) - keysSize);
+                while (const auto* record = cursor.next())
+                    if (const auto* measurement = THDRecord::view<THDRecord::Measurement> (record, record->size))
+                        records.push_back (*measurement);
+
+                numCached += result.numCached;
+                --plan.numJobsLeft;
+                return true;
+            }
+
+            case MessageType::job:
+            case MessageType::shutdown:
+            default:
+                return false;
+        }
+    };
+
+    for (size_t file = 0; file < files.size(); ++file)
+    {
+        auto& plan = plans[file];
+        plan.path = files[file];
+        plan.planned = true;
+
+        InputFile input;
+        std::string error;
+        if (! input.open (plan.path, options, error))
+        {
+            failFile (file, error);
+            continue;
+        }
+
+        plan.numChunks = input.numChunks;
+        plan.fileSize = input.wav.fileSize;
+        plan.modifiedNs = input.wav.modifiedNs;
+        plan.manifestKey = input.manifestKey;
+        numChunks += plan.numChunks;
+
+        std::vector<std::vector<thd_result>> results;
+        if (store != nullptr && ! options.rehash && input.loadFromManifest (*store, results))
+        {
+            plan.fromManifest = true;
+            plan.segments.resize (results.size());
+
+            for (size_t chunk = 0; chunk < results.size(); ++chunk)
+                for (size_t i = 0; i < results[chunk].size(); ++i)
+                    plan.segments[chunk].push_back (toMeasurement (results[chunk][i],
+                                                                   input.chunkFirstFrame (chunk) + static_cast<int64_t> (i / input.wav.numChannels),
+                                                                   input.chunkStartSample (chunk), input.fftSize,
+                                                                   static_cast<double> (input.wav.sampleRate)));
+
+            numCached += plan.numChunks;
+            ++numFromManifest;
+            printFinished();
+            continue;
+        }
+
+        // Local workers start with the first job, while the remaining files are
+        // planned; they wait on the listener until the loop below accepts them.
+        if (numSpawned == 0 && plan.numChunks > 0)
+            for (int worker = 0; worker < options.numWorkers; ++worker)
+                spawnWorker();
+
+        plan.chunkKeys.resize (plan.numChunks);
+        for (size_t first = 0; first < plan.numChunks; first += static_cast<size_t> (options.segmentChunks))
+        {
+            Job job;
+            job.file = file;
+            job.segment = plan.segments.size();
+            job.firstChunk = static_cast<uint32_t> (first);
+            job.endChunk = static_cast<uint32_t> (std::min (plan.numChunks, first + static_cast<size_t> (options.segmentChunks)));
+
+            queue.push_back (jobs.size());
+            jobs.push_back (job);
+            plan.segments.emplace_back();
+            ++plan.numJobsLeft;
+        }
+
+        printFinished();
+    }
+
+    std::vector<pollfd> polled;
+    std::vector<unsigned char> readBuffer (1 << 16);
+
+    while (numPrinted < plans.size())
+    {
+        // Reap local workers, replacing any that died while work remains.
+        for (int status = 0;;)
+        {
+            const auto pid = ::waitpid (-1, &status, WNOHANG);
+            if (pid <= 0)
+                break;
+
+            children.erase (std::remove (children.begin(), children.end(), pid), children.end());
+
+            if (! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+                std::fprintf (stderr, "thd-analyze: worker %d %s\n", static_cast<int> (pid),
+                              WIFSIGNALED (status) ? ("killed by signal " + std::to_string (WTERMSIG (status))).c_str() : "failed");
+
+            if (numSpawned < maxSpawns)
+                spawnWorker();
+        }
+
+        if (options.numWorkers > 0 && numSpawned > 0 && children.empty() && connections.empty() && numSpawned >= maxSpawns)
+        {
+            for (size_t file = numPrinted; file < plans.size(); ++file)
+                if (plans[file].numJobsLeft > 0)
+                    failFile (file, "no workers left");
+
+            printFinished();
+            break;
+        }
+
+        polled.assign (1, pollfd { listener, POLLIN, 0 });
+        for (const auto& connection : connections)
+            polled.push_back (pollfd { connection.fd, POLLIN, 0 });
+
+        if (::poll (polled.data(), polled.size(), 200) < 0 && errno != EINTR)
+            break;
+
+        if ((polled[0].revents & POLLIN) != 0)
+        {
+            const auto fd = ::accept (listener, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                ::fcntl (fd, F_SETFD, FD_CLOEXEC);
+                connections.emplace_back();
+                connections.back().fd = fd;
+            }
+        }
+
+        // Back to front, so dropping a connection leaves the indices still to visit intact.
+        for (auto index = polled.size() - 1; index > 0; --index)
+        {
+            if (polled[index].revents == 0)
+                continue;
+
+            auto& connection = connections[index - 1];
+            const auto numRead = ::read (connection.fd, readBuffer.data(), readBuffer.size());
+
+            if (numRead < 0 && errno == EINTR)
+                continue;
+
+            bool healthy = numRead > 0;
+            if (healthy)
+                connection.inbox.insert (connection.inbox.end(), readBuffer.data(), readBuffer.data() + numRead);
+
+            std::vector<uint64_t> payload;
+            size_t consumed = 0;
+
+            while (healthy && connection.inbox.size() - consumed >= sizeof (MessageHeader))
+            {
+                MessageHeader header;
+                std::memcpy (&header, connection.inbox.data() + consumed, sizeof (header));
+
+                if (header.size > maxMessageSize)
+                {
+                    healthy = false;
+                    break;
+                }
+
+                if (connection.inbox.size() - consumed - sizeof (header) < header.size)
+                    break;
+
+                payload.resize ((header.size + 7) / 8);
+                std::memcpy (payload.data(), connection.inbox.data() + consumed + sizeof (header), header.size);
+                consumed += sizeof (header) + header.size;
+
+                healthy = handleMessage (connection, header, reinterpret_cast<const unsigned char*> (payload.data()));
+            }
+
+            connection.inbox.erase (connection.inbox.begin(), connection.inbox.begin() + static_cast<std::ptrdiff_t> (consumed));
+
+            if (! healthy)
+                dropConnection (index - 1);
+        }
+
+        // Work handed back by a dead worker goes to whoever is idle.
+        for (auto& connection : connections)
+            if (connection.waiting && ! queue.empty())
+                sendJob (connection);
+
+        printFinished();
+    }
+
+    for (const auto& connection : connections)
+    {
+        sendMessage (connection.fd, MessageType::shutdown);
+        ::close (connection.fd);
+    }
+
+    // Closing the listener also resets connections never accepted, so every worker exits.
+    ::close (listener);
+    ::unlink (socketPath.c_str());
+
+    for (const auto pid : children)
+        ::waitpid (pid, nullptr, 0);
+
+    if (! options.quiet)
+    {
+        const auto seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - started).count();
+        std::fprintf (stderr, "thd-analyze: %zu files (%zu from manifest, %zu failed), %zu jobs, %zu retried, "
+                              "%zu chunks (%zu cached), %zu workers started, %.3f s\n",
+                      plans.size(), numFromManifest, numFailed, jobs.size(), numRetries, numChunks, numCached,
+                      numSpawned, seconds);
+    }
+
+    return numFailed == 0 ? 0 : 1;
+}
+}
+
+int main
+ (int argc, char** argv)
+{
+    Options options;
+    std::vector<std::string> files;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        const std::string flag = argv[arg];
+        const auto hasValue = arg + 1 < argc;
+
+        if (flag == "--cache" && hasValue)             options.cacheDirectory = argv[++arg];
+        else if (flag == "--no-cache")                 options.useCache = false;
+        else if (flag == "--rehash")                   options.rehash = true;
+        else if (flag == "--quiet")                    options.quiet = true;
+        else if (flag == "--fft-order" && hasValue)    options.fftOrder = std::atoi (argv[++arg]);
+        else if (flag == "--hop" && hasValue)          options.hopSize = std::atoi (argv[++arg]);
+        else if (flag == "--chunk-frames" && hasValue) options.framesPerChunk = std::atoi (argv[++arg]);
+        else if (flag == "--rate" && hasValue)         options.rawSampleRate = static_cast<uint32_t> (std::atoi (argv[++arg]));
+        else if (flag == "--channels" && hasValue)     options.rawChannels = static_cast<uint32_t> (std::atoi (argv[++arg]));
+        else if (flag == "--block-kb" && hasValue)     options.rawBlockBytes = static_cast<size_t> (std::max (1, std::atoi (argv[++arg]))) * 1024;
+        else if (flag == "--raw" && hasValue)
+        {
+            options.raw = true;
+            if (! parseRawFormat (argv[++arg], options.rawFormat))
+                return printUsage();
+        }
+        else if (flag == "--coordinator")              options.coordinator = true;
+        else if (flag == "--workers" && hasValue)      options.numWorkers = std::atoi (argv[++arg]);
+        else if (flag == "--segment-chunks" && hasValue) options.segmentChunks = std::atoi (argv[++arg]);
+        else if (flag == "--socket" && hasValue)       options.socketPath = argv[++arg];
+        else if (flag == "--worker" && hasValue)       options.workerSocketPath = argv[++arg];
+        else if (flag == "-")                          files.push_back (flag);
+        else if (! flag.empty() && flag[0] == '-')     return printUsage();
+        else                                           files.push_back (flag);
+    }
+
+    options.executablePath = argv[0];
+
+    if (! options.workerSocketPath.empty())
+        return runWorker (options.workerSocketPath, options);
+
+    if (options.raw && files.empty())
+        files.push_back ("-");
+
+    if (files.empty() || options.framesPerChunk < 1 || options.hopSize < 0)
+        return printUsage();
+
+    if (options.coordinator && (options.raw || options.numWorkers < 0 || options.segmentChunks < 1))
+        return printUsage();
+
+    if (options.raw && (options.rawSampleRate == 0 || options.rawChannels < 1 || options.rawChannels > THD_MAX_CHANNELS))
+    {
+        std::fprintf (stderr, "thd-analyze: --raw needs --rate and --channels 1..%d\n", THD_MAX_CHANNELS);
+        return 2;
+    }
+
+    AnalysisCache::Store store (options.cacheDirectory);
+    std::string error;
+
+    if (options.useCache && ! options.raw && ! store.open (&error))
+    {
+        std::fprintf (stderr, "thd-analyze: cache disabled: %s\n", error.c_str());
+        options.useCache = false;
+    }
+
+    static char outputBuffer[1 << 16];
+    std::setvbuf (stdout, outputBuffer, _IOFBF, sizeof (outputBuffer));
+    std::fputs ("time_s,channel,valid,f0_hz,thd_pct,thdn_pct,level_rms,noise_floor,h2,h3,h4,h5,h6,h7,h8\n", stdout);
+
+    if (options.coordinator)
+        return runCoordinator (files, options, options.useCache ? &store : nullptr);
+
+    int exitCode = 0;
+    for (const auto& file : files)
+    {
+        if (files.size() > 1)
+            std::printf ("# file=%s\n", file.c_str());
+
+        if (options.raw)
+        {
+            const auto fd = file == "-" ? STDIN_FILENO : ::open (file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                std::fprintf (stderr, "thd-analyze: %s: %s\n", file.c_str(), std::strerror (errno));
+                exitCode = 1;
+                continue;
+            }
+
+            if (! analyzeStream (fd, file == "-" ? "stdin" : file, options))
+                exitCode = 1;
+
+            if (fd != STDIN_FILENO)
+                ::close (fd);
+        }
+        else if (! analyzeFile (file, options, options.useCache ? &store : nullptr))
+        {
+            exitCode = 1;
+        }
+    }
+
+    return exitCode;
+}
@@ -0,0 +1,272 @@
+/* ==============================================================================
+   THD Analyzer IPC Client
+   Minimal command-line client for the plugin's local IPC server.
+
+   Usage:
+     thd-ipc-client [--socket PATH] [--binary] ping
+     thd-ipc-client [--socket PATH] [--binary] snapshot [channels]
+     thd-ipc-client [--socket PATH] [--binary] subscribe <channels> <rateHz> [frames]
+     thd-ipc-client [--socket PATH] at <sample> [tolerance] [channels]
+
+   "at" lists each channel's hop nearest a host timeline sample, e.g. the
+   sample position of bar 33, with a JOIN line summarising them.
+   --binary asks for binary frames (THDRecordFormat.h) and reads the records
+   in place from the receive buffer; the printed CH lines match text mode.
+
+   The socket path defaults to THD_ANALYZER_SOCKET. When the plugin was started
+   without it, its socket is thd-analyzer-<pid>.sock under XDG_RUNTIME_DIR (or /tmp).
+   ============================================================================== */
+
+#include "../Source/THDRecordFormat.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+int printUsage()
+{
+    std::fprintf (stderr,
+                  "usage: thd-ipc-client [--socket PATH] [--binary] ping\n"
+                  "       thd-ipc-client [--socket PATH] [--binary] snapshot [channels]\n"
+                  "       thd-ipc-client [--socket PATH] [--binary] subscribe <channels> <rateHz> [frames]\n"
+                  "       thd-ipc-client [--socket PATH] at <sample> [tolerance] [channels]\n");
+    return 2;
+}
+
+bool sendAll (int fd, const std::string& text)
+{
+    size_t offset = 0;
+    while (offset < text.size())
+    {
+        const auto written = ::write (fd, text.data() + offset, text.size() - offset);
+        if (written <= 0)
+            return false;
+
+        offset += static_cast<size_t> (written);
+    }
+
+    return true;
+}
+
+/** Prints every Measurement of a binary frame as a CH line; returns false if the frame is malformed. */
+bool printBinaryFrame (const void* frame, size_t numBytes)
+{
+    THDRecord::Cursor cursor (frame, numBytes);
+
+    while (const auto* header = cursor.next())
+    {
+        const auto* record = THDRecord::view<THDRecord::Measurement> (header, header->size);
+        if (record == nullptr)
+            continue; // stream header, or a record type this client does not know
+
+        std::printf ("CH id=%d seq=%llu thd=%.6g thdn=%.6g level=%.6g peak=%.6g group=%d h=",
+                     record->channelId,
+                     static_cast<unsigned long long> (record->sequence),
+                     static_cast<double> (record->thd),
+                     static_cast<double> (record->thdN),
+                     static_cast<double> (record->level),
+                     static_cast<double> (record->peakLevel),
+                     record->groupIndex);
+
+        for (size_t i = 0; i < record->harmonics.size(); ++i)
+            std::printf (i == 0 ? "%.6g" : ",%.6g", static_cast<double> (record->harmonics[i]));
+
+        std::printf ("\n");
+    }
+
+    return cursor.isAtEnd();
+}
+}
+
+int main (int argc, char** argv)
+{
+    std::string socketPath;
+    if (const auto* configured = std::getenv ("THD_ANALYZER_SOCKET"))
+        socketPath = configured;
+
+    int arg = 1;
+    bool binary = false;
+
+    for (;;)
+    {
+        if (arg + 1 < argc && std::strcmp (argv[arg], "--socket") == 0)
+        {
+            socketPath = argv[arg + 1];
+            arg += 2;
+        }
+        else if (arg < argc && std::strcmp (argv[arg], "--binary") == 0)
+        {
+            binary = true;
+            ++arg;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (arg >= argc || socketPath.empty())
+        return printUsage();
+
+    const std::string verb = argv[arg++];
+    std::string request;
+    long framesToRead = 1;
+
+    if (verb == "ping")
+    {
+        request = "PING\n";
+    }
+    else if (verb == "snapshot")
+    {
+        request = "SNAPSHOT " + std::string (arg < argc ? argv[arg] : "all") + "\n";
+    }
+    else if (verb == "subscribe" && arg + 1 < argc)
+    {
+        request = "SUBSCRIBE " + std::string (argv[arg]) + " " + argv[arg + 1] + "\n";
+        framesToRead = arg + 2 < argc ? std::strtol (argv[arg + 2], nullptr, 10) : -1;
+    }
+    else if (verb == "at" && arg < argc)
+    {
+        request = "AT";
+        for (; arg < argc; ++arg)
+            request += " " + std::string (argv[arg]);
+
+        request += "\n";
+    }
+    else
+    {
+        return printUsage();
+    }
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof (address.sun_path))
+    {
+        std::fprintf (stderr, "socket path too long: %s\n", socketPath.c_str());
+        return 1;
+    }
+
+    std::memcpy (address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    const auto fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect (fd, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) != 0)
+    {
+        std::perror (socketPath.c_str());
+        return 1;
+    }
+
+    // The server acknowledges FORMAT with OK before the real reply.
+    long acknowledgementsToSkip = 0;
+    if (binary)
+    {
+        request = "FORMAT BINARY\n" + request;
+        acknowledgementsToSkip = 1;
+    }
+
+    if (! sendAll (fd, request))
+    {
+        std::perror ("write");
+        ::close (fd);
+        return 1;
+    }
+
+    // Replies are line-delimited; a frame ends at END (or PONG/OK/ERR for single-line replies).
+    // A binary frame is a "BIN <bytes>" line followed by that many bytes of records, which are
+    // gathered into an 8-byte aligned buffer so they can be read in place.
+    std::string pending;
+    std::vector<uint64_t> frame;
+    size_t frameBytes = 0;
+    size_t frameFilled = 0;
+    bool inBinaryFrame = false;
+    long framesSeen = 0;
+    char buffer[4096];
+
+    while (framesToRead < 0 || framesSeen < framesToRead)
+    {
+        const auto bytesRead = ::read (fd, buffer, sizeof (buffer));
+        if (bytesRead <= 0)
+            break;
+
+        pending.append (buffer, static_cast<size_t> (bytesRead));
+
+        for (;;)
+        {
+            if (inBinaryFrame)
+            {
+                const auto toCopy = std::min (frameBytes - frameFilled, pending.size());
+                std::memcpy (reinterpret_cast<char*> (frame.data()) + frameFilled, pending.data(), toCopy);
+                pending.erase (0, toCopy);
+                frameFilled += toCopy;
+
+                if (frameFilled < frameBytes)
+                    break;
+
+                inBinaryFrame = false;
+                ++framesSeen;
+
+                if (! printBinaryFrame (frame.data(), frameBytes))
+                {
+                    std::fprintf (stderr, "malformed binary frame\n");
+                    ::close (fd);
+                    return 1;
+                }
+
+                if (framesToRead >= 0 && framesSeen >= framesToRead)
+                    break;
+
+                continue;
+            }
+
+            const auto newline = pending.find ('\n');
+            if (newline == std::string::npos)
+                break;
+
+            const auto line = pending.substr (0, newline);
+            pending.erase (0, newline + 1);
+
+            if (line.rfind ("BIN ", 0) == 0)
+            {
+                frameBytes = static_cast<size_t> (std::strtoull (line.c_str() + 4, nullptr, 10));
+                frame.assign ((frameBytes + sizeof (uint64_t) - 1) / sizeof (uint64_t), 0);
+                frameFilled = 0;
+                inBinaryFrame = true;
+                continue;
+            }
+
+            if (line == "OK" && acknowledgementsToSkip > 0)
+            {
+                --acknowledgementsToSkip;
+                continue;
+            }
+
+            std::printf ("%s\n", line.c_str());
+
+            if (line.rfind ("ERR", 0) == 0)
+            {
+                ::close (fd);
+                return 1;
+            }
+
+            if (line == "END" || line == "PONG")
+                ++framesSeen;
+
+            if (framesToRead >= 0 && framesSeen >= framesToRead)
+                break;
+        }
+
+        std::fflush (stdout);
+    }
+
+    sendAll (fd, "QUIT\n");
+    ::close (fd);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/* ==============================================================================
+   THD Log Index Tool
+   Builds or updates the LOD index (<log>.thdx) of binary measurement logs
+   ahead of viewing, and times what the log viewer does with it: opening,
+   and panning a window across every channel lane.
+
+   Usage:
+     thd-log-index [--rebuild] [--bench] [--width PX] [--window SECONDS] LOG.thdr...
+
+   --rebuild  deletes the existing index first, so the full build is timed
+   --bench    after opening, queries every channel at --width points (default
+              1600) for a --window (default 3600 s) stepped across the log,
+              as one viewer frame per step, and reports the time per frame
+   ============================================================================== */
+
+#include "../Source/MeasurementLogIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli> (Clock::now() - start).count();
+}
+
+void printUsage()
+{
+    std::fprintf (stderr, "usage: thd-log-index [--rebuild] [--bench] [--width PX] [--window SECONDS] LOG.thdr...\n");
+}
+
+void benchmarkPan (const MeasurementLogIndex& index, int width, double window)
+{
+    const auto channelIds = index.getChannelIds();
+    const auto start = index.getStartTime();
+    const auto span = std::max (0.0, index.getEndTime() - start - window);
+    constexpr int numFrames = 120;
+
+    std::vector<MeasurementLogIndex::Span> spans;
+    const auto began = Clock::now();
+
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        const auto from = start + span * frame / (numFrames - 1);
+
+        for (const auto channelId : channelIds)
+            index.query (channelId, MeasurementLogIndex::Column::thdN, from, from + window, width, spans);
+    }
+
+    std::printf ("  pan: %.3f ms per frame (%zu lanes x %d points, %.0f s window)\n",
+                 millisecondsSince (began) / numFrames, channelIds.size(), width, window);
+}
+}
+
+int main (int argc, char** argv)
+{
+    auto rebuild = false;
+    auto bench = false;
+    auto width = 1600;
+    auto window = 3600.0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp (argv[i], "--rebuild") == 0)
+            rebuild = true;
+        else if (std::strcmp (argv[i], "--bench") == 0)
+            bench = true;
+        else if (std::strcmp (argv[i], "--width") == 0 && i + 1 < argc)
+            width = std::max (1, std::atoi (argv[++i]));
+        else if (std::strcmp (argv[i], "--window") == 0 && i + 1 < argc)
+            window = std::max (0.001, std::atof (argv[++i]));
+        else if (argv[i][0] == '-')
+        {
+            printUsage();
+            return 2;
+        }
+        else
+            paths.emplace_back (argv[i]);
+    }
+
+    if (paths.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    auto failures = 0;
+
+    for (const auto& path : paths)
+    {
+        if (rebuild)
+            std::remove (MeasurementLogIndex::indexPathFor (path).c_str());
+
+        MeasurementLogIndex index;
+        std::string error;
+        const auto began = Clock::now();
+
+        if (! index.open (path, &error))
+        {
+            std::fprintf (stderr, "%s: %s\n", path.c_str(), error.c_str());
+            ++failures;
+            continue;
+        }
+
+        const auto openMs = millisecondsSince (began);
+        const auto channelIds = index.getChannelIds();
+        auto numLevels = 0;
+
+        for (const auto channelId : channelIds)
+            numLevels = std::max (numLevels, index.getNumLevels (channelId));
+
+        std::printf ("%s: %llu rows, %zu channels, %.1f s, %d levels; opened in %.2f ms (%s)\n",
+                     path.c_str(), static_cast<unsigned long long> (index.getNumRows()), channelIds.size(),
+                     index.getEndTime() - index.getStartTime(), numLevels, openMs,
+                     index.wasLoadedFromDisk() ? "index loaded" : "index built");
+
+        if (bench)
+            benchmarkPan (index, width, window);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/* ==============================================================================
+   THD Record Format Benchmark
+   Measures encode/decode of THDRecordFormat.h records against a plain memcpy
+   of the same bytes, with the IPC text format as a reference point.
+
+   Usage:
+     thd-record-bench [records] [iterations]
+
+   encode       writes ready-made records into a frame buffer (THDRecord::write)
+   encode+fill  builds each record from a log row first, as MeasurementLog does
+   decode       walks the frame with THDRecord::Cursor/view and reads fields in place
+   text         formats and parses the same rows as IPC CH lines
+   ============================================================================== */
+
+#include "../Source/THDRecordFormat.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Row
+{
+    double timeSeconds;
+    int channelId;
+    uint64_t sequence;
+    float thd, thdN, level, peakLevel;
+    std::array<float, 7> harmonics;
+};
+
+// Keeps the optimiser from discarding work whose result is otherwise unused.
+volatile double sink = 0.0;
+
+template <typename Function>
+double bestSecondsPerIteration (int iterations, Function&& function)
+{
+    auto best = 1.0e30;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+        best = elapsed < best ? elapsed : best;
+    }
+
+    return best;
+}
+
+void report (const char* name, double seconds, size_t numRecords, size_t numBytes, double memcpySeconds)
+{
+    std::printf ("%-12s %8.2f ns/record %8.2f GB/s %8.2fx memcpy\n",
+                 name,
+                 seconds * 1.0e9 / static_cast<double> (numRecords),
+                 static_cast<double> (numBytes) / seconds * 1.0e-9,
+                 seconds / memcpySeconds);
+}
+}
+
+int main (int argc, char** argv)
+{
+    const auto numRecords = static_cast<size_t> (argc > 1 ? std::strtoul (argv[1], nullptr, 10) : 65536);
+    const auto iterations = argc > 2 ? std::atoi (argv[2]) : 50;
+
+    if (numRecords == 0 || iterations <= 0)
+    {
+        std::fprintf (stderr, "usage: thd-record-bench [records] [iterations]\n");
+        return 2;
+    }
+
+    std::vector<Row> rows (numRecords);
+    std::vector<THDRecord::Measurement> records (numRecords);
+
+    for (size_t i = 0; i < numRecords; ++i)
+    {
+        auto& row = rows[i];
+        row.timeSeconds = static_cast<double> (i) * 0.01;
+        row.channelId = static_cast<int> (i % 64);
+        row.sequence = i;
+        row.thd = 0.01f * static_cast<float> (i % 100);
+        row.thdN = row.thd * 1.5f;
+        row.level = 0.1f;
+        row.peakLevel = 0.3f;
+        for (size_t h = 0; h < row.harmonics.size(); ++h)
+            row.harmonics[h] = row.thd / static_cast<float> (h + 2);
+
+        records[i] = THDRecord::makeMeasurement();
+        records[i].channelId = row.channelId;
+        records[i].sequence = row.sequence;
+        records[i].thd = row.thd;
+    }
+
+    const auto payloadBytes = numRecords * sizeof (THDRecord::Measurement);
+    const auto frameBytes = sizeof (THDRecord::StreamHeader) + payloadBytes;
+    std::vector<uint64_t> frameStorage (frameBytes / sizeof (uint64_t));
+    std::vector<uint64_t> copyStorage (frameStorage.size());
+    auto* frame = reinterpret_cast<unsigned char*> (frameStorage.data());
+
+    const auto memcpySeconds = bestSecondsPerIteration (iterations, [&]
+    {
+        std::memcpy (copyStorage.data(), records.data(), payloadBytes);
+        sink = sink + static_cast<double> (reinterpret_cast<const float*> (copyStorage.data())[14]);
+    });
+
+    const auto encodeSeconds = bestSecondsPerIteration (iterations, [&]
+    {
+        auto header = THDRecord::make<THDRecord::StreamHeader>();
+        header.numRecords = static_cast<uint32_t> (numRecords);
+        auto offset = THDRecord::write (frame, frameBytes, header);
+
+        for (const auto& record : records)
+            offset += THDRecord::write (frame + offset, frameBytes - offset, record);
+
+        sink = sink + static_cast<double> (offset);
+    });
+
+    const auto encodeFillSeconds = bestSecondsPerIteration (iterations, [&]
+    {
+        auto header = THDRecord::make<THDRecord::StreamHeader>();
+        auto offset = THDRecord::write (frame, frameBytes, header);
+
+        for (const auto& row : rows)
+        {
+            auto record = THDRecord::makeMeasurement();
+            record.channelId = row.channelId;
+            record.sequence = row.sequence;
+            record.timeSeconds = row.timeSeconds;
+            record.thd = row.thd;
+            record.thdN = row.thdN;
+            record.level = row.level;
+            record.peakLevel = row.peakLevel;
+            record.harmonics = row.harmonics;
+            offset += THDRecord::write (frame + offset, frameBytes - offset, record);
+        }
+
+        sink = sink + static_cast<double> (offset);
+    });
+
+    size_t decoded = 0;
+    const auto decodeSeconds = bestSecondsPerIteration (iterations, [&]
+    {
+        THDRecord::Cursor cursor (frame, frameBytes);
+        double thdSum = 0.0;
+        decoded = 0;
+
+        while (const auto* header = cursor.next())
+        {
+            if (const auto* record = THDRecord::view<THDRecord::Measurement> (header, header->size))
+            {
+                thdSum += static_cast<double> (record->thd);
+                ++decoded;
+            }
+        }
+
+        sink = sink + thdSum;
+    });
+
+    if (decoded != numRecords)
+    {
+        std::fprintf (stderr, "decode walked %zu of %zu records\n", decoded, numRecords);
+        return 1;
+    }
+
+    std::string text;
+    const auto textSeconds = bestSecondsPerIteration (iterations < 5 ? iterations : 5, [&]
+    {
+        text.clear();
+        char line[512];
+
+        for (const auto& row : rows)
+        {
+            const auto written = std::snprintf (line, sizeof (line),
+                                                "CH id=%d seq=%llu thd=%.6g thdn=%.6g level=%.6g peak=%.6g group=-1 h=%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                                                row.channelId, static_cast<unsigned long long> (row.sequence),
+                                                static_cast<double> (row.thd), static_cast<double> (row.thdN),
+                                                static_cast<double> (row.level), static_cast<double> (row.peakLevel),
+                                                static_cast<double> (row.harmonics[0]), static_cast<double> (row.harmonics[1]),
+                                                static_cast<double> (row.harmonics[2]), static_cast<double> (row.harmonics[3]),
+                                                static_cast<double> (row.harmonics[4]), static_cast<double> (row.harmonics[5]),
+                                                static_cast<double> (row.harmonics[6]));
+            text.append (line, static_cast<size_t> (written));
+        }
+
+        double thdSum = 0.0;
+        for (const char* cursor = std::strstr (text.c_str(), "thd="); cursor != nullptr; cursor = std::strstr (cursor + 4, " thd="))
+            thdSum += std::strtod (cursor + (cursor[0] == ' ' ? 5 : 4), nullptr);
+
+        sink = sink + thdSum;
+    });
+
+    std::printf ("%zu records x %zu bytes, best of %d\n", numRecords, sizeof (THDRecord::Measurement), iterations);
+    report ("memcpy", memcpySeconds, numRecords, payloadBytes, memcpySeconds);
+    report ("encode", encodeSeconds, numRecords, frameBytes, memcpySeconds);
+    report ("encode+fill", encodeFillSeconds, numRecords, frameBytes, memcpySeconds);
+    report ("decode", decodeSeconds, numRecords, frameBytes, memcpySeconds);
+    report ("text", textSeconds, numRecords, text.size(), memcpySeconds);
+    return 0;
+}